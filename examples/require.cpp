@@ -16,15 +16,11 @@ int main() {
     lua["package"]["path"] = "?.lua";
 
     auto deferred = typedlua::DeferredTypeCollection();
-    auto scope = typedlua::Scope(&deferred);
-
-    scope.enable_basic_types();
+    auto scope = typedlua::Scope(&typedlua::libs::prelude(), &deferred);
 
     typedlua::install_loader(lua.lua_state(), scope);
     typedlua::install_require(lua.lua_state(), scope);
 
-    typedlua::libs::import_package(scope);
-
     lua.script(R"(
         local testsimple = require('testsimple')
         testsimple.test()
@@ -1,6 +1,7 @@
 
 #include "sol.hpp"
 #include <loader.hpp>
+#include <libs.hpp>
 
 int main() {
     sol::state lua;
@@ -14,9 +15,7 @@ int main() {
     lua["package"]["path"] = "?.lua";
 
     auto deferred = typedlua::DeferredTypeCollection();
-    auto scope = typedlua::Scope(&deferred);
-
-    scope.enable_basic_types();
+    auto scope = typedlua::Scope(&typedlua::libs::prelude(), &deferred);
 
     typedlua::install_loader(lua.lua_state(), scope);
 
@@ -0,0 +1,27 @@
+#include "arena.hpp"
+
+#include <algorithm>
+#include <cstdint>
+
+namespace typedlua {
+
+void* Arena::allocate(std::size_t size, std::size_t align) {
+    auto padding = (align - reinterpret_cast<std::uintptr_t>(head) % align) % align;
+
+    if (!head || padding + size > remaining) {
+        auto capacity = std::max(chunk_size, size + align);
+        chunks.push_back(std::make_unique<std::byte[]>(capacity));
+        head = chunks.back().get();
+        remaining = capacity;
+        padding = (align - reinterpret_cast<std::uintptr_t>(head) % align) % align;
+    }
+
+    auto result = head + padding;
+    head += padding + size;
+    remaining -= padding + size;
+    allocated += size;
+
+    return result;
+}
+
+} // namespace typedlua
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace typedlua {
+
+// Bump allocator whose memory is released all at once when it is destroyed.
+class Arena {
+public:
+    explicit Arena(std::size_t chunk_size = 64 * 1024) : chunk_size(chunk_size) {}
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    void* allocate(std::size_t size, std::size_t align);
+
+    std::size_t bytes_allocated() const { return allocated; }
+
+private:
+    std::size_t chunk_size;
+    std::vector<std::unique_ptr<std::byte[]>> chunks;
+    std::byte* head = nullptr;
+    std::size_t remaining = 0;
+    std::size_t allocated = 0;
+};
+
+} // namespace typedlua
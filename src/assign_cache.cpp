@@ -0,0 +1,243 @@
+#include "assign_cache.hpp"
+
+#include "type_identity.hpp"
+
+#include <algorithm>
+#include <optional>
+#include <utility>
+
+namespace typedlua {
+
+namespace { // static
+
+thread_local AssignCache* current_cache = nullptr;
+
+std::size_t hash_overload(const OverloadIndex& index, const std::vector<Type>& args) {
+    auto hash = std::hash<const OverloadIndex*>{}(&index);
+
+    for (const auto& arg : args) {
+        hash = hash * 31 + hash_type(arg);
+    }
+
+    return hash;
+}
+
+bool same_args(const std::vector<Type>& lhs, const std::vector<Type>& rhs) {
+    if (lhs.size() != rhs.size()) {
+        return false;
+    }
+
+    for (auto i = 0u; i < lhs.size(); ++i) {
+        if (!same_type(lhs[i], rhs[i])) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool is_narrowing(const DeferredType& defer) {
+    return defer.collection->is_narrowing(defer.id);
+}
+
+} // static
+
+AssignCache::AssignCache() : previous(std::exchange(current_cache, this)) {}
+
+AssignCache::~AssignCache() {
+    current_cache = previous;
+}
+
+AssignCache* AssignCache::current() {
+    return current_cache;
+}
+
+AssignCache::Result AssignCache::lookup(const DeferredType& lhs, const DeferredType& rhs) const {
+    auto iter = entries.find(make_key(lhs, rhs));
+
+    if (iter != entries.end()) {
+        return iter->second.result;
+    }
+
+    return Result::UNKNOWN;
+}
+
+void AssignCache::begin(const DeferredType& lhs, const DeferredType& rhs) {
+    entries.insert_or_assign(make_key(lhs, rhs), Entry{Result::PENDING, log.size()});
+}
+
+void AssignCache::finish(const DeferredType& lhs, const DeferredType& rhs, bool yes) {
+    auto key = make_key(lhs, rhs);
+
+    if (!reducing.empty()) {
+        entries.erase(key);
+        return;
+    }
+
+    auto& entry = entries.at(key);
+
+    if (!yes) {
+        // Successes recorded since this pair began may rest on the assumption that it was assignable.
+        // Failures never do, since assumptions only ever make a comparison succeed.
+        for (auto i = entry.mark; i < log.size(); ++i) {
+            entries.erase(log[i]);
+        }
+
+        log.resize(entry.mark);
+    }
+
+    // A narrowing entry may change through a later assignment without its pair noticing, if it changes one it refers to.
+    if (is_narrowing(lhs) || is_narrowing(rhs)) {
+        entries.erase(key);
+        return;
+    }
+
+    if (yes) {
+        entry.result = Result::YES;
+        log.push_back(std::move(key));
+    } else {
+        entry.result = Result::NO;
+    }
+}
+
+bool AssignCache::begin_explain(const DeferredType& lhs, const DeferredType& rhs) {
+    return explaining.insert(make_key(lhs, rhs)).second;
+}
+
+void AssignCache::finish_explain(const DeferredType& lhs, const DeferredType& rhs) {
+    explaining.erase(make_key(lhs, rhs));
+}
+
+void AssignCache::begin_reduce(const DeferredType& defer) {
+    reducing.emplace_back(defer.collection, defer.id);
+}
+
+void AssignCache::finish_reduce() {
+    reducing.pop_back();
+}
+
+bool AssignCache::is_reducing(const DeferredType& defer) const {
+    return std::find(reducing.begin(), reducing.end(), std::make_pair(static_cast<const DeferredTypeCollection*>(defer.collection), defer.id)) != reducing.end();
+}
+
+const Type* AssignCache::find_instance(const DeferredType& defer) const {
+    auto iter = instances.find(defer);
+
+    if (iter == instances.end() || iter->second.version != defer.collection->get_version(defer.id)) {
+        return nullptr;
+    }
+
+    return &iter->second.type;
+}
+
+void AssignCache::add_instance(const DeferredType& defer, Type type) {
+    instances.insert_or_assign(defer, Instance{defer.collection->get_version(defer.id), std::move(type)});
+}
+
+std::optional<int> AssignCache::find_overload(const OverloadIndex& index, const std::vector<Type>& args) const {
+    auto [first, last] = overloads.equal_range(hash_overload(index, args));
+
+    for (auto iter = first; iter != last; ++iter) {
+        if (iter->second.index.get() == &index && same_args(iter->second.args, args)) {
+            return iter->second.position;
+        }
+    }
+
+    return std::nullopt;
+}
+
+void AssignCache::add_overload(std::shared_ptr<const OverloadIndex> index, std::vector<Type> args, int position) {
+    for (auto& arg : args) {
+        arg = intern(arg);
+    }
+
+    auto hash = hash_overload(*index, args);
+    overloads.emplace(hash, Overload{std::move(index), std::move(args), position});
+}
+
+AssignCache::Key AssignCache::make_key(const DeferredType& lhs, const DeferredType& rhs) {
+    return Key{lhs, rhs, lhs.collection->get_version(lhs.id), rhs.collection->get_version(rhs.id)};
+}
+
+std::size_t AssignCache::KeyHash::operator()(const Key& key) const {
+    return (hash_deferred(key.lhs) * 31 + hash_deferred(key.rhs)) * 31 + key.lversion * 7 + key.rversion;
+}
+
+bool AssignCache::KeyEqual::operator()(const Key& lhs, const Key& rhs) const {
+    return lhs.lversion == rhs.lversion && lhs.rversion == rhs.rversion
+        && same_deferred(lhs.lhs, rhs.lhs) && same_deferred(lhs.rhs, rhs.rhs);
+}
+
+std::size_t AssignCache::DeferredHash::operator()(const DeferredType& defer) const {
+    return hash_deferred(defer);
+}
+
+bool AssignCache::DeferredEqual::operator()(const DeferredType& lhs, const DeferredType& rhs) const {
+    return same_deferred(lhs, rhs);
+}
+
+bool is_being_reduced(const DeferredType& defer) {
+    auto cache = AssignCache::current();
+    return cache && cache->is_reducing(defer);
+}
+
+bool can_assign(const DeferredType& ldefer, const DeferredType& rdefer) {
+    if (ldefer.collection == rdefer.collection && ldefer.id == rdefer.id) {
+        return true;
+    }
+
+    if (is_being_reduced(ldefer) || is_being_reduced(rdefer)) {
+        return false;
+    }
+
+    auto session = std::optional<AssignCache>{};
+    auto cache = AssignCache::current();
+
+    if (!cache) {
+        cache = &session.emplace();
+    }
+
+    switch (cache->lookup(ldefer, rdefer)) {
+        case AssignCache::Result::PENDING: return true;
+        case AssignCache::Result::YES: return true;
+        case AssignCache::Result::NO: return false;
+        default: break;
+    }
+
+    cache->begin(ldefer, rdefer);
+
+    auto result = can_assign(reduce_deferred(ldefer, {}), rdefer);
+
+    cache->finish(ldefer, rdefer, result);
+
+    return result;
+}
+
+AssignResult is_assignable(const DeferredType& ldefer, const DeferredType& rdefer) {
+    auto session = std::optional<AssignCache>{};
+    auto cache = AssignCache::current();
+
+    if (!cache) {
+        cache = &session.emplace();
+    }
+
+    if (can_assign(ldefer, rdefer)) {
+        return true;
+    }
+
+    if (is_being_reduced(ldefer) || is_being_reduced(rdefer)) {
+        return {false, cannot_assign(ldefer, rdefer)};
+    }
+
+    if (!cache->begin_explain(ldefer, rdefer)) {
+        return true;
+    }
+
+    auto result = is_assignable(reduce_deferred(ldefer, {}), rdefer);
+
+    cache->finish_explain(ldefer, rdefer);
+
+    return result;
+}
+
+} // namespace typedlua
@@ -0,0 +1,123 @@
+#pragma once
+
+#include "type.hpp"
+
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace typedlua {
+
+// Memo of `can_assign` results between deferred types, of their instantiations, and of overload resolutions, for one check session.
+// While constructed, it is the current cache of its thread.
+// Pairs still being compared are assumed assignable, so recursive interfaces are related coinductively.
+// If such an assumption fails, results derived from it are dropped.
+// Pairs are keyed on the versions of both entries, and pairs involving a narrowing entry are never kept,
+// since narrowing changes the entry, or one it refers to, while the session goes on.
+class AssignCache {
+public:
+    enum class Result {
+        UNKNOWN,
+        PENDING,
+        YES,
+        NO
+    };
+
+    AssignCache();
+    AssignCache(const AssignCache&) = delete;
+    AssignCache& operator=(const AssignCache&) = delete;
+    ~AssignCache();
+
+    static AssignCache* current();
+
+    Result lookup(const DeferredType& lhs, const DeferredType& rhs) const;
+
+    void begin(const DeferredType& lhs, const DeferredType& rhs);
+
+    void finish(const DeferredType& lhs, const DeferredType& rhs, bool yes);
+
+    // Guards the diagnostic path against re-entering a pair it is already explaining.
+    bool begin_explain(const DeferredType& lhs, const DeferredType& rhs);
+
+    void finish_explain(const DeferredType& lhs, const DeferredType& rhs);
+
+    // While a deferred type's body is being reduced, probes against that type fail.
+    // Rebuilding a self-referential union like `T|nil` then keeps both members instead of reducing `T` again.
+    // Results computed meanwhile are not memoized.
+    void begin_reduce(const DeferredType& defer);
+
+    void finish_reduce();
+
+    bool is_reducing(const DeferredType& defer) const;
+
+    // The reduced type of `defer` memoized by add_instance, unless its entry changed since.
+    // Only reductions outside of any other reduction are memoized, since those are not affected by the probes failing.
+    const Type* find_instance(const DeferredType& defer) const;
+
+    void add_instance(const DeferredType& defer, Type type);
+
+    bool is_reducing() const { return !reducing.empty(); }
+
+    // Which member of the product indexed by `index` accepted these argument types, or -1 if none did.
+    // Only used for memoizable products and arguments with no deferred or nominal types, whose resolution never changes.
+    std::optional<int> find_overload(const OverloadIndex& index, const std::vector<Type>& args) const;
+
+    void add_overload(std::shared_ptr<const OverloadIndex> index, std::vector<Type> args, int position);
+
+private:
+    struct Key {
+        DeferredType lhs;
+        DeferredType rhs;
+        unsigned lversion;
+        unsigned rversion;
+    };
+
+    static Key make_key(const DeferredType& lhs, const DeferredType& rhs);
+
+    struct KeyHash {
+        std::size_t operator()(const Key& key) const;
+    };
+
+    struct KeyEqual {
+        bool operator()(const Key& lhs, const Key& rhs) const;
+    };
+
+    struct Entry {
+        Result result;
+        std::size_t mark;
+    };
+
+    struct DeferredHash {
+        std::size_t operator()(const DeferredType& defer) const;
+    };
+
+    struct DeferredEqual {
+        bool operator()(const DeferredType& lhs, const DeferredType& rhs) const;
+    };
+
+    struct Instance {
+        unsigned version;
+        Type type;
+    };
+
+    struct Overload {
+        // Keeps the index alive, so that its address is not reused by another product.
+        std::shared_ptr<const OverloadIndex> index;
+        std::vector<Type> args;
+        int position;
+    };
+
+    std::unordered_map<Key, Entry, KeyHash, KeyEqual> entries;
+    std::vector<Key> log;
+    std::unordered_set<Key, KeyHash, KeyEqual> explaining;
+    std::vector<std::pair<const DeferredTypeCollection*, int>> reducing;
+    std::unordered_map<DeferredType, Instance, DeferredHash, DeferredEqual> instances;
+    std::unordered_multimap<std::size_t, Overload> overloads;
+    AssignCache* previous;
+};
+
+} // namespace typedlua
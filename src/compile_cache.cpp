@@ -0,0 +1,412 @@
+#include "compile_cache.hpp"
+
+#include "prelude_blob.hpp"
+#include "serialize.hpp"
+#include "type_identity.hpp"
+#include "typedlua_compiler.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace typedlua {
+
+namespace { // static
+
+namespace fs = std::filesystem;
+
+constexpr auto entry_magic = std::string_view("TLC3");
+
+// Bump whenever the emitted Lua or the entry layout changes, so old entries stop matching.
+constexpr auto cache_version = std::string_view("typedlua-cache-3");
+
+std::uint64_t fnv1a(std::string_view data, std::uint64_t hash = 0xcbf29ce484222325) {
+    for (auto c : data) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 0x100000001b3;
+    }
+    return hash;
+}
+
+// A compiler with a different stdlib must not reuse entries either.
+std::uint64_t cache_seed() {
+    static const auto seed = fnv1a(
+        std::string_view(reinterpret_cast<const char*>(libs::prelude_blob), libs::prelude_blob_size),
+        fnv1a(cache_version));
+    return seed;
+}
+
+// The module type and the types of its globals are written as one tuple, so that entries they share stay shared.
+std::string encode_entry(
+    std::string_view source,
+    std::uint64_t environment,
+    const std::vector<CompiledDependency>& dependencies,
+    const std::vector<NameType>& globals,
+    const CompiledModule& module,
+    const DeferredTypeCollection& collection) {
+    auto out = std::string(entry_magic);
+
+    serialize_string(out, source);
+    serialize_uint(out, environment);
+    serialize_uint(out, dependencies.size());
+    for (const auto& dependency : dependencies) {
+        serialize_string(out, dependency.name);
+        serialize_uint(out, dependency.interface_hash);
+    }
+    serialize_string(out, module.lua);
+    serialize_string(out, module.warnings);
+
+    auto types = std::vector<Type>{module.type};
+    serialize_uint(out, globals.size());
+    for (const auto& global : globals) {
+        serialize_string(out, global.name);
+        types.push_back(global.type);
+    }
+    serialize_type_closure(out, Type::make_tuple(std::move(types), false), collection);
+
+    return out;
+}
+
+// Warnings alone do not keep a module from compiling.
+bool has_errors(const std::vector<CompileError>& errors) {
+    return std::any_of(errors.begin(), errors.end(), [](const CompileError& error) {
+        return error.severity == CompileError::Severity::ERROR;
+    });
+}
+
+std::optional<std::string> read_file(const fs::path& path) {
+    auto file = std::ifstream(path, std::ios::binary);
+
+    if (!file) {
+        return std::nullopt;
+    }
+
+    auto ss = std::stringstream{};
+    ss << file.rdbuf();
+    return ss.str();
+}
+
+} // static
+
+CompileCache::CompileCache(std::filesystem::path directory) : directory(std::move(directory)) {
+    auto ec = std::error_code{};
+    fs::create_directories(this->directory, ec);
+}
+
+std::optional<CompiledModule> CompileCache::load(std::string_view source, Scope& global_scope) const {
+    auto data = read_file(entry_path(source));
+
+    if (!data) {
+        return std::nullopt;
+    }
+
+    auto in = std::string_view(*data);
+
+    if (in.substr(0, entry_magic.size()) != entry_magic) {
+        return std::nullopt;
+    }
+
+    try {
+        auto pos = entry_magic.size();
+
+        // Sources whose hashes collide share a path, so only the source itself tells them apart.
+        if (deserialize_string(in, pos) != source) {
+            return std::nullopt;
+        }
+
+        if (deserialize_uint(in, pos) != environment_hash(global_scope)) {
+            return std::nullopt;
+        }
+
+        auto& collection = global_scope.get_deferred_types();
+        const auto& get_package_type = global_scope.get_get_package_type();
+
+        auto module = CompiledModule{};
+
+        auto dependency_count = deserialize_uint(in, pos);
+        for (auto i = 0u; i < dependency_count; ++i) {
+            auto name = deserialize_string(in, pos);
+            auto expected = deserialize_uint(in, pos);
+
+            if (!get_package_type || interface_hash(get_package_type(name), collection) != expected) {
+                return std::nullopt;
+            }
+
+            module.dependencies.push_back(std::move(name));
+        }
+
+        module.lua = deserialize_string(in, pos);
+        module.warnings = deserialize_string(in, pos);
+
+        auto global_names = std::vector<std::string>(deserialize_count(in, pos));
+        for (auto& name : global_names) {
+            name = deserialize_string(in, pos);
+        }
+
+        auto types = deserialize_type_closure(in, pos, collection);
+
+        if (types.get_tag() != Type::Tag::TUPLE) {
+            return std::nullopt;
+        }
+
+        const auto& members = types.get_tuple().types;
+
+        if (members.size() != global_names.size() + 1) {
+            return std::nullopt;
+        }
+
+        module.type = members[0];
+
+        for (auto i = 0u; i < global_names.size(); ++i) {
+            global_scope.add_global_name(global_names[i], members[i + 1]);
+        }
+
+        return module;
+    } catch (const std::runtime_error&) {
+        // Truncated or corrupt, most likely from an older build. It is overwritten once recompiled.
+        return std::nullopt;
+    } catch (const std::logic_error&) {
+        // The globals refer to another collection, so they have no hash to compare.
+        return std::nullopt;
+    }
+}
+
+void CompileCache::store(
+    std::string_view source,
+    std::uint64_t environment,
+    const std::vector<CompiledDependency>& dependencies,
+    const std::vector<NameType>& globals,
+    const CompiledModule& module,
+    const DeferredTypeCollection& collection) const {
+    auto path = entry_path(source);
+    auto data = encode_entry(source, environment, dependencies, globals, module, collection);
+
+    auto temp_path = path;
+    temp_path += "." + std::to_string(std::random_device{}()) + ".tmp";
+
+    {
+        auto file = std::ofstream(temp_path, std::ios::binary);
+        file << data;
+
+        if (!file) {
+            auto ec = std::error_code{};
+            fs::remove(temp_path, ec);
+            return;
+        }
+    }
+
+    // Readers see either the old entry or the new one, never a partial write.
+    auto ec = std::error_code{};
+    fs::rename(temp_path, path, ec);
+
+    if (ec) {
+        fs::remove(temp_path, ec);
+    }
+}
+
+std::filesystem::path CompileCache::entry_path(std::string_view source) const {
+    char name[21];
+    std::snprintf(name, sizeof(name), "%016llx.tlc", static_cast<unsigned long long>(fnv1a(source, cache_seed())));
+    return directory / name;
+}
+
+std::uint64_t interface_hash(const Type& type, const DeferredTypeCollection& collection) {
+    auto data = std::string{};
+    serialize_type_closure(data, type, collection);
+    return fnv1a(data);
+}
+
+std::uint64_t environment_hash(Scope& global_scope) {
+    const auto& collection = global_scope.get_deferred_types();
+
+    // Sorted, so that the hash does not depend on the order the names were added in.
+    auto names = std::map<std::string, const Type*>{};
+    for (const auto& [name, type] : global_scope.get_names()) {
+        names.emplace(name.str(), &type);
+    }
+
+    auto types = std::map<std::string, const Type*>{};
+    for (const auto& [name, type] : global_scope.get_types()) {
+        types.emplace(name.str(), &type);
+    }
+
+    auto data = std::string{};
+
+    for (const auto* map : {&names, &types}) {
+        serialize_uint(data, map->size());
+        for (const auto& [name, type] : *map) {
+            serialize_string(data, name);
+            serialize_type_closure(data, *type, collection);
+        }
+    }
+
+    return fnv1a(data);
+}
+
+namespace { // static
+
+// Loads or checks and compiles the module into `result`, within the generation compile_module opened.
+void compile_into(CompiledModule& result, std::string source, Scope& global_scope, const CompileCache* cache) {
+    auto source_size = source.size();
+    auto& collection = global_scope.get_deferred_types();
+
+    if (cache) {
+        if (auto module = cache->load(source, global_scope)) {
+            result = std::move(*module);
+            return;
+        }
+    }
+
+    // Padded for in-place scanning.
+    source.append(2, '\0');
+
+    auto [root_node, errors] = parse_in_place(source.data(), source.size());
+
+    auto dependencies = std::map<std::string, std::uint64_t>{};
+    auto cacheable = cache != nullptr;
+    auto environment = std::uint64_t{};
+
+    // The globals the module declares are the names it adds to the root scope or gives another type.
+    // A warm load sets all of them again, so it leaves the same environment as checking did.
+    auto previous_globals = std::unordered_map<Symbol, Type>{};
+
+    if (cacheable) {
+        try {
+            environment = environment_hash(global_scope);
+        } catch (const std::logic_error&) {
+            cacheable = false;
+        }
+
+        for (const auto& [name, type] : global_scope.get_names()) {
+            previous_globals.emplace(name, type);
+        }
+    }
+
+    if (root_node && !has_errors(errors)) {
+        auto scope = Scope(&global_scope);
+        scope.deduce_return_type();
+
+        // Records every package the module's types reach, so the module can be invalidated when one changes.
+        const auto& get_package_type = global_scope.get_get_package_type();
+
+        if (get_package_type) {
+            scope.set_get_package_type([&](const std::string& name) {
+                auto type = get_package_type(name);
+
+                result.dependencies.push_back(name);
+
+                if (cacheable && dependencies.count(name) == 0) {
+                    try {
+                        dependencies.emplace(name, interface_hash(type, collection));
+                    } catch (const std::logic_error&) {
+                        // Types from another collection have no portable encoding.
+                        cacheable = false;
+                    }
+                }
+
+                return type;
+            });
+        }
+
+        auto check_errors = check(*root_node, scope);
+        errors.insert(errors.end(), check_errors.begin(), check_errors.end());
+
+        if (!has_errors(errors)) {
+            auto rettype = scope.get_return_type();
+
+            if (rettype) {
+                result.type = *rettype;
+            }
+        }
+    }
+
+    if (has_errors(errors)) {
+        auto oss = std::ostringstream{};
+        oss << errors;
+        result.errors = oss.str();
+        return;
+    }
+
+    if (!errors.empty()) {
+        auto oss = std::ostringstream{};
+        oss << errors;
+        result.warnings = oss.str();
+    }
+
+    if (!root_node) {
+        throw std::logic_error("How did you get here?");
+    }
+
+    result.lua = compile(*root_node);
+
+    if (cache && cacheable) {
+        auto dependency_list = std::vector<CompiledDependency>{};
+        for (const auto& [name, hash] : dependencies) {
+            dependency_list.push_back({name, hash});
+        }
+
+        auto globals = std::vector<NameType>{};
+        for (const auto& [name, type] : global_scope.get_names()) {
+            auto previous = previous_globals.find(name);
+
+            if (previous == previous_globals.end() || !same_type(previous->second, type)) {
+                globals.push_back({name.str(), type});
+            }
+        }
+
+        try {
+            cache->store(std::string_view(source).substr(0, source_size), environment, dependency_list, globals, result, collection);
+        } catch (const std::logic_error&) {
+            // Same as above, the module type reaches into another collection.
+        }
+    }
+}
+
+} // static
+
+CompiledModule compile_module(std::string source, Scope& global_scope, const CompileCache* cache) {
+    auto result = CompiledModule{};
+
+    // What checking or loading reserves in the global collection is freed again once the module is done,
+    // except what its type or the globals it defined still refer to.
+    // Opened even for a cache hit, so that a module loaded while another is checked does not leave its entries to the other's generation.
+    auto& collection = global_scope.get_deferred_types();
+    collection.begin_generation();
+
+    auto release = [&] {
+        auto roots = std::vector<const Type*>{&result.type};
+
+        for (const auto& [name, type] : global_scope.get_names()) {
+            roots.push_back(&type);
+        }
+
+        for (const auto& [name, type] : global_scope.get_types()) {
+            roots.push_back(&type);
+        }
+
+        for (const auto& [luatype, type] : global_scope.get_luatype_metatable_map()) {
+            roots.push_back(&type);
+        }
+
+        result.entries = collection.end_generation(roots);
+    };
+
+    // Closed on every exit, or the entries of every later module would be attributed to this generation and never freed.
+    try {
+        compile_into(result, std::move(source), global_scope, cache);
+    } catch (...) {
+        release();
+        throw;
+    }
+
+    release();
+
+    return result;
+}
+
+} // namespace typedlua
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "scope.hpp"
+#include "type.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace typedlua {
+
+// A module after the whole pipeline: its emitted Lua and the type it returns, or its diagnostics.
+// Only errors make it fail. A module with nothing but warnings is emitted, and keeps them in `warnings`.
+struct CompiledModule {
+    std::string lua;
+    Type type;
+    std::string errors;
+    std::string warnings;
+    // Collection entries kept for good once it was compiled. Free them with DeferredTypeCollection::release when replacing the module.
+    std::vector<int> entries;
+    // Packages its check required, whose replacement makes its type stale.
+    std::vector<std::string> dependencies;
+};
+
+// Package that a module's type depended on, and the hash of the interface it had then.
+struct CompiledDependency {
+    std::string name;
+    std::uint64_t interface_hash;
+};
+
+// Directory of compiled modules, filed by a hash of their source, which each entry keeps in full to compare against.
+// Each entry records the interfaces of the packages it was checked against, and the globals of the root scope it was checked in,
+// and is only reused while they are still the same.
+// Entries assume the same stdlib every time; give differently configured compilers their own directories.
+// Entries are replaced atomically, so several processes and threads may share a directory.
+class CompileCache {
+public:
+    explicit CompileCache(std::filesystem::path directory);
+
+    const std::filesystem::path& get_directory() const { return directory; }
+
+    // Returns the cached module for `source` if every package it depends on still has the same interface,
+    // and `global_scope` has the same globals it was checked in.
+    // The globals the module declared are added to `global_scope` again, as checking it would.
+    std::optional<CompiledModule> load(std::string_view source, Scope& global_scope) const;
+
+    // Only successfully checked modules should be stored.
+    // `environment` is the environment_hash of the root scope before the module was checked, and `globals` are those it declared.
+    void store(
+        std::string_view source,
+        std::uint64_t environment,
+        const std::vector<CompiledDependency>& dependencies,
+        const std::vector<NameType>& globals,
+        const CompiledModule& module,
+        const DeferredTypeCollection& collection) const;
+
+private:
+    std::filesystem::path entry_path(std::string_view source) const;
+
+    std::filesystem::path directory;
+};
+
+// Stable across processes, unlike std::hash.
+std::uint64_t interface_hash(const Type& type, const DeferredTypeCollection& collection);
+
+// Hash of the names and types a root scope declares itself, as opposed to those of its prelude.
+// Throws std::logic_error if one of them refers to another collection.
+std::uint64_t environment_hash(Scope& global_scope);
+
+// Parses, checks and emits a module in a child of `global_scope`, going through `cache` if there is one.
+// Collection entries that only the module's check needed are freed afterwards, so `global_scope` should be a root scope:
+// its names, types and metatables are what keeps entries of earlier modules alive.
+CompiledModule compile_module(std::string source, Scope& global_scope, const CompileCache* cache = nullptr);
+
+} // namespace typedlua
@@ -0,0 +1,1089 @@
+#include "descent_parser.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+namespace typedlua {
+
+namespace { // static
+
+using namespace ast;
+
+// Thrown at the first token the grammar does not allow. It carries nothing, the Bison parser reports it instead.
+struct SyntaxError {};
+
+// Deeper nesting is left to the Bison parser, whose stack is not the thread's.
+constexpr auto max_nesting = 1000;
+
+struct Lexeme {
+    int kind;
+    Token text;
+    Location location;
+};
+
+// A binary operator binds its left operand if its power is above the limit that operand was parsed with.
+// Right operands are parsed with `right` as the limit, one below the power for right associative operators.
+// The powers follow the %left and %right declarations in parser.y.
+struct BinaryOperator {
+    BinaryOp op;
+    int power;
+    int right;
+};
+
+constexpr auto unary_power = 12;
+
+std::optional<BinaryOperator> binary_operator(int kind) {
+    switch (kind) {
+        case TOR: return BinaryOperator{BinaryOp::OR, 1, 1};
+        case TAND: return BinaryOperator{BinaryOp::AND, 2, 2};
+        case '<': return BinaryOperator{BinaryOp::LT, 3, 3};
+        case '>': return BinaryOperator{BinaryOp::GT, 3, 3};
+        case TCLE: return BinaryOperator{BinaryOp::LEQ, 3, 3};
+        case TCGE: return BinaryOperator{BinaryOp::GEQ, 3, 3};
+        case TCNE: return BinaryOperator{BinaryOp::NEQ, 3, 3};
+        case TCEQ: return BinaryOperator{BinaryOp::EQ, 3, 3};
+        case '|': return BinaryOperator{BinaryOp::BOR, 4, 4};
+        case '~': return BinaryOperator{BinaryOp::BXOR, 5, 5};
+        case '&': return BinaryOperator{BinaryOp::BAND, 6, 6};
+        case TSHL: return BinaryOperator{BinaryOp::SHL, 7, 7};
+        case TSHR: return BinaryOperator{BinaryOp::SHR, 7, 7};
+        case TDOT2: return BinaryOperator{BinaryOp::CONCAT, 9, 8};
+        case '+': return BinaryOperator{BinaryOp::ADD, 10, 10};
+        case '-': return BinaryOperator{BinaryOp::SUB, 10, 10};
+        case '*': return BinaryOperator{BinaryOp::MUL, 11, 11};
+        case '/': return BinaryOperator{BinaryOp::DIV, 11, 11};
+        case TSLASH2: return BinaryOperator{BinaryOp::IDIV, 11, 11};
+        case '%': return BinaryOperator{BinaryOp::MOD, 11, 11};
+        case '^': return BinaryOperator{BinaryOp::POW, 14, 13};
+        default: return std::nullopt;
+    }
+}
+
+std::optional<UnaryOp> unary_operator(int kind) {
+    switch (kind) {
+        case TNOT: return UnaryOp::NOT;
+        case '#': return UnaryOp::LEN;
+        case '-': return UnaryOp::NEG;
+        case '~': return UnaryOp::BNOT;
+        default: return std::nullopt;
+    }
+}
+
+bool starts_statement(int kind) {
+    switch (kind) {
+        case ';':
+        case TBREAK:
+        case TGOTO:
+        case TCOLON2:
+        case TDO:
+        case TWHILE:
+        case TREPEAT:
+        case TIF:
+        case TFOR:
+        case TFUNCTION:
+        case TLOCAL:
+        case TGLOBAL:
+        case TINTERFACE:
+        case TIDENTIFIER:
+        case '(':
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool starts_expression(int kind) {
+    switch (kind) {
+        case TNIL:
+        case TFALSE:
+        case TTRUE:
+        case TNUMBER:
+        case TSTRING:
+        case TDOT3:
+        case TFUNCTION:
+        case TIDENTIFIER:
+        case '(':
+        case '{':
+        case TNOT:
+        case '#':
+        case '-':
+        case '~':
+            return true;
+        default:
+            return false;
+    }
+}
+
+// A prefixexpr of the grammar, and which of its rules it came from.
+struct Prefix {
+    enum class Kind {
+        VAR,
+        CALL,
+        PARENTHESIZED
+    };
+
+    NodeId expr;
+    Kind kind;
+};
+
+class DescentParser {
+public:
+    DescentParser(Scanner& scanner, Tree& tree) : scanner(scanner), tree(tree) {}
+
+    void chunk() {
+        tree.root = block();
+
+        expect(0);
+    }
+
+private:
+    class Nesting {
+    public:
+        explicit Nesting(int& depth) : depth(depth) {
+            if (++depth > max_nesting) {
+                throw SyntaxError{};
+            }
+        }
+
+        Nesting(const Nesting&) = delete;
+        Nesting& operator=(const Nesting&) = delete;
+
+        ~Nesting() { --depth; }
+
+    private:
+        int& depth;
+    };
+
+    // Token `n` after the current one, scanned on demand.
+    const Lexeme& peek(std::size_t n = 0) {
+        while (buffered <= n) {
+            auto& lexeme = window[(head + buffered) % window_size];
+            auto value = TYPEDLUASTYPE{};
+
+            lexeme.kind = scanner.next(value, cursor);
+            lexeme.text = value.token;
+            lexeme.location = cursor;
+            ++buffered;
+        }
+
+        return window[head % window_size];
+    }
+
+    int kind(std::size_t n = 0) {
+        if (n == 0) {
+            return peek().kind;
+        }
+
+        peek(n);
+        return window[(head + n) % window_size].kind;
+    }
+
+    Token advance() {
+        const auto& lexeme = peek();
+
+        previous = lexeme.location;
+        head = (head + 1) % window_size;
+        --buffered;
+
+        return lexeme.text;
+    }
+
+    bool check(int token) {
+        return kind() == token;
+    }
+
+    bool accept(int token) {
+        if (!check(token)) {
+            return false;
+        }
+
+        advance();
+        return true;
+    }
+
+    Token expect(int token) {
+        if (!check(token)) {
+            throw SyntaxError{};
+        }
+
+        return advance();
+    }
+
+    // Location of a rule whose first token was at `first`, as YYLLOC_DEFAULT computes it.
+    Location since(const Location& first) const {
+        return {first.first_line, first.first_column, previous.last_line, previous.last_column};
+    }
+
+    // Bison places a rule that matched nothing at the end of the previous symbol.
+    Location empty() const {
+        return {previous.last_line, previous.last_column, previous.last_line, previous.last_column};
+    }
+
+    NodeId add_text(Kind kind, const Location& location, std::string_view text, std::initializer_list<NodeId> children = {}) {
+        auto id = tree.add(kind, location, children);
+        tree.set_text(id, text);
+        return id;
+    }
+
+    // Adds a node whose children are those pushed on `pending` since it had `mark` of them, and pops them.
+    NodeId add_pending(Kind kind, const Location& location, std::size_t mark) {
+        auto id = tree.add(kind, location, pending.data() + mark, pending.size() - mark);
+        pending.resize(mark);
+        return id;
+    }
+
+    NodeId block() {
+        auto nesting = Nesting(depth);
+        auto first = peek().location;
+        auto mark = pending.size();
+
+        while (starts_statement(kind())) {
+            pending.push_back(statement());
+        }
+
+        if (check(TRETURN)) {
+            pending.push_back(return_statement());
+        }
+
+        return add_pending(Kind::BLOCK, pending.size() == mark ? empty() : since(first), mark);
+    }
+
+    NodeId statement() {
+        auto first = peek().location;
+
+        switch (kind()) {
+            case ';':
+                advance();
+                return tree.add(Kind::EMPTY, since(first));
+            case TBREAK:
+                advance();
+                return tree.add(Kind::BREAK, since(first));
+            case TGOTO:
+                advance();
+                // Without a location, as in parser.y.
+                return add_text(Kind::GOTO, {}, expect(TIDENTIFIER));
+            case TCOLON2: {
+                advance();
+                auto name = expect(TIDENTIFIER);
+                expect(TCOLON2);
+                return add_text(Kind::LABEL, since(first), name);
+            }
+            case TDO: {
+                advance();
+                auto node = block();
+                expect(TEND);
+                tree.set_flag(node, true);
+                tree.set_location(node, since(first));
+                return node;
+            }
+            case TWHILE: {
+                advance();
+                auto condition = expression();
+                expect(TDO);
+                auto body = block();
+                expect(TEND);
+                return tree.add(Kind::WHILE, since(first), {condition, body});
+            }
+            case TREPEAT: {
+                advance();
+                auto body = block();
+                expect(TUNTIL);
+                auto until = expression();
+                return tree.add(Kind::REPEAT, since(first), {body, until});
+            }
+            case TIF:
+                return if_statement();
+            case TFOR:
+                return for_statement();
+            case TFUNCTION:
+                return function_statement();
+            case TLOCAL:
+                return local_statement();
+            case TGLOBAL: {
+                advance();
+                auto mark = pending.size();
+                namelist();
+                auto names = pending.size() - mark;
+
+                if (accept('=')) {
+                    explist();
+                }
+
+                auto node = add_pending(Kind::GLOBAL_VAR, since(first), mark);
+                tree.set_data(node, names);
+                return node;
+            }
+            case TINTERFACE: {
+                advance();
+                auto name = expect(TIDENTIFIER);
+                auto mark = pending.size();
+                pending.push_back(no_node);
+
+                if (accept('<')) {
+                    namelist();
+                    expect('>');
+                }
+
+                expect(':');
+                auto type = this->type();
+                pending[mark] = type;
+
+                auto node = add_pending(Kind::INTERFACE, since(first), mark);
+                tree.set_text(node, name);
+                return node;
+            }
+            default:
+                return expression_statement();
+        }
+    }
+
+    NodeId return_statement() {
+        auto first = peek().location;
+        expect(TRETURN);
+
+        auto mark = pending.size();
+
+        if (starts_expression(kind())) {
+            explist();
+        }
+
+        while (accept(';')) {}
+
+        return add_pending(Kind::RETURN, since(first), mark);
+    }
+
+    NodeId if_statement() {
+        auto first = peek().location;
+        expect(TIF);
+
+        auto condition = expression();
+        expect(TTHEN);
+        auto body = block();
+
+        auto mark = pending.size();
+        pending.insert(pending.end(), {condition, body, no_node});
+
+        while (check(TELSEIF)) {
+            auto elseif_first = peek().location;
+            advance();
+
+            auto elseif_condition = expression();
+            expect(TTHEN);
+            auto elseif_body = block();
+            pending.push_back(tree.add(Kind::ELSE_IF, since(elseif_first), {elseif_condition, elseif_body}));
+        }
+
+        if (check(TELSE)) {
+            auto else_first = peek().location;
+            advance();
+
+            auto else_body = block();
+            pending[mark + 2] = tree.add(Kind::ELSE, since(else_first), {else_body});
+        }
+
+        expect(TEND);
+        return add_pending(Kind::IF, since(first), mark);
+    }
+
+    NodeId for_statement() {
+        auto first = peek().location;
+        expect(TFOR);
+
+        if (check(TIDENTIFIER) && kind(1) == '=') {
+            auto name = advance();
+            advance();
+            auto begin = expression();
+            expect(',');
+            auto end = expression();
+            auto step = no_node;
+
+            if (accept(',')) {
+                step = expression();
+            }
+
+            expect(TDO);
+            auto body = block();
+            expect(TEND);
+            return add_text(Kind::FOR_NUMERIC, since(first), name, {begin, end, step, body});
+        }
+
+        auto mark = pending.size();
+        pending.push_back(no_node);
+        namelist();
+        auto names = pending.size() - mark - 1;
+        expect(TIN);
+        explist();
+        expect(TDO);
+        auto body = block();
+        pending[mark] = body;
+        expect(TEND);
+
+        auto node = add_pending(Kind::FOR_GENERIC, since(first), mark);
+        tree.set_data(node, names);
+        return node;
+    }
+
+    NodeId function_statement() {
+        auto first = peek().location;
+        expect(TFUNCTION);
+
+        auto name_first = peek().location;
+        auto ident = expect(TIDENTIFIER);
+        auto name = tree.add(Kind::IDENT, since(name_first));
+        tree.set_symbol(name, std::string_view(ident));
+
+        while (accept('.')) {
+            auto field = expect(TIDENTIFIER);
+            name = add_text(Kind::TABLE_ACCESS, since(name_first), field, {name});
+        }
+
+        if (accept(':')) {
+            auto method = expect(TIDENTIFIER);
+            auto node = function_body(Kind::SELF_FUNCTION, first, name);
+            tree.set_text(node, method);
+            return node;
+        }
+
+        return function_body(Kind::FUNCTION, first, name);
+    }
+
+    NodeId local_statement() {
+        auto first = peek().location;
+        expect(TLOCAL);
+
+        if (accept(TFUNCTION)) {
+            auto name = expect(TIDENTIFIER);
+            auto node = function_body(Kind::LOCAL_FUNCTION, first, no_node);
+            tree.set_text(node, name);
+            return node;
+        }
+
+        auto mark = pending.size();
+        namelist();
+        auto names = pending.size() - mark;
+
+        if (accept('=')) {
+            explist();
+        }
+
+        auto node = add_pending(Kind::LOCAL_VAR, since(first), mark);
+        tree.set_data(node, names);
+        return node;
+    }
+
+    NodeId expression_statement() {
+        auto first = peek().location;
+        auto prefix = prefix_expression();
+
+        if (prefix.kind == Prefix::Kind::CALL && !check('=') && !check(',')) {
+            return prefix.expr;
+        }
+
+        auto mark = pending.size();
+
+        for (;;) {
+            if (prefix.kind != Prefix::Kind::VAR) {
+                throw SyntaxError{};
+            }
+
+            pending.push_back(prefix.expr);
+
+            if (!accept(',')) {
+                break;
+            }
+
+            prefix = prefix_expression();
+        }
+
+        auto vars = pending.size() - mark;
+
+        expect('=');
+        explist();
+
+        auto node = add_pending(Kind::ASSIGNMENT, since(first), mark);
+        tree.set_data(node, vars);
+        return node;
+    }
+
+    // The generic parameters, parameters, return type, body and `end` of a function statement starting at `first`.
+    NodeId function_body(Kind kind, const Location& first, NodeId name) {
+        auto mark = pending.size();
+        pending.insert(pending.end(), {no_node, no_node, no_node, name});
+
+        if (accept('<')) {
+            if (!accept('>')) {
+                namelist();
+                expect('>');
+            }
+        }
+
+        auto params = parameters();
+        auto ret = return_annotation();
+        auto body = block();
+        expect(TEND);
+
+        pending[mark] = params;
+        pending[mark + 1] = ret;
+        pending[mark + 2] = body;
+
+        return add_pending(kind, since(first), mark);
+    }
+
+    NodeId parameters() {
+        auto first = peek().location;
+        expect('(');
+
+        auto mark = pending.size();
+        auto variadic = false;
+
+        if (accept(TDOT3)) {
+            variadic = true;
+        } else if (!check(')')) {
+            namelist();
+
+            if (accept(',')) {
+                expect(TDOT3);
+                variadic = true;
+            }
+        }
+
+        expect(')');
+
+        auto node = add_pending(Kind::FUNC_PARAMS, since(first), mark);
+        tree.set_flag(node, variadic);
+        return node;
+    }
+
+    NodeId return_annotation() {
+        if (!accept(':')) {
+            return no_node;
+        }
+
+        return return_type();
+    }
+
+    // Pushes the names on `pending`.
+    void namelist() {
+        for (;;) {
+            auto first = peek().location;
+            auto name = expect(TIDENTIFIER);
+            auto type = no_node;
+
+            if (accept(':')) {
+                type = this->type();
+            }
+
+            pending.push_back(add_text(Kind::NAME_DECL, since(first), name, {type}));
+
+            // A `...` after the comma ends the parameters instead.
+            if (!check(',') || kind(1) != TIDENTIFIER) {
+                break;
+            }
+
+            advance();
+        }
+    }
+
+    // Pushes the expressions on `pending`.
+    void explist() {
+        pending.push_back(expression());
+
+        while (accept(',')) {
+            pending.push_back(expression());
+        }
+    }
+
+    NodeId expression(int limit = 0) {
+        auto nesting = Nesting(depth);
+        auto first = peek().location;
+        auto left = no_node;
+
+        if (auto op = unary_operator(kind())) {
+            advance();
+
+            auto operand = expression(unary_power);
+            left = tree.add(Kind::UNARYOP, since(first), {operand});
+            tree.set_flag(left, std::uint8_t(*op));
+        } else {
+            left = simple_expression();
+        }
+
+        for (auto op = binary_operator(kind()); op && op->power > limit; op = binary_operator(kind())) {
+            advance();
+
+            auto right = expression(op->right);
+            left = tree.add(Kind::BINOP, since(first), {left, right});
+            tree.set_flag(left, std::uint8_t(op->op));
+        }
+
+        return left;
+    }
+
+    // Literals are left without a location, as in parser.y.
+    NodeId simple_expression() {
+        switch (kind()) {
+            case TNIL:
+                advance();
+                return tree.add(Kind::NIL, {});
+            case TFALSE:
+                advance();
+                return tree.add(Kind::BOOLEAN_LITERAL, {});
+            case TTRUE: {
+                advance();
+                auto node = tree.add(Kind::BOOLEAN_LITERAL, {});
+                tree.set_flag(node, true);
+                return node;
+            }
+            case TNUMBER:
+                return add_text(Kind::NUMBER_LITERAL, {}, advance());
+            case TSTRING:
+                return add_text(Kind::STRING_LITERAL, {}, advance());
+            case TDOT3:
+                advance();
+                return tree.add(Kind::DOTS, {});
+            case TFUNCTION:
+                return function_definition();
+            case '{':
+                return table_constructor();
+            default:
+                return prefix_expression().expr;
+        }
+    }
+
+    Prefix prefix_expression() {
+        auto first = peek().location;
+        auto result = Prefix{};
+
+        if (check(TIDENTIFIER)) {
+            auto name = advance();
+            result.expr = tree.add(Kind::IDENT, since(first));
+            result.kind = Prefix::Kind::VAR;
+            tree.set_symbol(result.expr, std::string_view(name));
+        } else if (accept('(')) {
+            result.expr = expression();
+            result.kind = Prefix::Kind::PARENTHESIZED;
+            expect(')');
+            tree.set_location(result.expr, since(first));
+        } else {
+            throw SyntaxError{};
+        }
+
+        for (;;) {
+            switch (kind()) {
+                case '[': {
+                    advance();
+                    auto subscript = expression();
+                    expect(']');
+                    result = {tree.add(Kind::SUBSCRIPT, since(first), {result.expr, subscript}), Prefix::Kind::VAR};
+                    break;
+                }
+                case '.': {
+                    advance();
+                    auto name = expect(TIDENTIFIER);
+                    result = {add_text(Kind::TABLE_ACCESS, since(first), name, {result.expr}), Prefix::Kind::VAR};
+                    break;
+                }
+                case ':': {
+                    advance();
+                    auto name = expect(TIDENTIFIER);
+                    auto mark = pending.size();
+                    pending.push_back(result.expr);
+                    arguments();
+                    auto node = add_pending(Kind::FUNCTION_SELF_CALL, since(first), mark);
+                    tree.set_text(node, name);
+                    result = {node, Prefix::Kind::CALL};
+                    break;
+                }
+                case '(': {
+                    auto mark = pending.size();
+                    pending.push_back(result.expr);
+                    arguments();
+                    result = {add_pending(Kind::FUNCTION_CALL, since(first), mark), Prefix::Kind::CALL};
+                    break;
+                }
+                default:
+                    return result;
+            }
+        }
+    }
+
+    // Pushes the arguments on `pending`.
+    void arguments() {
+        expect('(');
+
+        if (accept(')')) {
+            return;
+        }
+
+        explist();
+        expect(')');
+    }
+
+    NodeId function_definition() {
+        auto first = peek().location;
+        expect(TFUNCTION);
+
+        auto params = parameters();
+        auto ret = return_annotation();
+        auto body = block();
+        expect(TEND);
+        return tree.add(Kind::FUNCTION_DEF, since(first), {params, ret, body});
+    }
+
+    NodeId table_constructor() {
+        auto first = peek().location;
+        expect('{');
+
+        auto mark = pending.size();
+
+        while (!check('}')) {
+            pending.push_back(field());
+
+            if (!accept(',') && !accept(';')) {
+                break;
+            }
+        }
+
+        expect('}');
+        return add_pending(Kind::TABLE_CONSTRUCTOR, since(first), mark);
+    }
+
+    NodeId field() {
+        auto first = peek().location;
+
+        if (accept('[')) {
+            auto key = expression();
+            expect(']');
+            expect('=');
+            auto value = expression();
+            return tree.add(Kind::FIELD_KEY, since(first), {key, value});
+        }
+
+        if (check(TIDENTIFIER) && kind(1) == '=') {
+            auto key = advance();
+            advance();
+            auto value = expression();
+            return add_text(Kind::FIELD_NAMED, since(first), key, {value});
+        }
+
+        auto expr = expression();
+        return tree.add(Kind::FIELD_EXPR, since(first), {expr});
+    }
+
+    NodeId type() {
+        auto nesting = Nesting(depth);
+
+        if (starts_function_type()) {
+            return function_type();
+        }
+
+        return unit_type(0);
+    }
+
+    // Whether a `(` opens the parameters of a function type rather than a parenthesized type.
+    bool starts_function_type() {
+        if (check('<')) {
+            return true;
+        }
+
+        if (!check('(')) {
+            return false;
+        }
+
+        switch (kind(1)) {
+            case ')':
+            case TDOT3:
+            case ':':
+                return true;
+            case TIDENTIFIER:
+                return kind(2) == ':';
+            default:
+                return false;
+        }
+    }
+
+    NodeId function_type() {
+        auto first = peek().location;
+        auto mark = pending.size();
+        auto generic_params = std::size_t(0);
+        auto variadic = false;
+
+        pending.push_back(no_node);
+
+        if (accept('<')) {
+            namelist();
+            generic_params = pending.size() - mark - 1;
+            expect('>');
+        }
+
+        expect('(');
+
+        if (accept(TDOT3)) {
+            variadic = true;
+        } else if (!check(')')) {
+            type_params();
+
+            if (accept(',')) {
+                expect(TDOT3);
+                variadic = true;
+            }
+        }
+
+        expect(')');
+        expect(':');
+        auto ret = return_type();
+        pending[mark] = ret;
+
+        auto node = add_pending(Kind::TYPE_FUNCTION, since(first), mark);
+        tree.set_flag(node, variadic);
+        tree.set_data(node, generic_params);
+        return node;
+    }
+
+    // Pushes the parameters on `pending`.
+    void type_params() {
+        for (;;) {
+            auto first = peek().location;
+            auto name = std::string_view{};
+
+            if (!accept(':')) {
+                name = expect(TIDENTIFIER);
+                expect(':');
+            }
+
+            auto type = this->type();
+            pending.push_back(add_text(Kind::TYPE_FUNCTION_PARAM, since(first), name, {type}));
+
+            if (!check(',') || (kind(1) != ':' && kind(1) != TIDENTIFIER)) {
+                break;
+            }
+
+            advance();
+        }
+    }
+
+    // `|` binds looser than `&`, and both are left associative.
+    NodeId unit_type(int limit) {
+        auto first = peek().location;
+        auto left = common_type();
+
+        for (;;) {
+            if (check('|') && limit < 1) {
+                advance();
+                auto right = unit_type(1);
+                left = tree.add(Kind::TYPE_SUM, since(first), {left, right});
+            } else if (check('&') && limit < 2) {
+                advance();
+                auto right = unit_type(2);
+                left = tree.add(Kind::TYPE_PRODUCT, since(first), {left, right});
+            } else {
+                return left;
+            }
+        }
+    }
+
+    // Return types also take tuples, but no `&`.
+    NodeId return_type() {
+        if (starts_function_type()) {
+            return function_type();
+        }
+
+        auto first = peek().location;
+        auto left = return_unit_type();
+
+        while (accept('|')) {
+            auto right = return_unit_type();
+            left = tree.add(Kind::TYPE_SUM, since(first), {left, right});
+        }
+
+        return left;
+    }
+
+    NodeId return_unit_type() {
+        if (check('[')) {
+            return tuple_type();
+        }
+
+        return common_type();
+    }
+
+    NodeId common_type() {
+        auto first = peek().location;
+
+        switch (kind()) {
+            case TIDENTIFIER:
+            case TNIL: {
+                auto symbol = check(TNIL) ? Symbol("nil") : Symbol(std::string_view(peek().text));
+                advance();
+                auto name = tree.add(Kind::TYPE_NAME, since(first));
+                tree.set_symbol(name, symbol);
+
+                if (!accept('<')) {
+                    return name;
+                }
+
+                auto mark = pending.size();
+                pending.push_back(name);
+                pending.push_back(type());
+
+                while (accept(',')) {
+                    pending.push_back(type());
+                }
+
+                expect('>');
+                return add_pending(Kind::TYPE_GENERIC_CALL, since(first), mark);
+            }
+            case '(': {
+                advance();
+                auto node = type();
+                expect(')');
+                tree.set_location(node, since(first));
+                return node;
+            }
+            case '{':
+                return table_type();
+            case TFALSE:
+            case TTRUE: {
+                auto value = check(TTRUE);
+                advance();
+                auto node = tree.add(Kind::TYPE_LITERAL_BOOLEAN, since(first));
+                tree.set_flag(node, value);
+                return node;
+            }
+            case TNUMBER: {
+                auto value = advance();
+                return add_text(Kind::TYPE_LITERAL_NUMBER, since(first), value);
+            }
+            case TSTRING: {
+                auto value = advance();
+                return add_text(Kind::TYPE_LITERAL_STRING, since(first), value);
+            }
+            case T_REQUIRE: {
+                advance();
+                expect('(');
+                auto type = this->type();
+                expect(')');
+                return tree.add(Kind::TYPE_REQUIRE, since(first), {type});
+            }
+            default:
+                throw SyntaxError{};
+        }
+    }
+
+    NodeId tuple_type() {
+        auto first = peek().location;
+        expect('[');
+
+        auto mark = pending.size();
+        auto variadic = false;
+
+        if (accept(TDOT3)) {
+            variadic = true;
+        } else {
+            type_params();
+
+            if (accept(',')) {
+                expect(TDOT3);
+                variadic = true;
+            }
+        }
+
+        expect(']');
+
+        auto node = add_pending(Kind::TYPE_TUPLE, since(first), mark);
+        tree.set_flag(node, variadic);
+        return node;
+    }
+
+    // Indexes come before fields, and either may be followed by `;`.
+    NodeId table_type() {
+        auto first = peek().location;
+        expect('{');
+
+        auto indexes = no_node;
+        auto fields = no_node;
+
+        if (check('[')) {
+            auto indexes_first = peek().location;
+            auto mark = pending.size();
+
+            while (check('[') || check(';')) {
+                if (!accept(';')) {
+                    pending.push_back(index_type());
+                }
+            }
+
+            indexes = add_pending(Kind::INDEX_LIST, since(indexes_first), mark);
+        }
+
+        if (check(TIDENTIFIER)) {
+            auto fields_first = peek().location;
+            auto mark = pending.size();
+
+            while (check(TIDENTIFIER) || check(';')) {
+                if (!accept(';')) {
+                    pending.push_back(field_decl());
+                }
+            }
+
+            fields = add_pending(Kind::FIELD_DECL_LIST, since(fields_first), mark);
+        }
+
+        expect('}');
+        return tree.add(Kind::TYPE_TABLE, since(first), {indexes, fields});
+    }
+
+    NodeId index_type() {
+        auto first = peek().location;
+        expect('[');
+
+        auto key = type();
+        expect(']');
+        expect(':');
+        auto val = type();
+        return tree.add(Kind::INDEX, since(first), {key, val});
+    }
+
+    NodeId field_decl() {
+        auto first = peek().location;
+        auto name = expect(TIDENTIFIER);
+        expect(':');
+        auto type = this->type();
+        return add_text(Kind::FIELD_DECL, since(first), name, {type});
+    }
+
+    // Room for the current token and the two after it that `starts_function_type` looks at.
+    static constexpr std::size_t window_size = 4;
+
+    Scanner& scanner;
+    Tree& tree;
+    Lexeme window[window_size] = {};
+    std::size_t head = 0;
+    std::size_t buffered = 0;
+    // Like Bison's yylloc, whose columns the scanner leaves as they start out.
+    Location cursor = {1, 1, 1, 1};
+    Location previous = {1, 1, 1, 1};
+    int depth = 0;
+    // Children of the lists being parsed, innermost last, until their node is added.
+    std::vector<NodeId> pending;
+};
+
+} // static
+
+std::unique_ptr<ast::Tree> parse_descent(Scanner& scanner) {
+    auto tree = std::make_unique<ast::Tree>();
+
+    try {
+        DescentParser(scanner, *tree).chunk();
+    } catch (const SyntaxError&) {
+        return nullptr;
+    }
+
+    return tree;
+}
+
+} // namespace typedlua
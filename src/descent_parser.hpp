@@ -0,0 +1,17 @@
+#pragma once
+
+#include "node.hpp"
+#include "scanner.hpp"
+
+#include <memory>
+
+namespace typedlua {
+
+// Hand-written counterpart of the Bison grammar in parser.y, building the same tree with the same locations.
+// Statements and types are parsed by recursive descent, binary operators by precedence climbing with the precedences
+// declared there. Lists are gathered on a stack and copied into the tree when their node is added.
+//
+// Returns null on a syntax error, which it does not diagnose. `typedlua::parse` then runs the Bison parser for its messages.
+std::unique_ptr<ast::Tree> parse_descent(Scanner& scanner);
+
+} // namespace typedlua
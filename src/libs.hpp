@@ -16,4 +16,12 @@ void import_table(Scope& scope);
 
 void import_io(Scope& scope);
 
+// Basic types and every library above, imported from source.
+void import_prelude(Scope& scope);
+
+// The same as import_prelude, imported once per process and never modified afterwards.
+// Restored from the blob generated at build time when there is one.
+// Layer compilations on it with `Scope(&prelude(), &deferred_types)` instead of importing again.
+const Scope& prelude();
+
 } // namespace typedlua::libs
@@ -0,0 +1,42 @@
+#include "libs.hpp"
+#include "prelude_blob.hpp"
+#include "serialize.hpp"
+
+#include <string_view>
+
+namespace typedlua::libs {
+
+namespace { // static
+
+struct Prelude {
+    DeferredTypeCollection deferred_types;
+    Scope scope;
+
+    Prelude() : scope(&deferred_types) {
+        if (prelude_blob_size > 0) {
+            auto blob = std::string_view(reinterpret_cast<const char*>(prelude_blob), prelude_blob_size);
+            deserialize_scope(blob, scope, deferred_types);
+        } else {
+            import_prelude(scope);
+        }
+    }
+};
+
+} // static
+
+void import_prelude(Scope& scope) {
+    scope.enable_basic_types();
+    import_basic(scope);
+    import_math(scope);
+    import_package(scope);
+    import_string(scope);
+    import_table(scope);
+    import_io(scope);
+}
+
+const Scope& prelude() {
+    static const auto instance = Prelude{};
+    return instance.scope;
+}
+
+} // namespace typedlua::libs
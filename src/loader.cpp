@@ -1,6 +1,6 @@
 #include "loader.hpp"
 
-#include "typedlua_compiler.hpp"
+#include "module_cache.hpp"
 
 namespace typedlua {
 
@@ -22,7 +22,7 @@ const char* install_loader_lua = R"(
                 local text = file:read('*a')
                 file:close()
 
-                local result, err = tlua_compile(text)
+                local result, err = tlua_compile(text, name)
 
                 if result then
                     return (loadstring or load)(result, name), filepath
@@ -43,43 +43,21 @@ const char* install_loader_lua = R"(
 )";
 
 int tlua_compile(lua_State* L) {
-    auto source = lua_tostring(L, 1);
+    auto size = std::size_t{};
+    auto data = lua_tolstring(L, 1, &size);
+    auto source = std::string(data, size);
+    auto name = std::string(lua_tostring(L, 2));
     auto global_scope = static_cast<Scope*>(lua_touserdata(L, lua_upvalueindex(1)));
+    auto cache = static_cast<const CompileCache*>(lua_touserdata(L, lua_upvalueindex(2)));
 
-    auto new_source = std::optional<std::string>{};
-    auto error_string = std::optional<std::string>{};
+    const auto& module = ModuleCache::get(L).compile(name, std::move(source), *global_scope, cache);
 
-    auto [root_node, errors] = typedlua::parse(source);
-
-    if (root_node && errors.empty()) {
-        auto scope = Scope(global_scope);
-        scope.deduce_return_type();
-
-        errors = typedlua::check(*root_node, scope);
-    }
-
-    if (!errors.empty()) {
-        auto oss = std::ostringstream{};
-
-        oss << errors;
-
-        error_string = oss.str();
-    } else if (root_node) {
-        new_source = typedlua::compile(*root_node);
-    } else {
-        throw std::logic_error("How did you get here?");
-    }
-
-    if (new_source) {
-        lua_pushstring(L, new_source->data());
-    } else {
+    if (module.errors.empty()) {
+        lua_pushlstring(L, module.lua.data(), module.lua.size());
         lua_pushnil(L);
-    }
-
-    if (error_string) {
-        lua_pushstring(L, error_string->data());
     } else {
         lua_pushnil(L);
+        lua_pushstring(L, module.errors.data());
     }
 
     return 2;
@@ -87,10 +65,11 @@ int tlua_compile(lua_State* L) {
 
 } // static
 
-void install_loader(lua_State* L, Scope& global_scope) {
+void install_loader(lua_State* L, Scope& global_scope, const CompileCache* cache) {
     luaL_loadstring(L, install_loader_lua);
     lua_pushlightuserdata(L, &global_scope);
-    lua_pushcclosure(L, tlua_compile, 1);
+    lua_pushlightuserdata(L, const_cast<CompileCache*>(cache));
+    lua_pushcclosure(L, tlua_compile, 2);
 
     auto err = lua_pcall(L, 1, 0, 0);
 
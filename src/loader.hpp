@@ -1,11 +1,17 @@
 #pragma once
 
+#include "compile_cache.hpp"
 #include "scope.hpp"
 
 #include "lua.hpp"
 
 namespace typedlua {
 
-void install_loader(lua_State* L, Scope& scope);
+// Compiled modules are reused from `cache` if there is one. It must outlive the Lua state.
+// A module is reused only if its source and the sources of the packages it required, read again through `scope`, are unchanged.
+// Otherwise it is checked again when it is next loaded, whichever of them is asked for first,
+// and the package types memoized in `scope` forget every module that was checked against the old ones.
+// Hosts that change what a package resolves to in some other way than its source must call `scope.forget_package_types()` themselves.
+void install_loader(lua_State* L, Scope& scope, const CompileCache* cache = nullptr);
 
 } // namespace typedlua
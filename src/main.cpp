@@ -1,35 +1,256 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <mutex>
+#include <optional>
 #include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
 
+#include "compile_cache.hpp"
 #include "typedlua_compiler.hpp"
 #include "libs.hpp"
 
-int main(int argc, char **argv) {
+namespace { // static
+
+namespace fs = std::filesystem;
+
+int compile_stdin() {
     auto ss = std::stringstream{};
 
     ss << std::cin.rdbuf();
 
-    auto [root_node, errors] = typedlua::parse(ss.str());
+    // Padded for in-place scanning.
+    auto source = ss.str();
+    source.append(2, '\0');
+
+    auto [root_node, errors] = typedlua::parse_in_place(source.data(), source.size());
 
     if (root_node && errors.empty()) {
         auto deferred_types = typedlua::DeferredTypeCollection{};
-        auto scope = typedlua::Scope(&deferred_types);
-
-        scope.enable_basic_types();
-        typedlua::libs::import_basic(scope);
-        typedlua::libs::import_math(scope);
-        typedlua::libs::import_package(scope);
-        typedlua::libs::import_string(scope);
-        typedlua::libs::import_table(scope);
-        typedlua::libs::import_io(scope);
+        auto scope = typedlua::Scope(&typedlua::libs::prelude(), &deferred_types);
 
         errors = typedlua::check(*root_node, scope);
-        auto new_source = typedlua::compile(*root_node);
 
-        std::cout << new_source;
+        // Straight to stdout in chunks, which std::cout shares while it is synced with stdio.
+        auto out = typedlua::Sink::to_file(stdout);
+        typedlua::compile(*root_node, out);
     }
 
     if (!errors.empty()) {
         std::cout << "=== ERRORS ===\n" << errors;
     }
+
+    return 0;
+}
+
+// Deepest directory that contains every input, so that outputs keep their layout below it.
+fs::path common_base(const std::vector<fs::path>& inputs) {
+    auto base = fs::path{};
+
+    for (const auto& input : inputs) {
+        auto dir = fs::absolute(input).lexically_normal().parent_path();
+
+        if (base.empty()) {
+            base = dir;
+            continue;
+        }
+
+        auto common = fs::path{};
+        auto [b, d] = std::mismatch(base.begin(), base.end(), dir.begin(), dir.end());
+
+        for (auto iter = base.begin(); iter != b; ++iter) {
+            common /= *iter;
+        }
+
+        base = common;
+    }
+
+    return base;
+}
+
+// Where `input` compiles to below `outdir`, or nullopt with a reason in `report` if that would clobber the input or leave `outdir`.
+std::optional<fs::path> output_path(const fs::path& input, const fs::path& base, const fs::path& outdir, std::string& report) {
+    auto source = fs::absolute(input).lexically_normal();
+    auto root = fs::absolute(outdir).lexically_normal();
+
+    auto output = (root / source.lexically_relative(base)).lexically_normal();
+    output.replace_extension(".lua");
+
+    auto inside = output.lexically_relative(root);
+
+    if (inside.empty() || *inside.begin() == "..") {
+        report = "Error: output " + output.string() + " is outside of " + root.string() + "\n";
+        return std::nullopt;
+    }
+
+    auto ec = std::error_code{};
+
+    if (output == source || fs::equivalent(output, source, ec)) {
+        report = "Error: output " + output.string() + " would overwrite its input\n";
+        return std::nullopt;
+    }
+
+    return output;
+}
+
+// Compiles one module into `output`. Returns false if it had errors. Any diagnostics, warnings included, go to `report`.
+bool compile_file(
+    const typedlua::Scope& prelude,
+    const fs::path& input,
+    const fs::path& output,
+    const typedlua::CompileCache* cache,
+    std::string& report) {
+    auto file = std::ifstream(input, std::ios::binary);
+
+    if (!file) {
+        report = "Error: cannot open file\n";
+        return false;
+    }
+
+    auto ss = std::stringstream{};
+
+    ss << file.rdbuf();
+
+    auto deferred_types = typedlua::DeferredTypeCollection{};
+    auto scope = typedlua::Scope(&prelude, &deferred_types);
+
+    auto module = typedlua::compile_module(ss.str(), scope, cache);
+
+    if (!module.errors.empty()) {
+        report = module.errors;
+        return false;
+    }
+
+    report = module.warnings;
+
+    auto ec = std::error_code{};
+    fs::create_directories(output.parent_path(), ec);
+
+    auto out = std::ofstream(output, std::ios::binary);
+
+    if (!out) {
+        report += "Error: cannot write " + output.string() + "\n";
+        return false;
+    }
+
+    out << module.lua;
+
+    return true;
+}
+
+// Checks every input against the shared prelude, and writes it below `outdir` with its path relative to the inputs' common base.
+// Workers claim the next unclaimed file, so slow modules do not hold up a whole batch.
+int compile_files(const std::vector<fs::path>& inputs, const fs::path& outdir, unsigned jobs, const typedlua::CompileCache* cache) {
+    const auto& prelude = typedlua::libs::prelude();
+    const auto base = common_base(inputs);
+
+    auto next = std::atomic<std::size_t>{0};
+    auto failed = std::atomic<bool>{false};
+    auto report_mutex = std::mutex{};
+
+    auto worker = [&]{
+        for (auto i = next++; i < inputs.size(); i = next++) {
+            auto report = std::string{};
+            auto output = output_path(inputs[i], base, outdir, report);
+
+            if (!output || !compile_file(prelude, inputs[i], *output, cache, report)) {
+                failed = true;
+            }
+
+            if (!report.empty()) {
+                auto lock = std::lock_guard(report_mutex);
+                std::cerr << inputs[i].string() << ":\n" << report;
+            }
+        }
+    };
+
+    auto threads = std::vector<std::thread>{};
+
+    jobs = std::max(1u, std::min<unsigned>(jobs, inputs.size()));
+    threads.reserve(jobs - 1);
+
+    for (auto i = 1u; i < jobs; ++i) {
+        threads.emplace_back(worker);
+    }
+
+    worker();
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    return failed ? 1 : 0;
+}
+
+void print_usage(const char* argv0) {
+    std::cerr << "Usage: " << argv0 << " [-j jobs] [-o outdir] [-c cachedir] [file...]\n"
+        << "With no files, compiles stdin to stdout.\n"
+        << "Outputs keep their paths relative to the directory containing all inputs, below outdir.\n"
+        << "Without -o they are written next to their inputs, which .lua inputs would overwrite, so those need -o.\n"
+        << "With a cache directory, unchanged files are not compiled again. It needs input files.\n";
+}
+
+} // static
+
+int main(int argc, char **argv) {
+    auto inputs = std::vector<fs::path>{};
+    auto outdir = std::optional<fs::path>{};
+    auto jobs = std::max(1u, std::thread::hardware_concurrency());
+    auto cachedir = std::optional<fs::path>{};
+
+    for (auto i = 1; i < argc; ++i) {
+        auto arg = std::string_view(argv[i]);
+
+        if ((arg == "-o" || arg == "-j" || arg == "-c") && i + 1 < argc) {
+            auto value = argv[++i];
+
+            if (arg == "-o") {
+                outdir = value;
+            } else if (arg == "-c") {
+                cachedir = value;
+            } else {
+                jobs = std::max(1, std::atoi(value));
+            }
+        } else if (!arg.empty() && arg[0] == '-') {
+            print_usage(argv[0]);
+            return 2;
+        } else {
+            inputs.emplace_back(arg);
+        }
+    }
+
+    if (inputs.empty()) {
+        if (cachedir) {
+            std::cerr << argv[0] << ": -c needs input files, since stdin is never cached\n";
+            return 2;
+        }
+
+        return compile_stdin();
+    }
+
+    if (!outdir) {
+        auto is_lua = [](const fs::path& input) { return input.extension() == ".lua"; };
+
+        if (std::any_of(inputs.begin(), inputs.end(), is_lua)) {
+            std::cerr << argv[0] << ": -o is required for .lua inputs, since their outputs would replace them\n";
+            return 2;
+        }
+
+        outdir = common_base(inputs);
+    }
+
+    auto cache = std::optional<typedlua::CompileCache>{};
+
+    if (cachedir) {
+        cache.emplace(*cachedir);
+    }
+
+    return compile_files(inputs, *outdir, jobs, cache ? &*cache : nullptr);
 }
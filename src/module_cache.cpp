@@ -0,0 +1,214 @@
+#include "module_cache.hpp"
+
+#include <algorithm>
+#include <new>
+
+namespace typedlua {
+
+namespace { // static
+
+const char* registry_key = "typedlua.ModuleCache";
+
+int module_cache_gc(lua_State* L) {
+    static_cast<ModuleCache*>(lua_touserdata(L, 1))->~ModuleCache();
+    return 0;
+}
+
+} // static
+
+ModuleCache& ModuleCache::get(lua_State* L) {
+    lua_getfield(L, LUA_REGISTRYINDEX, registry_key);
+    auto cache = static_cast<ModuleCache*>(lua_touserdata(L, -1));
+    lua_pop(L, 1);
+
+    if (cache) {
+        return *cache;
+    }
+
+    cache = new (lua_newuserdata(L, sizeof(ModuleCache))) ModuleCache{};
+
+    lua_newtable(L);
+    lua_pushcfunction(L, module_cache_gc);
+    lua_setfield(L, -2, "__gc");
+    lua_setmetatable(L, -2);
+
+    lua_setfield(L, LUA_REGISTRYINDEX, registry_key);
+
+    return *cache;
+}
+
+const CompiledModule& ModuleCache::compile(const std::string& name, std::string source, Scope& global_scope, const CompileCache* cache) {
+    auto& in_progress = compiling[&global_scope];
+
+    {
+        auto& scope_modules = modules[&global_scope];
+
+        auto iter = scope_modules.find(name);
+
+        if (iter != scope_modules.end()) {
+            if (iter->second.source == source) {
+                // Refreshing may replace dependencies, and so drop this module.
+                if (in_progress.count(name) != 0 || refresh(global_scope, name)) {
+                    return modules[&global_scope].at(name).module;
+                }
+            }
+
+            invalidate(global_scope, name);
+        }
+    }
+
+    auto key = source;
+
+    // Checking may require other modules and so come back here.
+    // Modules replaced meanwhile may still be referred to by this one's check, so they are only freed once it is done.
+    ++depth;
+    in_progress.insert(name);
+
+    auto module = CompiledModule{};
+
+    try {
+        module = compile_module(std::move(source), global_scope, cache);
+    } catch (...) {
+        in_progress.erase(in_progress.find(name));
+        --depth;
+        throw;
+    }
+
+    auto dependency_versions = std::vector<std::pair<std::string, std::uint64_t>>{};
+
+    for (const auto& dependency : module.dependencies) {
+        if (in_progress.count(dependency) == 0) {
+            dependency_versions.emplace_back(dependency, version_of(global_scope, dependency));
+        }
+    }
+
+    in_progress.erase(in_progress.find(name));
+    --depth;
+
+    auto& entry = modules[&global_scope].insert_or_assign(
+        name,
+        Entry{std::move(key), std::move(module), next_version++, std::move(dependency_versions)}).first->second;
+
+    if (depth == 0) {
+        release_retired();
+    }
+
+    return entry.module;
+}
+
+bool ModuleCache::refresh(Scope& global_scope, const std::string& name) {
+    const auto& get_package_type = global_scope.get_get_package_type();
+
+    // Copied, since resolving a dependency that changed drops this entry.
+    auto dependency_versions = modules[&global_scope].at(name).dependency_versions;
+
+    if (!get_package_type || dependency_versions.empty()) {
+        return true;
+    }
+
+    auto& in_progress = compiling[&global_scope];
+    in_progress.insert(name);
+
+    try {
+        for (const auto& [dependency, version] : dependency_versions) {
+            // Resolving it again reads its source again, which compiles it anew if it changed.
+            global_scope.forget_package_type(dependency);
+            get_package_type(dependency);
+        }
+    } catch (...) {
+        in_progress.erase(in_progress.find(name));
+        throw;
+    }
+
+    in_progress.erase(in_progress.find(name));
+
+    if (modules[&global_scope].count(name) == 0) {
+        return false;
+    }
+
+    for (const auto& [dependency, version] : dependency_versions) {
+        if (version_of(global_scope, dependency) != version) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+std::uint64_t ModuleCache::version_of(Scope& global_scope, const std::string& name) const {
+    auto scope_modules = modules.find(&global_scope);
+
+    if (scope_modules == modules.end()) {
+        return 0;
+    }
+
+    auto iter = scope_modules->second.find(name);
+
+    return iter != scope_modules->second.end() ? iter->second.version : 0;
+}
+
+void ModuleCache::invalidate(Scope& global_scope, const std::string& name) {
+    auto& scope_modules = modules[&global_scope];
+    auto& ids = retired[&global_scope];
+
+    auto stale = std::vector<std::string>{name};
+
+    while (!stale.empty()) {
+        auto current = std::move(stale.back());
+        stale.pop_back();
+
+        global_scope.forget_package_type(current);
+
+        auto iter = scope_modules.find(current);
+
+        if (iter == scope_modules.end()) {
+            continue;
+        }
+
+        const auto& entries = iter->second.module.entries;
+        ids.insert(ids.end(), entries.begin(), entries.end());
+        scope_modules.erase(iter);
+
+        for (const auto& [other, entry] : scope_modules) {
+            const auto& dependencies = entry.module.dependencies;
+
+            if (std::find(dependencies.begin(), dependencies.end(), current) != dependencies.end()) {
+                stale.push_back(other);
+            }
+        }
+    }
+}
+
+void ModuleCache::release_retired() {
+    for (auto& [global_scope, ids] : retired) {
+        if (ids.empty()) {
+            continue;
+        }
+
+        auto roots = std::vector<const Type*>{};
+
+        for (const auto& [name, type] : global_scope->get_names()) {
+            roots.push_back(&type);
+        }
+
+        for (const auto& [name, type] : global_scope->get_types()) {
+            roots.push_back(&type);
+        }
+
+        for (const auto& [luatype, type] : global_scope->get_luatype_metatable_map()) {
+            roots.push_back(&type);
+        }
+
+        // Modules of every scope, in case another one shares the collection.
+        for (const auto& [scope, scope_modules] : modules) {
+            for (const auto& [name, entry] : scope_modules) {
+                roots.push_back(&entry.module.type);
+            }
+        }
+
+        global_scope->get_deferred_types().release(ids, roots);
+        ids.clear();
+    }
+}
+
+} // namespace typedlua
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "compile_cache.hpp"
+#include "scope.hpp"
+
+#include "lua.hpp"
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace typedlua {
+
+// Modules compiled in one Lua state, shared by its package searcher and its $require type queries,
+// so each source is parsed and checked once no matter which of them asks first.
+// Lives in the state's registry as a userdata and is destroyed by its __gc when the state is closed.
+class ModuleCache {
+public:
+    ModuleCache() = default;
+    ModuleCache(const ModuleCache&) = delete;
+    ModuleCache& operator=(const ModuleCache&) = delete;
+
+    // The state's cache, created on first use.
+    static ModuleCache& get(lua_State* L);
+
+    // Results are kept per global scope and module name, since the same source checks differently in another scope.
+    // A module compiled again from a different source replaces its old result, whose collection entries are freed
+    // once no other module or global refers to them. References stay valid until then.
+    // Modules that required the replaced one are dropped as well, and the package types of `global_scope` forget them all,
+    // so that they are checked again against the new type the next time they are asked for.
+    // A result is only reused once the packages it required have been resolved again through `global_scope`
+    // and are still the modules it was checked against, so a module asked for before a dependency that changed is checked again too.
+    const CompiledModule& compile(const std::string& name, std::string source, Scope& global_scope, const CompileCache* cache);
+
+private:
+    struct Entry {
+        std::string source;
+        CompiledModule module;
+        // Tells apart the results a name had over time.
+        std::uint64_t version;
+        // Version of each dependency's result when the module was checked, or 0 if it had none.
+        // Dependencies that were themselves being compiled, as in a cycle, are not listed.
+        std::vector<std::pair<std::string, std::uint64_t>> dependency_versions;
+    };
+
+    // Resolves the dependencies of `name` again, which replaces those whose source changed,
+    // and returns whether its result is still the one to use.
+    bool refresh(Scope& global_scope, const std::string& name);
+
+    std::uint64_t version_of(Scope& global_scope, const std::string& name) const;
+
+    // Drops `name` and every module that required it, directly or not.
+    void invalidate(Scope& global_scope, const std::string& name);
+
+    // Frees the entries of replaced modules that nothing cached still refers to.
+    void release_retired();
+
+    std::unordered_map<Scope*, std::unordered_map<std::string, Entry>> modules;
+    // Collection entries of replaced modules, by global scope, freed once no compilation is in progress.
+    std::unordered_map<Scope*, std::vector<int>> retired;
+    // Compilations in progress, which may still refer to replaced modules.
+    int depth = 0;
+    // Modules being compiled or refreshed, by global scope. Asking for one of them again, as a cycle does, gives its result as it is.
+    std::unordered_map<Scope*, std::unordered_multiset<std::string>> compiling;
+    std::uint64_t next_version = 1;
+};
+
+} // namespace typedlua
@@ -1,1783 +1,1622 @@
 #include "node.hpp"
 
-namespace typedlua::ast {
+#include "type_identity.hpp"
 
-void Node::check(Scope& parent_scope, std::vector<CompileError>& errors) const {
-    // do nothing
-}
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <unordered_map>
 
-void Node::dump(std::ostream& out) const {
-    out << "--[[NOT IMPLEMENTED]]";
-}
+namespace typedlua::ast {
 
-void NExpr::check_expect(Scope& parent_scope, const Type& expected, std::vector<CompileError>& errors) const {
-    check(parent_scope, errors);
-}
+namespace { // static
 
-void NBlock::check(Scope& parent_scope, std::vector<CompileError>& errors) const {
-    auto this_scope = Scope(&parent_scope);
-    for (const auto& child : children) {
-        child->check(this_scope, errors);
-    }
-}
+// Array elements already added to a constructor, bucketed by structural hash.
+// Generated data tables repeat the same few element types, and only exact duplicates are skipped, so each distinct element stays its own sum member.
+struct SeenElements {
+    std::unordered_map<std::size_t, std::vector<Type>> buckets;
 
-void NBlock::dump(std::ostream& out) const {
-    if (scoped) out << "do\n";
-    for (const auto& child : children) {
-        out << *child << "\n";
-    }
-    if (scoped) out << "end";
-}
+    // Whether `type` was seen before, remembering it if not.
+    bool insert(const Type& type) {
+        auto& bucket = buckets[hash_type(type)];
 
-void NType::dump(std::ostream& out) const {
-    throw std::logic_error("Types cannot be emitted");
-}
+        for (const auto& seen : bucket) {
+            if (same_type(seen, type)) {
+                return false;
+            }
+        }
 
-NNameDecl::NNameDecl(std::string name)
-    : name(std::move(name)) {}
-NNameDecl::NNameDecl(std::string name, std::unique_ptr<NType> type)
-    : name(std::move(name)), type(std::move(type)) {}
+        bucket.push_back(type);
+        return true;
+    }
+};
 
-void NNameDecl::check(Scope& parent_scope, std::vector<CompileError>& errors) const {
-    if (type) type->check(parent_scope, errors);
+void add_element(std::vector<KeyValPair>& indexes, Type exprtype) {
+    for (auto& index : indexes) {
+        if (can_assign(index.key, LuaType::NUMBER)) {
+            index.val = std::move(index.val) | exprtype;
+            return;
+        }
+    }
+    indexes.push_back({Type::make_luatype(LuaType::NUMBER), std::move(exprtype)});
 }
 
-void NNameDecl::dump(std::ostream& out) const {
-    out << name;
-}
+std::string join_notes(const std::vector<std::string>& notes) {
+    std::string msg;
+    for (const auto& note : notes) {
+        msg = note + "\n" + msg;
+    }
+    return msg;
+}
+
+// Walks a tree to check it, switching on the kind of each node.
+// Each node kind is handled by the member named after it, like `check_function_call` or `get_type_table`.
+class Checker {
+public:
+    Checker(const Tree& tree, Annotations& annotations, std::vector<CompileError>& errors)
+        : tree(tree), annotations(annotations), errors(errors) {}
+
+    void check(NodeId id, Scope& scope) {
+        switch (tree.kind(id)) {
+            case Kind::BLOCK: return check_block(id, scope);
+            case Kind::NAME_DECL: return check_optional(tree.child(id, 0), scope);
+            case Kind::TYPE_NAME: return check_type_name(id, scope);
+            case Kind::TYPE_FUNCTION: return check_type_function(id, scope);
+            case Kind::INDEX: return check_index(id, scope);
+            case Kind::FIELD_DECL_LIST: return check_field_decl_list(id, scope);
+            case Kind::TYPE_GENERIC_CALL: return check_type_generic_call(id, scope);
+            case Kind::INTERFACE: return check_interface(id, scope);
+            case Kind::IDENT: return check_ident(id, scope);
+            case Kind::SUBSCRIPT: return check_subscript(id, scope);
+            case Kind::TABLE_ACCESS: return check_table_access(id, scope);
+            case Kind::FUNCTION_CALL: return check_function_call(id, scope);
+            case Kind::FUNCTION_SELF_CALL: return check_function_self_call(id, scope);
+            case Kind::ASSIGNMENT: return check_assignment(id, scope);
+            case Kind::IF: return check_if(id, scope);
+            case Kind::FOR_NUMERIC: return check_for_numeric(id, scope);
+            case Kind::FOR_GENERIC: return check_for_generic(id, scope);
+            case Kind::FUNC_PARAMS: return check_func_params(id, scope);
+            case Kind::FUNCTION: return check_function(id, scope);
+            case Kind::SELF_FUNCTION: return check_self_function(id, scope);
+            case Kind::LOCAL_FUNCTION: return check_local_function(id, scope);
+            case Kind::RETURN: return check_return(id, scope);
+            case Kind::LOCAL_VAR: return check_local_var(id, scope);
+            case Kind::GLOBAL_VAR: return check_global_var(id, scope);
+            case Kind::DOTS: return check_dots(id, scope);
+            case Kind::FUNCTION_DEF: return check_function_def(id, scope);
+            case Kind::TABLE_CONSTRUCTOR: return check_table_constructor(id, scope);
+            case Kind::BINOP: return check_binop(id, scope);
+            case Kind::UNARYOP: return check_unaryop(id, scope);
+            case Kind::TYPE_LITERAL_BOOLEAN:
+            case Kind::TYPE_LITERAL_NUMBER:
+            case Kind::TYPE_LITERAL_STRING:
+            case Kind::NUMBER_LITERAL:
+            case Kind::EMPTY:
+            case Kind::LABEL:
+            case Kind::BREAK:
+            case Kind::GOTO:
+            case Kind::NIL:
+            case Kind::BOOLEAN_LITERAL:
+            case Kind::STRING_LITERAL:
+                return;
+            default:
+                // Everything else only checks its children, in order.
+                for (auto child : tree.children(id)) {
+                    check_optional(child, scope);
+                }
+                return;
+        }
+    }
 
-Type NNameDecl::get_type(const Scope& scope) const {
-    if (type) {
-        return type->get_type(scope);
-    } else {
-        return Type::make_any();
+    void check_expect(NodeId id, Scope& scope, const Type& expected) {
+        switch (tree.kind(id)) {
+            case Kind::IDENT: return check_expect_ident(id, scope, expected);
+            case Kind::SUBSCRIPT: return check_expect_subscript(id, scope, expected);
+            case Kind::TABLE_ACCESS: return check_expect_table_access(id, scope, expected);
+            default: return check(id, scope);
+        }
     }
-}
 
-NTypeName::NTypeName(std::string name)
-    : name(std::move(name)) {}
+    // Type of an expression or type annotation, once it is checked.
+    Type get_type(NodeId id, const Scope& scope) {
+        switch (tree.kind(id)) {
+            case Kind::NAME_DECL: return get_type_optional(tree.child(id, 0), scope);
+            case Kind::TYPE_NAME: return get_type_name(id, scope);
+            case Kind::TYPE_FUNCTION: return get_cached_type(id, Type{});
+            case Kind::TYPE_TUPLE: return get_type_tuple(id, scope);
+            case Kind::TYPE_SUM: return get_type(tree.child(id, 0), scope) | get_type(tree.child(id, 1), scope);
+            case Kind::TYPE_PRODUCT: return get_type(tree.child(id, 0), scope) & get_type(tree.child(id, 1), scope);
+            case Kind::TYPE_TABLE: return get_type_table(id, scope);
+            case Kind::TYPE_LITERAL_BOOLEAN: return Type::make_literal(tree.flag(id));
+            case Kind::TYPE_LITERAL_NUMBER: return Type::make_literal(NumberRep(std::string(tree.text(id))));
+            case Kind::TYPE_LITERAL_STRING: return Type::make_literal(normalize_quotes(tree.text(id)));
+            case Kind::TYPE_REQUIRE: return Type::make_require(get_type(tree.child(id, 0), scope));
+            case Kind::TYPE_GENERIC_CALL: return get_cached_type(id, Type::make_any());
+            case Kind::IDENT: return get_type_ident(id, scope);
+            case Kind::SUBSCRIPT: return get_cached_type(id, Type::make_any());
+            case Kind::TABLE_ACCESS: return get_cached_type(id, Type::make_any());
+            case Kind::FUNCTION_CALL: return get_cached_type(id, Type::make_any());
+            case Kind::FUNCTION_SELF_CALL: return get_cached_type(id, Type::make_any());
+            case Kind::NUMBER_LITERAL: return Type::make_literal(NumberRep(std::string(tree.text(id))));
+            case Kind::NIL: return Type::make_luatype(LuaType::NIL);
+            case Kind::BOOLEAN_LITERAL: return Type::make_literal(tree.flag(id));
+            case Kind::STRING_LITERAL: return Type::make_literal(normalize_quotes(tree.text(id)));
+            case Kind::DOTS: return Type::make_any();
+            case Kind::FUNCTION_DEF: return get_type_function_def(id, scope);
+            case Kind::TABLE_CONSTRUCTOR: return get_cached_type(id, Type::make_any());
+            case Kind::BINOP: return get_type_binop(id, scope);
+            case Kind::UNARYOP: return get_type_unaryop(id, scope);
+            default: throw std::logic_error("Node has no type");
+        }
+    }
 
-void NTypeName::check(Scope& parent_scope, std::vector<CompileError>& errors) const {
-    if (!parent_scope.get_type(name)) {
-        errors.emplace_back("Type `" + name + "` not in scope", location);
+private:
+    std::string str(NodeId id) const {
+        return std::string(tree.text(id));
     }
-}
 
-Type NTypeName::get_type(const Scope& scope) const {
-    if (auto type = scope.get_type(name)) {
-        return *type;
-    } else {
-        return Type::make_any();
+    void error(NodeId id, std::string message) {
+        errors.emplace_back(std::move(message), tree.location(id));
     }
-}
 
-NTypeFunctionParam::NTypeFunctionParam(std::string name, std::unique_ptr<NType> type)
-    : name(std::move(name)), type(std::move(type)) {}
+    void warning(NodeId id, std::string message) {
+        errors.emplace_back(CompileError::Severity::WARNING, std::move(message), tree.location(id));
+    }
 
-void NTypeFunctionParam::check(Scope& parent_scope, std::vector<CompileError>& errors) const {
-    type->check(parent_scope, errors);
-}
+    void check_optional(NodeId id, Scope& scope) {
+        if (id != no_node) check(id, scope);
+    }
 
-void NTypeFunctionParam::dump(std::ostream& out) const {
-    out << name << ":" << *type;
-}
+    Type get_type_optional(NodeId id, const Scope& scope) {
+        return id != no_node ? get_type(id, scope) : Type::make_any();
+    }
 
-NTypeFunction::NTypeFunction(std::vector<NTypeFunctionParam> p, std::unique_ptr<NType> r, bool v)
-    : params(std::move(p)), ret(std::move(r)), is_variadic(v) {}
+    Type get_cached_type(NodeId id, Type otherwise) const {
+        auto type = annotations.find_type(id);
+        return type ? *type : std::move(otherwise);
+    }
 
-void NTypeFunction::check(Scope& parent_scope, std::vector<CompileError>& errors) const {
-    auto scope = Scope(&parent_scope);
-    auto& deferred = scope.get_deferred_types();
+    void check_block(NodeId id, Scope& parent_scope) {
+        auto this_scope = Scope(&parent_scope);
+        for (auto child : tree.children(id)) {
+            check(child, this_scope);
+        }
+    }
 
-    std::vector<NameType> genparams;
-    std::vector<int> nominals;
-    std::vector<Type> paramtypes;
+    void check_type_name(NodeId id, Scope& parent_scope) {
+        auto name = tree.symbol(id);
 
-    for (auto i = 0u; i < generic_params.size(); ++i) {
-        const auto& gparam = generic_params[i];
-        gparam.check(scope, errors);
-        auto id = deferred.reserve(gparam.name);
-        scope.add_type(gparam.name, Type::make_nominal(deferred, id));
-        genparams.push_back({gparam.name, gparam.get_type(scope)});
-        nominals.push_back(id);
+        if (!parent_scope.get_type(name)) {
+            error(id, "Type `" + name.str() + "` not in scope");
+        }
     }
 
-    for (const auto& param : params) {
-        param.check(scope, errors);
-        paramtypes.push_back(param.type->get_type(scope));
+    Type get_type_name(NodeId id, const Scope& scope) {
+        if (auto type = scope.get_type(tree.symbol(id))) {
+            return *type;
+        } else {
+            return Type::make_any();
+        }
     }
 
-    ret->check(scope, errors);
+    void check_type_function(NodeId id, Scope& parent_scope) {
+        auto scope = Scope(&parent_scope);
+        auto& deferred = scope.get_deferred_types();
 
-    cached_type = Type::make_function(std::move(genparams), nominals, std::move(paramtypes), ret->get_type(scope), is_variadic);
-}
+        const auto generic_count = tree.data(id);
+        const auto ret = tree.child(id, 0);
 
-Type NTypeFunction::get_type(const Scope& parent_scope) const {
-    return cached_type;
-}
+        std::vector<NameType> genparams;
+        std::vector<int> nominals;
+        std::vector<Type> paramtypes;
+
+        for (auto gparam : tree.children(id, 1, 1 + generic_count)) {
+            check(gparam, scope);
+            auto name = str(gparam);
+            auto defer_id = deferred.reserve(name);
+            scope.add_type(name, Type::make_nominal(deferred, defer_id));
+            genparams.push_back({name, get_type(gparam, scope)});
+            nominals.push_back(defer_id);
+        }
 
-NTypeTuple::NTypeTuple(std::vector<NTypeFunctionParam> p, bool v)
-    : params(std::move(p)), variadic(v) {}
+        for (auto param : tree.children(id, 1 + generic_count)) {
+            check(param, scope);
+            paramtypes.push_back(get_type(tree.child(param, 0), scope));
+        }
+
+        check(ret, scope);
 
-void NTypeTuple::check(Scope& parent_scope, std::vector<CompileError>& errors) const {
-    for (const auto& param : params) {
-        param.check(parent_scope, errors);
+        annotations.set_type(
+            id,
+            intern(Type::make_function(std::move(genparams), nominals, std::move(paramtypes), get_type(ret, scope), tree.flag(id))));
     }
-}
 
-Type NTypeTuple::get_type(const Scope& scope) const {
-    std::vector<Type> paramtypes;
-    for (const auto& param : params) {
-        paramtypes.push_back(param.type->get_type(scope));
+    Type get_type_tuple(NodeId id, const Scope& scope) {
+        std::vector<Type> paramtypes;
+        for (auto param : tree.children(id)) {
+            paramtypes.push_back(get_type(tree.child(param, 0), scope));
+        }
+        return Type::make_tuple(std::move(paramtypes), tree.flag(id));
     }
-    return Type::make_tuple(std::move(paramtypes), variadic);
-}
 
-NTypeSum::NTypeSum(std::unique_ptr<NType> l, std::unique_ptr<NType> r)
-    : lhs(std::move(l)), rhs(std::move(r)) {}
+    void check_index(NodeId id, Scope& parent_scope) {
+        const auto key = tree.child(id, 0);
 
-void NTypeSum::check(Scope& parent_scope, std::vector<CompileError>& errors) const {
-    lhs->check(parent_scope, errors);
-    rhs->check(parent_scope, errors);
-}
+        check(key, parent_scope);
+        check(tree.child(id, 1), parent_scope);
 
-Type NTypeSum::get_type(const Scope& scope) const {
-    return lhs->get_type(scope) | rhs->get_type(scope);
-}
+        auto ktype = get_type(key, parent_scope);
+
+        if (can_assign(ktype, LuaType::NIL)) {
+            error(key, "Key type must not be compatible with `nil`");
+        }
+    }
 
-NTypeProduct::NTypeProduct(std::unique_ptr<NType> l, std::unique_ptr<NType> r)
-    : lhs(std::move(l)), rhs(std::move(r)) {}
+    void check_field_decl_list(NodeId id, Scope& parent_scope) {
+        auto& cached_fields = annotations.fields(id);
 
-void NTypeProduct::check(Scope& parent_scope, std::vector<CompileError>& errors) const {
-    lhs->check(parent_scope, errors);
-    rhs->check(parent_scope, errors);
-}
+        cached_fields.clear();
 
-Type NTypeProduct::get_type(const Scope& scope) const {
-    return lhs->get_type(scope) & rhs->get_type(scope);
-}
+        // Position of each name in cached_fields, so wide interfaces are not quadratic to declare.
+        auto positions = std::unordered_map<std::string, std::size_t>{};
+        positions.reserve(tree.node(id).count);
 
-NIndex::NIndex(std::unique_ptr<NType> k, std::unique_ptr<NType> v)
-    : key(std::move(k)), val(std::move(v)) {}
+        for (auto field : tree.children(id)) {
+            const auto type = tree.child(field, 0);
 
-void NIndex::check(Scope& parent_scope, std::vector<CompileError>& errors) const {
-    key->check(parent_scope, errors);
-    val->check(parent_scope, errors);
+            check(field, parent_scope);
 
-    auto ktype = key->get_type(parent_scope);
+            auto name = str(field);
+            auto [iter, inserted] = positions.try_emplace(name, cached_fields.size());
 
-    if (is_assignable(ktype, LuaType::NIL).yes) {
-        errors.emplace_back("Key type must not be compatible with `nil`", key->location);
+            if (!inserted) {
+                error(id, "Duplicate table key '" + name + "'");
+                auto& fd = cached_fields[iter->second];
+                fd.type = fd.type | get_type(type, parent_scope);
+            } else {
+                cached_fields.push_back({std::move(name), get_type(type, parent_scope)});
+            }
+        }
     }
-}
 
-void NIndex::dump(std::ostream& out) const {
-    out << "[" << *key << "]:" << *val;
-}
+    Type get_type_table(NodeId id, const Scope& scope) {
+        const auto indexlist = tree.child(id, 0);
+        const auto fieldlist = tree.child(id, 1);
 
-KeyValPair NIndex::get_kvp(const Scope& scope) const {
-    return {key->get_type(scope), val->get_type(scope)};
-}
+        std::vector<KeyValPair> indexes;
+        FieldMap fielddecls;
 
-void NIndexList::check(Scope& parent_scope, std::vector<CompileError>& errors) const {
-    for (const auto& index : indexes) {
-        index->check(parent_scope, errors);
-    }
-}
+        if (indexlist != no_node) {
+            for (auto index : tree.children(indexlist)) {
+                indexes.push_back({get_type(tree.child(index, 0), scope), get_type(tree.child(index, 1), scope)});
+            }
+        }
 
-void NIndexList::dump(std::ostream& out) const {
-    bool first = true;
-    for (const auto& index : indexes) {
-        if (!first) {
-            out << ";";
+        if (fieldlist != no_node) {
+            if (auto found = annotations.find_fields(fieldlist)) {
+                fielddecls = *found;
+            }
         }
-        out << *index;
-        first = false;
-    }
-}
 
-std::vector<KeyValPair> NIndexList::get_types(const Scope& scope) const {
-    std::vector<KeyValPair> rv;
-    for (const auto& index : indexes) {
-        rv.push_back(index->get_kvp(scope));
+        return Type::make_table(std::move(indexes), std::move(fielddecls));
     }
-    return rv;
-}
 
-NFieldDecl::NFieldDecl(std::string n, std::unique_ptr<NType> t)
-    : name(std::move(n)), type(std::move(t)) {}
+    void check_type_generic_call(NodeId id, Scope& parent_scope) {
+        const auto type = tree.child(id, 0);
+        const auto args = tree.children(id, 1);
 
-void NFieldDecl::check(Scope& parent_scope, std::vector<CompileError>& errors) const {
-    type->check(parent_scope, errors);
-}
+        check(type, parent_scope);
 
-void NFieldDecl::dump(std::ostream& out) const {
-    out << name << ":" << *type;
-}
+        auto realtype = get_type(type, parent_scope);
 
-void NFieldDeclList::check(Scope& parent_scope, std::vector<CompileError>& errors) const {
-    for (const auto& field : fields) {
-        field->check(parent_scope, errors);
+        if (realtype.get_tag() != Type::Tag::DEFERRED) {
+            error(id, "Type `" + to_string(realtype) + "` is not a generic type");
+        }
 
-        auto iter = std::find_if(cached_fields.begin(), cached_fields.end(), [&](NameType& fd) { return fd.name == field->name; });
+        const auto& defer = realtype.get_deferred();
+        const auto& nominals = defer.collection->get_nominals(defer.id);
 
-        if (iter != cached_fields.end()) {
-            errors.emplace_back("Duplicate table key '" + field->name + "'", location);
-            iter->type = iter->type | field->type->get_type(parent_scope);
+        if (args.size() < nominals.size()) {
+            error(id, "Not enough arguments");
+        } else if (args.size() > nominals.size()) {
+            error(id, "Too many arguments");
         } else {
-            cached_fields.push_back({field->name, field->type->get_type(parent_scope)});
+            std::vector<std::optional<Type>> argtypes;
+            argtypes.resize(args.size());
+
+            for (auto i = 0u; i < args.size(); ++i) {
+                const auto a = args[i];
+                const auto& paramtype = defer.collection->get_type(nominals[i]);
+
+                check(a, parent_scope);
+                auto argtype = get_type(a, parent_scope);
+
+                auto r = is_assignable(paramtype, argtype);
+
+                if (!r.yes) {
+                    error(id, to_string(r));
+                } else {
+                    argtypes[i] = std::move(argtype);
+                }
+            }
+
+            annotations.set_type(id, intern(Type::make_deferred(*defer.collection, defer.id, std::move(argtypes))));
         }
     }
-}
 
-void NFieldDeclList::dump(std::ostream& out) const {
-    bool first = true;
-    for (const auto& field : fields) {
-        if (!first) {
-            out << ";";
+    void check_interface(NodeId id, Scope& parent_scope) {
+        const auto type = tree.child(id, 0);
+        const auto name = str(id);
+
+        if (auto oldtype = parent_scope.get_type(name)) {
+            warning(id, "Interface `" + name + "` shadows existing type");
         }
-        out << *field;
-        first = false;
-    }
-}
 
-FieldMap NFieldDeclList::get_types(const Scope& scope) const {
-    return cached_fields;
-}
+        auto& deferred = parent_scope.get_deferred_types();
+        const auto deferred_id = deferred.reserve(name);
 
-NTypeTable::NTypeTable(std::unique_ptr<NIndexList> i, std::unique_ptr<NFieldDeclList> f)
-    : indexlist(std::move(i)), fieldlist(std::move(f)) {}
+        parent_scope.add_type(name, Type::make_deferred(deferred, deferred_id));
 
-void NTypeTable::check(Scope& parent_scope, std::vector<CompileError>& errors) const {
-    if (indexlist) indexlist->check(parent_scope, errors);
-    if (fieldlist) fieldlist->check(parent_scope, errors);
-}
+        auto scope = Scope(&parent_scope);
+        auto nominals = std::vector<int>{};
 
-Type NTypeTable::get_type(const Scope& scope) const {
-    std::vector<KeyValPair> indexes;
-    FieldMap fields;
+        for (auto gparam : tree.children(id, 1)) {
+            auto gname = str(gparam);
+            auto defer_id = deferred.reserve(gname);
+            deferred.set(defer_id, get_type(gparam, scope));
+            scope.add_type(gname, Type::make_nominal(deferred, defer_id));
+            nominals.push_back(defer_id);
+        }
 
-    if (indexlist) indexes = indexlist->get_types(scope);
-    if (fieldlist) fields = fieldlist->get_types(scope);
+        deferred.set_nominals(deferred_id, std::move(nominals));
 
-    return Type::make_table(std::move(indexes), std::move(fields));
-}
+        check(type, scope);
 
-NTypeLiteralBoolean::NTypeLiteralBoolean(bool v)
-    : value(v) {}
+        deferred.set(deferred_id, intern(get_type(type, scope)));
+    }
 
-Type NTypeLiteralBoolean::get_type(const Scope& scope) const {
-    return Type::make_literal(value);
-}
+    void check_ident(NodeId id, Scope& parent_scope) {
+        if (!parent_scope.get_type_of(tree.symbol(id))) {
+            fail_ident(id, parent_scope);
+        }
+    }
 
-NTypeLiteralNumber::NTypeLiteralNumber(const std::string& s)
-    : value(s) {}
+    void check_expect_ident(NodeId id, Scope& parent_scope, const Type& expected) {
+        if (auto type = parent_scope.get_type_of(tree.symbol(id))) {
+            if (type->get_tag() == Type::Tag::DEFERRED) {
+                const auto& defer = type->get_deferred();
 
-Type NTypeLiteralNumber::get_type(const Scope& scope) const {
-    return Type::make_literal(value);
-}
+                if (!defer.collection->is_narrowing(defer.id)) {
+                    return;
+                }
 
-NTypeLiteralString::NTypeLiteralString(std::string_view s)
-    : value(normalize_quotes(s)) {}
+                const auto& current_type = reduce_deferred(defer, parent_scope.get_get_package_type());
 
-Type NTypeLiteralString::get_type(const Scope& scope) const {
-    return Type::make_literal(value);
-}
+                auto narrowed_type = current_type | expected;
 
-NTypeRequire::NTypeRequire(std::unique_ptr<NType> t)
-    : type(std::move(t)) {}
+                defer.collection->set(defer.id, std::move(narrowed_type));
+            }
+        } else {
+            fail_ident(id, parent_scope);
+        }
+    }
 
-void NTypeRequire::check(Scope& parent_scope, std::vector<CompileError>& errors) const {
-    type->check(parent_scope, errors);
-}
+    Type get_type_ident(NodeId id, const Scope& scope) {
+        if (auto type = scope.get_type_of(tree.symbol(id))) {
+            return *type;
+        } else {
+            return Type::make_any();
+        }
+    }
 
-Type NTypeRequire::get_type(const Scope& scope) const {
-    return Type::make_require(type->get_type(scope));
-}
+    void fail_ident(NodeId id, Scope& parent_scope) {
+        auto name = tree.symbol(id);
+        error(id, "Name `" + name.str() + "` is not in scope");
+        // Prevent further type errors for this name
+        parent_scope.add_name(name, Type::make_any());
+    }
 
-NTypeGenericCall::NTypeGenericCall(std::unique_ptr<NType> t, std::vector<std::unique_ptr<NType>> a)
-    : type(std::move(t)), args(std::move(a)) {}
+    void check_subscript(NodeId id, Scope& parent_scope) {
+        const auto prefix = tree.child(id, 0);
+        const auto subscript = tree.child(id, 1);
 
-void NTypeGenericCall::check(Scope& parent_scope, std::vector<CompileError>& errors) const {
-    type->check(parent_scope, errors);
+        check(prefix, parent_scope);
+        check(subscript, parent_scope);
 
-    auto realtype = type->get_type(parent_scope);
+        auto prefixtype = get_type(prefix, parent_scope);
+        auto keytype = get_type(subscript, parent_scope);
 
-    if (realtype.get_tag() != Type::Tag::DEFERRED) {
-        errors.emplace_back("Type `" + to_string(realtype) + "` is not a generic type", location);
+        check_subscript_common(id, prefixtype, keytype);
     }
 
-    const auto& defer = realtype.get_deferred();
-    const auto& nominals = defer.collection->get_nominals(defer.id);
+    void check_expect_subscript(NodeId id, Scope& parent_scope, const Type& expected) {
+        const auto prefix = tree.child(id, 0);
+        const auto subscript = tree.child(id, 1);
 
-    if (args.size() < nominals.size()) {
-        errors.emplace_back("Not enough arguments", location);
-    } else if (args.size() > nominals.size()) {
-        errors.emplace_back("Too many arguments", location);
-    } else {
-        std::vector<std::optional<Type>> argtypes;
-        argtypes.resize(args.size());
+        check(prefix, parent_scope);
+        check(subscript, parent_scope);
 
-        for (auto i = 0; i < args.size(); ++i) {
-            const auto& a = args[i];
-            const auto& paramtype = defer.collection->get_type(nominals[i]);
+        auto prefixtype = get_type(prefix, parent_scope);
+        auto keytype = get_type(subscript, parent_scope);
 
-            a->check(parent_scope, errors);
-            auto argtype = a->get_type(parent_scope);
+        if (prefixtype.get_tag() == Type::Tag::DEFERRED) {
+            const auto& defer = prefixtype.get_deferred();
 
-            auto r = is_assignable(paramtype, argtype);
+            if (!defer.collection->is_narrowing(defer.id)) {
+                return check_subscript_common(id, prefixtype, keytype);
+            }
 
-            if (!r.yes) {
-                errors.emplace_back(to_string(r), location);
-            } else {
-                argtypes[i] = std::move(argtype);
+            // Narrowing entries have no parameters to apply, so they are narrowed as stored.
+            if (defer.collection->get_type(defer.id).get_tag() != Type::Tag::TABLE) {
+                return check_subscript_common(id, prefixtype, keytype);
             }
-        }
 
-        cached_type = Type::make_deferred(*defer.collection, defer.id, std::move(argtypes));
+            auto narrowed_type = narrow_index(defer.collection->take(defer.id), keytype, expected);
+
+            defer.collection->set(defer.id, std::move(narrowed_type));
+        } else {
+            return check_subscript_common(id, prefixtype, keytype);
+        }
     }
-}
 
-Type NTypeGenericCall::get_type(const Scope& scope) const {
-    return cached_type.value_or(Type::make_any());
-}
+    void check_subscript_common(NodeId id, const Type& prefixtype, const Type& keytype) {
+        std::vector<std::string> notes;
 
-NInterface::NInterface(std::string n, std::unique_ptr<NType> t)
-    : name(std::move(n)), type(std::move(t)) {}
+        auto result = get_index_type(prefixtype, keytype, notes);
+
+        if (!result) {
+            notes.push_back("Could not find index `" + to_string(keytype) + "` in `" + to_string(prefixtype) + "`");
+        }
 
-NInterface::NInterface(std::string n, std::unique_ptr<NType> t, std::vector<NNameDecl> p)
-    : name(std::move(n)), type(std::move(t)), params(std::move(p)) {}
+        if (!notes.empty()) {
+            error(id, join_notes(notes));
+        }
 
-void NInterface::check(Scope& parent_scope, std::vector<CompileError>& errors) const {
-    if (auto oldtype = parent_scope.get_type(name)) {
-        errors.emplace_back(CompileError::Severity::WARNING, "Interface `" + name + "` shadows existing type", location);
+        annotations.set_type(id, std::move(result));
     }
 
-    auto& deferred = parent_scope.get_deferred_types();
-    const auto deferred_id = deferred.reserve(name);
+    void check_table_access(NodeId id, Scope& parent_scope) {
+        const auto prefix = tree.child(id, 0);
 
-    parent_scope.add_type(name, Type::make_deferred(deferred, deferred_id));
+        check(prefix, parent_scope);
 
-    auto scope = Scope(&parent_scope);
-    auto nominals = std::vector<int>{};
+        auto prefixtype = get_type(prefix, parent_scope);
 
-    for (auto i = 0u; i < params.size(); ++i) {
-        const auto& gparam = params[i];
-        auto defer_id = deferred.reserve(gparam.name);
-        deferred.set(defer_id, gparam.get_type(scope));
-        scope.add_type(gparam.name, Type::make_nominal(deferred, defer_id));
-        nominals.push_back(defer_id);
+        return check_table_access_common(id, prefixtype, parent_scope);
     }
 
-    deferred.set_nominals(deferred_id, std::move(nominals));
-
-    type->check(scope, errors);
-
-    deferred.set(deferred_id, type->get_type(scope));
-}
-
-void NInterface::dump(std::ostream& out) const {
-    // do nothing
-}
+    void check_expect_table_access(NodeId id, Scope& parent_scope, const Type& expected) {
+        const auto prefix = tree.child(id, 0);
 
-NIdent::NIdent(std::string v)
-    : name(std::move(v)) {}
+        check(prefix, parent_scope);
 
-void NIdent::check(Scope& parent_scope, std::vector<CompileError>& errors) const {
-    if (!parent_scope.get_type_of(name)) {
-        fail_common(parent_scope, errors);
-    }
-}
+        auto prefixtype = get_type(prefix, parent_scope);
 
-void NIdent::check_expect(Scope& parent_scope, const Type& expected, std::vector<CompileError>& errors) const {
-    if (auto type = parent_scope.get_type_of(name)) {
-        if (type->get_tag() == Type::Tag::DEFERRED) {
-            const auto& defer = type->get_deferred();
+        if (prefixtype.get_tag() == Type::Tag::DEFERRED) {
+            const auto& defer = prefixtype.get_deferred();
 
             if (!defer.collection->is_narrowing(defer.id)) {
-                return;
+                return check_table_access_common(id, prefixtype, parent_scope);
             }
 
-            const auto& current_type = reduce_deferred(defer, parent_scope.get_get_package_type());
+            // Narrowing entries have no parameters to apply, so they are narrowed as stored.
+            if (defer.collection->get_type(defer.id).get_tag() != Type::Tag::TABLE) {
+                return check_table_access_common(id, prefixtype, parent_scope);
+            }
 
-            auto narrowed_type = current_type | expected;
+            auto narrowed_type = narrow_field(defer.collection->take(defer.id), str(id), expected);
 
             defer.collection->set(defer.id, std::move(narrowed_type));
+        } else {
+            return check_table_access_common(id, prefixtype, parent_scope);
         }
-    } else {
-        fail_common(parent_scope, errors);
     }
-}
-
-void NIdent::dump(std::ostream& out) const {
-    out << name;
-}
 
-Type NIdent::get_type(const Scope& scope) const {
-    if (auto type = scope.get_type_of(name)) {
-        return *type;
-    } else {
-        return Type::make_any();
-    }
-}
+    void check_table_access_common(NodeId id, const Type& prefixtype, Scope& parent_scope) {
+        const auto name = str(id);
 
-void NIdent::fail_common(Scope& parent_scope, std::vector<CompileError>& errors) const {
-    errors.emplace_back("Name `" + name + "` is not in scope", location);
-    // Prevent further type errors for this name
-    parent_scope.add_name(name, Type::make_any());
-}
+        std::vector<std::string> notes;
 
-NSubscript::NSubscript(std::unique_ptr<NExpr> p, std::unique_ptr<NExpr> s)
-    : prefix(std::move(p)), subscript(std::move(s)) {}
+        auto result = get_field_type(prefixtype, name, notes, parent_scope.get_luatype_metatable_map());
 
-void NSubscript::check(Scope& parent_scope, std::vector<CompileError>& errors) const {
-    prefix->check(parent_scope, errors);
-    subscript->check(parent_scope, errors);
+        if (!result) {
+            notes.push_back("Could not find field '" + name + "' in `" + to_string(prefixtype) + "`");
+        }
 
-    auto prefixtype = prefix->get_type(parent_scope);
-    auto keytype = subscript->get_type(parent_scope);
+        if (!notes.empty()) {
+            error(id, join_notes(notes));
+        }
 
-    check_common(prefixtype, keytype, parent_scope, errors);
-}
+        annotations.set_type(id, std::move(result));
+    }
 
-void NSubscript::check_expect(Scope& parent_scope, const Type& expected, std::vector<CompileError>& errors) const {
-    prefix->check(parent_scope, errors);
-    subscript->check(parent_scope, errors);
+    void check_function_call(NodeId id, Scope& parent_scope) {
+        const auto prefix = tree.child(id, 0);
+        const auto args = tree.children(id, 1);
 
-    auto prefixtype = prefix->get_type(parent_scope);
-    auto keytype = subscript->get_type(parent_scope);
+        check(prefix, parent_scope);
+        for (auto arg : args) {
+            check(arg, parent_scope);
+        }
 
-    if (prefixtype.get_tag() == Type::Tag::DEFERRED) {
-        const auto& defer = prefixtype.get_deferred();
+        auto prefixtype = get_type(prefix, parent_scope);
 
-        if (!defer.collection->is_narrowing(defer.id)) {
-            return check_common(prefixtype, keytype, parent_scope, errors);
-        }
+        auto arg_types = std::vector<Type>{};
 
-        const auto& current_type = reduce_deferred(defer, parent_scope.get_get_package_type());
+        arg_types.reserve(args.size());
 
-        if (current_type.get_tag() != Type::Tag::TABLE) {
-            return check_common(prefixtype, keytype, parent_scope, errors);
+        for (auto arg : args) {
+            arg_types.push_back(get_type(arg, parent_scope));
         }
 
-        auto narrowed_type = narrow_index(current_type, keytype, expected);
-
-        defer.collection->set(defer.id, std::move(narrowed_type));
-    } else {
-        return check_common(prefixtype, keytype, parent_scope, errors);
-    }
-}
+        std::vector<std::string> notes;
 
-void NSubscript::dump(std::ostream& out) const {
-    out << *prefix << "[" << *subscript << "]";
-}
+        auto rettype = resolve_overload(prefixtype, arg_types, notes, parent_scope.get_get_package_type());
 
-Type NSubscript::get_type(const Scope& scope) const {
-    if (cached_type) {
-        return *cached_type;
-    } else {
-        return Type::make_any();
-    }
-}
-void NSubscript::check_common(const Type& prefixtype, const Type& keytype, Scope& parent_scope, std::vector<CompileError>& errors) const {
-    std::vector<std::string> notes;
+        if (!notes.empty()) {
+            auto msg = join_notes(notes);
 
-    auto result = get_index_type(prefixtype, keytype, notes);
+            if (!rettype) {
+                msg = "Type `" + to_string(prefixtype) + "` is not callable with these arguments.\n" + msg;
+            }
 
-    if (!result) {
-        notes.push_back("Could not find index `" + to_string(keytype) + "` in `" + to_string(prefixtype) + "`");
-    }
+            auto sev = rettype ? CompileError::Severity::WARNING : CompileError::Severity::ERROR;
 
-    if (!notes.empty()) {
-        std::string msg;
-        for (const auto& note : notes) {
-            msg = note + "\n" + msg;
+            errors.emplace_back(sev, msg, tree.location(id));
         }
-        errors.emplace_back(msg, location);
-    }
 
-    cached_type = std::move(result);
-}
+        annotations.set_type(id, std::move(rettype));
+    }
 
-NTableAccess::NTableAccess(std::unique_ptr<NExpr> p, std::string n)
-    : prefix(std::move(p)), name(std::move(n)) {}
+    void check_function_self_call(NodeId id, Scope& parent_scope) {
+        const auto prefix = tree.child(id, 0);
+        const auto args = tree.children(id, 1);
+        const auto name = str(id);
 
-void NTableAccess::check(Scope& parent_scope, std::vector<CompileError>& errors) const {
-    prefix->check(parent_scope, errors);
+        check(prefix, parent_scope);
+        for (auto arg : args) {
+            check(arg, parent_scope);
+        }
 
-    auto prefixtype = prefix->get_type(parent_scope);
+        auto prefixtype = get_type(prefix, parent_scope);
 
-    return check_common(prefixtype, parent_scope, errors);
-}
+        std::vector<std::string> notes;
 
-void NTableAccess::check_expect(Scope& parent_scope, const Type& expected, std::vector<CompileError>& errors) const {
-    prefix->check(parent_scope, errors);
+        auto functype = get_field_type(prefixtype, name, notes, parent_scope.get_luatype_metatable_map());
 
-    auto prefixtype = prefix->get_type(parent_scope);
+        if (!functype) {
+            error(id, "Could not find method '" + name + "' in type `" + to_string(prefixtype) + "`");
+        } else {
+            auto arg_types = std::vector<Type>{};
 
-    if (prefixtype.get_tag() == Type::Tag::DEFERRED) {
-        const auto& defer = prefixtype.get_deferred();
+            arg_types.reserve(1 + args.size());
+            arg_types.push_back(prefixtype);
 
-        if (!defer.collection->is_narrowing(defer.id)) {
-            return check_common(prefixtype, parent_scope, errors);
-        }
+            for (auto arg : args) {
+                arg_types.push_back(get_type(arg, parent_scope));
+            }
 
-        const auto& current_type = reduce_deferred(defer, parent_scope.get_get_package_type());
+            auto rettype = resolve_overload(*functype, arg_types, notes, parent_scope.get_get_package_type());
 
-        if (current_type.get_tag() != Type::Tag::TABLE) {
-            return check_common(prefixtype, parent_scope, errors);
-        }
+            if (!notes.empty()) {
+                auto msg = join_notes(notes);
 
-        auto narrowed_type = narrow_field(current_type, name, expected);
+                if (!rettype) {
+                    msg = "Type `" + to_string(prefixtype) + "` is not callable with these arguments.\n" + msg;
+                }
 
-        defer.collection->set(defer.id, std::move(narrowed_type));
-    } else {
-        return check_common(prefixtype, parent_scope, errors);
-    }
-}
+                auto sev = rettype ? CompileError::Severity::WARNING : CompileError::Severity::ERROR;
 
-void NTableAccess::dump(std::ostream& out) const {
-    out << *prefix << "." << name;
-}
+                errors.emplace_back(sev, msg, tree.location(id));
+            }
 
-Type NTableAccess::get_type(const Scope& scope) const {
-    if (cached_type) {
-        return *cached_type;
-    } else {
-        return Type::make_any();
+            annotations.set_type(id, std::move(rettype));
+        }
     }
-}
 
-void NTableAccess::check_common(const Type& prefixtype, Scope& parent_scope, std::vector<CompileError>& errors) const {
-    std::vector<std::string> notes;
+    void check_assignment(NodeId id, Scope& parent_scope) {
+        const auto vars = tree.children(id, 0, tree.data(id));
+        const auto exprs = tree.children(id, tree.data(id));
 
-    auto result = get_field_type(prefixtype, name, notes, parent_scope.get_luatype_metatable_map());
+        std::vector<Type> lhs;
+        std::vector<Type> rhs;
 
-    if (!result) {
-        notes.push_back("Could not find field '" + name + "' in `" + to_string(prefixtype) + "`");
-    }
+        lhs.reserve(vars.size());
+        rhs.reserve(exprs.size());
 
-    if (!notes.empty()) {
-        std::string msg;
-        for (const auto& note : notes) {
-            msg = note + "\n" + msg;
+        for (auto expr : exprs) {
+            check(expr, parent_scope);
+            rhs.push_back(get_type(expr, parent_scope));
         }
-        errors.emplace_back(msg, location);
-    }
 
-    cached_type = std::move(result);
-}
+        for (auto i = 0u; i < vars.size(); ++i) {
+            const auto var = vars[i];
+            if (i < rhs.size()) {
+                check_expect(var, parent_scope, rhs[i]);
+            } else {
+                check(var, parent_scope);
+            }
+            lhs.push_back(get_type(var, parent_scope));
+        }
+
+        const auto lhstype = Type::make_reduced_tuple(std::move(lhs));
+        const auto rhstype = Type::make_reduced_tuple(std::move(rhs));
+        const auto r = is_assignable(lhstype, rhstype);
 
-void NArgSeq::check(Scope& parent_scope, std::vector<CompileError>& errors) const {
-    for (const auto& arg : args) {
-        arg->check(parent_scope, errors);
+        if (!r.yes) {
+            error(id, to_string(r));
+        } else if (!r.messages.empty()) {
+            warning(id, to_string(r));
+        }
     }
-}
 
-void NArgSeq::dump(std::ostream& out) const {
-    bool first = true;
-    for (const auto& arg : args) {
-        if (!first) {
-            out << ",";
+    void check_if(NodeId id, Scope& parent_scope) {
+        check(tree.child(id, 0), parent_scope);
+        check(tree.child(id, 1), parent_scope);
+        for (auto elseif : tree.children(id, 3)) {
+            check(elseif, parent_scope);
         }
-        out << *arg;
-        first = false;
+        check_optional(tree.child(id, 2), parent_scope);
     }
-}
 
-NFunctionCall::NFunctionCall(std::unique_ptr<NExpr> p, std::unique_ptr<NArgSeq> a)
-    : prefix(std::move(p)), args(std::move(a)) {}
+    void check_for_numeric(NodeId id, Scope& parent_scope) {
+        check(tree.child(id, 0), parent_scope);
+        check(tree.child(id, 1), parent_scope);
+        check_optional(tree.child(id, 2), parent_scope);
 
-void NFunctionCall::check(Scope& parent_scope, std::vector<CompileError>& errors) const {
-    prefix->check(parent_scope, errors);
-    if (args) args->check(parent_scope, errors);
+        auto this_scope = Scope(&parent_scope);
+        this_scope.add_name(tree.text(id), Type(LuaType::NUMBER));
 
-    auto prefixtype = prefix->get_type(parent_scope);
+        check(tree.child(id, 3), this_scope);
+    }
 
-    auto arg_types = std::vector<Type>{};
+    void check_for_generic(NodeId id, Scope& parent_scope) {
+        const auto names = tree.children(id, 1, 1 + tree.data(id));
 
-    if (args) {
-        arg_types.reserve(args->args.size());
+        for (auto name : names) {
+            if (parent_scope.get_type_of(tree.text(name))) {
+                warning(id, "For-loop variable shadows name `" + str(name) + "`");
+            }
+            check(name, parent_scope);
+        }
 
-        for (const auto& expr : args->args) {
-            arg_types.push_back(expr->get_type(parent_scope));
+        for (auto expr : tree.children(id, 1 + tree.data(id))) {
+            check(expr, parent_scope);
         }
-    }
 
-    std::vector<std::string> notes;
+        auto this_scope = Scope(&parent_scope);
+        for (auto name : names) {
+            this_scope.add_name(tree.text(name), get_type(name, parent_scope));
+        }
 
-    cached_rettype = resolve_overload(prefixtype, arg_types, notes, parent_scope.get_get_package_type());
+        check(tree.child(id, 0), this_scope);
+    }
 
-    if (!notes.empty()) {
-        std::string msg;
-        for (const auto& note : notes) {
-            msg = note + "\n" + msg;
+    void check_func_params(NodeId id, Scope& parent_scope) {
+        for (auto name : tree.children(id)) {
+            if (parent_scope.get_type_of(tree.text(name))) {
+                warning(id, "Function parameter shadows name `" + str(name) + "`");
+            }
+            check(name, parent_scope);
         }
+    }
 
-        if (!cached_rettype) {
-            msg = "Type `" + to_string(prefixtype) + "` is not callable with these arguments.\n" + msg;
+    void add_params_to_scope(NodeId params, Scope& scope) {
+        for (auto name : tree.children(params)) {
+            scope.add_name(tree.text(name), get_type(name, scope));
+        }
+        if (tree.flag(params)) {
+            scope.set_dots_type(Type::make_any());
+        } else {
+            scope.disable_dots();
         }
-
-        auto sev = cached_rettype ? CompileError::Severity::WARNING : CompileError::Severity::ERROR;
-        
-        errors.emplace_back(sev, msg, location);
     }
-}
 
-void NFunctionCall::dump(std::ostream& out) const {
-    out << *prefix << "(";
-    if (args) out << *args;
-    out << ")";
-}
+    std::vector<Type> get_param_types(NodeId params, const Scope& scope) {
+        std::vector<Type> rv;
+        for (auto name : tree.children(params)) {
+            rv.push_back(get_type(name, scope));
+        }
+        return rv;
+    }
 
-Type NFunctionCall::get_type(const Scope& scope) const {
-    return cached_rettype.value_or(Type::make_any());
-}
+    // Checks the parameters, return type and body shared by FUNCTION, SELF_FUNCTION and LOCAL_FUNCTION, and returns the
+    // return type.
+    Type check_function_base(NodeId id, Scope& parent_scope, const std::optional<std::string>& local_name) {
+        const auto params = tree.child(id, 0);
+        const auto ret = tree.child(id, 1);
+        const auto block = tree.child(id, 2);
 
-NFunctionSelfCall::NFunctionSelfCall(std::unique_ptr<NExpr> p, std::string n, std::unique_ptr<NArgSeq> a)
-    : prefix(std::move(p)), name(std::move(n)), args(std::move(a)) {}
+        auto return_type = Type{};
 
-void NFunctionSelfCall::check(Scope& parent_scope, std::vector<CompileError>& errors) const {
-    prefix->check(parent_scope, errors);
-    if (args) args->check(parent_scope, errors);
+        auto& function_nominals = annotations.nominals(id);
 
-    auto prefixtype = prefix->get_type(parent_scope);
+        function_nominals.clear();
+        function_nominals.reserve(tree.node(id).count - 4);
 
-    std::vector<std::string> notes;
+        auto setup_scope = [&] {
+            auto scope = Scope(&parent_scope);
+            auto& deferred = scope.get_deferred_types();
 
-    auto functype = get_field_type(prefixtype, name, notes, parent_scope.get_luatype_metatable_map());
+            for (auto gparam : tree.children(id, 4)) {
+                auto name = str(gparam);
+                auto defer_id = deferred.reserve(name);
+                deferred.set(defer_id, get_type(gparam, scope));
+                scope.add_type(name, Type::make_nominal(deferred, defer_id));
+                function_nominals.push_back(defer_id);
+            }
 
-    if (!functype) {
-        errors.emplace_back("Could not find method '" + name + "' in type `" + to_string(prefixtype) + "`", location);
-    } else {
-        auto arg_types = std::vector<Type>{};
+            check(params, scope);
+            add_params_to_scope(params, scope);
 
-        arg_types.reserve(1 + (args ? args->args.size() : 0));
-        arg_types.push_back(prefixtype);
+            if (ret != no_node) {
+                check(ret, scope);
+                return_type = get_type(ret, scope);
+            }
 
-        if (args) {
-            for (const auto& expr : args->args) {
-                arg_types.push_back(expr->get_type(parent_scope));
+            if (tree.flag(params)) {
+                scope.set_dots_type(Type::make_tuple({}, true));
+            } else {
+                scope.disable_dots();
             }
-        }
 
-        cached_rettype = resolve_overload(*functype, arg_types, notes, parent_scope.get_get_package_type());
-        
-        if (!notes.empty()) {
-            std::string msg;
-            for (const auto& note : notes) {
-                msg = note + "\n" + msg;
+            return scope;
+        };
+
+        if (ret != no_node) {
+            auto this_scope = setup_scope();
+
+            this_scope.set_return_type(return_type);
+
+            if (local_name) {
+                this_scope.add_name(*local_name, get_function_base_type(id, this_scope, return_type));
             }
 
-            if (!cached_rettype) {
-                msg = "Type `" + to_string(prefixtype) + "` is not callable with these arguments.\n" + msg;
+            check(block, this_scope);
+        } else {
+            auto this_scope = setup_scope();
+
+            this_scope.deduce_return_type();
+
+            if (local_name) {
+                this_scope.add_name(*local_name, get_function_base_type(id, this_scope, Type::make_any()));
             }
 
-            auto sev = cached_rettype ? CompileError::Severity::WARNING : CompileError::Severity::ERROR;
+            check(block, this_scope);
 
-            errors.emplace_back(sev, msg, location);
+            if (auto newret = this_scope.get_return_type()) {
+                return_type = std::move(*newret);
+            }
         }
-    }
-}
-
-void NFunctionSelfCall::dump(std::ostream& out) const {
-    out << *prefix << ":" << name << "(";
-    if (args) out << *args;
-    out << ")";
-}
 
-Type NFunctionSelfCall::get_type(const Scope& scope) const {
-    if (cached_rettype) {
-        return *cached_rettype;
-    } else {
-        return Type::make_any();
+        return return_type;
     }
-}
 
-NNumberLiteral::NNumberLiteral(std::string v)
-    : value(std::move(v)) {}
+    // The type of the function, with `selftype` as its first parameter if there is one.
+    Type get_function_base_type(NodeId id, Scope& parent_scope, const Type& rettype, const Type* selftype = nullptr) {
+        const auto params = tree.child(id, 0);
+        const auto& function_nominals = annotations.nominals(id);
 
-void NNumberLiteral::dump(std::ostream& out) const {
-    out << value;
-}
+        auto scope = Scope(&parent_scope);
+        auto& deferred = scope.get_deferred_types();
 
-Type NNumberLiteral::get_type(const Scope& scope) const {
-    return Type::make_literal(NumberRep(value));
-}
+        std::vector<NameType> genparams;
 
-NAssignment::NAssignment(std::vector<std::unique_ptr<NExpr>> v, std::vector<std::unique_ptr<NExpr>> e)
-    : vars(std::move(v)), exprs(std::move(e)) {}
+        auto i = 0u;
+        for (auto gparam : tree.children(id, 4)) {
+            auto name = str(gparam);
+            scope.add_type(name, Type::make_nominal(deferred, function_nominals[i++]));
+            genparams.push_back({std::move(name), get_type(gparam, scope)});
+        }
 
-void NAssignment::check(Scope& parent_scope, std::vector<CompileError>& errors) const {
-    std::vector<Type> lhs;
-    std::vector<Type> rhs;
+        auto paramtypes = get_param_types(params, scope);
 
-    lhs.reserve(vars.size());
-    rhs.reserve(exprs.size());
+        if (selftype) {
+            paramtypes.insert(paramtypes.begin(), *selftype);
+        }
 
-    for (const auto& expr : exprs) {
-        expr->check(parent_scope, errors);
-        rhs.push_back(expr->get_type(parent_scope));
+        return Type::make_function(std::move(genparams), function_nominals, std::move(paramtypes), rettype, tree.flag(params));
     }
 
-    for (auto i = 0u; i < vars.size(); ++i) {
-        auto& var = vars[i];
-        if (i < rhs.size()) {
-            var->check_expect(parent_scope, rhs[i], errors);
-        } else {
-            var->check(parent_scope, errors);
-        }
-        lhs.push_back(var->get_type(parent_scope));
-    }
+    void check_function(NodeId id, Scope& parent_scope) {
+        auto return_type = check_function_base(id, parent_scope, {});
 
-    const auto lhstype = Type::make_reduced_tuple(std::move(lhs));
-    const auto rhstype = Type::make_reduced_tuple(std::move(rhs));
-    const auto r = is_assignable(lhstype, rhstype);
+        const auto functype = get_function_base_type(id, parent_scope, return_type);
 
-    if (!r.yes) {
-        errors.emplace_back(to_string(r), location);
-    } else if (!r.messages.empty()) {
-        errors.emplace_back(CompileError::Severity::WARNING, to_string(r), location);
+        check_expect(tree.child(id, 3), parent_scope, functype);
     }
-}
 
-void NAssignment::dump(std::ostream& out) const {
-    bool first = true;
-    for (const auto& var : vars) {
-        if (!first) {
-            out << ",";
-        }
-        out << *var;
-        first = false;
-    }
+    void check_self_function(NodeId id, Scope& parent_scope) {
+        const auto expr = tree.child(id, 3);
+        const auto name = str(id);
 
-    out << "=";
+        check(expr, parent_scope);
 
-    first = true;
-    for (const auto& expr : exprs) {
-        if (!first) {
-            out << ",";
-        }
-        out << *expr;
-        first = false;
-    }
-}
-
-void NEmpty::dump(std::ostream& out) const {
-    out << ";";
-}
-
-NLabel::NLabel(std::string n)
-    : name(std::move(n)) {}
+        const auto self_type = get_type(expr, parent_scope);
 
-void NLabel::dump(std::ostream& out) const {
-    out << "::" << name << "::";
-}
-
-void NBreak::dump(std::ostream& out) const {
-    out << "break";
-}
-
-NGoto::NGoto(std::string n)
-    : name(std::move(n)) {}
-
-void NGoto::dump(std::ostream& out) const {
-    out << "goto " << name;
-}
+        auto scope = Scope(&parent_scope);
 
-NWhile::NWhile(std::unique_ptr<NExpr> c, std::unique_ptr<NBlock> b)
-    : condition(std::move(c)), block(std::move(b)) {}
+        scope.add_name("self", self_type);
 
-void NWhile::check(Scope& parent_scope, std::vector<CompileError>& errors) const {
-    condition->check(parent_scope, errors);
-    block->check(parent_scope, errors);
-}
+        auto return_type = check_function_base(id, scope, {});
 
-void NWhile::dump(std::ostream& out) const {
-    out << "while " << *condition << " do\n";
-    out << *block;
-    out << "end";
-}
+        const auto functype = get_function_base_type(id, scope, return_type, &self_type);
 
-NRepeat::NRepeat(std::unique_ptr<NBlock> b, std::unique_ptr<NExpr> u)
-    : block(std::move(b)), until(std::move(u)) {}
+        if (self_type.get_tag() == Type::Tag::DEFERRED) {
+            const auto& defer = self_type.get_deferred();
 
-void NRepeat::check(Scope& parent_scope, std::vector<CompileError>& errors) const {
-    block->check(parent_scope, errors);
-    until->check(parent_scope, errors);
-}
+            if (defer.collection->is_narrowing(defer.id)) {
+                if (defer.collection->get_type(defer.id).get_tag() == Type::Tag::TABLE) {
+                    auto narrowed_type = narrow_field(defer.collection->take(defer.id), name, functype);
 
-void NRepeat::dump(std::ostream& out) const {
-    out << "repeat\n";
-    out << *block;
-    out << "until " << *until;
-}
+                    defer.collection->set(defer.id, std::move(narrowed_type));
+                }
+            }
+        }
 
-NElseIf::NElseIf(std::unique_ptr<NExpr> c, std::unique_ptr<NBlock> b)
-    : condition(std::move(c)), block(std::move(b)) {}
+        std::vector<std::string> notes;
 
-void NElseIf::check(Scope& parent_scope, std::vector<CompileError>& errors) const {
-    condition->check(parent_scope, errors);
-    block->check(parent_scope, errors);
-}
+        auto fieldtype = get_field_type(self_type, name, notes, parent_scope.get_luatype_metatable_map());
 
-void NElseIf::dump(std::ostream& out) const {
-    out << "elseif " << *condition << " then\n";
-    out << *block;
-}
+        if (fieldtype) {
+            const auto r = is_assignable(*fieldtype, functype);
 
-NElse::NElse(std::unique_ptr<NBlock> b)
-    : block(std::move(b)) {}
+            if (!r.yes) {
+                error(id, to_string(r));
+            } else if (!r.messages.empty()) {
+                warning(id, to_string(r));
+            }
+        } else {
+            if (!notes.empty()) {
+                error(id, "Failed to deduce field type\n" + join_notes(notes));
+            }
+        }
+    }
 
-void NElse::check(Scope& parent_scope, std::vector<CompileError>& errors) const {
-    block->check(parent_scope, errors);
-}
+    void check_local_function(NodeId id, Scope& parent_scope) {
+        const auto name = str(id);
 
-void NElse::dump(std::ostream& out) const {
-    out << "else\n";
-    out << *block;
-}
+        auto return_type = check_function_base(id, parent_scope, name);
 
-NIf::NIf(std::unique_ptr<NExpr> c, std::unique_ptr<NBlock> b, std::vector<std::unique_ptr<NElseIf>> ei, std::unique_ptr<NElse> e)
-    : condition(std::move(c)), block(std::move(b)), elseifs(std::move(ei)), else_(std::move(e)) {}
+        const auto functype = get_function_base_type(id, parent_scope, return_type);
 
-void NIf::check(Scope& parent_scope, std::vector<CompileError>& errors) const {
-    condition->check(parent_scope, errors);
-    block->check(parent_scope, errors);
-    for (const auto& elseif : elseifs) {
-        elseif->check(parent_scope, errors);
-    }
-    if (else_) else_->check(parent_scope, errors);
-}
+        if (auto existing_type = parent_scope.get_type_of(name)) {
+            auto r = is_assignable(*existing_type, functype);
 
-void NIf::dump(std::ostream& out) const {
-    out << "if " << *condition << " then\n";
-    out << *block;
-    for (const auto& elseif : elseifs) {
-        out << *elseif;
+            if (!r.yes) {
+                error(id, to_string(r));
+            } else if (!r.messages.empty()) {
+                warning(id, to_string(r));
+            }
+        } else {
+            parent_scope.add_name(name, functype);
+        }
     }
-    if (else_) out << *else_;
-    out << "end";
-}
-
-NForNumeric::NForNumeric(
-    std::string n,
-    std::unique_ptr<NExpr> b,
-    std::unique_ptr<NExpr> e,
-    std::unique_ptr<NExpr> s,
-    std::unique_ptr<NBlock> k)
-    : name(std::move(n)), begin(std::move(b)), end(std::move(e)), step(std::move(s)), block(std::move(k)) {}
 
-void NForNumeric::check(Scope& parent_scope, std::vector<CompileError>& errors) const {
-    begin->check(parent_scope, errors);
-    end->check(parent_scope, errors);
-    if (step) step->check(parent_scope, errors);
+    void check_return(NodeId id, Scope& parent_scope) {
+        const auto exprs = tree.children(id);
 
-    auto this_scope = Scope(&parent_scope);
-    this_scope.add_name(name, Type(LuaType::NUMBER));
+        auto exprtypes = std::vector<Type>{};
 
-    block->check(this_scope, errors);
-}
+        exprtypes.reserve(exprs.size());
 
-void NForNumeric::dump(std::ostream& out) const {
-    out << "for " << name << "=" << *begin << "," << *end;
-    if (step) out << "," << *step;
-    out << " do\n";
-    out << *block;
-    out << "end";
-}
+        for (auto expr : exprs) {
+            check(expr, parent_scope);
+            exprtypes.push_back(get_type(expr, parent_scope));
+        }
 
-NForGeneric::NForGeneric(std::vector<NNameDecl> n, std::vector<std::unique_ptr<NExpr>> e, std::unique_ptr<NBlock> b)
-    : names(std::move(n)), exprs(std::move(e)), block(std::move(b)) {}
+        auto type = Type::make_reduced_tuple(std::move(exprtypes));
 
-void NForGeneric::check(Scope& parent_scope, std::vector<CompileError>& errors) const {
-    for (const auto& name : names) {
-        if (parent_scope.get_type_of(name.name)) {
-            errors.emplace_back(CompileError::Severity::WARNING, "For-loop variable shadows name `" + name.name + "`", location);
+        if (auto rettype = parent_scope.get_fixed_return_type()) {
+            auto r = is_assignable(*rettype, type);
+            if (!r.yes) {
+                error(id, to_string(r));
+            }
+        } else {
+            parent_scope.add_return_type(type);
         }
-        name.check(parent_scope, errors);
     }
 
-    for (const auto& expr : exprs) {
-        expr->check(parent_scope, errors);
-    }
+    void check_local_var(NodeId id, Scope& parent_scope) {
+        const auto names = tree.children(id, 0, tree.data(id));
 
-    auto this_scope = Scope(&parent_scope);
-    for (const auto& name : names) {
-        this_scope.add_name(name.name, name.get_type(parent_scope));
-    }
+        for (auto name : names) {
+            if (parent_scope.get_type_of(tree.text(name))) {
+                warning(id, "Local variable shadows name `" + str(name) + "`");
+            }
+            check(name, parent_scope);
+        }
 
-    block->check(this_scope, errors);
-}
+        std::vector<Type> exprtypes;
+        for (auto expr : tree.children(id, tree.data(id))) {
+            check(expr, parent_scope);
+            exprtypes.push_back(get_type(expr, parent_scope));
+        }
 
-void NForGeneric::dump(std::ostream& out) const {
-    out << "for ";
-    bool first = true;
-    for (const auto& name : names) {
-        if (!first) {
-            out << ",";
+        if (!exprtypes.empty() && exprtypes.back().get_tag() == Type::Tag::TUPLE) {
+            auto tupletype = std::move(exprtypes.back());
+            exprtypes.pop_back();
+            const auto& tuple = tupletype.get_tuple();
+            exprtypes.insert(exprtypes.end(), tuple.types.begin(), tuple.types.end());
         }
-        out << name;
-        first = false;
-    }
-    out << " in ";
-    first = true;
-    for (const auto& expr : exprs) {
-        if (!first) {
-            out << ",";
+
+        for (auto i = 0u; i < names.size(); ++i) {
+            const auto name = names[i];
+            if (tree.child(name, 0) != no_node) {
+                parent_scope.add_name(tree.text(name), get_type(name, parent_scope));
+            } else if (i < exprtypes.size()) {
+                auto& exprtype = exprtypes[i];
+                if (exprtype.get_tag() == Type::Tag::LITERAL) {
+                    auto& collection = parent_scope.get_deferred_types();
+                    auto narrow_id = collection.reserve_narrow("@" + std::to_string(tree.location(id).first_line));
+                    collection.set(narrow_id, std::move(exprtype));
+                    exprtype = Type::make_deferred(collection, narrow_id);
+                }
+                parent_scope.add_name(tree.text(name), std::move(exprtype));
+            } else {
+                parent_scope.add_name(tree.text(name), Type::make_any());
+            }
         }
-        out << *expr;
-        first = false;
     }
-    out << " do\n";
-    out << *block;
-    out << "end";
-}
 
-NFuncParams::NFuncParams(std::vector<NNameDecl> n, bool v)
-    : names(std::move(n)), is_variadic(v) {}
+    void check_global_var(NodeId id, Scope& parent_scope) {
+        const auto names = tree.children(id, 0, tree.data(id));
 
-void NFuncParams::check(Scope& parent_scope, std::vector<CompileError>& errors) const {
-    for (const auto& name : names) {
-        if (parent_scope.get_type_of(name.name)) {
-            errors.emplace_back(CompileError::Severity::WARNING, "Function parameter shadows name `" + name.name + "`", location);
+        for (auto name : names) {
+            check(name, parent_scope);
         }
-        name.check(parent_scope, errors);
-    }
-}
-
-void NFuncParams::dump(std::ostream& out) const {
-    bool first = true;
-    for (const auto& name : names) {
-        if (!first) {
-            out << ",";
+        for (auto expr : tree.children(id, tree.data(id))) {
+            check(expr, parent_scope);
         }
-        out << name;
-        first = false;
-    }
-    if (is_variadic) {
-        if (!first) {
-            out << ",";
+        for (auto name : names) {
+            if (auto type = parent_scope.get_type_of(tree.text(name))) {
+                auto r = is_assignable(*type, get_type(name, parent_scope));
+                if (!r.yes) {
+                    error(id, "Global variable conflict: " + to_string(r));
+                }
+            } else {
+                parent_scope.add_global_name(tree.text(name), get_type(name, parent_scope));
+            }
         }
-        out << "...";
     }
-}
 
-void NFuncParams::add_to_scope(Scope& scope) const {
-    for (const auto& name : names) {
-        scope.add_name(name.name, name.get_type(scope));
-    }
-    if (is_variadic) {
-        scope.set_dots_type(Type::make_any());
-    } else {
-        scope.disable_dots();
+    void check_dots(NodeId id, Scope& parent_scope) {
+        if (!parent_scope.get_dots_type()) {
+            error(id, "Scope does not contain `...`");
+        }
     }
-}
 
-std::vector<Type> NFuncParams::get_types(const Scope& scope) const {
-    std::vector<Type> rv;
-    for (const auto& name : names) {
-        rv.push_back(name.get_type(scope));
-    }
-    return rv;
-}
+    void check_function_def(NodeId id, Scope& parent_scope) {
+        const auto params = tree.child(id, 0);
+        const auto ret = tree.child(id, 1);
+        const auto block = tree.child(id, 2);
 
-FunctionBase::FunctionBase(std::vector<NNameDecl> g, std::unique_ptr<NFuncParams> p, std::unique_ptr<NType> r, std::unique_ptr<NBlock> b)
-    : generic_params(std::move(g)), params(std::move(p)), ret(std::move(r)), block(std::move(b)) {}
+        check(params, parent_scope);
+        check_optional(ret, parent_scope);
 
-Type FunctionBase::check(Scope& parent_scope, std::vector<CompileError>& errors, const std::optional<std::string>& local_name) const {
-    auto return_type = Type{};
+        if (ret != no_node) {
+            auto rettype = get_type(ret, parent_scope);
 
-    nominals.clear();
-    nominals.reserve(generic_params.size());
+            auto this_scope = Scope(&parent_scope);
+            add_params_to_scope(params, this_scope);
+            this_scope.set_return_type(std::move(rettype));
 
-    auto setup_scope = [&] {
-        auto scope = Scope(&parent_scope);
-        auto& deferred = scope.get_deferred_types();
-
-        for (auto i = 0u; i < generic_params.size(); ++i) {
-            const auto& gparam = generic_params[i];
-            auto defer_id = deferred.reserve(gparam.name);
-            deferred.set(defer_id, gparam.get_type(scope));
-            scope.add_type(gparam.name, Type::make_nominal(deferred, defer_id));
-            nominals.push_back(defer_id);
-        }
-
-        params->check(scope, errors);
-        params->add_to_scope(scope);
-
-        if (ret) {
-            ret->check(scope, errors);
-            return_type = ret->get_type(scope);
-        }
+            if (tree.flag(params)) {
+                this_scope.set_dots_type(Type::make_tuple({}, true));
+            } else {
+                this_scope.disable_dots();
+            }
 
-        if (params->is_variadic) {
-            scope.set_dots_type(Type::make_tuple({}, true));
+            check(block, this_scope);
         } else {
-            scope.disable_dots();
-        }
-
-        return scope;
-    };
-
-    if (ret) {
-        auto this_scope = setup_scope();
-
-        this_scope.set_return_type(return_type);
-
-        if (local_name) {
-            this_scope.add_name(*local_name, get_type(this_scope, return_type));
-        }
-
-        block->check(this_scope, errors);
-    } else {
-        auto this_scope = setup_scope();
+            auto this_scope = Scope(&parent_scope);
+            add_params_to_scope(params, this_scope);
+            this_scope.deduce_return_type();
 
-        this_scope.deduce_return_type();
-
-        if (local_name) {
-            this_scope.add_name(*local_name, get_type(this_scope, Type::make_any()));
-        }
+            if (tree.flag(params)) {
+                this_scope.set_dots_type(Type::make_tuple({}, true));
+            } else {
+                this_scope.disable_dots();
+            }
 
-        block->check(this_scope, errors);
+            check(block, this_scope);
 
-        if (auto newret = this_scope.get_return_type()) {
-            return_type = std::move(*newret);
+            if (auto newret = this_scope.get_return_type()) {
+                annotations.set_type(id, std::move(*newret));
+            }
         }
     }
 
-    return return_type;
-}
+    Type get_type_function_def(NodeId id, const Scope& scope) {
+        const auto params = tree.child(id, 0);
+        const auto ret = tree.child(id, 1);
 
-Type FunctionBase::get_type(Scope& parent_scope, const Type& rettype) const {
-    auto scope = Scope(&parent_scope);
-    auto& deferred = scope.get_deferred_types();
+        auto paramtypes = get_param_types(params, scope);
 
-    std::vector<NameType> genparams;
+        auto rettype = ret != no_node ? get_type(ret, scope) : get_cached_type(id, Type::make_any());
 
-    for (auto i = 0u; i < generic_params.size(); ++i) {
-        const auto& gparam = generic_params[i];
-        scope.add_type(gparam.name, Type::make_nominal(deferred, nominals[i]));
-        genparams.push_back({gparam.name, gparam.get_type(scope)});
+        return Type::make_function(std::move(paramtypes), std::move(rettype), tree.flag(params));
     }
 
-    return Type::make_function(std::move(genparams), nominals, params->get_types(scope), rettype, params->is_variadic);
-}
-
-Type FunctionBase::get_type(Scope& parent_scope, const Type& rettype, const Type& selftype) const {
-    auto scope = Scope(&parent_scope);
-    auto& deferred = scope.get_deferred_types();
-
-    std::vector<NameType> genparams;
+    void add_to_table(NodeId id, const Scope& scope, TableType& table, SeenElements& elements) {
+        switch (tree.kind(id)) {
+            case Kind::FIELD_EXPR: {
+                const auto expr = tree.child(id, 0);
+                auto exprtype = get_type(expr, scope);
 
-    for (auto i = 0u; i < generic_params.size(); ++i) {
-        const auto& gparam = generic_params[i];
-        scope.add_type(gparam.name, Type::make_nominal(deferred, nominals[i]));
-        genparams.push_back({gparam.name, gparam.get_type(scope)});
+                if (elements.insert(exprtype)) {
+                    add_element(table.indexes, std::move(exprtype));
+                }
+                return;
+            }
+            case Kind::FIELD_NAMED: {
+                const auto value = tree.child(id, 0);
+                auto key = str(id);
+
+                // Large keyed constructors look their keys up through the table's field index.
+                if (auto field = find_field(table, key)) {
+                    error(id, "Duplicate table key '" + key + "'");
+                    auto& type = table.fields[field - table.fields.data()].type;
+                    type = std::move(type) | get_type(value, scope);
+                } else {
+                    add_table_field(table, {std::move(key), get_type(value, scope)});
+                }
+                return;
+            }
+            case Kind::FIELD_KEY: {
+                const auto key = tree.child(id, 0);
+                const auto value = tree.child(id, 1);
+                auto keytype = get_type(key, scope);
+                auto exprtype = get_type(value, scope);
+                for (auto& index : table.indexes) {
+                    if (can_assign(index.key, keytype)) {
+                        index.val = std::move(index.val) | exprtype;
+                        return;
+                    }
+                }
+                table.indexes.push_back({std::move(keytype), std::move(exprtype)});
+                return;
+            }
+            default:
+                throw std::logic_error("Invalid table field");
+        }
     }
 
-    auto paramtypes = params->get_types(scope);
-
-    paramtypes.insert(paramtypes.begin(), selftype);
+    void check_table_constructor(NodeId id, Scope& parent_scope) {
+        const auto table_fields = tree.children(id);
 
-    return Type::make_function(std::move(genparams), nominals, std::move(paramtypes), rettype, params->is_variadic);
-}
-
-NFunction::NFunction(FunctionBase fb, std::unique_ptr<NExpr> e)
-    : base(std::move(fb)), expr(std::move(e)) {}
-
-void NFunction::check(Scope& parent_scope, std::vector<CompileError>& errors) const {
-    auto return_type = base.check(parent_scope, errors, {});
-
-    const auto functype = base.get_type(parent_scope, return_type);
-
-    expr->check_expect(parent_scope, functype, errors);
-}
-
-void NFunction::dump(std::ostream& out) const {
-    out << "function " << *expr << "(" << *base.params << ")";
-    out << "\n";
-    out << *base.block;
-    out << "end";
-}
-
-NSelfFunction::NSelfFunction(FunctionBase fb, std::string m, std::unique_ptr<NExpr> e)
-    : base(std::move(fb)), name(std::move(m)), expr(std::move(e)) {}
-
-void NSelfFunction::check(Scope& parent_scope, std::vector<CompileError>& errors) const {
-    expr->check(parent_scope, errors);
-
-    const auto self_type = expr->get_type(parent_scope);
-
-    auto scope = Scope(&parent_scope);
+        for (auto field : table_fields) {
+            check(field, parent_scope);
+        }
 
-    scope.add_name("self", self_type);
+        TableType table;
+        SeenElements elements;
 
-    auto return_type = base.check(scope, errors, {});
+        for (auto field : table_fields) {
+            add_to_table(field, parent_scope, table, elements);
+        }
 
-    const auto functype = base.get_type(scope, return_type, self_type);
+        if (table.indexes.empty() && table_fields.empty()) {
+            auto& deferred = parent_scope.get_deferred_types();
+            auto deferred_id = deferred.reserve_narrow("@" + std::to_string(tree.location(id).last_line));
+            deferred.set(deferred_id, Type::make_table({}, {}));
+            annotations.set_type(id, Type::make_deferred(deferred, deferred_id));
+        } else {
+            annotations.set_type(id, Type::make_table(std::move(table.indexes), std::move(table.fields), std::move(table.field_index)));
+        }
+    }
 
-    if (self_type.get_tag() == Type::Tag::DEFERRED) {
-        const auto& defer = self_type.get_deferred();
+    void check_binop(NodeId id, Scope& parent_scope) {
+        const auto left = tree.child(id, 0);
+        const auto right = tree.child(id, 1);
 
-        if (defer.collection->is_narrowing(defer.id)) {
-            const auto& current_type = reduce_deferred(defer, parent_scope.get_get_package_type());
+        check(left, parent_scope);
+        check(right, parent_scope);
 
-            if (current_type.get_tag() == Type::Tag::TABLE) {
-                auto narrowed_type = narrow_field(current_type, name, functype);
+        auto lhs = get_type(left, parent_scope);
+        auto rhs = get_type(right, parent_scope);
 
-                defer.collection->set(defer.id, std::move(narrowed_type));
+        auto require_compare = [&] {
+            for (const auto& type : {LuaType::NUMBER, LuaType::STRING}) {
+                if (can_assign(type, lhs) && can_assign(type, rhs)) {
+                    return;
+                }
             }
-        }
-    }
 
-    std::vector<std::string> notes;
+            error(id, "Cannot compare `" + to_string(lhs) + "` to `" + to_string(rhs) + "`");
+        };
 
-    auto fieldtype = get_field_type(self_type, name, notes, parent_scope.get_luatype_metatable_map());
+        auto require_equal = [&] {
+            if (can_assign(lhs, rhs) || can_assign(rhs, lhs)) {
+                return;
+            }
 
-    if (fieldtype) {
-        const auto r = is_assignable(*fieldtype, functype);
+            error(id, "Cannot compare `" + to_string(lhs) + "` to `" + to_string(rhs) + "`");
+        };
 
-        if (!r.yes) {
-            errors.emplace_back(to_string(r), location);
-        } else if (!r.messages.empty()) {
-            errors.emplace_back(CompileError::Severity::WARNING, to_string(r), location);
-        }
-    } else {
-        if (!notes.empty()) {
-            std::string msg;
+        auto require_operands = [&](LuaType luatype, const char* operation) {
+            auto l = is_assignable(luatype, lhs);
+            auto r = is_assignable(luatype, rhs);
 
-            for (const auto& note : notes) {
-                msg = note + "\n" + msg;
+            if (!l.yes) {
+                l.messages.push_back(operation);
+                error(id, to_string(l));
             }
 
-            msg = "Failed to deduce field type\n" + msg;
-            errors.emplace_back(msg, location);
+            if (!r.yes) {
+                r.messages.push_back(operation);
+                error(id, to_string(r));
+            }
+        };
+
+        auto require_bitwise = [&] { require_operands(LuaType::NUMBER, "In bitwise operation"); };
+        auto require_concat = [&] { require_operands(LuaType::STRING, "In concat operation"); };
+        auto require_math = [&] { require_operands(LuaType::NUMBER, "In arithmetic operation"); };
+
+        switch (tree.binary_op(id)) {
+            case BinaryOp::OR: break;
+            case BinaryOp::AND: break;
+            case BinaryOp::LT: require_compare(); break;
+            case BinaryOp::GT: require_compare(); break;
+            case BinaryOp::LEQ: require_compare(); break;
+            case BinaryOp::GEQ: require_compare(); break;
+            case BinaryOp::NEQ: require_equal(); break;
+            case BinaryOp::EQ: require_equal(); break;
+            case BinaryOp::BOR: require_bitwise(); break;
+            case BinaryOp::BXOR: require_bitwise(); break;
+            case BinaryOp::BAND: require_bitwise(); break;
+            case BinaryOp::SHL: require_bitwise(); break;
+            case BinaryOp::SHR: require_bitwise(); break;
+            case BinaryOp::CONCAT: require_concat(); break;
+            case BinaryOp::ADD: require_math(); break;
+            case BinaryOp::SUB: require_math(); break;
+            case BinaryOp::MUL: require_math(); break;
+            case BinaryOp::DIV: require_math(); break;
+            case BinaryOp::IDIV: require_math(); break;
+            case BinaryOp::MOD: require_math(); break;
+            case BinaryOp::POW: require_math(); break;
+            default: throw std::logic_error("Invalid binary operator");
         }
     }
-}
-
-void NSelfFunction::dump(std::ostream& out) const {
-    out << "function " << *expr << ":" << name << "(" << *base.params << ")";
-    out << "\n";
-    out << *base.block;
-    out << "end";
-}
-
-NLocalFunction::NLocalFunction(FunctionBase fb, std::string n)
-    : base(std::move(fb)), name(std::move(n)) {}
-
-void NLocalFunction::check(Scope& parent_scope, std::vector<CompileError>& errors) const {
-    auto return_type = base.check(parent_scope, errors, name);
-
-    const auto functype = base.get_type(parent_scope, return_type);
-
-    if (auto existing_type = parent_scope.get_type_of(name)) {
-        auto r = is_assignable(*existing_type, functype);
 
-        if (!r.yes) {
-            errors.emplace_back(to_string(r), location);
-        } else if (!r.messages.empty()) {
-            errors.emplace_back(CompileError::Severity::WARNING, to_string(r), location);
+    Type get_type_binop(NodeId id, const Scope& scope) {
+        switch (tree.binary_op(id)) {
+            case BinaryOp::OR: return (get_type(tree.child(id, 0), scope) - Type::make_literal(false)) | get_type(tree.child(id, 1), scope);
+            case BinaryOp::AND: return Type::make_literal(false) | get_type(tree.child(id, 1), scope);
+            case BinaryOp::LT: return Type::make_luatype(LuaType::BOOLEAN);
+            case BinaryOp::GT: return Type::make_luatype(LuaType::BOOLEAN);
+            case BinaryOp::LEQ: return Type::make_luatype(LuaType::BOOLEAN);
+            case BinaryOp::GEQ: return Type::make_luatype(LuaType::BOOLEAN);
+            case BinaryOp::NEQ: return Type::make_luatype(LuaType::BOOLEAN);
+            case BinaryOp::EQ: return Type::make_luatype(LuaType::BOOLEAN);
+            case BinaryOp::BOR: return Type::make_luatype(LuaType::NUMBER);
+            case BinaryOp::BXOR: return Type::make_luatype(LuaType::NUMBER);
+            case BinaryOp::BAND: return Type::make_luatype(LuaType::NUMBER);
+            case BinaryOp::SHL: return Type::make_luatype(LuaType::NUMBER);
+            case BinaryOp::SHR: return Type::make_luatype(LuaType::NUMBER);
+            case BinaryOp::CONCAT: return Type::make_luatype(LuaType::STRING);
+            case BinaryOp::ADD: return Type::make_luatype(LuaType::NUMBER);
+            case BinaryOp::SUB: return Type::make_luatype(LuaType::NUMBER);
+            case BinaryOp::MUL: return Type::make_luatype(LuaType::NUMBER);
+            case BinaryOp::DIV: return Type::make_luatype(LuaType::NUMBER);
+            case BinaryOp::IDIV: return Type::make_luatype(LuaType::NUMBER);
+            case BinaryOp::MOD: return Type::make_luatype(LuaType::NUMBER);
+            case BinaryOp::POW: return Type::make_luatype(LuaType::NUMBER);
+            default: throw std::logic_error("Invalid binary operator");
         }
-    } else {
-        parent_scope.add_name(name, functype);
     }
-}
 
-void NLocalFunction::dump(std::ostream& out) const {
-    out << "local function " << name << "(" << *base.params << ")";
-    out << "\n";
-    out << *base.block;
-    out << "end";
-}
-
-NReturn::NReturn(std::vector<std::unique_ptr<NExpr>> e)
-    : exprs(std::move(e)) {}
+    void check_unaryop(NodeId id, Scope& parent_scope) {
+        const auto expr = tree.child(id, 0);
 
-void NReturn::check(Scope& parent_scope, std::vector<CompileError>& errors) const {
-    auto exprtypes = std::vector<Type>{};
+        check(expr, parent_scope);
 
-    exprtypes.reserve(exprs.size());
+        auto type = get_type(expr, parent_scope);
 
-    for (const auto& expr : exprs) {
-        expr->check(parent_scope, errors);
-        exprtypes.push_back(expr->get_type(parent_scope));
-    }
+        auto require_len = [&] {
+            auto str = Type::make_luatype(LuaType::STRING);
+            auto tab = Type::make_table({{Type::make_luatype(LuaType::NUMBER), Type::make_any()}}, {});
+            auto r = is_assignable(str | tab, type);
 
-    auto type = Type::make_reduced_tuple(std::move(exprtypes));
+            if (!r.yes) {
+                r.messages.push_back("In length operator");
+                error(id, to_string(r));
+            }
+        };
 
-    if (auto rettype = parent_scope.get_fixed_return_type()) {
-        auto r = is_assignable(*rettype, type);
-        if (!r.yes) {
-            errors.emplace_back(to_string(r), location);
-        }
-    } else {
-        parent_scope.add_return_type(type);
-    }
-}
+        auto require_number = [&] {
+            auto num = Type::make_luatype(LuaType::NUMBER);
+            auto r = is_assignable(num, type);
 
-void NReturn::dump(std::ostream& out) const {
-    out << "return";
-    if (!exprs.empty()) {
-        out << " ";
-        bool first = true;
-        for (const auto& expr : exprs) {
-            if (!first) {
-                out << ",";
+            if (!r.yes) {
+                r.messages.push_back("In unary operator");
+                error(id, to_string(r));
             }
-            out << *expr;
-            first = false;
+        };
+
+        switch (tree.unary_op(id)) {
+            case UnaryOp::NOT: break;
+            case UnaryOp::LEN: require_len(); break;
+            case UnaryOp::NEG: require_number(); break;
+            case UnaryOp::BNOT: require_number(); break;
+            default: throw std::logic_error("Invalid unary operator");
         }
     }
-}
-
-NLocalVar::NLocalVar(std::vector<NNameDecl> n, std::vector<std::unique_ptr<NExpr>> e)
-    : names(std::move(n)), exprs(std::move(e)) {}
 
-void NLocalVar::check(Scope& parent_scope, std::vector<CompileError>& errors) const {
-    for (const auto& name : names) {
-        if (parent_scope.get_type_of(name.name)) {
-            errors.emplace_back(CompileError::Severity::WARNING, "Local variable shadows name `" + name.name + "`", location);
+    Type get_type_unaryop(NodeId id, const Scope& scope) {
+        switch (tree.unary_op(id)) {
+            case UnaryOp::NOT: return Type::make_luatype(LuaType::BOOLEAN);
+            case UnaryOp::LEN: return Type::make_luatype(LuaType::NUMBER);
+            case UnaryOp::NEG: return Type::make_luatype(LuaType::NUMBER);
+            case UnaryOp::BNOT: return Type::make_luatype(LuaType::NUMBER);
+            default: throw std::logic_error("Invalid unary operator");
         }
-        name.check(parent_scope, errors);
     }
 
-    std::vector<Type> exprtypes;
-    for (const auto& expr : exprs) {
-        expr->check(parent_scope, errors);
-        exprtypes.push_back(expr->get_type(parent_scope));
-    }
+    const Tree& tree;
+    Annotations& annotations;
+    std::vector<CompileError>& errors;
+};
 
-    if (!exprtypes.empty() && exprtypes.back().get_tag() == Type::Tag::TUPLE) {
-        auto tupletype = std::move(exprtypes.back());
-        exprtypes.pop_back();
-        const auto& tuple = tupletype.get_tuple();
-        exprtypes.insert(exprtypes.end(), tuple.types.begin(), tuple.types.end());
-    }
+void dump_list(const Tree& tree, NodeRange ids, Sink& out);
 
-    for (auto i = 0u; i < names.size(); ++i) {
-        const auto& name = names[i];
-        if (name.type) {
-            parent_scope.add_name(name.name, name.get_type(parent_scope));
-        } else if (i < exprtypes.size()) {
-            auto& exprtype = exprtypes[i];
-            if (exprtype.get_tag() == Type::Tag::LITERAL) {
-                auto& collection = parent_scope.get_deferred_types();
-                auto id = collection.reserve_narrow("@" + std::to_string(location.first_line));
-                collection.set(id, std::move(exprtype));
-                exprtype = Type::make_deferred(collection, id);
+// Emits a node as Lua, switching on its kind. Types are erased and interfaces and global declarations without
+// values disappear.
+void dump(const Tree& tree, NodeId id, Sink& out) {
+    switch (tree.kind(id)) {
+        case Kind::BLOCK: {
+            const auto scoped = tree.flag(id);
+            if (scoped) out << "do\n";
+            for (auto child : tree.children(id)) {
+                dump(tree, child, out);
+                out << "\n";
             }
-            parent_scope.add_name(name.name, std::move(exprtype));
-        } else {
-            parent_scope.add_name(name.name, Type::make_any());
-        }
-    }
-}
-
-void NLocalVar::dump(std::ostream& out) const {
-    out << "local ";
-    bool first = true;
-    for (const auto& name : names) {
-        if (!first) {
-            out << ",";
+            if (scoped) out << "end";
+            return;
         }
-        out << name;
-        first = false;
-    }
-    if (!exprs.empty()) {
-        out << "=";
-        bool first = true;
-        for (const auto& expr : exprs) {
-            if (!first) {
-                out << ",";
+        case Kind::NAME_DECL:
+            out << tree.text(id);
+            return;
+        case Kind::INTERFACE:
+            return;
+        case Kind::IDENT:
+            out << tree.symbol(id).str();
+            return;
+        case Kind::SUBSCRIPT:
+            dump(tree, tree.child(id, 0), out);
+            out << "[";
+            dump(tree, tree.child(id, 1), out);
+            out << "]";
+            return;
+        case Kind::TABLE_ACCESS:
+            dump(tree, tree.child(id, 0), out);
+            out << "." << tree.text(id);
+            return;
+        case Kind::FUNCTION_CALL:
+            dump(tree, tree.child(id, 0), out);
+            out << "(";
+            dump_list(tree, tree.children(id, 1), out);
+            out << ")";
+            return;
+        case Kind::FUNCTION_SELF_CALL:
+            dump(tree, tree.child(id, 0), out);
+            out << ":" << tree.text(id) << "(";
+            dump_list(tree, tree.children(id, 1), out);
+            out << ")";
+            return;
+        case Kind::NUMBER_LITERAL:
+            out << tree.text(id);
+            return;
+        case Kind::ASSIGNMENT:
+            dump_list(tree, tree.children(id, 0, tree.data(id)), out);
+            out << "=";
+            dump_list(tree, tree.children(id, tree.data(id)), out);
+            return;
+        case Kind::EMPTY:
+            out << ";";
+            return;
+        case Kind::LABEL:
+            out << "::" << tree.text(id) << "::";
+            return;
+        case Kind::BREAK:
+            out << "break";
+            return;
+        case Kind::GOTO:
+            out << "goto " << tree.text(id);
+            return;
+        case Kind::WHILE:
+            out << "while ";
+            dump(tree, tree.child(id, 0), out);
+            out << " do\n";
+            dump(tree, tree.child(id, 1), out);
+            out << "end";
+            return;
+        case Kind::REPEAT:
+            out << "repeat\n";
+            dump(tree, tree.child(id, 0), out);
+            out << "until ";
+            dump(tree, tree.child(id, 1), out);
+            return;
+        case Kind::ELSE_IF:
+            out << "elseif ";
+            dump(tree, tree.child(id, 0), out);
+            out << " then\n";
+            dump(tree, tree.child(id, 1), out);
+            return;
+        case Kind::ELSE:
+            out << "else\n";
+            dump(tree, tree.child(id, 0), out);
+            return;
+        case Kind::IF: {
+            out << "if ";
+            dump(tree, tree.child(id, 0), out);
+            out << " then\n";
+            dump(tree, tree.child(id, 1), out);
+            for (auto elseif : tree.children(id, 3)) {
+                dump(tree, elseif, out);
             }
-            out << *expr;
-            first = false;
-        }
-    }
-}
-
-NGlobalVar::NGlobalVar(std::vector<NNameDecl> n, std::vector<std::unique_ptr<NExpr>> e)
-    : names(std::move(n)), exprs(std::move(e)) {}
-
-void NGlobalVar::check(Scope& parent_scope, std::vector<CompileError>& errors) const {
-    for (const auto& name : names) {
-        name.check(parent_scope, errors);
-    }
-    for (const auto& expr : exprs) {
-        expr->check(parent_scope, errors);
-    }
-    for (const auto& name : names) {
-        if (auto type = parent_scope.get_type_of(name.name)) {
-            auto r = is_assignable(*type, name.get_type(parent_scope));
-            if (!r.yes) {
-                errors.emplace_back("Global variable conflict: " + to_string(r), location);
+            if (auto else_ = tree.child(id, 2); else_ != no_node) {
+                dump(tree, else_, out);
             }
-        } else {
-            parent_scope.add_global_name(name.name, name.get_type(parent_scope));
+            out << "end";
+            return;
         }
-    }
-}
-
-void NGlobalVar::dump(std::ostream& out) const {
-    if (!exprs.empty()) {
-        bool first = true;
-        for (const auto& name : names) {
-            if (!first) {
+        case Kind::FOR_NUMERIC: {
+            out << "for " << tree.text(id) << "=";
+            dump(tree, tree.child(id, 0), out);
+            out << ",";
+            dump(tree, tree.child(id, 1), out);
+            if (auto step = tree.child(id, 2); step != no_node) {
                 out << ",";
+                dump(tree, step, out);
             }
-            out << name;
-            first = false;
+            out << " do\n";
+            dump(tree, tree.child(id, 3), out);
+            out << "end";
+            return;
         }
-        out << "=";
-        first = true;
-        for (const auto& expr : exprs) {
-            if (!first) {
-                out << ",";
+        case Kind::FOR_GENERIC:
+            out << "for ";
+            dump_list(tree, tree.children(id, 1, 1 + tree.data(id)), out);
+            out << " in ";
+            dump_list(tree, tree.children(id, 1 + tree.data(id)), out);
+            out << " do\n";
+            dump(tree, tree.child(id, 0), out);
+            out << "end";
+            return;
+        case Kind::FUNC_PARAMS: {
+            const auto names = tree.children(id);
+            dump_list(tree, names, out);
+            if (tree.flag(id)) {
+                if (!names.empty()) {
+                    out << ",";
+                }
+                out << "...";
             }
-            out << *expr;
-            first = false;
+            return;
         }
+        case Kind::FUNCTION:
+        case Kind::SELF_FUNCTION:
+        case Kind::LOCAL_FUNCTION:
+            if (tree.kind(id) == Kind::LOCAL_FUNCTION) {
+                out << "local function " << tree.text(id);
+            } else {
+                out << "function ";
+                dump(tree, tree.child(id, 3), out);
+                if (tree.kind(id) == Kind::SELF_FUNCTION) {
+                    out << ":" << tree.text(id);
+                }
+            }
+            out << "(";
+            dump(tree, tree.child(id, 0), out);
+            out << ")";
+            out << "\n";
+            dump(tree, tree.child(id, 2), out);
+            out << "end";
+            return;
+        case Kind::RETURN:
+            out << "return";
+            if (tree.node(id).count != 0) {
+                out << " ";
+                dump_list(tree, tree.children(id), out);
+            }
+            return;
+        case Kind::LOCAL_VAR:
+            out << "local ";
+            dump_list(tree, tree.children(id, 0, tree.data(id)), out);
+            if (tree.node(id).count != tree.data(id)) {
+                out << "=";
+                dump_list(tree, tree.children(id, tree.data(id)), out);
+            }
+            return;
+        case Kind::GLOBAL_VAR:
+            if (tree.node(id).count != tree.data(id)) {
+                dump_list(tree, tree.children(id, 0, tree.data(id)), out);
+                out << "=";
+                dump_list(tree, tree.children(id, tree.data(id)), out);
+            }
+            return;
+        case Kind::NIL:
+            out << "nil";
+            return;
+        case Kind::BOOLEAN_LITERAL:
+            out << (tree.flag(id) ? "true" : "false");
+            return;
+        case Kind::STRING_LITERAL:
+            out << tree.text(id);
+            return;
+        case Kind::DOTS:
+            out << "...";
+            return;
+        case Kind::FUNCTION_DEF:
+            out << "function(";
+            dump(tree, tree.child(id, 0), out);
+            out << ")";
+            out << "\n";
+            dump(tree, tree.child(id, 2), out);
+            out << "end";
+            return;
+        case Kind::FIELD_EXPR:
+            dump(tree, tree.child(id, 0), out);
+            return;
+        case Kind::FIELD_NAMED:
+            out << tree.text(id) << "=";
+            dump(tree, tree.child(id, 0), out);
+            return;
+        case Kind::FIELD_KEY:
+            out << "[";
+            dump(tree, tree.child(id, 0), out);
+            out << "]=";
+            dump(tree, tree.child(id, 1), out);
+            return;
+        case Kind::TABLE_CONSTRUCTOR:
+            out << "{\n";
+            for (auto field : tree.children(id)) {
+                dump(tree, field, out);
+                out << ",\n";
+            }
+            out << "}";
+            return;
+        case Kind::BINOP:
+            out << "(";
+            dump(tree, tree.child(id, 0), out);
+            out << " ";
+            switch (tree.binary_op(id)) {
+                case BinaryOp::OR: out << "or"; break;
+                case BinaryOp::AND: out << "and"; break;
+                case BinaryOp::LT: out << "<"; break;
+                case BinaryOp::GT: out << ">"; break;
+                case BinaryOp::LEQ: out << "<="; break;
+                case BinaryOp::GEQ: out << ">="; break;
+                case BinaryOp::NEQ: out << "~="; break;
+                case BinaryOp::EQ: out << "=="; break;
+                case BinaryOp::BOR: out << "|"; break;
+                case BinaryOp::BXOR: out << "~"; break;
+                case BinaryOp::BAND: out << "&"; break;
+                case BinaryOp::SHL: out << "<<"; break;
+                case BinaryOp::SHR: out << ">>"; break;
+                case BinaryOp::CONCAT: out << ".."; break;
+                case BinaryOp::ADD: out << "+"; break;
+                case BinaryOp::SUB: out << "-"; break;
+                case BinaryOp::MUL: out << "*"; break;
+                case BinaryOp::DIV: out << "/"; break;
+                case BinaryOp::IDIV: out << "//"; break;
+                case BinaryOp::MOD: out << "%"; break;
+                case BinaryOp::POW: out << "^"; break;
+                default: throw std::logic_error("Invalid binary operator");
+            }
+            out << " ";
+            dump(tree, tree.child(id, 1), out);
+            out << ")";
+            return;
+        case Kind::UNARYOP:
+            out << "(";
+            switch (tree.unary_op(id)) {
+                case UnaryOp::NOT: out << "not"; break;
+                case UnaryOp::LEN: out << "#"; break;
+                case UnaryOp::NEG: out << "-"; break;
+                case UnaryOp::BNOT: out << "~"; break;
+                default: throw std::logic_error("Invalid unary operator");
+            }
+            out << " ";
+            dump(tree, tree.child(id, 0), out);
+            out << ")";
+            return;
+        default:
+            throw std::logic_error("Types cannot be emitted");
     }
 }
 
-void NNil::dump(std::ostream& out) const {
-    out << "nil";
-}
-
-Type NNil::get_type(const Scope& scope) const {
-    return Type::make_luatype(LuaType::NIL);
-}
-
-NBooleanLiteral::NBooleanLiteral(bool v)
-    : value(v) {}
-
-void NBooleanLiteral::dump(std::ostream& out) const {
-    out << (value ? "true" : "false");
-}
-
-Type NBooleanLiteral::get_type(const Scope& scope) const {
-    return Type::make_literal(value);
-}
-
-NStringLiteral::NStringLiteral(std::string v)
-    : value(std::move(v)) {}
-
-void NStringLiteral::dump(std::ostream& out) const {
-    out << value;
-}
-
-Type NStringLiteral::get_type(const Scope& scope) const {
-    return Type::make_literal(normalize_quotes(value));
-}
-
-void NDots::check(Scope& parent_scope, std::vector<CompileError>& errors) const {
-    if (!parent_scope.get_dots_type()) {
-        errors.emplace_back("Scope does not contain `...`", location);
-    }
-}
-
-void NDots::dump(std::ostream& out) const {
-    out << "...";
-}
-
-Type NDots::get_type(const Scope& scope) const {
-    return Type::make_any();
-}
-
-NFunctionDef::NFunctionDef(std::unique_ptr<NFuncParams> p, std::unique_ptr<NType> r, std::unique_ptr<NBlock> b)
-    : params(std::move(p)), ret(std::move(r)), block(std::move(b)) {}
-
-void NFunctionDef::check(Scope& parent_scope, std::vector<CompileError>& errors) const {
-    params->check(parent_scope, errors);
-    if (ret) ret->check(parent_scope, errors);
-
-    if (ret) {
-        auto rettype = ret->get_type(parent_scope);
-
-        auto this_scope = Scope(&parent_scope);
-        params->add_to_scope(this_scope);
-        this_scope.set_return_type(std::move(rettype));
-
-        if (params->is_variadic) {
-            this_scope.set_dots_type(Type::make_tuple({}, true));
-        } else {
-            this_scope.disable_dots();
-        }
-
-        block->check(this_scope, errors);
-    } else {
-        auto this_scope = Scope(&parent_scope);
-        params->add_to_scope(this_scope);
-        this_scope.deduce_return_type();
-
-        if (params->is_variadic) {
-            this_scope.set_dots_type(Type::make_tuple({}, true));
-        } else {
-            this_scope.disable_dots();
-        }
-
-        block->check(this_scope, errors);
-
-        if (auto newret = this_scope.get_return_type()) {
-            deducedret = std::move(*newret);
+// Comma separated.
+void dump_list(const Tree& tree, NodeRange ids, Sink& out) {
+    bool first = true;
+    for (auto id : ids) {
+        if (!first) {
+            out << ",";
         }
+        dump(tree, id, out);
+        first = false;
     }
 }
 
-void NFunctionDef::dump(std::ostream& out) const {
-    out << "function(" << *params << ")";
-    out << "\n";
-    out << *block;
-    out << "end";
-}
+} // static
 
-Type NFunctionDef::get_type(const Scope& scope) const {
-    std::vector<Type> paramtypes;
-    for (const auto& name : params->names) {
-        paramtypes.push_back(name.get_type(scope));
-    }
+NodeId Tree::add(Kind kind, const Location& location, const NodeId* children, std::size_t count) {
+    auto id = NodeId(nodes.size());
 
-    auto rettype = ret ? ret->get_type(scope) : deducedret ? *deducedret : Type::make_any();
+    nodes.push_back({kind, 0, std::uint32_t(edges.size()), std::uint32_t(count), 0});
+    locations.push_back(location);
+    edges.insert(edges.end(), children, children + count);
 
-    return Type::make_function(std::move(paramtypes), std::move(rettype), params->is_variadic);
+    return id;
 }
 
-NFieldExpr::NFieldExpr(std::unique_ptr<NExpr> e)
-    : expr(std::move(e)) {}
-
-void NFieldExpr::check(Scope& parent_scope, std::vector<CompileError>& errors) const {
-    expr->check(parent_scope, errors);
-}
+void Tree::set_text(NodeId id, std::string_view text) {
+    auto copy = static_cast<char*>(text_storage.allocate(text.size(), 1));
+    std::memcpy(copy, text.data(), text.size());
 
-void NFieldExpr::dump(std::ostream& out) const {
-    out << *expr;
+    nodes[id].data = std::uint32_t(texts.size());
+    texts.emplace_back(copy, text.size());
 }
 
-void NFieldExpr::add_to_table(const Scope& scope, std::vector<KeyValPair>& indexes, FieldMap& fielddecls, std::vector<CompileError>& errors)
-    const {
-    auto exprtype = expr->get_type(scope);
-    for (auto& index : indexes) {
-        if (is_assignable(index.key, LuaType::NUMBER).yes) {
-            index.val = index.val | std::move(exprtype);
-            return;
-        }
-    }
-    indexes.push_back({Type::make_luatype(LuaType::NUMBER), std::move(exprtype)});
+void Tree::set_symbol(NodeId id, Symbol symbol) {
+    nodes[id].data = std::uint32_t(symbols.size());
+    symbols.push_back(symbol);
 }
 
-NFieldNamed::NFieldNamed(std::string k, std::unique_ptr<NExpr> v)
-    : key(std::move(k)), value(std::move(v)) {}
-
-void NFieldNamed::check(Scope& parent_scope, std::vector<CompileError>& errors) const {
-    value->check(parent_scope, errors);
+void Tree::check(Scope& scope, Annotations& annotations, std::vector<CompileError>& errors) const {
+    Checker(*this, annotations, errors).check(root, scope);
 }
 
-void NFieldNamed::dump(std::ostream& out) const {
-    out << key << "=" << *value;
+void Tree::dump(Sink& out) const {
+    ast::dump(*this, root, out);
 }
 
-void NFieldNamed::add_to_table(
-    const Scope& scope,
-    std::vector<KeyValPair>& indexes,
-    FieldMap& fielddecls,
-    std::vector<CompileError>& errors) const {
-    auto iter = std::find_if(fielddecls.begin(), fielddecls.end(), [&](NameType& fd) { return fd.name == key; });
-
-    if (iter != fielddecls.end()) {
-        errors.emplace_back("Duplicate table key '" + key + "'", location);
-        iter->type = iter->type | value->get_type(scope);
-    } else {
-        fielddecls.push_back({key, value->get_type(scope)});
-    }
-}
+std::ostream& operator<<(std::ostream& out, const Tree& tree) {
+    auto write = [](void* context, const char* data, std::size_t size) {
+        static_cast<std::ostream*>(context)->write(data, std::streamsize(size));
+    };
 
-NFieldKey::NFieldKey(std::unique_ptr<NExpr> k, std::unique_ptr<NExpr> v)
-    : key(std::move(k)), value(std::move(v)) {}
+    auto sink = Sink(write, &out);
+    tree.dump(sink);
 
-void NFieldKey::check(Scope& parent_scope, std::vector<CompileError>& errors) const {
-    key->check(parent_scope, errors);
-    value->check(parent_scope, errors);
+    return out;
 }
 
-void NFieldKey::dump(std::ostream& out) const {
-    out << "[" << *key << "]=" << *value;
+const Type* Annotations::find_type(NodeId id) const {
+    auto slot = slots[id];
+    return slot != no_slot && types[slot] ? &*types[slot] : nullptr;
 }
 
-void NFieldKey::add_to_table(const Scope& scope, std::vector<KeyValPair>& indexes, FieldMap& fielddecls, std::vector<CompileError>& errors)
-    const {
-    auto keytype = key->get_type(scope);
-    auto exprtype = value->get_type(scope);
-    for (auto& index : indexes) {
-        if (is_assignable(index.key, keytype).yes) {
-            index.val = index.val | std::move(exprtype);
-            return;
-        }
+void Annotations::set_type(NodeId id, std::optional<Type> type) {
+    if (type || slots[id] != no_slot) {
+        at(id, types) = std::move(type);
     }
-    indexes.push_back({std::move(keytype), std::move(exprtype)});
 }
 
-NTableConstructor::NTableConstructor(std::vector<std::unique_ptr<NField>> f)
-    : fields(std::move(f)) {}
-
-void NTableConstructor::check(Scope& parent_scope, std::vector<CompileError>& errors) const {
-    for (const auto& field : fields) {
-        field->check(parent_scope, errors);
-    }
-
-    std::vector<KeyValPair> indexes;
-    FieldMap fielddecls;
-
-    for (const auto& field : fields) {
-        field->add_to_table(parent_scope, indexes, fielddecls, errors);
-    }
-
-    if (indexes.empty() && fields.empty()) {
-        auto& deferred = parent_scope.get_deferred_types();
-        auto deferred_id = deferred.reserve_narrow("@" + std::to_string(location.last_line));
-        deferred.set(deferred_id, Type::make_table({}, {}));
-        cached_type = Type::make_deferred(deferred, deferred_id);
-    } else {
-        cached_type = Type::make_table(std::move(indexes), std::move(fielddecls));
-    }
+const FieldMap* Annotations::find_fields(NodeId id) const {
+    auto slot = slots[id];
+    return slot != no_slot ? &field_maps[slot] : nullptr;
 }
 
-void NTableConstructor::dump(std::ostream& out) const {
-    out << "{\n";
-    for (const auto& field : fields) {
-        out << *field << ",\n";
-    }
-    out << "}";
+FieldMap& Annotations::fields(NodeId id) {
+    return at(id, field_maps);
 }
 
-Type NTableConstructor::get_type(const Scope& scope) const {
-    if (cached_type) {
-        return *cached_type;
-    } else {
-        return Type::make_any();
-    }
+std::vector<int>& Annotations::nominals(NodeId id) {
+    return at(id, nominal_ids);
 }
 
-NBinop::NBinop(Op o, std::unique_ptr<NExpr> l, std::unique_ptr<NExpr> r)
-    : op(o), left(std::move(l)), right(std::move(r)) {}
-
-void NBinop::check(Scope& parent_scope, std::vector<CompileError>& errors) const {
-    left->check(parent_scope, errors);
-    right->check(parent_scope, errors);
-
-    auto lhs = left->get_type(parent_scope);
-    auto rhs = right->get_type(parent_scope);
-
-    auto require_compare = [&] {
-        for (const auto& type : {LuaType::NUMBER, LuaType::STRING}) {
-            auto l = is_assignable(type, lhs);
-            auto r = is_assignable(type, rhs);
-
-            if (l.yes && r.yes) {
-                return;
-            }
-        }
-
-        errors.emplace_back("Cannot compare `" + to_string(lhs) + "` to `" + to_string(rhs) + "`", location);
-    };
-
-    auto require_equal = [&] {
-        auto l = is_assignable(lhs, rhs);
-        auto r = is_assignable(rhs, lhs);
-
-        if (l.yes || r.yes) {
-            return;
-        }
-
-        errors.emplace_back("Cannot compare `" + to_string(lhs) + "` to `" + to_string(rhs) + "`", location);
-    };
-
-    auto require_bitwise = [&] {
-        auto l = is_assignable(LuaType::NUMBER, lhs);
-        auto r = is_assignable(LuaType::NUMBER, rhs);
-
-        if (!l.yes) {
-            l.messages.push_back("In bitwise operation");
-            errors.emplace_back(to_string(l), location);
-        }
+template <typename T>
+T& Annotations::at(NodeId id, std::deque<T>& results) {
+    auto& slot = slots[id];
 
-        if (!r.yes) {
-            r.messages.push_back("In bitwise operation");
-            errors.emplace_back(to_string(r), location);
-        }
-    };
-
-    auto require_concat = [&] {
-        auto l = is_assignable(LuaType::STRING, lhs);
-        auto r = is_assignable(LuaType::STRING, rhs);
-
-        if (!l.yes) {
-            l.messages.push_back("In concat operation");
-            errors.emplace_back(to_string(l), location);
-        }
-
-        if (!r.yes) {
-            r.messages.push_back("In concat operation");
-            errors.emplace_back(to_string(r), location);
-        }
-    };
-
-    auto require_math = [&] {
-        auto l = is_assignable(LuaType::NUMBER, lhs);
-        auto r = is_assignable(LuaType::NUMBER, rhs);
-
-        if (!l.yes) {
-            l.messages.push_back("In arithmetic operation");
-            errors.emplace_back(to_string(l), location);
-        }
-
-        if (!r.yes) {
-            r.messages.push_back("In arithmetic operation");
-            errors.emplace_back(to_string(r), location);
-        }
-    };
-
-    switch (op) {
-        case Op::OR: break;
-        case Op::AND: break;
-        case Op::LT: require_compare(); break;
-        case Op::GT: require_compare(); break;
-        case Op::LEQ: require_compare(); break;
-        case Op::GEQ: require_compare(); break;
-        case Op::NEQ: require_equal(); break;
-        case Op::EQ: require_equal(); break;
-        case Op::BOR: require_bitwise(); break;
-        case Op::BXOR: require_bitwise(); break;
-        case Op::BAND: require_bitwise(); break;
-        case Op::SHL: require_bitwise(); break;
-        case Op::SHR: require_bitwise(); break;
-        case Op::CONCAT: require_concat(); break;
-        case Op::ADD: require_math(); break;
-        case Op::SUB: require_math(); break;
-        case Op::MUL: require_math(); break;
-        case Op::DIV: require_math(); break;
-        case Op::IDIV: require_math(); break;
-        case Op::MOD: require_math(); break;
-        case Op::POW: require_math(); break;
-        default: throw std::logic_error("Invalid binary operator");
+    if (slot == no_slot) {
+        slot = std::uint32_t(results.size());
+        results.emplace_back();
     }
-}
 
-void NBinop::dump(std::ostream& out) const {
-    out << "(" << *left << " ";
-    switch (op) {
-        case Op::OR: out << "or"; break;
-        case Op::AND: out << "and"; break;
-        case Op::LT: out << "<"; break;
-        case Op::GT: out << ">"; break;
-        case Op::LEQ: out << "<="; break;
-        case Op::GEQ: out << ">="; break;
-        case Op::NEQ: out << "~="; break;
-        case Op::EQ: out << "=="; break;
-        case Op::BOR: out << "|"; break;
-        case Op::BXOR: out << "~"; break;
-        case Op::BAND: out << "&"; break;
-        case Op::SHL: out << "<<"; break;
-        case Op::SHR: out << ">>"; break;
-        case Op::CONCAT: out << ".."; break;
-        case Op::ADD: out << "+"; break;
-        case Op::SUB: out << "-"; break;
-        case Op::MUL: out << "*"; break;
-        case Op::DIV: out << "/"; break;
-        case Op::IDIV: out << "//"; break;
-        case Op::MOD: out << "%"; break;
-        case Op::POW: out << "^"; break;
-        default: throw std::logic_error("Invalid binary operator");
-    }
-    out << " " << *right << ")";
-}
-
-Type NBinop::get_type(const Scope& scope) const {
-    switch (op) {
-        case Op::OR: return (left->get_type(scope) - Type::make_literal(false)) | right->get_type(scope);
-        case Op::AND: return Type::make_literal(false) | right->get_type(scope);
-        case Op::LT: return Type::make_luatype(LuaType::BOOLEAN);
-        case Op::GT: return Type::make_luatype(LuaType::BOOLEAN);
-        case Op::LEQ: return Type::make_luatype(LuaType::BOOLEAN);
-        case Op::GEQ: return Type::make_luatype(LuaType::BOOLEAN);
-        case Op::NEQ: return Type::make_luatype(LuaType::BOOLEAN);
-        case Op::EQ: return Type::make_luatype(LuaType::BOOLEAN);
-        case Op::BOR: return Type::make_luatype(LuaType::NUMBER);
-        case Op::BXOR: return Type::make_luatype(LuaType::NUMBER);
-        case Op::BAND: return Type::make_luatype(LuaType::NUMBER);
-        case Op::SHL: return Type::make_luatype(LuaType::NUMBER);
-        case Op::SHR: return Type::make_luatype(LuaType::NUMBER);
-        case Op::CONCAT: return Type::make_luatype(LuaType::STRING);
-        case Op::ADD: return Type::make_luatype(LuaType::NUMBER);
-        case Op::SUB: return Type::make_luatype(LuaType::NUMBER);
-        case Op::MUL: return Type::make_luatype(LuaType::NUMBER);
-        case Op::DIV: return Type::make_luatype(LuaType::NUMBER);
-        case Op::IDIV: return Type::make_luatype(LuaType::NUMBER);
-        case Op::MOD: return Type::make_luatype(LuaType::NUMBER);
-        case Op::POW: return Type::make_luatype(LuaType::NUMBER);
-        default: throw std::logic_error("Invalid binary operator");
-    }
-}
-
-NUnaryop::NUnaryop(Op o, std::unique_ptr<NExpr> e)
-    : op(o), expr(std::move(e)) {}
-
-void NUnaryop::check(Scope& parent_scope, std::vector<CompileError>& errors) const {
-    expr->check(parent_scope, errors);
-
-    auto type = expr->get_type(parent_scope);
-
-    auto require_len = [&] {
-        auto str = Type::make_luatype(LuaType::STRING);
-        auto tab = Type::make_table({{Type::make_luatype(LuaType::NUMBER), Type::make_any()}}, {});
-        auto r = is_assignable(str | tab, type);
-
-        if (!r.yes) {
-            r.messages.push_back("In length operator");
-            errors.emplace_back(to_string(r), location);
-        }
-    };
-
-    auto require_number = [&] {
-        auto num = Type::make_luatype(LuaType::NUMBER);
-        auto r = is_assignable(num, type);
-
-        if (!r.yes) {
-            r.messages.push_back("In unary operator");
-            errors.emplace_back(to_string(r), location);
-        }
-    };
-
-    switch (op) {
-        case Op::NOT: break;
-        case Op::LEN: require_len(); break;
-        case Op::NEG: require_number(); break;
-        case Op::BNOT: require_number(); break;
-        default: throw std::logic_error("Invalid unary operator");
-    }
-}
-
-void NUnaryop::dump(std::ostream& out) const {
-    out << "(";
-    switch (op) {
-        case Op::NOT: out << "not"; break;
-        case Op::LEN: out << "#"; break;
-        case Op::NEG: out << "-"; break;
-        case Op::BNOT: out << "~"; break;
-        default: throw std::logic_error("Invalid unary operator");
-    }
-    out << " " << *expr << ")";
-}
-
-Type NUnaryop::get_type(const Scope& scope) const {
-    switch (op) {
-        case Op::NOT: return Type::make_luatype(LuaType::BOOLEAN);
-        case Op::LEN: return Type::make_luatype(LuaType::NUMBER);
-        case Op::NEG: return Type::make_luatype(LuaType::NUMBER);
-        case Op::BNOT: return Type::make_luatype(LuaType::NUMBER);
-        default: throw std::logic_error("Invalid unary operator");
-    }
+    return results[slot];
 }
 
 } // namespace typedlua::ast
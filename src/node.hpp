@@ -1,797 +1,265 @@
 #ifndef TYPEDLUA_NODE_HPP
 #define TYPEDLUA_NODE_HPP
 
+#include "arena.hpp"
 #include "compile_error.hpp"
 #include "location.hpp"
 #include "scope.hpp"
+#include "sink.hpp"
+#include "symbol.hpp"
 #include "type.hpp"
 
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <initializer_list>
 #include <iostream>
-#include <memory>
 #include <optional>
-#include <string>
+#include <string_view>
 #include <vector>
 
 namespace typedlua::ast {
 
-class Node {
-public:
-    virtual ~Node() = default;
-
-    virtual void check(Scope& parent_scope, std::vector<CompileError>& errors) const;
-
-    virtual void dump(std::ostream& out) const;
-
-    Location location;
-};
-
-inline std::ostream& operator<<(std::ostream& out, const Node& n) {
-    n.dump(out);
-    return out;
-}
-
-class NExpr : public Node {
-public:
-    virtual Type get_type(const Scope& scope) const = 0;
-
-    virtual void check_expect(Scope& parent_scope, const Type& expected, std::vector<CompileError>& errors) const;
-};
-
-class NBlock final : public Node {
-public:
-    std::vector<std::unique_ptr<Node>> children;
-    bool scoped = false;
-
-    virtual void check(Scope& parent_scope, std::vector<CompileError>& errors) const override final;
-
-    virtual void dump(std::ostream& out) const override;
-};
-
-class NType : public Node {
-public:
-    virtual void dump(std::ostream& out) const override final;
-
-    virtual Type get_type(const Scope& scope) const = 0;
-};
-
-class NNameDecl final : public Node {
-public:
-    NNameDecl() = default;
-    NNameDecl(std::string name);
-    NNameDecl(std::string name, std::unique_ptr<NType> type);
-    std::string name;
-    std::unique_ptr<NType> type;
-
-    virtual void check(Scope& parent_scope, std::vector<CompileError>& errors) const override final;
-
-    virtual void dump(std::ostream& out) const override;
-
-    Type get_type(const Scope& scope) const;
-};
-
-class NTypeName final : public NType {
-public:
-    NTypeName() = default;
-    NTypeName(std::string name);
-    std::string name;
-
-    virtual void check(Scope& parent_scope, std::vector<CompileError>& errors) const override final;
-
-    virtual Type get_type(const Scope& scope) const override;
-};
-
-class NTypeFunctionParam final : public Node {
-public:
-    NTypeFunctionParam() = default;
-    NTypeFunctionParam(std::string name, std::unique_ptr<NType> type);
-    std::string name;
-    std::unique_ptr<NType> type;
-
-    virtual void check(Scope& parent_scope, std::vector<CompileError>& errors) const override final;
-
-    virtual void dump(std::ostream& out) const override;
-};
-
-class NTypeFunction final : public NType {
-public:
-    NTypeFunction() = default;
-    NTypeFunction(std::vector<NTypeFunctionParam> p, std::unique_ptr<NType> r, bool v);
-    std::vector<NNameDecl> generic_params;
-    std::vector<NTypeFunctionParam> params;
-    std::unique_ptr<NType> ret;
-    bool is_variadic;
-    mutable Type cached_type;
-
-    virtual void check(Scope& parent_scope, std::vector<CompileError>& errors) const override final;
-
-    virtual Type get_type(const Scope& parent_scope) const override;
-};
-
-class NTypeTuple final : public NType {
-public:
-    NTypeTuple() = default;
-    NTypeTuple(std::vector<NTypeFunctionParam> p, bool v);
-    std::vector<NTypeFunctionParam> params;
-    bool variadic;
-
-    virtual void check(Scope& parent_scope, std::vector<CompileError>& errors) const override final;
+using NodeId = std::uint32_t;
+
+// Stands for an optional child that is absent.
+constexpr auto no_node = NodeId(-1);
+
+// What a node is, and how its children are laid out. "text" and "symbol" are its payload, see `Tree::text` and
+// `Tree::symbol`, and "flag" is `Node::flag`. A child in brackets is `no_node` when it is absent.
+enum class Kind : std::uint8_t {
+    BLOCK,                // statements...; flag: scoped by `do ... end`
+    NAME_DECL,            // [type]; text: name
+    TYPE_NAME,            // symbol: name
+    TYPE_FUNCTION_PARAM,  // type; text: name, possibly empty
+    TYPE_FUNCTION,        // ret, generic params (NAME_DECL)..., params (TYPE_FUNCTION_PARAM)...; data: generic param count; flag: variadic
+    TYPE_TUPLE,           // params (TYPE_FUNCTION_PARAM)...; flag: variadic
+    TYPE_SUM,             // lhs, rhs
+    TYPE_PRODUCT,         // lhs, rhs
+    INDEX,                // key, val
+    INDEX_LIST,           // indexes (INDEX)...
+    FIELD_DECL,           // type; text: name
+    FIELD_DECL_LIST,      // fields (FIELD_DECL)...
+    TYPE_TABLE,           // [indexes (INDEX_LIST)], [fields (FIELD_DECL_LIST)]
+    TYPE_LITERAL_BOOLEAN, // flag: value
+    TYPE_LITERAL_NUMBER,  // text: value
+    TYPE_LITERAL_STRING,  // text: value, quoted
+    TYPE_REQUIRE,         // type
+    TYPE_GENERIC_CALL,    // type, args...
+    INTERFACE,            // type, params (NAME_DECL)...; text: name
+    IDENT,                // symbol: name
+    SUBSCRIPT,            // prefix, subscript
+    TABLE_ACCESS,         // prefix; text: name
+    FUNCTION_CALL,        // prefix, args...
+    FUNCTION_SELF_CALL,   // prefix, args...; text: method name
+    NUMBER_LITERAL,       // text: value
+    ASSIGNMENT,           // vars..., exprs...; data: var count
+    EMPTY,                //
+    LABEL,                // text: name
+    BREAK,                //
+    GOTO,                 // text: label
+    WHILE,                // condition, block
+    REPEAT,               // block, until
+    ELSE_IF,              // condition, block
+    ELSE,                 // block
+    IF,                   // condition, block, [else (ELSE)], elseifs (ELSE_IF)...
+    FOR_NUMERIC,          // begin, end, [step], block; text: name
+    FOR_GENERIC,          // block, names (NAME_DECL)..., exprs...; data: name count
+    FUNC_PARAMS,          // names (NAME_DECL)...; flag: variadic
+    FUNCTION,             // params (FUNC_PARAMS), [ret], block, name, generic params (NAME_DECL)...
+    SELF_FUNCTION,        // params (FUNC_PARAMS), [ret], block, self, generic params (NAME_DECL)...; text: method name
+    LOCAL_FUNCTION,       // params (FUNC_PARAMS), [ret], block, no_node, generic params (NAME_DECL)...; text: name
+    RETURN,               // exprs...
+    LOCAL_VAR,            // names (NAME_DECL)..., exprs...; data: name count
+    GLOBAL_VAR,           // names (NAME_DECL)..., exprs...; data: name count
+    NIL,                  //
+    BOOLEAN_LITERAL,      // flag: value
+    STRING_LITERAL,       // text: value, as written
+    DOTS,                 //
+    FUNCTION_DEF,         // params (FUNC_PARAMS), [ret], block
+    FIELD_EXPR,           // expr
+    FIELD_NAMED,          // value; text: key
+    FIELD_KEY,            // key, value
+    TABLE_CONSTRUCTOR,    // fields (FIELD_EXPR, FIELD_NAMED or FIELD_KEY)...
+    BINOP,                // left, right; flag: BinaryOp
+    UNARYOP               // expr; flag: UnaryOp
+};
+
+enum class BinaryOp : std::uint8_t {
+    OR,
+    AND,
+    LT,
+    GT,
+    LEQ,
+    GEQ,
+    NEQ,
+    EQ,
+    BOR,
+    BXOR,
+    BAND,
+    SHL,
+    SHR,
+    CONCAT,
+    ADD,
+    SUB,
+    MUL,
+    DIV,
+    IDIV,
+    MOD,
+    POW
+};
+
+enum class UnaryOp : std::uint8_t {
+    NOT,
+    LEN,
+    NEG,
+    BNOT
+};
+
+struct Node {
+    Kind kind;
+    // A boolean or an operator, see Kind.
+    std::uint8_t flag;
+    // The children are Tree::edges[first, first + count).
+    std::uint32_t first;
+    std::uint32_t count;
+    // Index of the text or symbol, or a count of children, see Kind.
+    std::uint32_t data;
+};
+
+// Consecutive children of a node.
+class NodeRange {
+public:
+    NodeRange(const NodeId* first, const NodeId* last) : first(first), last(last) {}
+
+    const NodeId* begin() const { return first; }
+    const NodeId* end() const { return last; }
+    std::size_t size() const { return last - first; }
+    bool empty() const { return first == last; }
+    NodeId operator[](std::size_t i) const { return first[i]; }
 
-    virtual Type get_type(const Scope& scope) const override;
+private:
+    const NodeId* first;
+    const NodeId* last;
 };
 
-class NTypeSum final : public NType {
-public:
-    NTypeSum() = default;
-    NTypeSum(std::unique_ptr<NType> l, std::unique_ptr<NType> r);
-    std::unique_ptr<NType> lhs;
-    std::unique_ptr<NType> rhs;
-
-    virtual void check(Scope& parent_scope, std::vector<CompileError>& errors) const override final;
-
-    virtual Type get_type(const Scope& scope) const override;
-};
+class Annotations;
 
-class NTypeProduct final : public NType {
+// A parsed chunk. Nodes are stored in one array and refer to each other by index, children in one more, and names and
+// literals in side arrays, so the whole tree is freed at once and walked without chasing pointers.
+// Nodes are added bottom up, so every child has a lower id than its parent and the root is added last.
+class Tree {
 public:
-    NTypeProduct() = default;
-    NTypeProduct(std::unique_ptr<NType> l, std::unique_ptr<NType> r);
-    std::unique_ptr<NType> lhs;
-    std::unique_ptr<NType> rhs;
-
-    virtual void check(Scope& parent_scope, std::vector<CompileError>& errors) const override final;
-
-    virtual Type get_type(const Scope& scope) const override;
-};
+    Tree() = default;
+    Tree(const Tree&) = delete;
+    Tree& operator=(const Tree&) = delete;
 
-class NIndex final : public Node {
-public:
-    NIndex() = default;
-    NIndex(std::unique_ptr<NType> k, std::unique_ptr<NType> v);
-    std::unique_ptr<NType> key;
-    std::unique_ptr<NType> val;
+    NodeId add(Kind kind, const Location& location, const NodeId* children, std::size_t count);
 
-    virtual void check(Scope& parent_scope, std::vector<CompileError>& errors) const override final;
+    NodeId add(Kind kind, const Location& location, std::initializer_list<NodeId> children = {}) {
+        return add(kind, location, children.begin(), children.size());
+    }
 
-    virtual void dump(std::ostream& out) const override;
+    NodeId add(Kind kind, const Location& location, const std::vector<NodeId>& children) {
+        return add(kind, location, children.data(), children.size());
+    }
 
-    KeyValPair get_kvp(const Scope& scope) const;
-};
+    // Copies `text` into the tree.
+    void set_text(NodeId id, std::string_view text);
 
-class NIndexList final : public Node {
-public:
-    NIndexList() = default;
-    std::vector<std::unique_ptr<NIndex>> indexes;
+    void set_symbol(NodeId id, Symbol symbol);
 
-    virtual void check(Scope& parent_scope, std::vector<CompileError>& errors) const override final;
+    void set_flag(NodeId id, std::uint8_t flag) { nodes[id].flag = flag; }
 
-    virtual void dump(std::ostream& out) const override;
-    std::vector<KeyValPair> get_types(const Scope& scope) const;
-};
+    void set_data(NodeId id, std::uint32_t data) { nodes[id].data = data; }
 
-class NFieldDecl final : public Node {
-public:
-    NFieldDecl() = default;
-    NFieldDecl(std::string n, std::unique_ptr<NType> t);
-    std::string name;
-    std::unique_ptr<NType> type;
+    void set_location(NodeId id, const Location& location) { locations[id] = location; }
 
-    virtual void check(Scope& parent_scope, std::vector<CompileError>& errors) const override final;
+    const Node& node(NodeId id) const { return nodes[id]; }
 
-    virtual void dump(std::ostream& out) const override;
-};
+    Kind kind(NodeId id) const { return nodes[id].kind; }
 
-class NFieldDeclList final : public Node {
-public:
-    NFieldDeclList() = default;
-    std::vector<std::unique_ptr<NFieldDecl>> fields;
-    mutable FieldMap cached_fields;
+    bool flag(NodeId id) const { return nodes[id].flag != 0; }
 
-    virtual void check(Scope& parent_scope, std::vector<CompileError>& errors) const override final;
+    BinaryOp binary_op(NodeId id) const { return static_cast<BinaryOp>(nodes[id].flag); }
 
-    virtual void dump(std::ostream& out) const override;
+    UnaryOp unary_op(NodeId id) const { return static_cast<UnaryOp>(nodes[id].flag); }
 
-    FieldMap get_types(const Scope& scope) const;
-};
+    std::uint32_t data(NodeId id) const { return nodes[id].data; }
 
-class NTypeTable final : public NType {
-public:
-    NTypeTable() = default;
-    NTypeTable(std::unique_ptr<NIndexList> i, std::unique_ptr<NFieldDeclList> f);
-    std::unique_ptr<NIndexList> indexlist;
-    std::unique_ptr<NFieldDeclList> fieldlist;
+    const Location& location(NodeId id) const { return locations[id]; }
 
-    virtual void check(Scope& parent_scope, std::vector<CompileError>& errors) const override final;
+    std::string_view text(NodeId id) const { return texts[nodes[id].data]; }
 
-    virtual Type get_type(const Scope& scope) const override;
-};
+    Symbol symbol(NodeId id) const { return symbols[nodes[id].data]; }
 
-class NTypeLiteralBoolean final : public NType {
-public:
-    NTypeLiteralBoolean() = default;
-    NTypeLiteralBoolean(bool v);
-    bool value;
+    NodeId child(NodeId id, std::size_t i) const { return edges[nodes[id].first + i]; }
 
-    virtual Type get_type(const Scope& scope) const override;
-};
+    NodeRange children(NodeId id) const { return children(id, 0, nodes[id].count); }
 
-class NTypeLiteralNumber final : public NType {
-public:
-    NTypeLiteralNumber() = default;
-    NTypeLiteralNumber(const std::string& s);
-    NumberRep value;
+    NodeRange children(NodeId id, std::size_t from) const { return children(id, from, nodes[id].count); }
 
-    virtual Type get_type(const Scope& scope) const override;
-};
+    NodeRange children(NodeId id, std::size_t from, std::size_t to) const {
+        auto first = edges.data() + nodes[id].first;
+        return {first + from, first + to};
+    }
 
-class NTypeLiteralString final : public NType {
-public:
-    NTypeLiteralString() = default;
-    NTypeLiteralString(std::string_view s);
-    std::string value;
+    std::size_t size() const { return nodes.size(); }
 
-    virtual Type get_type(const Scope& scope) const override;
-};
+    // Records what it finds out about nodes in `annotations`, which must have been made for this tree.
+    void check(Scope& scope, Annotations& annotations, std::vector<CompileError>& errors) const;
 
-class NTypeRequire final : public NType {
-public:
-    NTypeRequire() = default;
-    NTypeRequire(std::unique_ptr<NType> t);
-    std::unique_ptr<NType> type;
+    // Writes the tree as Lua.
+    void dump(Sink& out) const;
 
-    virtual void check(Scope& parent_scope, std::vector<CompileError>& errors) const override final;
-
-    virtual Type get_type(const Scope& scope) const override;
-};
-
-class NTypeGenericCall final : public NType {
-public:
-    NTypeGenericCall() = default;
-    NTypeGenericCall(std::unique_ptr<NType> t, std::vector<std::unique_ptr<NType>> a);
-    std::unique_ptr<NType> type;
-    std::vector<std::unique_ptr<NType>> args;
-    mutable std::optional<Type> cached_type;
-
-    virtual void check(Scope& parent_scope, std::vector<CompileError>& errors) const override final;
-
-    virtual Type get_type(const Scope& scope) const override;
-};
-
-class NInterface final : public Node {
-public:
-    NInterface() = default;
-    NInterface(std::string n, std::unique_ptr<NType> t);
-    NInterface(std::string n, std::unique_ptr<NType> t, std::vector<NNameDecl> p);
-    std::string name;
-    std::unique_ptr<NType> type;
-    std::vector<NNameDecl> params;
-
-    virtual void check(Scope& parent_scope, std::vector<CompileError>& errors) const override final;
-
-    virtual void dump(std::ostream& out) const override;
-};
-
-class NIdent final : public NExpr {
-public:
-    NIdent() = default;
-    NIdent(std::string v);
-    std::string name;
-
-    virtual void check(Scope& parent_scope, std::vector<CompileError>& errors) const override final;
-
-    virtual void check_expect(Scope& parent_scope, const Type& expected, std::vector<CompileError>& errors) const override final;
-
-    virtual void dump(std::ostream& out) const override;
-
-    virtual Type get_type(const Scope& scope) const override;
+    NodeId root = no_node;
 
 private:
-    void fail_common(Scope& parent_scope, std::vector<CompileError>& errors) const;
+    std::vector<Node> nodes;
+    std::vector<Location> locations;
+    std::vector<NodeId> edges;
+    std::vector<std::string_view> texts;
+    std::vector<Symbol> symbols;
+    // Holds the characters of `texts`.
+    Arena text_storage;
 };
 
-class NSubscript final : public NExpr {
+// Results of one check of a tree, by node id: the types of calls, accesses, table constructors, function types and
+// generic calls, the deduced return types of function definitions, the fields of table types, and the deferred ids of
+// the generic parameters of functions.
+// The tree itself is never written to, so it can be checked again, or on several threads at once, each with its own.
+class Annotations {
 public:
-    NSubscript() = default;
-    NSubscript(std::unique_ptr<NExpr> p, std::unique_ptr<NExpr> s);
-    std::unique_ptr<NExpr> prefix;
-    std::unique_ptr<NExpr> subscript;
-    mutable std::optional<Type> cached_type;
-
-    virtual void check(Scope& parent_scope, std::vector<CompileError>& errors) const override final;
-
-    virtual void check_expect(Scope& parent_scope, const Type& expected, std::vector<CompileError>& errors) const override final;
-
-    virtual void dump(std::ostream& out) const override;
-
-    virtual Type get_type(const Scope& scope) const override;
+    explicit Annotations(const Tree& tree) : slots(tree.size(), no_slot) {}
+    Annotations(const Annotations&) = delete;
+    Annotations& operator=(const Annotations&) = delete;
 
-private:
-    void check_common(const Type& prefixtype, const Type& keytype, Scope& parent_scope, std::vector<CompileError>& errors) const;
-};
-
-class NTableAccess final : public NExpr {
-public:
-    NTableAccess() = default;
-    NTableAccess(std::unique_ptr<NExpr> p, std::string n);
-    std::unique_ptr<NExpr> prefix;
-    std::string name;
-    mutable std::optional<Type> cached_type;
+    const Type* find_type(NodeId id) const;
 
-    virtual void check(Scope& parent_scope, std::vector<CompileError>& errors) const override final;
+    // Forgets the type if `type` is empty.
+    void set_type(NodeId id, std::optional<Type> type);
 
-    virtual void check_expect(Scope& parent_scope, const Type& expected, std::vector<CompileError>& errors) const override final;
+    const FieldMap* find_fields(NodeId id) const;
 
-    virtual void dump(std::ostream& out) const override;
+    FieldMap& fields(NodeId id);
 
-    virtual Type get_type(const Scope& scope) const override;
+    std::vector<int>& nominals(NodeId id);
 
 private:
-    void check_common(const Type& prefixtype, Scope& parent_scope, std::vector<CompileError>& errors) const;
-};
-
-class NArgSeq final : public Node {
-public:
-    NArgSeq() = default;
-    std::vector<std::unique_ptr<NExpr>> args;
-
-    virtual void check(Scope& parent_scope, std::vector<CompileError>& errors) const override final;
-
-    virtual void dump(std::ostream& out) const override;
-};
-
-class NFunctionCall final : public NExpr {
-public:
-    NFunctionCall() = default;
-    NFunctionCall(std::unique_ptr<NExpr> p, std::unique_ptr<NArgSeq> a);
-    std::unique_ptr<NExpr> prefix;
-    std::unique_ptr<NArgSeq> args;
-    mutable std::optional<Type> cached_rettype;
-
-    virtual void check(Scope& parent_scope, std::vector<CompileError>& errors) const override final;
-
-    virtual void dump(std::ostream& out) const override;
-
-    virtual Type get_type(const Scope& scope) const override;
-};
-
-class NFunctionSelfCall final : public NExpr {
-public:
-    NFunctionSelfCall() = default;
-    NFunctionSelfCall(std::unique_ptr<NExpr> p, std::string n, std::unique_ptr<NArgSeq> a);
-    std::unique_ptr<NExpr> prefix;
-    std::string name;
-    std::unique_ptr<NArgSeq> args;
-    mutable std::optional<Type> cached_rettype;
-
-    virtual void check(Scope& parent_scope, std::vector<CompileError>& errors) const override final;
-
-    virtual void dump(std::ostream& out) const override;
-
-    virtual Type get_type(const Scope& scope) const override;
-};
-
-class NNumberLiteral final : public NExpr {
-public:
-    NNumberLiteral() = default;
-    NNumberLiteral(std::string v);
-    std::string value;
-
-    virtual void dump(std::ostream& out) const override;
-
-    virtual Type get_type(const Scope& scope) const override;
-};
-
-class NAssignment final : public Node {
-public:
-    NAssignment() = default;
-    NAssignment(std::vector<std::unique_ptr<NExpr>> v, std::vector<std::unique_ptr<NExpr>> e);
-    std::vector<std::unique_ptr<NExpr>> vars;
-    std::vector<std::unique_ptr<NExpr>> exprs;
-
-    virtual void check(Scope& parent_scope, std::vector<CompileError>& errors) const override final;
-
-    virtual void dump(std::ostream& out) const override;
-};
-
-class NEmpty final : public Node {
-public:
-    NEmpty() = default;
-
-    virtual void dump(std::ostream& out) const override;
-};
-
-class NLabel final : public Node {
-public:
-    NLabel() = default;
-    NLabel(std::string n);
-    std::string name;
-
-    virtual void dump(std::ostream& out) const override;
-};
-
-class NBreak final : public Node {
-public:
-    NBreak() = default;
-
-    virtual void dump(std::ostream& out) const override;
-};
-
-class NGoto final : public Node {
-public:
-    NGoto() = default;
-    NGoto(std::string n);
-    std::string name;
-
-    virtual void dump(std::ostream& out) const override;
-};
-
-class NWhile final : public Node {
-public:
-    NWhile() = default;
-    NWhile(std::unique_ptr<NExpr> c, std::unique_ptr<NBlock> b);
-    std::unique_ptr<NExpr> condition;
-    std::unique_ptr<NBlock> block;
-
-    virtual void check(Scope& parent_scope, std::vector<CompileError>& errors) const override final;
-
-    virtual void dump(std::ostream& out) const override;
-};
-
-class NRepeat final : public Node {
-public:
-    NRepeat() = default;
-    NRepeat(std::unique_ptr<NBlock> b, std::unique_ptr<NExpr> u);
-    std::unique_ptr<NBlock> block;
-    std::unique_ptr<NExpr> until;
-
-    virtual void check(Scope& parent_scope, std::vector<CompileError>& errors) const override final;
-
-    virtual void dump(std::ostream& out) const override;
-};
-
-class NElseIf final : public Node {
-public:
-    NElseIf() = default;
-    NElseIf(std::unique_ptr<NExpr> c, std::unique_ptr<NBlock> b);
-    std::unique_ptr<NExpr> condition;
-    std::unique_ptr<NBlock> block;
-
-    virtual void check(Scope& parent_scope, std::vector<CompileError>& errors) const override final;
-
-    virtual void dump(std::ostream& out) const override;
-};
-
-class NElse final : public Node {
-public:
-    NElse() = default;
-    NElse(std::unique_ptr<NBlock> b);
-    std::unique_ptr<NBlock> block;
-
-    virtual void check(Scope& parent_scope, std::vector<CompileError>& errors) const override final;
-
-    virtual void dump(std::ostream& out) const override;
-};
-
-class NIf final : public Node {
-public:
-    NIf() = default;
-    NIf(std::unique_ptr<NExpr> c, std::unique_ptr<NBlock> b, std::vector<std::unique_ptr<NElseIf>> ei, std::unique_ptr<NElse> e);
-    std::unique_ptr<NExpr> condition;
-    std::unique_ptr<NBlock> block;
-    std::vector<std::unique_ptr<NElseIf>> elseifs;
-    std::unique_ptr<NElse> else_;
-
-    virtual void check(Scope& parent_scope, std::vector<CompileError>& errors) const override final;
-
-    virtual void dump(std::ostream& out) const override;
-};
-
-class NForNumeric final : public Node {
-public:
-    NForNumeric() = default;
-    NForNumeric(std::string n, std::unique_ptr<NExpr> b, std::unique_ptr<NExpr> e, std::unique_ptr<NExpr> s, std::unique_ptr<NBlock> k);
-    std::string name;
-    std::unique_ptr<NExpr> begin;
-    std::unique_ptr<NExpr> end;
-    std::unique_ptr<NExpr> step;
-    std::unique_ptr<NBlock> block;
-
-    virtual void check(Scope& parent_scope, std::vector<CompileError>& errors) const override final;
-
-    virtual void dump(std::ostream& out) const override;
-};
-
-class NForGeneric final : public Node {
-public:
-    NForGeneric() = default;
-    NForGeneric(std::vector<NNameDecl> n, std::vector<std::unique_ptr<NExpr>> e, std::unique_ptr<NBlock> b);
-    std::vector<NNameDecl> names;
-    std::vector<std::unique_ptr<NExpr>> exprs;
-    std::unique_ptr<NBlock> block;
-
-    virtual void check(Scope& parent_scope, std::vector<CompileError>& errors) const override final;
-
-    virtual void dump(std::ostream& out) const override;
-};
-
-class NFuncParams final : public Node {
-public:
-    NFuncParams() = default;
-    NFuncParams(std::vector<NNameDecl> n, bool v);
-    std::vector<NNameDecl> names;
-    bool is_variadic = false;
-
-    virtual void check(Scope& parent_scope, std::vector<CompileError>& errors) const override final;
-
-    virtual void dump(std::ostream& out) const override;
-
-    void add_to_scope(Scope& scope) const;
-
-    std::vector<Type> get_types(const Scope& scope) const;
-};
-
-class FunctionBase {
-public:
-    FunctionBase() = default;
-    FunctionBase(std::vector<NNameDecl> g, std::unique_ptr<NFuncParams> p, std::unique_ptr<NType> r, std::unique_ptr<NBlock> b);
-
-    Type check(Scope& parent_scope, std::vector<CompileError>& errors, const std::optional<std::string>& local_name) const;
-
-    Type get_type(Scope& parent_scope, const Type& rettype) const;
-
-    Type get_type(Scope& parent_scope, const Type& rettype, const Type& selftype) const;
-
-    std::vector<NNameDecl> generic_params;
-    std::unique_ptr<NFuncParams> params;
-    std::unique_ptr<NType> ret;
-    std::unique_ptr<NBlock> block;
-    mutable std::vector<int> nominals;
-};
+    static constexpr auto no_slot = std::uint32_t(-1);
 
-class NFunction final : public Node {
-public:
-    NFunction() = default;
-    NFunction(FunctionBase fb, std::unique_ptr<NExpr> e);
-    FunctionBase base;
-    std::unique_ptr<NExpr> expr;
+    template <typename T>
+    T& at(NodeId id, std::deque<T>& results);
 
-    virtual void check(Scope& parent_scope, std::vector<CompileError>& errors) const override final;
-    virtual void dump(std::ostream& out) const override;
+    // Where the result for each node is in whichever of the stores below its kind has results in, or no_slot.
+    std::vector<std::uint32_t> slots;
+    // Deques, so results handed out stay put while nested nodes add theirs.
+    std::deque<std::optional<Type>> types;
+    std::deque<FieldMap> field_maps;
+    std::deque<std::vector<int>> nominal_ids;
 };
 
-class NSelfFunction final : public Node {
-public:
-    NSelfFunction() = default;
-    NSelfFunction(FunctionBase fb, std::string m, std::unique_ptr<NExpr> e);
-
-    FunctionBase base;
-    std::string name;
-    std::unique_ptr<NExpr> expr;
-
-    virtual void check(Scope& parent_scope, std::vector<CompileError>& errors) const override final;
-
-    virtual void dump(std::ostream& out) const override;
-};
-
-class NLocalFunction final : public Node {
-public:
-    NLocalFunction() = default;
-    NLocalFunction(FunctionBase fb, std::string n);
-    FunctionBase base;
-    std::string name;
-
-    virtual void check(Scope& parent_scope, std::vector<CompileError>& errors) const override final;
-
-    virtual void dump(std::ostream& out) const override;
-};
-
-class NReturn final : public Node {
-public:
-    NReturn() = default;
-    NReturn(std::vector<std::unique_ptr<NExpr>> e);
-    std::vector<std::unique_ptr<NExpr>> exprs;
-
-    virtual void check(Scope& parent_scope, std::vector<CompileError>& errors) const override final;
-
-    virtual void dump(std::ostream& out) const override;
-};
-
-class NLocalVar final : public Node {
-public:
-    NLocalVar() = default;
-    NLocalVar(std::vector<NNameDecl> n, std::vector<std::unique_ptr<NExpr>> e);
-    std::vector<NNameDecl> names;
-    std::vector<std::unique_ptr<NExpr>> exprs;
-
-    virtual void check(Scope& parent_scope, std::vector<CompileError>& errors) const override final;
-
-    virtual void dump(std::ostream& out) const override;
-};
-
-class NGlobalVar final : public Node {
-public:
-    NGlobalVar() = default;
-    NGlobalVar(std::vector<NNameDecl> n, std::vector<std::unique_ptr<NExpr>> e);
-    std::vector<NNameDecl> names;
-    std::vector<std::unique_ptr<NExpr>> exprs;
-
-    virtual void check(Scope& parent_scope, std::vector<CompileError>& errors) const override final;
-
-    virtual void dump(std::ostream& out) const override;
-};
-
-class NNil final : public NExpr {
-public:
-    virtual void dump(std::ostream& out) const override;
-
-    virtual Type get_type(const Scope& scope) const override;
-};
-
-class NBooleanLiteral final : public NExpr {
-public:
-    NBooleanLiteral() = default;
-    NBooleanLiteral(bool v);
-    bool value;
-
-    virtual void dump(std::ostream& out) const override;
-
-    virtual Type get_type(const Scope& scope) const override;
-};
-
-class NStringLiteral final : public NExpr {
-public:
-    NStringLiteral() = default;
-    NStringLiteral(std::string v);
-    std::string value;
-
-    virtual void dump(std::ostream& out) const override;
-
-    virtual Type get_type(const Scope& scope) const override;
-};
-
-class NDots final : public NExpr {
-public:
-    virtual void check(Scope& parent_scope, std::vector<CompileError>& errors) const override final;
-
-    virtual void dump(std::ostream& out) const override;
-
-    virtual Type get_type(const Scope& scope) const override;
-};
-
-class NFunctionDef final : public NExpr {
-public:
-    NFunctionDef() = default;
-    NFunctionDef(std::unique_ptr<NFuncParams> p, std::unique_ptr<NType> r, std::unique_ptr<NBlock> b);
-    std::unique_ptr<NFuncParams> params;
-    std::unique_ptr<NType> ret;
-    std::unique_ptr<NBlock> block;
-    mutable std::optional<Type> deducedret;
-
-    virtual void check(Scope& parent_scope, std::vector<CompileError>& errors) const override final;
-
-    virtual void dump(std::ostream& out) const override;
-
-    virtual Type get_type(const Scope& scope) const override;
-};
-
-class NField : public Node {
-public:
-    virtual void add_to_table(const Scope& scope, std::vector<KeyValPair>& indexes, FieldMap& fielddecls, std::vector<CompileError>& errors)
-        const = 0;
-};
-
-class NFieldExpr final : public NField {
-public:
-    NFieldExpr() = default;
-    NFieldExpr(std::unique_ptr<NExpr> e);
-    std::unique_ptr<NExpr> expr;
-
-    virtual void check(Scope& parent_scope, std::vector<CompileError>& errors) const override final;
-
-    virtual void dump(std::ostream& out) const override;
-
-    virtual void add_to_table(const Scope& scope, std::vector<KeyValPair>& indexes, FieldMap& fielddecls, std::vector<CompileError>& errors)
-        const override;
-};
-
-class NFieldNamed final : public NField {
-public:
-    NFieldNamed() = default;
-    NFieldNamed(std::string k, std::unique_ptr<NExpr> v);
-    std::string key;
-    std::unique_ptr<NExpr> value;
-
-    virtual void check(Scope& parent_scope, std::vector<CompileError>& errors) const override final;
-    virtual void dump(std::ostream& out) const override;
-    virtual void add_to_table(const Scope& scope, std::vector<KeyValPair>& indexes, FieldMap& fielddecls, std::vector<CompileError>& errors)
-        const override;
-};
-
-class NFieldKey final : public NField {
-public:
-    NFieldKey() = default;
-    NFieldKey(std::unique_ptr<NExpr> k, std::unique_ptr<NExpr> v);
-    std::unique_ptr<NExpr> key;
-    std::unique_ptr<NExpr> value;
-
-    virtual void check(Scope& parent_scope, std::vector<CompileError>& errors) const override final;
-
-    virtual void dump(std::ostream& out) const override;
-    virtual void add_to_table(const Scope& scope, std::vector<KeyValPair>& indexes, FieldMap& fielddecls, std::vector<CompileError>& errors)
-        const override;
-};
-
-class NTableConstructor final : public NExpr {
-public:
-    NTableConstructor() = default;
-    NTableConstructor(std::vector<std::unique_ptr<NField>> f);
-    std::vector<std::unique_ptr<NField>> fields;
-    mutable std::optional<Type> cached_type;
-
-    virtual void check(Scope& parent_scope, std::vector<CompileError>& errors) const override final;
-
-    virtual void dump(std::ostream& out) const override;
-    virtual Type get_type(const Scope& scope) const override;
-};
-
-class NBinop final : public NExpr {
-public:
-    enum class Op {
-        OR,
-        AND,
-        LT,
-        GT,
-        LEQ,
-        GEQ,
-        NEQ,
-        EQ,
-        BOR,
-        BXOR,
-        BAND,
-        SHL,
-        SHR,
-        CONCAT,
-        ADD,
-        SUB,
-        MUL,
-        DIV,
-        IDIV,
-        MOD,
-        POW
-    };
-
-    NBinop() = default;
-    NBinop(Op o, std::unique_ptr<NExpr> l, std::unique_ptr<NExpr> r);
-    Op op;
-    std::unique_ptr<NExpr> left;
-    std::unique_ptr<NExpr> right;
-
-    virtual void check(Scope& parent_scope, std::vector<CompileError>& errors) const override final;
-
-    virtual void dump(std::ostream& out) const override;
-
-    virtual Type get_type(const Scope& scope) const override;
-};
-
-class NUnaryop final : public NExpr {
-public:
-    enum class Op {
-        NOT,
-        LEN,
-        NEG,
-        BNOT
-    };
-
-    NUnaryop() = default;
-    NUnaryop(Op o, std::unique_ptr<NExpr> e);
-    Op op;
-    std::unique_ptr<NExpr> expr;
-
-    virtual void check(Scope& parent_scope, std::vector<CompileError>& errors) const override final;
-
-    virtual void dump(std::ostream& out) const override;
-
-    virtual Type get_type(const Scope& scope) const override;
-};
+std::ostream& operator<<(std::ostream& out, const Tree& tree);
 
 } // namespace typedlua::ast
 
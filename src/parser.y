@@ -4,17 +4,18 @@
 %define parse.error verbose
 
 // Defines a reentrant parser and lexer.
-// The first parse-param should be a `yyscan_t`,
-// but due to a circular dependency, this seems impossible.
+// The scanner is a typedlua::Scanner, or a flex `yyscan_t` when built with TYPEDLUA_FLEX_LEXER.
+// Either way it is passed as `void*`, which is also all a `yyscan_t` is.
 %define api.pure full
-%lex-param {yyscan_t scanner}
-%parse-param {void* scanner} {std::unique_ptr<typedlua::ast::Node>& root} {std::vector<typedlua::CompileError>& errors}
+%lex-param {void* scanner}
+%parse-param {void* scanner} {typedlua::ast::Tree& tree} {std::vector<typedlua::CompileError>& errors}
 
 %locations
 
 %code requires {
     #include "node.hpp"
     #include "location.hpp"
+    #include "token.hpp"
     #include <string>
 
     using TYPEDLUALTYPE = typedlua::Location;
@@ -23,31 +24,17 @@
 }
 
 %union {
-    std::string* string;
-    typedlua::ast::Node* node;
-    typedlua::ast::NBlock* block;
-    typedlua::ast::NExpr* expr;
-    typedlua::ast::NArgSeq* argseq;
-    std::vector<std::unique_ptr<typedlua::ast::NElseIf>>* elseifseq;
-    typedlua::ast::NElseIf* elseif;
-    typedlua::ast::NElse* else_;
-    std::vector<std::unique_ptr<typedlua::ast::NExpr>>* exprs;
-    typedlua::ast::NField* field;
-    std::vector<std::unique_ptr<typedlua::ast::NField>>* fields;
-    typedlua::ast::NFuncParams* params;
-    std::vector<typedlua::ast::NNameDecl>* namedecls;
-    typedlua::ast::NType* type;
-    std::vector<typedlua::ast::NTypeFunctionParam>* typefuncparams;
-    typedlua::ast::NIndex* index;
-    typedlua::ast::NIndexList* indexlist;
-    typedlua::ast::NFieldDecl* fielddecl;
-    typedlua::ast::NFieldDeclList* fielddecllist;
-    typedlua::ast::NTypeFunction* typefunction;
-    std::vector<std::unique_ptr<typedlua::ast::NType>>* types;
+    typedlua::Token token;
+    typedlua::ast::NodeId node;
+    std::vector<typedlua::ast::NodeId>* nodes;
 }
 
 %code {
+    #ifdef TYPEDLUA_FLEX_LEXER
     #include "lexer.hpp"
+    #else
+    #include "scanner.hpp"
+    #endif
     #include "compile_error.hpp"
 
     using namespace typedlua::ast;
@@ -55,46 +42,40 @@
     static void yyerror(
         YYLTYPE* loc,
         void* scanner,
-        std::unique_ptr<Node>& root,
+        Tree& tree,
         std::vector<typedlua::CompileError>& errors,
         const char *s)
     {
         errors.emplace_back(s, *loc);
     }
 
-    template <typename T>
-    std::unique_ptr<T> ptr(T* expr) {
-        return std::unique_ptr<T>(expr);
+    // `head` followed by the ids in each of `lists` that is not null.
+    static std::vector<NodeId> join(
+        std::initializer_list<NodeId> head,
+        std::initializer_list<const std::vector<NodeId>*> lists)
+    {
+        auto rv = std::vector<NodeId>(head);
+        for (auto list : lists) {
+            if (list) rv.insert(rv.end(), list->begin(), list->end());
+        }
+        return rv;
+    }
+
+    static NodeId add_text(Tree& tree, Kind kind, const YYLTYPE& loc, std::string_view text, std::initializer_list<NodeId> children = {}) {
+        auto id = tree.add(kind, loc, children);
+        tree.set_text(id, text);
+        return id;
     }
 
     #define BINOP(OBJ, OP, LEFT, RIGHT, LOC) \
-        OBJ = new NBinop(NBinop::Op::OP, ptr(LEFT), ptr(RIGHT)); \
-        OBJ->location = LOC;
+        OBJ = tree.add(Kind::BINOP, LOC, {LEFT, RIGHT}); \
+        tree.set_flag(OBJ, std::uint8_t(BinaryOp::OP));
     #define UNARYOP(OBJ, OP, EXPR, LOC) \
-        OBJ = new NUnaryop(NUnaryop::Op::OP, ptr(EXPR)); \
-        OBJ->location = LOC;
+        OBJ = tree.add(Kind::UNARYOP, LOC, {EXPR}); \
+        tree.set_flag(OBJ, std::uint8_t(UnaryOp::OP));
 }
 
-%destructor { delete $$; } <string>
-%destructor { delete $$; } <node>
-%destructor { delete $$; } <block>
-%destructor { delete $$; } <expr>
-%destructor { delete $$; } <argseq>
-%destructor { delete $$; } <elseifseq>
-%destructor { delete $$; } <elseif>
-%destructor { delete $$; } <else_>
-%destructor { delete $$; } <exprs>
-%destructor { delete $$; } <field>
-%destructor { delete $$; } <fields>
-%destructor { delete $$; } <params>
-%destructor { delete $$; } <namedecls>
-%destructor { delete $$; } <type>
-%destructor { delete $$; } <typefuncparams>
-%destructor { delete $$; } <index>
-%destructor { delete $$; } <indexlist>
-%destructor { delete $$; } <fielddecl>
-%destructor { delete $$; } <fielddecllist>
-%destructor { delete $$; } <typefunction>
+%destructor { delete $$; } <nodes>
 
 %token TCEQ TCNE TCLE TCGE TSHL TSHR
 %token TSLASH2 TDOT2 TDOT3 TCOLON2
@@ -105,7 +86,7 @@
 
 %token TGLOBAL TINTERFACE T_REQUIRE
 
-%token <string> TIDENTIFIER TNUMBER TSTRING
+%token <token> TIDENTIFIER TNUMBER TSTRING
 
 %left TOR
 %left TAND
@@ -124,85 +105,64 @@
 
 %type <node> stat assign label goto while repeat if fornumeric forgeneric
 %type <node> function localfunc retstat localvar globalvar interface
-%type <block> block statseq
-%type <expr> expr var functioncall prefixexpr funcvar functiondef
-%type <expr> tableconstructor binopcall unaryopcall
-%type <argseq> argseq args
-%type <elseifseq> elseifseq
-%type <elseif> elseif
-%type <else_> else
-%type <exprs> explist varlist
-%type <field> field
-%type <fields> fieldlist
-%type <params> funcparams
-%type <namedecls> namelist funcgenparams
-%type <type> commonunittype unittype type typetuple idtype tabletype
-%type <type> funcret rettype functype retunittype literaltype
-%type <type> requiretype genericcalltype
-%type <typefuncparams> typefuncparams
-%type <index> index
-%type <indexlist> indexes tableindexes
-%type <fielddecl> fielddecl
-%type <fielddecllist> fielddecls tablefields
-%type <typefunction> regfunctype
-%type <types> typelist
+%type <node> block
+%type <node> expr var functioncall prefixexpr funcvar functiondef
+%type <node> tableconstructor binopcall unaryopcall
+%type <node> elseif else
+%type <node> field
+%type <node> funcparams
+%type <node> commonunittype unittype type typetuple idtype tabletype
+%type <node> funcret rettype functype retunittype literaltype
+%type <node> requiretype genericcalltype
+%type <node> index tableindexes
+%type <node> fielddecl tablefields
+%type <node> regfunctype
+%type <nodes> statseq argseq args elseifseq explist varlist fieldlist
+%type <nodes> namelist funcgenparams typefuncparams indexes fielddecls typelist
 
 %start chunk
 
 %%
 
-chunk: block { root = ptr($1); }
+chunk: block { tree.root = $1; }
      ;
 
-block: statseq { $$ = $1; }
-     | statseq retstat {
-         $$ = $1;
-         $$->location = @$;
-         $$->children.push_back(std::unique_ptr<Node>($retstat));
-     }
-     | retstat {
-         $$ = new NBlock();
-         $$->location = @$;
-         $$->children.push_back(std::unique_ptr<Node>($retstat));
+block: statseq {
+         $$ = tree.add(Kind::BLOCK, @$, *$statseq);
+         delete $statseq;
      }
-     | %empty {
-         $$ = new NBlock();
-         $$->location = @$;
+     | statseq retstat {
+         $statseq->push_back($retstat);
+         $$ = tree.add(Kind::BLOCK, @$, *$statseq);
+         delete $statseq;
      }
+     | retstat { $$ = tree.add(Kind::BLOCK, @$, {$retstat}); }
+     | %empty { $$ = tree.add(Kind::BLOCK, @$); }
      ;
 
-statseq: stat {
-           $$ = new NBlock();
-           $$->location = @$;
-           $$->children.push_back(std::unique_ptr<Node>($1));
-       }
-       | statseq stat {
-           $$ = $1;
-           $$->location = @$;
-           $$->children.push_back(std::unique_ptr<Node>($2));
-       }
+statseq: stat { $$ = new std::vector<NodeId>{$1}; }
+       | statseq stat { $$ = $1; $$->push_back($2); }
        ;
 
-retstat: TRETURN { $$ = new NReturn(); $$->location = @$; }
+retstat: TRETURN { $$ = tree.add(Kind::RETURN, @$); }
        | TRETURN explist {
-           $$ = new NReturn(std::move(*$explist));
-           $$->location = @$;
+           $$ = tree.add(Kind::RETURN, @$, *$explist);
            delete $explist;
        }
-       | retstat ';' { $$ = $1; $$->location = @$; }
+       | retstat ';' { $$ = $1; tree.set_location($$, @$); }
        ;
 
 prefixexpr: var { $$ = $1; }
           | functioncall { $$ = $1; }
-          | '(' expr ')' { $$ = $2; $$->location = @$; }
+          | '(' expr ')' { $$ = $2; tree.set_location($$, @$); }
           ;
 
-expr: TNIL { $$ = new NNil(); }
-    | TFALSE { $$ = new NBooleanLiteral(false); }
-    | TTRUE { $$ = new NBooleanLiteral(true); }
-    | TNUMBER { $$ = new NNumberLiteral(std::move(*$1)); delete $1; }
-    | TSTRING { $$ = new NStringLiteral(std::move(*$1)); delete $1; }
-    | TDOT3 { $$ = new NDots(); }
+expr: TNIL { $$ = tree.add(Kind::NIL, {}); }
+    | TFALSE { $$ = tree.add(Kind::BOOLEAN_LITERAL, {}); }
+    | TTRUE { $$ = tree.add(Kind::BOOLEAN_LITERAL, {}); tree.set_flag($$, true); }
+    | TNUMBER { $$ = add_text(tree, Kind::NUMBER_LITERAL, {}, $1); }
+    | TSTRING { $$ = add_text(tree, Kind::STRING_LITERAL, {}, $1); }
+    | TDOT3 { $$ = tree.add(Kind::DOTS, {}); }
     | functiondef { $$ = $1; }
     | prefixexpr %prec ')' { $$ = $1; }
     | tableconstructor { $$ = $1; }
@@ -210,13 +170,13 @@ expr: TNIL { $$ = new NNil(); }
     | unaryopcall { $$ = $1; }
     ;
 
-stat: ';' { $$ = new NEmpty(); $$->location = @$; }
+stat: ';' { $$ = tree.add(Kind::EMPTY, @$); }
     | assign { $$ = $1; }
     | functioncall { $$ = $1; }
     | label { $$ = $1; }
-    | TBREAK { $$ = new NBreak(); $$->location = @$; }
+    | TBREAK { $$ = tree.add(Kind::BREAK, @$); }
     | goto { $$ = $1; }
-    | TDO block TEND { $$ = $2; $2->scoped = true; $$->location = @$; }
+    | TDO block TEND { $$ = $2; tree.set_flag($$, true); tree.set_location($$, @$); }
     | while { $$ = $1; }
     | repeat { $$ = $1; }
     | if { $$ = $1; }
@@ -230,30 +190,23 @@ stat: ';' { $$ = new NEmpty(); $$->location = @$; }
     ;
 
 namelist: TIDENTIFIER {
-            $$ = new std::vector<NNameDecl>();
-            $$->emplace_back(std::move(*$1));
-            $$->back().location = @$;
-            delete $1;
+            $$ = new std::vector<NodeId>{add_text(tree, Kind::NAME_DECL, @$, $1, {no_node})};
         }
         | TIDENTIFIER ':' type {
-            $$ = new std::vector<NNameDecl>();
-            $$->emplace_back(std::move(*$1), std::unique_ptr<NType>($type));
-            $$->back().location = @$;
-            delete $1;
+            $$ = new std::vector<NodeId>{add_text(tree, Kind::NAME_DECL, @$, $1, {$type})};
         }
         | namelist ',' TIDENTIFIER {
             $$ = $1;
-            $$->emplace_back(std::move(*$3));
-            $$->back().location = @3;
-            delete $3;
+            $$->push_back(add_text(tree, Kind::NAME_DECL, @3, $3, {no_node}));
         }
         | namelist ',' TIDENTIFIER ':' type {
             $$ = $1;
-            $$->emplace_back(std::move(*$3), std::unique_ptr<NType>($type));
-            $$->back().location = @3;
-            $$->back().location.last_line = @5.last_line;
-            $$->back().location.last_column = @5.last_column;
-            delete $3;
+            $$->push_back(add_text(
+                tree,
+                Kind::NAME_DECL,
+                {@3.first_line, @3.first_column, @5.last_line, @5.last_column},
+                $3,
+                {$type}));
         }
         ;
 
@@ -262,18 +215,17 @@ type: unittype { $$ = $1; }
     ;
 
 idtype: TIDENTIFIER {
-          $$ = new NTypeName(std::move(*$1));
-          $$->location = @$;
-          delete $1;
+          $$ = tree.add(Kind::TYPE_NAME, @$);
+          tree.set_symbol($$, std::string_view($1));
       }
       | TNIL {
-          $$ = new NTypeName("nil");
-          $$->location = @$;
+          $$ = tree.add(Kind::TYPE_NAME, @$);
+          tree.set_symbol($$, "nil");
       }
       ;
 
 commonunittype: idtype { $$ = $1; }
-              | '(' type ')' { $$ = $2; $$->location = @$; }
+              | '(' type ')' { $$ = $2; tree.set_location($$, @$); }
               | tabletype { $$ = $1; }
               | literaltype { $$ = $1; }
               | requiretype { $$ = $1; }
@@ -281,82 +233,63 @@ commonunittype: idtype { $$ = $1; }
               ;
 
 unittype: commonunittype { $$ = $1; }
-        | unittype[lhs] '|' unittype[rhs] {
-            $$ = new NTypeSum(ptr($lhs), ptr($rhs));
-            $$->location = @$;
-        }
-        | unittype[lhs] '&' unittype[rhs] {
-            $$ = new NTypeProduct(ptr($lhs), ptr($rhs));
-            $$->location = @$;
-        }
+        | unittype[lhs] '|' unittype[rhs] { $$ = tree.add(Kind::TYPE_SUM, @$, {$lhs, $rhs}); }
+        | unittype[lhs] '&' unittype[rhs] { $$ = tree.add(Kind::TYPE_PRODUCT, @$, {$lhs, $rhs}); }
         ;
 
-literaltype: TFALSE { $$ = new NTypeLiteralBoolean(false); $$->location = @$; }
-           | TTRUE { $$ = new NTypeLiteralBoolean(true); $$->location = @$; }
-           | TNUMBER {
-               $$ = new NTypeLiteralNumber(*$1);
-               $$->location = @$;
-               delete $1;
-           }
-           | TSTRING {
-               $$ = new NTypeLiteralString(*$1);
-               $$->location = @$;
-               delete $1;
-           }
+literaltype: TFALSE { $$ = tree.add(Kind::TYPE_LITERAL_BOOLEAN, @$); }
+           | TTRUE { $$ = tree.add(Kind::TYPE_LITERAL_BOOLEAN, @$); tree.set_flag($$, true); }
+           | TNUMBER { $$ = add_text(tree, Kind::TYPE_LITERAL_NUMBER, @$, $1); }
+           | TSTRING { $$ = add_text(tree, Kind::TYPE_LITERAL_STRING, @$, $1); }
            ;
 
-requiretype: T_REQUIRE '(' type ')' { $$ = new NTypeRequire(ptr($type)); $$->location = @$; }
+requiretype: T_REQUIRE '(' type ')' { $$ = tree.add(Kind::TYPE_REQUIRE, @$, {$type}); }
            ;
 
 genericcalltype: idtype '<' typelist '>' {
-                   $$ = new NTypeGenericCall(ptr($idtype), std::move(*$typelist));
-                   $$->location = @$;
+                   $$ = tree.add(Kind::TYPE_GENERIC_CALL, @$, join({$idtype}, {$typelist}));
                    delete $typelist;
                }
                ;
 
-typelist: type {
-            $$ = new std::vector<std::unique_ptr<NType>>{};
-            $$->push_back(ptr($type));
-        }
-        | typelist ',' type { $$->push_back(ptr($type)); }
+typelist: type { $$ = new std::vector<NodeId>{$type}; }
+        | typelist ',' type { $$ = $1; $$->push_back($type); }
         ;
 
-regfunctype: '(' ')' ':' rettype[ret] {
-               $$ = new NTypeFunction({}, std::unique_ptr<NType>($ret), false);
-               $$->location = @$;
-           }
+regfunctype: '(' ')' ':' rettype[ret] { $$ = tree.add(Kind::TYPE_FUNCTION, @$, {$ret}); }
            | '(' typefuncparams ')' ':' rettype[ret] {
-               $$ = new NTypeFunction(std::move(*$typefuncparams), ptr($ret), false);
-               $$->location = @$;
+               $$ = tree.add(Kind::TYPE_FUNCTION, @$, join({$ret}, {$typefuncparams}));
                delete $typefuncparams;
            }
            | '(' TDOT3 ')' ':' rettype[ret] {
-               $$ = new NTypeFunction({}, std::unique_ptr<NType>($ret), true);
-               $$->location = @$;
+               $$ = tree.add(Kind::TYPE_FUNCTION, @$, {$ret});
+               tree.set_flag($$, true);
            }
            | '(' typefuncparams ',' TDOT3 ')' ':' rettype[ret] {
-               $$ = new NTypeFunction(std::move(*$typefuncparams), ptr($ret), true);
-               $$->location = @$;
+               $$ = tree.add(Kind::TYPE_FUNCTION, @$, join({$ret}, {$typefuncparams}));
+               tree.set_flag($$, true);
                delete $typefuncparams;
            }
            ;
 
 functype: regfunctype { $$ = $1; }
         | '<' namelist '>' regfunctype {
-            $regfunctype->generic_params = std::move(*$namelist);
-            $$ = $regfunctype;
-            $$->location = @$;
+            // Rebuilt with the generic parameters between the return type and the parameters.
+            const auto variadic = tree.flag($regfunctype);
+            auto children = join({tree.child($regfunctype, 0)}, {$namelist});
+            for (auto param : tree.children($regfunctype, 1)) {
+                children.push_back(param);
+            }
+            $$ = tree.add(Kind::TYPE_FUNCTION, @$, children);
+            tree.set_flag($$, variadic);
+            tree.set_data($$, $namelist->size());
             delete $namelist;
         }
         ;
 
 retunittype: commonunittype { $$ = $1; }
            | typetuple { $$ = $1; }
-           | retunittype[lhs] '|' retunittype[rhs] {
-               $$ = new NTypeSum(ptr($lhs), ptr($rhs));
-               $$->location = @$;
-           }
+           | retunittype[lhs] '|' retunittype[rhs] { $$ = tree.add(Kind::TYPE_SUM, @$, {$lhs, $rhs}); }
            ;
 
 rettype: retunittype { $$ = $1; }
@@ -364,110 +297,79 @@ rettype: retunittype { $$ = $1; }
        ;
 
 typetuple: '[' typefuncparams ']' {
-             $$ = new NTypeTuple(std::move(*$typefuncparams), false);
-             $$->location = @$;
+             $$ = tree.add(Kind::TYPE_TUPLE, @$, *$typefuncparams);
              delete $typefuncparams;
          }
          | '[' typefuncparams ',' TDOT3 ']' {
-             $$ = new NTypeTuple(std::move(*$typefuncparams), true);
-             $$->location = @$;
+             $$ = tree.add(Kind::TYPE_TUPLE, @$, *$typefuncparams);
+             tree.set_flag($$, true);
              delete $typefuncparams;
          }
          | '[' TDOT3 ']' {
-             $$ = new NTypeTuple({}, true);
-             $$->location = @$;
+             $$ = tree.add(Kind::TYPE_TUPLE, @$);
+             tree.set_flag($$, true);
          }
          ;
 
 typefuncparams: ':' type {
-                  $$ = new std::vector<NTypeFunctionParam>();
-                  $$->emplace_back("", std::unique_ptr<NType>($type));
-                  $$->back().location = @$;
+                  $$ = new std::vector<NodeId>{add_text(tree, Kind::TYPE_FUNCTION_PARAM, @$, "", {$type})};
               }
               | TIDENTIFIER[name] ':' type {
-                  $$ = new std::vector<NTypeFunctionParam>();
-                  $$->emplace_back(std::move(*$name), std::unique_ptr<NType>($type));
-                  $$->back().location = @$;
-                  delete $name;
+                  $$ = new std::vector<NodeId>{add_text(tree, Kind::TYPE_FUNCTION_PARAM, @$, $name, {$type})};
               }
               | typefuncparams ',' ':'[colon] type {
                   $$ = $1;
-                  $$->emplace_back("", std::unique_ptr<NType>($type));
-                  $$->back().location = {
-                      @colon.first_line,
-                      @colon.first_column,
-                      @type.last_line,
-                      @type.last_column};
+                  $$->push_back(add_text(
+                      tree,
+                      Kind::TYPE_FUNCTION_PARAM,
+                      {@colon.first_line, @colon.first_column, @type.last_line, @type.last_column},
+                      "",
+                      {$type}));
               }
               | typefuncparams ',' TIDENTIFIER[name] ':' type {
                   $$ = $1;
-                  $$->emplace_back(std::move(*$name), std::unique_ptr<NType>($type));
-                  $$->back().location = {
-                      @name.first_line,
-                      @name.first_column,
-                      @type.last_line,
-                      @type.last_column};
-                  delete $name;
+                  $$->push_back(add_text(
+                      tree,
+                      Kind::TYPE_FUNCTION_PARAM,
+                      {@name.first_line, @name.first_column, @type.last_line, @type.last_column},
+                      $name,
+                      {$type}));
               }
               ;
 
 tabletype: '{' tableindexes tablefields '}' {
-             $$ = new NTypeTable(ptr($tableindexes), ptr($tablefields));
-             $$->location = @$;
+             $$ = tree.add(Kind::TYPE_TABLE, @$, {$tableindexes, $tablefields});
          }
          ;
 
-tableindexes: %empty { $$ = nullptr; }
-            | indexes { $$ = $1; }
+tableindexes: %empty { $$ = no_node; }
+            | indexes {
+                $$ = tree.add(Kind::INDEX_LIST, @$, *$indexes);
+                delete $indexes;
+            }
             ;
 
-indexes: index {
-           $$ = new NIndexList();
-           $$->location = @$;
-           $$->indexes.push_back(ptr($index));
-       }
-       | indexes index {
-           $$ = $1;
-           $$->location = @$;
-           $$->indexes.push_back(ptr($index));
-       }
-       | indexes ';' {
-           $$ = $1;
-           $$->location = @$;
-       }
+indexes: index { $$ = new std::vector<NodeId>{$index}; }
+       | indexes index { $$ = $1; $$->push_back($index); }
+       | indexes ';' { $$ = $1; }
        ;
 
-index: '[' type[key] ']' ':' type[val] {
-         $$ = new NIndex(ptr($key), ptr($val));
-         $$->location = @$;
-     }
+index: '[' type[key] ']' ':' type[val] { $$ = tree.add(Kind::INDEX, @$, {$key, $val}); }
      ;
 
-tablefields: %empty { $$ = nullptr; }
-           | fielddecls { $$ = $1; }
+tablefields: %empty { $$ = no_node; }
+           | fielddecls {
+               $$ = tree.add(Kind::FIELD_DECL_LIST, @$, *$fielddecls);
+               delete $fielddecls;
+           }
            ;
 
-fielddecls: fielddecl {
-              $$ = new NFieldDeclList();
-              $$->location = @$;
-              $$->fields.push_back(ptr($fielddecl));
-          }
-          | fielddecls fielddecl {
-              $$ = $1;
-              $$->location = @$;
-              $$->fields.push_back(ptr($fielddecl));
-          }
-          | fielddecls ';' {
-              $$ = $1;
-              $$->location = @$;
-          }
+fielddecls: fielddecl { $$ = new std::vector<NodeId>{$fielddecl}; }
+          | fielddecls fielddecl { $$ = $1; $$->push_back($fielddecl); }
+          | fielddecls ';' { $$ = $1; }
           ;
 
-fielddecl: TIDENTIFIER[name] ':' type {
-             $$ = new NFieldDecl(std::move(*$name), ptr($type));
-             $$->location = @$;
-             delete $name;
-         }
+fielddecl: TIDENTIFIER[name] ':' type { $$ = add_text(tree, Kind::FIELD_DECL, @$, $name, {$type}); }
          ;
 
 binopcall: expr[l] TOR expr[r] { BINOP($$, OR, $l, $r, @$) }
@@ -500,408 +402,208 @@ unaryopcall: TNOT expr { UNARYOP($$, NOT, $expr, @$) }
            ;
 
 globalvar: TGLOBAL namelist {
-          $$ = new NGlobalVar(
-              std::move(*$namelist),
-              {});
-          $$->location = @$;
+          $$ = tree.add(Kind::GLOBAL_VAR, @$, *$namelist);
+          tree.set_data($$, $namelist->size());
           delete $namelist;
       }
       | TGLOBAL namelist '=' explist {
-            $$ = new NGlobalVar(
-                std::move(*$namelist),
-                std::move(*$explist));
-            $$->location = @$;
+            $$ = tree.add(Kind::GLOBAL_VAR, @$, join({}, {$namelist, $explist}));
+            tree.set_data($$, $namelist->size());
             delete $namelist;
             delete $explist;
       }
       ;
 
-interface: TINTERFACE TIDENTIFIER[name] ':' type {
-             $$ = new NInterface(std::move(*$name), ptr($type));
-             $$->location = @$;
-             delete $name;
-         }
+interface: TINTERFACE TIDENTIFIER[name] ':' type { $$ = add_text(tree, Kind::INTERFACE, @$, $name, {$type}); }
          | TINTERFACE TIDENTIFIER[name] '<' namelist '>' ':' type {
-             $$ = new NInterface(std::move(*$name), ptr($type), std::move(*$namelist));
-             $$->location = @$;
-             delete $name;
+             $$ = tree.add(Kind::INTERFACE, @$, join({$type}, {$namelist}));
+             tree.set_text($$, $name);
              delete $namelist;
          }
          ;
 
 localvar: TLOCAL namelist {
-            $$ = new NLocalVar(
-                std::move(*$namelist),
-                {});
-            $$->location = @$;
+            $$ = tree.add(Kind::LOCAL_VAR, @$, *$namelist);
+            tree.set_data($$, $namelist->size());
             delete $namelist;
         }
         | TLOCAL namelist '=' explist {
-            $$ = new NLocalVar(
-                std::move(*$namelist),
-                std::move(*$explist));
-            $$->location = @$;
+            $$ = tree.add(Kind::LOCAL_VAR, @$, join({}, {$namelist, $explist}));
+            tree.set_data($$, $namelist->size());
             delete $namelist;
             delete $explist;
         }
         ;
 
 localfunc: TLOCAL TFUNCTION TIDENTIFIER[name] funcparams funcret block TEND {
-             $$ = new NLocalFunction(
-                 {
-                     {},
-                     ptr($funcparams),
-                     ptr($funcret),
-                     ptr($block)
-                 },
-                 std::move(*$name));
-             $$->location = @$;
-             delete $name;
+             $$ = add_text(tree, Kind::LOCAL_FUNCTION, @$, $name, {$funcparams, $funcret, $block, no_node});
          }
          | TLOCAL TFUNCTION TIDENTIFIER[name] funcgenparams funcparams funcret block TEND {
-             $$ = new NLocalFunction(
-                 {
-                    std::move(*$funcgenparams),
-                    ptr($funcparams),
-                    ptr($funcret),
-                    ptr($block)
-                 },
-                 std::move(*$name));
-             $$->location = @$;
-             delete $name;
+             $$ = tree.add(Kind::LOCAL_FUNCTION, @$, join({$funcparams, $funcret, $block, no_node}, {$funcgenparams}));
+             tree.set_text($$, $name);
              delete $funcgenparams;
          }
          ;
 
 function: TFUNCTION funcvar funcparams funcret block TEND {
-            $$ = new NFunction(
-                {
-                    {},
-                    ptr($funcparams),
-                    ptr($funcret),
-                    ptr($block)
-                },
-                ptr($funcvar));
-            $$->location = @$;
+            $$ = tree.add(Kind::FUNCTION, @$, {$funcparams, $funcret, $block, $funcvar});
         }
         | TFUNCTION funcvar funcgenparams funcparams funcret block TEND {
-            $$ = new NFunction(
-                {
-                    std::move(*$funcgenparams),
-                    ptr($funcparams),
-                    ptr($funcret),
-                    ptr($block)
-                },
-                ptr($funcvar));
-            $$->location = @$;
+            $$ = tree.add(Kind::FUNCTION, @$, join({$funcparams, $funcret, $block, $funcvar}, {$funcgenparams}));
             delete $funcgenparams;
         }
         | TFUNCTION funcvar ':' TIDENTIFIER[name] funcparams funcret block TEND {
-            $$ = new NSelfFunction(
-                {
-                    {},
-                    std::unique_ptr<NFuncParams>($funcparams),
-                    std::unique_ptr<NType>($funcret),
-                    std::unique_ptr<NBlock>($block)
-                },
-                std::move(*$name),
-                std::unique_ptr<NExpr>($funcvar));
-            $$->location = @$;
-            delete $name;
+            $$ = add_text(tree, Kind::SELF_FUNCTION, @$, $name, {$funcparams, $funcret, $block, $funcvar});
         }
         | TFUNCTION funcvar ':' TIDENTIFIER[name] funcgenparams funcparams funcret block TEND {
-            $$ = new NSelfFunction(
-                {
-                    std::move(*$funcgenparams),
-                    std::unique_ptr<NFuncParams>($funcparams),
-                    std::unique_ptr<NType>($funcret),
-                    std::unique_ptr<NBlock>($block)
-                },
-                std::move(*$name),
-                std::unique_ptr<NExpr>($funcvar));
-            $$->location = @$;
+            $$ = tree.add(Kind::SELF_FUNCTION, @$, join({$funcparams, $funcret, $block, $funcvar}, {$funcgenparams}));
+            tree.set_text($$, $name);
             delete $funcgenparams;
-            delete $name;
         }
         ;
 
-funcret: %empty { $$ = nullptr; }
+funcret: %empty { $$ = no_node; }
        | ':' rettype { $$ = $rettype; }
        ;
 
 funcvar: TIDENTIFIER {
-           $$ = new NIdent(std::move(*$1));
-           $$->location = @$;
-           delete $1;
-       }
-       | funcvar '.' TIDENTIFIER {
-           $$ = new NTableAccess(
-               std::unique_ptr<NExpr>($1),
-               std::move(*$3));
-           $$->location = @$;
-           delete $3;
+           $$ = tree.add(Kind::IDENT, @$);
+           tree.set_symbol($$, std::string_view($1));
        }
+       | funcvar '.' TIDENTIFIER { $$ = add_text(tree, Kind::TABLE_ACCESS, @$, $3, {$1}); }
        ;
 
-funcgenparams: '<' '>' { $$ = new std::vector<NNameDecl>{}; }
+funcgenparams: '<' '>' { $$ = new std::vector<NodeId>{}; }
              | '<' namelist '>' { $$ = $namelist; }
              ;
 
-funcparams: '(' ')' { $$ = new NFuncParams(); $$->location = @$; }
+funcparams: '(' ')' { $$ = tree.add(Kind::FUNC_PARAMS, @$); }
           | '(' TDOT3 ')' {
-              $$ = new NFuncParams({}, true);
-              $$->location = @$;
+              $$ = tree.add(Kind::FUNC_PARAMS, @$);
+              tree.set_flag($$, true);
           }
           | '(' namelist ')' {
-              $$ = new NFuncParams(std::move(*$namelist), false);
-              $$->location = @$;
+              $$ = tree.add(Kind::FUNC_PARAMS, @$, *$namelist);
               delete $namelist;
           }
           | '(' namelist ',' TDOT3 ')' {
-              $$ = new NFuncParams(std::move(*$namelist), true);
-              $$->location = @$;
+              $$ = tree.add(Kind::FUNC_PARAMS, @$, *$namelist);
+              tree.set_flag($$, true);
               delete $namelist;
           }
           ;
 
 forgeneric: TFOR namelist TIN explist TDO block TEND {
-              $$ = new NForGeneric(
-                  std::move(*$namelist),
-                  std::move(*$explist),
-                  std::unique_ptr<NBlock>($block));
-              $$->location = @$;
+              $$ = tree.add(Kind::FOR_GENERIC, @$, join({$block}, {$namelist, $explist}));
+              tree.set_data($$, $namelist->size());
               delete $namelist;
               delete $explist;
           }
           ;
 
 fornumeric: TFOR TIDENTIFIER '=' expr ',' expr ',' expr TDO block TEND {
-              $$ = new NForNumeric(
-                  std::move(*$2),
-                  std::unique_ptr<NExpr>($4),
-                  std::unique_ptr<NExpr>($6),
-                  std::unique_ptr<NExpr>($8),
-                  std::unique_ptr<NBlock>($10));
-              $$->location = @$;
-              delete $2;
+              $$ = add_text(tree, Kind::FOR_NUMERIC, @$, $2, {$4, $6, $8, $10});
           }
           | TFOR TIDENTIFIER '=' expr ',' expr TDO block TEND {
-              $$ = new NForNumeric(
-                  std::move(*$2),
-                  std::unique_ptr<NExpr>($4),
-                  std::unique_ptr<NExpr>($6),
-                  std::unique_ptr<NExpr>(nullptr),
-                  std::unique_ptr<NBlock>($8));
-              $$->location = @$;
-              delete $2;
+              $$ = add_text(tree, Kind::FOR_NUMERIC, @$, $2, {$4, $6, no_node, $8});
           }
           ;
 
 if: TIF expr TTHEN block elseifseq else TEND {
-      $$ = new NIf(
-          std::unique_ptr<NExpr>($2),
-          std::unique_ptr<NBlock>($4),
-          std::move(*$5),
-          std::unique_ptr<NElse>($6));
-      $$->location = @$;
+      $$ = tree.add(Kind::IF, @$, join({$2, $4, $6}, {$5}));
       delete $5;
   }
   | TIF expr TTHEN block elseifseq TEND {
-      $$ = new NIf(
-          std::unique_ptr<NExpr>($2),
-          std::unique_ptr<NBlock>($4),
-          std::move(*$5),
-          std::unique_ptr<NElse>(nullptr));
-      $$->location = @$;
+      $$ = tree.add(Kind::IF, @$, join({$2, $4, no_node}, {$5}));
       delete $5;
   }
-  | TIF expr TTHEN block else TEND {
-      $$ = new NIf(
-          std::unique_ptr<NExpr>($2),
-          std::unique_ptr<NBlock>($4),
-          {},
-          std::unique_ptr<NElse>($5));
-      $$->location = @$;
-  }
-  | TIF expr TTHEN block TEND {
-      $$ = new NIf(
-          std::unique_ptr<NExpr>($2),
-          std::unique_ptr<NBlock>($4),
-          {},
-          std::unique_ptr<NElse>(nullptr));
-      $$->location = @$;
-  }
+  | TIF expr TTHEN block else TEND { $$ = tree.add(Kind::IF, @$, {$2, $4, $5}); }
+  | TIF expr TTHEN block TEND { $$ = tree.add(Kind::IF, @$, {$2, $4, no_node}); }
   ;
 
-elseifseq: elseif {
-             $$ = new std::vector<std::unique_ptr<NElseIf>>();
-             $$->push_back(std::unique_ptr<NElseIf>($1));
-         }
-         | elseifseq elseif {
-             $$ = $1;
-             $$->push_back(std::unique_ptr<NElseIf>($2));
-         }
+elseifseq: elseif { $$ = new std::vector<NodeId>{$1}; }
+         | elseifseq elseif { $$ = $1; $$->push_back($2); }
          ;
 
-elseif: TELSEIF expr TTHEN block {
-          $$ = new NElseIf(
-              std::unique_ptr<NExpr>($2), std::unique_ptr<NBlock>($4));
-          $$->location = @$;
-      }
+elseif: TELSEIF expr TTHEN block { $$ = tree.add(Kind::ELSE_IF, @$, {$2, $4}); }
       ;
 
-else: TELSE block { $$ = new NElse(std::unique_ptr<NBlock>($2)); $$->location = @$; }
+else: TELSE block { $$ = tree.add(Kind::ELSE, @$, {$2}); }
     ;
 
-repeat: TREPEAT block TUNTIL expr {
-          $$ = new NRepeat(
-              std::unique_ptr<NBlock>($2),
-              std::unique_ptr<NExpr>($4));
-          $$->location = @$;
-      }
+repeat: TREPEAT block TUNTIL expr { $$ = tree.add(Kind::REPEAT, @$, {$2, $4}); }
       ;
 
-while: TWHILE expr TDO block TEND {
-         $$ = new NWhile(
-             std::unique_ptr<NExpr>($2),
-             std::unique_ptr<NBlock>($4));
-         $$->location = @$;
-     }
+while: TWHILE expr TDO block TEND { $$ = tree.add(Kind::WHILE, @$, {$2, $4}); }
      ;
 
-goto: TGOTO TIDENTIFIER {
-        $$ = new NGoto(std::move(*$2));
-        delete $2;
-    }
+goto: TGOTO TIDENTIFIER { $$ = add_text(tree, Kind::GOTO, {}, $2); }
     ;
 
-label: TCOLON2 TIDENTIFIER TCOLON2 {
-         $$ = new NLabel(std::move(*$2));
-         $$->location = @$;
-         delete $2;
-     }
+label: TCOLON2 TIDENTIFIER TCOLON2 { $$ = add_text(tree, Kind::LABEL, @$, $2); }
      ;
 
 assign: varlist '=' explist {
-          $$ = new NAssignment(
-              std::move(*$varlist),
-              std::move(*$explist));
-          $$->location = @$;
+          $$ = tree.add(Kind::ASSIGNMENT, @$, join({}, {$varlist, $explist}));
+          tree.set_data($$, $varlist->size());
+          delete $varlist;
+          delete $explist;
       }
       ;
 
 functioncall: prefixexpr args {
-                $$ = new NFunctionCall(ptr($prefixexpr), ptr($args));
-                $$->location = @$;
+                $$ = tree.add(Kind::FUNCTION_CALL, @$, join({$prefixexpr}, {$args}));
+                delete $args;
             }
             | prefixexpr ':' TIDENTIFIER[name] args {
-                $$ = new NFunctionSelfCall(
-                    ptr($prefixexpr),
-                    std::move(*$name),
-                    ptr($args));
-                $$->location = @$;
-                delete $name;
+                $$ = tree.add(Kind::FUNCTION_SELF_CALL, @$, join({$prefixexpr}, {$args}));
+                tree.set_text($$, $name);
+                delete $args;
             }
             ;
 
-tableconstructor: '{' '}' { $$ = new NTableConstructor(); $$->location = @$; }
+tableconstructor: '{' '}' { $$ = tree.add(Kind::TABLE_CONSTRUCTOR, @$); }
                 | '{' fieldlist '}' {
-                    $$ = new NTableConstructor(std::move(*$fieldlist));
-                    $$->location = @$;
+                    $$ = tree.add(Kind::TABLE_CONSTRUCTOR, @$, *$fieldlist);
                     delete $fieldlist;
                 }
                 ;
 
-fieldlist: field {
-             $$ = new std::vector<std::unique_ptr<NField>>();
-             $$->push_back(std::unique_ptr<NField>($field));
-         }
-         | fieldlist fieldsep field {
-             $$ = $1;
-             $$->push_back(std::unique_ptr<NField>($field));
-         }
-         | fieldlist fieldsep {
-             $$ = $1;
-         }
+fieldlist: field { $$ = new std::vector<NodeId>{$field}; }
+         | fieldlist fieldsep field { $$ = $1; $$->push_back($field); }
+         | fieldlist fieldsep { $$ = $1; }
          ;
 
 fieldsep: ',' | ';' ;
 
-field: expr { $$ = new NFieldExpr(std::unique_ptr<NExpr>($expr)); $$->location = @$; }
-     | TIDENTIFIER[name] '=' expr {
-         $$ = new NFieldNamed(
-             std::move(*$name),
-             std::unique_ptr<NExpr>($expr));
-         $$->location = @$;
-         delete $name;
-     }
-     | '[' expr[key] ']' '=' expr[value] {
-         $$ = new NFieldKey(
-             std::unique_ptr<NExpr>($key),
-             std::unique_ptr<NExpr>($value));
-         $$->location = @$;
-     }
+field: expr { $$ = tree.add(Kind::FIELD_EXPR, @$, {$expr}); }
+     | TIDENTIFIER[name] '=' expr { $$ = add_text(tree, Kind::FIELD_NAMED, @$, $name, {$expr}); }
+     | '[' expr[key] ']' '=' expr[value] { $$ = tree.add(Kind::FIELD_KEY, @$, {$key, $value}); }
      ;
 
 functiondef: TFUNCTION funcparams funcret block TEND {
-               $$ = new NFunctionDef(
-                   std::unique_ptr<NFuncParams>($funcparams),
-                   std::unique_ptr<NType>($funcret),
-                   std::unique_ptr<NBlock>($block));
-               $$->location = @$;
+               $$ = tree.add(Kind::FUNCTION_DEF, @$, {$funcparams, $funcret, $block});
            }
            ;
 
-explist: expr {
-           $$ = new std::vector<std::unique_ptr<NExpr>>();
-           $$->push_back(std::unique_ptr<NExpr>($1));
-       }
-       | explist ',' expr {
-           $$ = $1;
-           $$->push_back(std::unique_ptr<NExpr>($3));
-       }
+explist: expr { $$ = new std::vector<NodeId>{$1}; }
+       | explist ',' expr { $$ = $1; $$->push_back($3); }
        ;
 
 var: TIDENTIFIER {
-       $$ = new NIdent(std::move(*$1));
-       $$->location = @$;
-       delete $1;
-   }
-   | prefixexpr '[' expr ']' {
-       $$ = new NSubscript(
-           std::unique_ptr<NExpr>($1),
-           std::unique_ptr<NExpr>($3));
-       $$->location = @$;
-   }
-   | prefixexpr '.' TIDENTIFIER {
-       $$ = new NTableAccess(
-           std::unique_ptr<NExpr>($1),
-           std::move(*$3));
-       $$->location = @$;
-       delete $3;
+       $$ = tree.add(Kind::IDENT, @$);
+       tree.set_symbol($$, std::string_view($1));
    }
+   | prefixexpr '[' expr ']' { $$ = tree.add(Kind::SUBSCRIPT, @$, {$1, $3}); }
+   | prefixexpr '.' TIDENTIFIER { $$ = add_text(tree, Kind::TABLE_ACCESS, @$, $3, {$1}); }
    ;
 
-varlist: var {
-           $$ = new std::vector<std::unique_ptr<NExpr>>();
-           $$->push_back(std::unique_ptr<NExpr>($var));
-       }
-       | varlist ',' var {
-           $$ = $1;
-           $$->push_back(std::unique_ptr<NExpr>($var));
-       }
+varlist: var { $$ = new std::vector<NodeId>{$var}; }
+       | varlist ',' var { $$ = $1; $$->push_back($var); }
        ;
 
-argseq: expr {
-          $$ = new NArgSeq();
-          $$->location = @$;
-          $$->args.push_back(std::unique_ptr<NExpr>($1));
-      }
-      | argseq ',' expr {
-          $$ = $1;
-          $$->location = @$;
-          $$->args.push_back(std::unique_ptr<NExpr>($3));
-      }
+argseq: expr { $$ = new std::vector<NodeId>{$1}; }
+      | argseq ',' expr { $$ = $1; $$->push_back($3); }
       ;
 
 args: '(' ')' { $$ = nullptr; }
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <cstddef>
+
+namespace typedlua::libs {
+
+// Serialized prelude scope, generated at build time by typedlua_prelude_gen.
+// Empty in the generator itself, which imports the libraries from source.
+extern const unsigned char prelude_blob[];
+extern const std::size_t prelude_blob_size;
+
+} // namespace typedlua::libs
@@ -0,0 +1,8 @@
+#include "prelude_blob.hpp"
+
+namespace typedlua::libs {
+
+const unsigned char prelude_blob[] = {0};
+const std::size_t prelude_blob_size = 0;
+
+} // namespace typedlua::libs
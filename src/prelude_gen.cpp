@@ -0,0 +1,43 @@
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "libs.hpp"
+#include "serialize.hpp"
+
+// Writes the serialized prelude as a C++ source defining prelude_blob, so tlc can skip importing the libraries.
+int main(int argc, char **argv) {
+    if (argc != 2) {
+        std::cerr << "Usage: " << argv[0] << " output.cpp\n";
+        return 2;
+    }
+
+    auto deferred_types = typedlua::DeferredTypeCollection{};
+    auto scope = typedlua::Scope(&deferred_types);
+
+    typedlua::libs::import_prelude(scope);
+
+    auto blob = typedlua::serialize_scope(scope, deferred_types);
+
+    auto out = std::ofstream(argv[1], std::ios::binary);
+
+    if (!out) {
+        std::cerr << "Error: cannot write " << argv[1] << "\n";
+        return 1;
+    }
+
+    out << "// Generated by typedlua_prelude_gen. Do not edit.\n"
+        << "#include \"prelude_blob.hpp\"\n\n"
+        << "namespace typedlua::libs {\n\n"
+        << "const unsigned char prelude_blob[] = {";
+
+    for (auto i = std::size_t{0}; i < blob.size(); ++i) {
+        out << (i % 16 == 0 ? "\n    " : " ") << static_cast<unsigned>(static_cast<unsigned char>(blob[i])) << ",";
+    }
+
+    out << "\n};\n"
+        << "const std::size_t prelude_blob_size = " << blob.size() << ";\n\n"
+        << "} // namespace typedlua::libs\n";
+
+    return out ? 0 : 1;
+}
@@ -1,6 +1,6 @@
 #include "loader.hpp"
 
-#include "typedlua_compiler.hpp"
+#include "module_cache.hpp"
 
 namespace typedlua {
 
@@ -19,7 +19,7 @@ const char* install_require_lua = R"(
             local text = file:read('*a')
             file:close()
 
-            tlua_get_type(text)
+            tlua_get_type(text, name)
 
             return
         end
@@ -27,27 +27,18 @@ const char* install_require_lua = R"(
 )";
 
 int tlua_get_type(lua_State* L) {
-    auto source = lua_tostring(L, 1);
+    auto size = std::size_t{};
+    auto data = lua_tolstring(L, 1, &size);
+    auto source = std::string(data, size);
+    auto name = std::string(lua_tostring(L, 2));
     auto global_scope = static_cast<Scope*>(lua_touserdata(L, lua_upvalueindex(1)));
     auto result = static_cast<Type*>(lua_touserdata(L, lua_upvalueindex(2)));
+    auto cache = static_cast<const CompileCache*>(lua_touserdata(L, lua_upvalueindex(3)));
 
-    auto [root_node, errors] = typedlua::parse(source);
+    const auto& module = ModuleCache::get(L).compile(name, std::move(source), *global_scope, cache);
 
-    if (root_node && errors.empty()) {
-        auto scope = Scope(global_scope);
-        scope.deduce_return_type();
-
-        errors = typedlua::check(*root_node, scope);
-
-        if (errors.empty()) {
-            auto rettype = scope.get_return_type();
-
-            if (rettype) {
-                *result = *rettype;
-            } else {
-                *result = Type{};
-            }
-        }
+    if (module.errors.empty()) {
+        *result = module.type;
     }
 
     return 0;
@@ -55,14 +46,15 @@ int tlua_get_type(lua_State* L) {
 
 } // static
 
-void install_require(lua_State* L, Scope& global_scope) {
-    global_scope.set_get_package_type([L, &global_scope](const std::string& name){
+void install_require(lua_State* L, Scope& global_scope, const CompileCache* cache) {
+    global_scope.set_get_package_type([L, &global_scope, cache](const std::string& name){
         auto result = Type::make_any();
 
         luaL_loadstring(L, install_require_lua);
         lua_pushlightuserdata(L, &global_scope);
         lua_pushlightuserdata(L, &result);
-        lua_pushcclosure(L, tlua_get_type, 2);
+        lua_pushlightuserdata(L, const_cast<CompileCache*>(cache));
+        lua_pushcclosure(L, tlua_get_type, 3);
         lua_pushstring(L, name.c_str());
 
         auto err = lua_pcall(L, 2, 0, 0);
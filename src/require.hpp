@@ -1,11 +1,13 @@
 #pragma once
 
+#include "compile_cache.hpp"
 #include "scope.hpp"
 
 #include "lua.hpp"
 
 namespace typedlua {
 
-void install_require(lua_State* L, Scope& scope);
+// Module types are reused from `cache` if there is one. It must outlive the Lua state.
+void install_require(lua_State* L, Scope& scope, const CompileCache* cache = nullptr);
 
 } // namespace typedlua
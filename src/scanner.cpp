@@ -0,0 +1,513 @@
+#include "scanner.hpp"
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define TYPEDLUA_SCANNER_BLOCKS
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define TYPEDLUA_SCANNER_BLOCKS
+#endif
+
+namespace typedlua {
+
+namespace { // static
+
+struct Keyword {
+    std::string_view text;
+    int token;
+};
+
+constexpr Keyword keywords[] = {
+    {"and", TAND},
+    {"break", TBREAK},
+    {"do", TDO},
+    {"else", TELSE},
+    {"elseif", TELSEIF},
+    {"end", TEND},
+    {"false", TFALSE},
+    {"for", TFOR},
+    {"function", TFUNCTION},
+    {"goto", TGOTO},
+    {"if", TIF},
+    {"in", TIN},
+    {"local", TLOCAL},
+    {"nil", TNIL},
+    {"not", TNOT},
+    {"or", TOR},
+    {"repeat", TREPEAT},
+    {"return", TRETURN},
+    {"then", TTHEN},
+    {"true", TTRUE},
+    {"until", TUNTIL},
+    {"while", TWHILE},
+    {"global", TGLOBAL},
+    {"interface", TINTERFACE},
+};
+
+constexpr std::size_t keyword_slots = 64;
+
+// Perfect over `keywords`, which the static_assert below checks. Pick other multipliers if a new keyword collides.
+constexpr std::size_t keyword_hash(const char* data, std::size_t size) {
+    return (static_cast<unsigned char>(data[0]) * 3 + static_cast<unsigned char>(data[size - 1]) * 13 + size) % keyword_slots;
+}
+
+struct KeywordTable {
+    // One plus the position in `keywords` of the keyword with each hash, or 0 if there is none.
+    std::array<std::size_t, keyword_slots> slots;
+    std::size_t min_size;
+    std::size_t max_size;
+    bool perfect;
+};
+
+constexpr KeywordTable make_keyword_table() {
+    auto table = KeywordTable{{}, keywords[0].text.size(), keywords[0].text.size(), true};
+
+    for (auto i = std::size_t{0}; i < std::size(keywords); ++i) {
+        const auto& text = keywords[i].text;
+        auto& slot = table.slots[keyword_hash(text.data(), text.size())];
+
+        table.perfect = table.perfect && slot == 0;
+        table.min_size = text.size() < table.min_size ? text.size() : table.min_size;
+        table.max_size = text.size() > table.max_size ? text.size() : table.max_size;
+        slot = i + 1;
+    }
+
+    return table;
+}
+
+constexpr auto keyword_table = make_keyword_table();
+
+static_assert(keyword_table.perfect, "keyword_hash has collisions");
+
+int identifier_token(const char* data, std::size_t size) {
+    if (size < keyword_table.min_size || size > keyword_table.max_size) {
+        return TIDENTIFIER;
+    }
+
+    auto slot = keyword_table.slots[keyword_hash(data, size)];
+
+    if (slot != 0 && keywords[slot - 1].text == std::string_view(data, size)) {
+        return keywords[slot - 1].token;
+    }
+
+    return TIDENTIFIER;
+}
+
+bool is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+bool is_digit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+bool is_identifier_start(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+bool is_identifier(char c) {
+    return is_identifier_start(c) || is_digit(c);
+}
+
+#ifdef TYPEDLUA_SCANNER_BLOCKS
+
+// One bit per byte of a block, lowest for the first byte.
+using Mask = std::uint32_t;
+
+#if defined(__AVX2__)
+
+constexpr std::ptrdiff_t block_size = 32;
+
+constexpr Mask all_bytes = 0xffffffff;
+
+using Block = __m256i;
+
+Block load(const char* p) {
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+}
+
+Mask equal(Block block, char c) {
+    return static_cast<Mask>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, _mm256_set1_epi8(c))));
+}
+
+// Bytes from `lo` to `hi`, compared unsigned.
+Mask in_range(Block block, char lo, char hi) {
+    auto offset = _mm256_sub_epi8(block, _mm256_set1_epi8(lo));
+    auto limit = _mm256_set1_epi8(static_cast<char>(hi - lo));
+    return static_cast<Mask>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_min_epu8(offset, limit), offset)));
+}
+
+// Maps upper case letters to lower case, and nothing else into letters.
+Block fold_case(Block block) {
+    return _mm256_or_si256(block, _mm256_set1_epi8(0x20));
+}
+
+#else
+
+constexpr std::ptrdiff_t block_size = 16;
+
+constexpr Mask all_bytes = 0xffff;
+
+using Block = __m128i;
+
+Block load(const char* p) {
+    return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+}
+
+Mask equal(Block block, char c) {
+    return static_cast<Mask>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, _mm_set1_epi8(c))));
+}
+
+// Bytes from `lo` to `hi`, compared unsigned.
+Mask in_range(Block block, char lo, char hi) {
+    auto offset = _mm_sub_epi8(block, _mm_set1_epi8(lo));
+    auto limit = _mm_set1_epi8(static_cast<char>(hi - lo));
+    return static_cast<Mask>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_min_epu8(offset, limit), offset)));
+}
+
+// Maps upper case letters to lower case, and nothing else into letters.
+Block fold_case(Block block) {
+    return _mm_or_si128(block, _mm_set1_epi8(0x20));
+}
+
+#endif
+
+int first_byte(Mask mask) {
+    return __builtin_ctz(mask);
+}
+
+// Number of newlines among the first `n` bytes of a block.
+int count_lines(Mask newlines, int n) {
+    return __builtin_popcount(newlines & ((Mask(1) << n) - 1));
+}
+
+#endif
+
+// Most runs of whitespace, identifiers and strings are short, so the scans below look at this many bytes one at a time before they switch to blocks.
+constexpr std::ptrdiff_t short_run = 16;
+
+const char* short_run_end(const char* p, const char* end) {
+    return end - p > short_run ? p + short_run : end;
+}
+
+// The blocked loops below stop a block short of `end`, since the source may not be padded. Scalar loops finish the rest.
+
+const char* skip_whitespace_long(const char* p, const char* end, int& line) {
+#ifdef TYPEDLUA_SCANNER_BLOCKS
+    while (end - p >= block_size) {
+        auto block = load(p);
+        auto newlines = equal(block, '\n');
+        auto others = ~(newlines | equal(block, ' ') | equal(block, '\t') | equal(block, '\r')) & all_bytes;
+
+        if (others != 0) {
+            auto n = first_byte(others);
+            line += count_lines(newlines, n);
+            return p + n;
+        }
+
+        line += __builtin_popcount(newlines);
+        p += block_size;
+    }
+#endif
+
+    while (p != end && is_space(*p)) {
+        line += *p == '\n';
+        ++p;
+    }
+
+    return p;
+}
+
+const char* skip_whitespace(const char* p, const char* end, int& line) {
+    for (auto stop = short_run_end(p, end); p != stop; ++p) {
+        if (!is_space(*p)) {
+            return p;
+        }
+
+        line += *p == '\n';
+    }
+
+    return skip_whitespace_long(p, end, line);
+}
+
+const char* skip_identifier_long(const char* p, const char* end) {
+#ifdef TYPEDLUA_SCANNER_BLOCKS
+    while (end - p >= block_size) {
+        auto block = load(p);
+        auto others = ~(in_range(fold_case(block), 'a', 'z') | in_range(block, '0', '9') | equal(block, '_')) & all_bytes;
+
+        if (others != 0) {
+            return p + first_byte(others);
+        }
+
+        p += block_size;
+    }
+#endif
+
+    while (p != end && is_identifier(*p)) {
+        ++p;
+    }
+
+    return p;
+}
+
+const char* skip_identifier(const char* p, const char* end) {
+    for (auto stop = short_run_end(p, end); p != stop; ++p) {
+        if (!is_identifier(*p)) {
+            return p;
+        }
+    }
+
+    return skip_identifier_long(p, end);
+}
+
+// Returns `end` if there is no newline.
+const char* find_newline(const char* p, const char* end) {
+#ifdef TYPEDLUA_SCANNER_BLOCKS
+    while (end - p >= block_size) {
+        auto newlines = equal(load(p), '\n');
+
+        if (newlines != 0) {
+            return p + first_byte(newlines);
+        }
+
+        p += block_size;
+    }
+#endif
+
+    while (p != end && *p != '\n') {
+        ++p;
+    }
+
+    return p;
+}
+
+// The next `quote` or backslash, or `end`, counting the lines up to it.
+const char* find_quote_or_escape_long(const char* p, const char* end, char quote, int& line) {
+#ifdef TYPEDLUA_SCANNER_BLOCKS
+    while (end - p >= block_size) {
+        auto block = load(p);
+        auto newlines = equal(block, '\n');
+        auto stops = equal(block, quote) | equal(block, '\\');
+
+        if (stops != 0) {
+            auto n = first_byte(stops);
+            line += count_lines(newlines, n);
+            return p + n;
+        }
+
+        line += __builtin_popcount(newlines);
+        p += block_size;
+    }
+#endif
+
+    while (p != end && *p != quote && *p != '\\') {
+        line += *p == '\n';
+        ++p;
+    }
+
+    return p;
+}
+
+const char* find_quote_or_escape(const char* p, const char* end, char quote, int& line) {
+    for (auto stop = short_run_end(p, end); p != stop; ++p) {
+        if (*p == quote || *p == '\\') {
+            return p;
+        }
+
+        line += *p == '\n';
+    }
+
+    return find_quote_or_escape_long(p, end, quote, line);
+}
+
+// End of the string starting at `p`, past its closing quote, or nullptr if it is not closed.
+// Like lexer.l, an escape is a backslash and any character but a newline, and strings may span lines.
+const char* skip_string(const char* p, const char* end, int& line) {
+    const auto quote = *p++;
+
+    for (;;) {
+        p = find_quote_or_escape(p, end, quote, line);
+
+        if (p == end) {
+            return nullptr;
+        }
+
+        if (*p == quote) {
+            return p + 1;
+        }
+
+        if (end - p < 2 || p[1] == '\n') {
+            return nullptr;
+        }
+
+        p += 2;
+    }
+}
+
+const char* skip_digits(const char* p, const char* end) {
+    while (p != end && is_digit(*p)) {
+        ++p;
+    }
+
+    return p;
+}
+
+// As lexer.l, digits with an optional fraction, and an exponent only after a fraction.
+const char* skip_number(const char* p, const char* end) {
+    p = skip_digits(p, end);
+
+    if (end - p >= 2 && p[0] == '.' && is_digit(p[1])) {
+        p = skip_digits(p + 1, end);
+
+        if (p != end && (*p == 'e' || *p == 'E')) {
+            auto exponent = p + 1;
+
+            if (exponent != end && *exponent == '-') {
+                ++exponent;
+            }
+
+            if (exponent != end && is_digit(*exponent)) {
+                p = skip_digits(exponent, end);
+            }
+        }
+    }
+
+    return p;
+}
+
+bool starts_with(const char* p, const char* end, std::string_view text) {
+    return static_cast<std::size_t>(end - p) >= text.size() && std::memcmp(p, text.data(), text.size()) == 0;
+}
+
+} // static
+
+int Scanner::next(TYPEDLUASTYPE& value, TYPEDLUALTYPE& location) {
+    if (done) {
+        return 0;
+    }
+
+    for (;;) {
+        if (pos != end && is_space(*pos)) {
+            pos = skip_whitespace(pos, end, line);
+        }
+
+        // A comment needs the newline that ends it. Without one, it is scanned as operators.
+        if (starts_with(pos, end, "--")) {
+            auto newline = find_newline(pos + 2, end);
+
+            if (newline != end) {
+                pos = newline + 1;
+                ++line;
+                continue;
+            }
+        }
+
+        break;
+    }
+
+    const auto* start = pos;
+
+    // Lines are those of the end of the token, as with yylineno.
+    auto finish = [&](const char* stop, int token) {
+        pos = stop;
+        location.first_line = location.last_line = line;
+        return token;
+    };
+
+    auto save = [&](const char* stop, int token) {
+        value.token = Token{start, static_cast<std::size_t>(stop - start)};
+        return finish(stop, token);
+    };
+
+    if (pos == end) {
+        done = true;
+        return finish(pos, 0);
+    }
+
+    const auto c = *pos;
+
+    if (is_identifier_start(c)) {
+        auto stop = skip_identifier(pos + 1, end);
+        auto token = identifier_token(start, stop - start);
+        return token == TIDENTIFIER ? save(stop, token) : finish(stop, token);
+    }
+
+    if (is_digit(c)) {
+        return save(skip_number(pos, end), TNUMBER);
+    }
+
+    if (c == '"' || c == '\'') {
+        auto string_line = line;
+
+        if (auto stop = skip_string(pos, end, string_line)) {
+            line = string_line;
+            return save(stop, TSTRING);
+        }
+    }
+
+    switch (c) {
+        case '=':
+            return starts_with(pos, end, "==") ? finish(pos + 2, TCEQ) : finish(pos + 1, c);
+        case '~':
+            return starts_with(pos, end, "~=") ? finish(pos + 2, TCNE) : finish(pos + 1, c);
+        case '<':
+            if (starts_with(pos, end, "<=")) return finish(pos + 2, TCLE);
+            if (starts_with(pos, end, "<<")) return finish(pos + 2, TSHL);
+            return finish(pos + 1, c);
+        case '>':
+            if (starts_with(pos, end, ">=")) return finish(pos + 2, TCGE);
+            if (starts_with(pos, end, ">>")) return finish(pos + 2, TSHR);
+            return finish(pos + 1, c);
+        case '/':
+            return starts_with(pos, end, "//") ? finish(pos + 2, TSLASH2) : finish(pos + 1, c);
+        case '.':
+            if (starts_with(pos, end, "...")) return finish(pos + 3, TDOT3);
+            if (starts_with(pos, end, "..")) return finish(pos + 2, TDOT2);
+            return finish(pos + 1, c);
+        case ':':
+            return starts_with(pos, end, "::") ? finish(pos + 2, TCOLON2) : finish(pos + 1, c);
+        case '$':
+            if (starts_with(pos, end, "$require")) return finish(pos + 8, T_REQUIRE);
+            break;
+        case '(':
+        case ')':
+        case '{':
+        case '}':
+        case '[':
+        case ']':
+        case ',':
+        case ';':
+        case '|':
+        case '&':
+        case '%':
+        case '#':
+        case '^':
+        case '+':
+        case '-':
+        case '*':
+            return finish(pos + 1, c);
+        default:
+            break;
+    }
+
+    // Like lexer.l, which stops scanning there as well. The caller reports it, see `unknown_token`.
+    unknown = pos;
+    done = true;
+    return finish(pos + 1, 0);
+}
+
+} // namespace typedlua
+
+#ifndef TYPEDLUA_FLEX_LEXER
+
+int typedlualex(TYPEDLUASTYPE* value, TYPEDLUALTYPE* location, void* scanner) {
+    return static_cast<typedlua::Scanner*>(scanner)->next(*value, *location);
+}
+
+#endif
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "parser.hpp"
+
+#include <string_view>
+
+namespace typedlua {
+
+// Hand-written counterpart of the flex scanner in lexer.l, producing the same tokens, lines and errors.
+// Whitespace, identifiers, comments and strings are scanned a block at a time with SSE2 or AVX2 where the target has them.
+class Scanner {
+public:
+    // Tokens point into `source`, so it must outlive them.
+    explicit Scanner(std::string_view source) : pos(source.data()), end(source.data() + source.size()) {}
+
+    // Returns the next token, or 0 at the end of the source or after an unknown character.
+    int next(TYPEDLUASTYPE& value, TYPEDLUALTYPE& location);
+
+    // The character scanning stopped at because it is not part of any token, if it did.
+    // lexer.l prints it as it goes, but a scan may be discarded, so here the caller does.
+    const char* unknown_token() const { return unknown; }
+
+private:
+    const char* pos;
+    const char* end;
+    int line = 1;
+    bool done = false;
+    const char* unknown = nullptr;
+};
+
+} // namespace typedlua
+
+#ifndef TYPEDLUA_FLEX_LEXER
+
+// Lexer entry point of typedluaparse, whose `scanner` is a typedlua::Scanner.
+int typedlualex(TYPEDLUASTYPE* value, TYPEDLUALTYPE* location, void* scanner);
+
+#endif
@@ -1,11 +1,13 @@
 #pragma once
 
+#include "symbol.hpp"
 #include "type.hpp"
 
 #include <unordered_map>
 #include <string>
 #include <optional>
 #include <functional>
+#include <memory>
 
 namespace typedlua {
 
@@ -13,9 +15,20 @@ class Scope {
 public:
     Scope() = default;
     Scope(DeferredTypeCollection* dt) : deferred_types(dt) {}
-    Scope(Scope* parent) : parent(parent) {}
 
-    const Type* get_type_of(const std::string& name) const {
+    // Child scopes are cheap: they only copy what their root and ancestors resolve to.
+    Scope(Scope* parent) :
+        parent(parent),
+        deferred_types(parent->deferred_types),
+        root(&parent->get_root()) {}
+
+    // Root scope whose names, types and metatables fall back to `prelude`, which is only ever read.
+    // Lets several compilations share one imported stdlib, even across threads.
+    Scope(const Scope* prelude, DeferredTypeCollection* dt) :
+        deferred_types(dt),
+        prelude(prelude) {}
+
+    const Type* get_type_of(Symbol name) const {
         auto iter = names.find(name);
         
         if (iter != names.end())
@@ -26,17 +39,21 @@ public:
         {
             return parent->get_type_of(name);
         }
+        else if (prelude)
+        {
+            return prelude->get_type_of(name);
+        }
         else
         {
             return nullptr;
         }
     }
 
-    void add_name(const std::string& name, Type type) {
+    void add_name(Symbol name, Type type) {
         names.insert_or_assign(name, std::move(type));
     }
 
-    void add_global_name(const std::string& name, Type type) {
+    void add_global_name(Symbol name, Type type) {
         if (parent) {
             parent->add_global_name(name, std::move(type));
         } else {
@@ -44,6 +61,10 @@ public:
         }
     }
 
+    const std::unordered_map<Symbol, Type>& get_names() const {
+        return names;
+    }
+
     const Type* get_dots_type() const {
         switch (dots_state) {
             case DotsState::INHERIT: return parent->get_dots_type();
@@ -63,18 +84,24 @@ public:
         dots_state = DotsState::NONE;
     }
 
-    const Type* get_type(const std::string& name) const {
+    const Type* get_type(Symbol name) const {
         auto iter = types.find(name);
         if (iter != types.end()) {
             return &iter->second;
         } else if (parent) {
             return parent->get_type(name);
+        } else if (prelude) {
+            return prelude->get_type(name);
         } else {
             return nullptr;
         }
     }
 
-    void add_type(const std::string& name, Type type) {
+    const std::unordered_map<Symbol, Type>& get_types() const {
+        return types;
+    }
+
+    void add_type(Symbol name, Type type) {
         types[name] = std::move(type);
     }
 
@@ -147,8 +174,6 @@ public:
     DeferredTypeCollection& get_deferred_types() {
         if (deferred_types) {
             return *deferred_types;
-        } else if (parent) {
-            return parent->get_deferred_types();
         } else {
             throw std::logic_error("No deferred type collection in tree");
         }
@@ -159,12 +184,17 @@ public:
             throw std::logic_error("LuaType metatables can only be set on root scope");
         }
 
+        // Copy on first write, so the prelude's other metatables stay visible.
+        if (luatype_metatables.empty() && prelude) {
+            luatype_metatables = prelude->get_luatype_metatable_map();
+        }
+
         luatype_metatables.insert_or_assign(luatype, std::move(type));
     }
 
     const Type* get_luatype_metatable(LuaType luatype) const {
         if (parent) {
-            return parent->get_luatype_metatable(luatype);
+            return root->get_luatype_metatable(luatype);
         }
 
         auto iter = luatype_metatables.find(luatype);
@@ -173,27 +203,75 @@ public:
             return &iter->second;
         }
 
+        if (prelude) {
+            return prelude->get_luatype_metatable(luatype);
+        }
+
         return nullptr;
     }
 
     const std::unordered_map<LuaType, Type>& get_luatype_metatable_map() const {
         if (parent) {
-            return parent->get_luatype_metatable_map();
+            return root->get_luatype_metatable_map();
+        }
+
+        if (luatype_metatables.empty() && prelude) {
+            return prelude->get_luatype_metatable_map();
         }
 
         return luatype_metatables;
     }
 
+    // Seen by every child scope that has no package type function of its own, including existing ones.
+    // Each package is resolved through `gpt` at most once, until forget_package_types or forget_package_type.
+    // While a package is being resolved, requiring it again, as a cyclic dependency does, gives `any`.
     void set_get_package_type(std::function<Type(const std::string& name)> gpt) {
-        get_package_type = std::move(gpt);
+        package_types = std::make_shared<PackageTypes>();
+
+        if (gpt) {
+            get_package_type = [gpt = std::move(gpt), package_types = package_types](const std::string& name) {
+                auto iter = package_types->find(name);
+
+                if (iter != package_types->end()) {
+                    return iter->second.value_or(Type::make_any());
+                }
+
+                package_types->emplace(name, std::nullopt);
+
+                try {
+                    auto type = gpt(name);
+                    (*package_types)[name] = type;
+                    return type;
+                } catch (...) {
+                    package_types->erase(name);
+                    throw;
+                }
+            };
+        } else {
+            get_package_type = nullptr;
+        }
     }
 
     const std::function<Type(const std::string& name)>& get_get_package_type() const {
-        if (!get_package_type && parent) {
-            return parent->get_get_package_type();
+        return get_package_scope().get_package_type;
+    }
+
+    // Makes packages resolve again, for hosts that reload them.
+    void forget_package_types() {
+        if (package_types) {
+            package_types->clear();
+        }
+    }
+
+    // Makes one package resolve again, unless it is being resolved right now.
+    void forget_package_type(const std::string& name) {
+        if (package_types) {
+            auto iter = package_types->find(name);
+
+            if (iter != package_types->end() && iter->second) {
+                package_types->erase(iter);
+            }
         }
-        
-        return get_package_type;
     }
 
 private:
@@ -209,16 +287,41 @@ private:
         DEDUCE
     };
 
+    const Scope& get_root() const {
+        return root ? *root : *this;
+    }
+
+    // Nearest scope, or prelude, that has a package type function, or the root if none does.
+    // Looked up on every call rather than when the scope is created, so setting one affects existing children.
+    const Scope& get_package_scope() const {
+        if (get_package_type) {
+            return *this;
+        } else if (parent) {
+            return parent->get_package_scope();
+        } else if (prelude) {
+            return prelude->get_package_scope();
+        } else {
+            return *this;
+        }
+    }
+
     Scope* parent = nullptr;
-    std::unordered_map<std::string, Type> names;
+    std::unordered_map<Symbol, Type> names;
     std::optional<Type> dots_type;
     DotsState dots_state = DotsState::INHERIT;
-    std::unordered_map<std::string, Type> types;
+    std::unordered_map<Symbol, Type> types;
     std::optional<Type> return_type;
     ReturnState return_type_state = ReturnState::INHERIT;
     DeferredTypeCollection* deferred_types = nullptr;
     std::unordered_map<LuaType, Type> luatype_metatables;
+    // Resolved package types by name, or nullopt while one is being resolved.
+    using PackageTypes = std::unordered_map<std::string, std::optional<Type>>;
+
     std::function<Type(const std::string& name)> get_package_type;
+    std::shared_ptr<PackageTypes> package_types;
+    const Scope* prelude = nullptr;
+    // Null where the scope is its own root, so that root scopes can be moved.
+    const Scope* root = nullptr;
 };
 
 } // namespace typedlua
@@ -0,0 +1,513 @@
+#include "serialize.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+namespace typedlua {
+
+namespace { // static
+
+constexpr auto scope_magic = std::string_view("TLS1");
+
+void write_int(std::string& out, std::int64_t value) {
+    serialize_uint(out, (static_cast<std::uint64_t>(value) << 1) ^ static_cast<std::uint64_t>(value >> 63));
+}
+
+std::int64_t read_int(std::string_view in, std::size_t& pos) {
+    auto value = deserialize_uint(in, pos);
+    return static_cast<std::int64_t>(value >> 1) ^ -static_cast<std::int64_t>(value & 1);
+}
+
+// Writes types whose deferred ids are either kept as they are, or renumbered in the order they are reached.
+class Writer {
+public:
+    Writer(std::string& out, const DeferredTypeCollection& collection) : out(out), collection(collection) {}
+
+    Writer(std::string& out, const DeferredTypeCollection& collection, std::unordered_map<int, int>& local_ids, std::vector<int>& reached) :
+        out(out),
+        collection(collection),
+        local_ids(&local_ids),
+        reached(&reached) {}
+
+    void write_type(const Type& type) {
+        serialize_uint(out, static_cast<std::uint64_t>(type.get_tag()));
+
+        switch (type.get_tag()) {
+            case Type::Tag::VOID:
+            case Type::Tag::ANY:
+                break;
+            case Type::Tag::LUATYPE:
+                serialize_uint(out, static_cast<std::uint64_t>(type.get_luatype()));
+                break;
+            case Type::Tag::FUNCTION: {
+                const auto& func = type.get_function();
+                write_name_types(func.genparams);
+                write_ids(func.nominals);
+                write_types(func.params);
+                write_type(*func.ret);
+                serialize_uint(out, func.variadic);
+                break;
+            }
+            case Type::Tag::TUPLE: {
+                const auto& tuple = type.get_tuple();
+                write_types(tuple.types);
+                serialize_uint(out, tuple.is_variadic);
+                break;
+            }
+            case Type::Tag::SUM:
+                write_types(type.get_sum().types);
+                break;
+            case Type::Tag::PRODUCT:
+                write_types(type.get_product().types);
+                break;
+            case Type::Tag::TABLE: {
+                const auto& table = type.get_table();
+                serialize_uint(out, table.indexes.size());
+                for (const auto& index : table.indexes) {
+                    write_type(index.key);
+                    write_type(index.val);
+                }
+                write_name_types(table.fields);
+                break;
+            }
+            case Type::Tag::DEFERRED: {
+                const auto& defer = type.get_deferred();
+                write_deferred_id(defer);
+                serialize_uint(out, defer.args.size());
+                for (const auto& arg : defer.args) {
+                    serialize_uint(out, arg.has_value());
+                    if (arg) {
+                        write_type(*arg);
+                    }
+                }
+                break;
+            }
+            case Type::Tag::LITERAL: {
+                const auto& literal = type.get_literal();
+                serialize_uint(out, static_cast<std::uint64_t>(literal.underlying_type));
+                switch (literal.underlying_type) {
+                    case LuaType::BOOLEAN:
+                        serialize_uint(out, literal.boolean);
+                        break;
+                    case LuaType::NUMBER:
+                        serialize_uint(out, literal.number.is_integer);
+                        if (literal.number.is_integer) {
+                            write_int(out, literal.number.integer);
+                        } else {
+                            auto bits = std::uint64_t{};
+                            std::memcpy(&bits, &literal.number.floating, sizeof(bits));
+                            serialize_uint(out, bits);
+                        }
+                        break;
+                    case LuaType::STRING:
+                        serialize_string(out, literal.string);
+                        break;
+                    default:
+                        throw std::logic_error("Unsupported literal type");
+                }
+                break;
+            }
+            case Type::Tag::NOMINAL:
+                write_deferred_id(type.get_nominal().defer);
+                break;
+            case Type::Tag::REQUIRE:
+                write_type(*type.get_require().basis);
+                break;
+            default:
+                throw std::logic_error("Type tag not supported by serialize_type");
+        }
+    }
+
+    void write_ids(const std::vector<int>& ids) {
+        serialize_uint(out, ids.size());
+        for (auto id : ids) {
+            serialize_uint(out, local_id(id));
+        }
+    }
+
+private:
+    void write_types(const std::vector<Type>& types) {
+        serialize_uint(out, types.size());
+        for (const auto& type : types) {
+            write_type(type);
+        }
+    }
+
+    void write_name_types(const std::vector<NameType>& name_types) {
+        serialize_uint(out, name_types.size());
+        for (const auto& name_type : name_types) {
+            serialize_string(out, name_type.name);
+            write_type(name_type.type);
+        }
+    }
+
+    void write_deferred_id(const DeferredType& defer) {
+        if (defer.collection != &collection) {
+            throw std::logic_error("Cannot serialize a deferred type from another collection");
+        }
+
+        serialize_uint(out, local_id(defer.id));
+    }
+
+    int local_id(int id) {
+        if (!local_ids) {
+            return id;
+        }
+
+        auto [iter, inserted] = local_ids->try_emplace(id, local_ids->size());
+
+        if (inserted) {
+            reached->push_back(id);
+        }
+
+        return iter->second;
+    }
+
+    std::string& out;
+    const DeferredTypeCollection& collection;
+    std::unordered_map<int, int>* local_ids = nullptr;
+    std::vector<int>* reached = nullptr;
+};
+
+// Reads types written by Writer, translating their deferred ids through `ids` if given.
+class Reader {
+public:
+    Reader(std::string_view in, std::size_t& pos, DeferredTypeCollection& collection, const std::vector<int>* ids = nullptr) :
+        in(in),
+        pos(pos),
+        collection(collection),
+        ids(ids) {}
+
+    Type read_type() {
+        switch (static_cast<Type::Tag>(deserialize_uint(in, pos))) {
+            case Type::Tag::VOID:
+                return Type{};
+            case Type::Tag::ANY:
+                return Type::make_any();
+            case Type::Tag::LUATYPE:
+                return Type::make_luatype(static_cast<LuaType>(deserialize_uint(in, pos)));
+            case Type::Tag::FUNCTION: {
+                auto genparams = read_name_types();
+                auto nominals = read_ids();
+                auto params = read_types();
+                auto ret = read_type();
+                auto variadic = deserialize_uint(in, pos) != 0;
+                return Type::make_function(std::move(genparams), std::move(nominals), std::move(params), std::move(ret), variadic);
+            }
+            case Type::Tag::TUPLE: {
+                auto types = read_types();
+                auto is_variadic = deserialize_uint(in, pos) != 0;
+                return Type::make_tuple(std::move(types), is_variadic);
+            }
+            case Type::Tag::SUM:
+                return Type::make_sum(read_types());
+            case Type::Tag::PRODUCT:
+                return Type::make_product(read_types());
+            case Type::Tag::TABLE: {
+                auto indexes = std::vector<KeyValPair>(deserialize_count(in, pos));
+                for (auto& index : indexes) {
+                    index.key = read_type();
+                    index.val = read_type();
+                }
+                auto fields = read_name_types();
+                return Type::make_table(std::move(indexes), std::move(fields));
+            }
+            case Type::Tag::DEFERRED: {
+                auto id = read_id();
+                auto args = std::vector<std::optional<Type>>(deserialize_count(in, pos));
+                for (auto& arg : args) {
+                    if (deserialize_uint(in, pos)) {
+                        arg = read_type();
+                    }
+                }
+                return Type::make_deferred(collection, id, std::move(args));
+            }
+            case Type::Tag::LITERAL: {
+                switch (static_cast<LuaType>(deserialize_uint(in, pos))) {
+                    case LuaType::BOOLEAN:
+                        return Type::make_literal(LiteralType(deserialize_uint(in, pos) != 0));
+                    case LuaType::NUMBER:
+                        if (deserialize_uint(in, pos)) {
+                            return Type::make_literal(NumberRep(read_int(in, pos)));
+                        } else {
+                            auto bits = deserialize_uint(in, pos);
+                            auto floating = double{};
+                            std::memcpy(&floating, &bits, sizeof(floating));
+                            return Type::make_literal(NumberRep(floating));
+                        }
+                    case LuaType::STRING:
+                        return Type::make_literal(deserialize_string(in, pos));
+                    default:
+                        throw std::runtime_error("Unsupported literal type in serialized type data");
+                }
+            }
+            case Type::Tag::NOMINAL:
+                return Type::make_nominal(collection, read_id());
+            case Type::Tag::REQUIRE:
+                return Type::make_require(read_type());
+            default:
+                throw std::runtime_error("Invalid type tag in serialized type data");
+        }
+    }
+
+    std::vector<int> read_ids() {
+        auto result = std::vector<int>(deserialize_count(in, pos));
+        for (auto& id : result) {
+            id = read_id();
+        }
+        return result;
+    }
+
+private:
+    std::vector<Type> read_types() {
+        auto types = std::vector<Type>{};
+        auto size = deserialize_count(in, pos);
+        types.reserve(size);
+        for (auto i = 0u; i < size; ++i) {
+            types.push_back(read_type());
+        }
+        return types;
+    }
+
+    std::vector<NameType> read_name_types() {
+        auto name_types = std::vector<NameType>{};
+        auto size = deserialize_count(in, pos);
+        name_types.reserve(size);
+        for (auto i = 0u; i < size; ++i) {
+            auto name = deserialize_string(in, pos);
+            auto type = read_type();
+            name_types.push_back({std::move(name), std::move(type)});
+        }
+        return name_types;
+    }
+
+    int read_id() {
+        auto id = deserialize_uint(in, pos);
+
+        if (!ids) {
+            return id;
+        }
+
+        if (id >= ids->size()) {
+            throw std::runtime_error("Invalid deferred type id in serialized type data");
+        }
+
+        return (*ids)[id];
+    }
+
+    std::string_view in;
+    std::size_t& pos;
+    DeferredTypeCollection& collection;
+    const std::vector<int>* ids;
+};
+
+void write_name_map(std::string& out, const std::unordered_map<Symbol, Type>& map, const DeferredTypeCollection& collection) {
+    // Sorted, so that the same scope always serializes to the same bytes.
+    auto entries = std::vector<const std::pair<const Symbol, Type>*>{};
+    entries.reserve(map.size());
+    for (const auto& entry : map) {
+        entries.push_back(&entry);
+    }
+    std::sort(entries.begin(), entries.end(), [](const auto* lhs, const auto* rhs) {
+        return lhs->first.str() < rhs->first.str();
+    });
+
+    serialize_uint(out, entries.size());
+    for (const auto* entry : entries) {
+        serialize_string(out, entry->first.str());
+        serialize_type(out, entry->second, collection);
+    }
+}
+
+} // static
+
+void serialize_uint(std::string& out, std::uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+std::uint64_t deserialize_uint(std::string_view in, std::size_t& pos) {
+    auto value = std::uint64_t{0};
+    auto shift = 0;
+
+    while (true) {
+        if (pos >= in.size()) {
+            throw std::runtime_error("Serialized type data is truncated");
+        }
+
+        auto byte = static_cast<unsigned char>(in[pos++]);
+        value |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+
+        if (!(byte & 0x80)) {
+            return value;
+        }
+
+        shift += 7;
+
+        if (shift >= 64) {
+            throw std::runtime_error("Serialized integer is too long");
+        }
+    }
+}
+
+std::size_t deserialize_count(std::string_view in, std::size_t& pos) {
+    auto count = deserialize_uint(in, pos);
+
+    if (count > in.size() - pos) {
+        throw std::runtime_error("Serialized type data is truncated");
+    }
+
+    return count;
+}
+
+void serialize_string(std::string& out, std::string_view str) {
+    serialize_uint(out, str.size());
+    out += str;
+}
+
+std::string deserialize_string(std::string_view in, std::size_t& pos) {
+    auto size = deserialize_uint(in, pos);
+
+    if (size > in.size() - pos) {
+        throw std::runtime_error("Serialized type data is truncated");
+    }
+
+    auto str = std::string(in.substr(pos, size));
+    pos += size;
+    return str;
+}
+
+void serialize_type(std::string& out, const Type& type, const DeferredTypeCollection& collection) {
+    Writer(out, collection).write_type(type);
+}
+
+Type deserialize_type(std::string_view in, std::size_t& pos, DeferredTypeCollection& collection) {
+    return Reader(in, pos, collection).read_type();
+}
+
+void serialize_type_closure(std::string& out, const Type& type, const DeferredTypeCollection& collection) {
+    auto local_ids = std::unordered_map<int, int>{};
+    auto reached = std::vector<int>{};
+
+    auto root = std::string{};
+    Writer(root, collection, local_ids, reached).write_type(type);
+
+    // Entries can reach further entries, so `reached` grows while it is walked.
+    auto entries = std::string{};
+    for (auto i = 0u; i < reached.size(); ++i) {
+        auto id = reached[i];
+        auto writer = Writer(entries, collection, local_ids, reached);
+        writer.write_type(collection.get_type(id));
+        writer.write_ids(collection.get_nominals(id));
+    }
+
+    serialize_uint(out, reached.size());
+    for (auto id : reached) {
+        serialize_string(out, collection.get_name(id));
+        serialize_uint(out, collection.is_narrowing(id));
+    }
+    out += entries;
+    out += root;
+}
+
+Type deserialize_type_closure(std::string_view in, std::size_t& pos, DeferredTypeCollection& collection) {
+    auto ids = std::vector<int>(deserialize_count(in, pos));
+    for (auto& id : ids) {
+        auto name = deserialize_string(in, pos);
+        auto narrowing = deserialize_uint(in, pos) != 0;
+
+        id = narrowing
+            ? collection.reserve_narrow(std::move(name))
+            : collection.reserve(std::move(name));
+    }
+
+    auto reader = Reader(in, pos, collection, &ids);
+
+    for (auto id : ids) {
+        collection.set(id, reader.read_type());
+        collection.set_nominals(id, reader.read_ids());
+    }
+
+    return reader.read_type();
+}
+
+std::string serialize_scope(const Scope& scope, const DeferredTypeCollection& collection) {
+    auto out = std::string(scope_magic);
+
+    serialize_uint(out, collection.size());
+    for (auto i = 0; i < collection.size(); ++i) {
+        serialize_string(out, collection.get_name(i));
+        serialize_uint(out, collection.is_narrowing(i));
+
+        auto writer = Writer(out, collection);
+        writer.write_type(collection.get_type(i));
+        writer.write_ids(collection.get_nominals(i));
+    }
+
+    write_name_map(out, scope.get_names(), collection);
+    write_name_map(out, scope.get_types(), collection);
+
+    const auto& metatables = scope.get_luatype_metatable_map();
+    auto luatypes = std::vector<LuaType>{};
+    for (const auto& [luatype, type] : metatables) {
+        luatypes.push_back(luatype);
+    }
+    std::sort(luatypes.begin(), luatypes.end());
+
+    serialize_uint(out, luatypes.size());
+    for (auto luatype : luatypes) {
+        serialize_uint(out, static_cast<std::uint64_t>(luatype));
+        serialize_type(out, metatables.at(luatype), collection);
+    }
+
+    return out;
+}
+
+void deserialize_scope(std::string_view in, Scope& scope, DeferredTypeCollection& collection) {
+    if (in.substr(0, scope_magic.size()) != scope_magic) {
+        throw std::runtime_error("Serialized scope has an unknown format");
+    }
+
+    auto pos = scope_magic.size();
+
+    auto entry_count = deserialize_uint(in, pos);
+    for (auto i = 0u; i < entry_count; ++i) {
+        auto name = deserialize_string(in, pos);
+        auto narrowing = deserialize_uint(in, pos) != 0;
+
+        auto id = narrowing
+            ? collection.reserve_narrow(std::move(name))
+            : collection.reserve(std::move(name));
+
+        auto reader = Reader(in, pos, collection);
+        collection.set(id, reader.read_type());
+        collection.set_nominals(id, reader.read_ids());
+    }
+
+    auto name_count = deserialize_uint(in, pos);
+    for (auto i = 0u; i < name_count; ++i) {
+        auto name = deserialize_string(in, pos);
+        scope.add_name(name, deserialize_type(in, pos, collection));
+    }
+
+    auto type_count = deserialize_uint(in, pos);
+    for (auto i = 0u; i < type_count; ++i) {
+        auto name = deserialize_string(in, pos);
+        scope.add_type(name, deserialize_type(in, pos, collection));
+    }
+
+    auto metatable_count = deserialize_uint(in, pos);
+    for (auto i = 0u; i < metatable_count; ++i) {
+        auto luatype = static_cast<LuaType>(deserialize_uint(in, pos));
+        scope.set_luatype_metatable(luatype, deserialize_type(in, pos, collection));
+    }
+}
+
+} // namespace typedlua
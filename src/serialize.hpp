@@ -0,0 +1,45 @@
+#pragma once
+
+#include "scope.hpp"
+#include "type.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace typedlua {
+
+// Variable-length primitives the encodings below are built from.
+void serialize_uint(std::string& out, std::uint64_t value);
+
+std::uint64_t deserialize_uint(std::string_view in, std::size_t& pos);
+
+// Reads the length of a sequence whose elements take at least a byte each, so that corrupt data cannot ask for a huge allocation.
+std::size_t deserialize_count(std::string_view in, std::size_t& pos);
+
+void serialize_string(std::string& out, std::string_view str);
+
+std::string deserialize_string(std::string_view in, std::size_t& pos);
+
+// Compact binary encoding of types.
+// Deferred and nominal types are written by id, so they may only refer to the given collection.
+void serialize_type(std::string& out, const Type& type, const DeferredTypeCollection& collection);
+
+// Reads one type written by serialize_type, advancing `pos`. Deferred types are bound to `collection`.
+Type deserialize_type(std::string_view in, std::size_t& pos, DeferredTypeCollection& collection);
+
+// Like serialize_type, but also writes every collection entry the type reaches, renumbered from zero.
+// The result does not depend on where those entries sit in the collection.
+void serialize_type_closure(std::string& out, const Type& type, const DeferredTypeCollection& collection);
+
+// Reads a type written by serialize_type_closure, adding fresh entries for it to `collection`.
+Type deserialize_type_closure(std::string_view in, std::size_t& pos, DeferredTypeCollection& collection);
+
+// Names, types and luatype metatables of a root scope, together with every entry of its collection.
+std::string serialize_scope(const Scope& scope, const DeferredTypeCollection& collection);
+
+// Restores a serialized scope into an empty root scope and collection.
+void deserialize_scope(std::string_view in, Scope& scope, DeferredTypeCollection& collection);
+
+} // namespace typedlua
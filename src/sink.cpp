@@ -0,0 +1,44 @@
+#include "sink.hpp"
+
+namespace typedlua {
+
+namespace { // static
+
+void write_file(void* context, const char* data, std::size_t size) {
+    std::fwrite(data, 1, size, static_cast<std::FILE*>(context));
+}
+
+void write_string(void* context, const char* data, std::size_t size) {
+    static_cast<std::string*>(context)->append(data, size);
+}
+
+} // static
+
+Sink Sink::to_file(std::FILE* file) {
+    return Sink(write_file, file);
+}
+
+Sink Sink::to_string(std::string& out) {
+    return Sink(write_string, &out);
+}
+
+void Sink::flush() {
+    if (used != 0) {
+        writer(context, buffer, used);
+        used = 0;
+    }
+}
+
+// Text that does not fit goes out after the buffer, and without being copied into it if it would fill it anyway.
+void Sink::write_long(std::string_view text) {
+    flush();
+
+    if (text.size() >= sizeof(buffer)) {
+        writer(context, text.data(), text.size());
+    } else {
+        std::memcpy(buffer, text.data(), text.size());
+        used = text.size();
+    }
+}
+
+} // namespace typedlua
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+namespace typedlua {
+
+// Output that is gathered in a fixed buffer and handed to a writer a chunk at a time, so it is never held whole unless
+// the writer keeps it.
+class Sink {
+public:
+    // Receives each chunk along with the context the sink was made with.
+    using Writer = void (*)(void* context, const char* data, std::size_t size);
+
+    Sink(Writer writer, void* context) : writer(writer), context(context) {}
+    Sink(const Sink&) = delete;
+    Sink& operator=(const Sink&) = delete;
+
+    // Writes what is left.
+    ~Sink() { flush(); }
+
+    // Writes with fwrite, and leaves flushing `file` to its owner.
+    static Sink to_file(std::FILE* file);
+
+    // Appends to `out`.
+    static Sink to_string(std::string& out);
+
+    void write(std::string_view text) {
+        if (text.size() <= sizeof(buffer) - used) {
+            std::memcpy(buffer + used, text.data(), text.size());
+            used += text.size();
+        } else {
+            write_long(text);
+        }
+    }
+
+    Sink& operator<<(std::string_view text) {
+        write(text);
+        return *this;
+    }
+
+    void flush();
+
+private:
+    void write_long(std::string_view text);
+
+    Writer writer;
+    void* context;
+    std::size_t used = 0;
+    char buffer[16 * 1024];
+};
+
+} // namespace typedlua
@@ -0,0 +1,47 @@
+#include "symbol.hpp"
+
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace typedlua {
+
+namespace { // static
+
+std::mutex interned_mutex;
+
+// Never shrinks, so the strings in it never move.
+// This is deliberate: symbols are copied as bare pointers into the shared prelude and into root scopes that outlive any one compilation,
+// like those of a ModuleCache, so no point short of process exit is known to have dropped the last one.
+// The set grows with the distinct names a process has seen, not with the modules it compiles, so reloading a module adds nothing.
+std::unordered_set<std::string>& interned() {
+    static auto instance = std::unordered_set<std::string>{};
+    return instance;
+}
+
+// Names this thread has already interned, so that only new ones take the lock.
+// At most one entry per name in the set above, and freed when the thread exits.
+thread_local std::unordered_map<std::string_view, const std::string*> interned_here;
+
+const std::string* intern(std::string_view name) {
+    auto iter = interned_here.find(name);
+
+    if (iter != interned_here.end()) {
+        return iter->second;
+    }
+
+    auto lock = std::lock_guard(interned_mutex);
+    const auto* canonical = &*interned().emplace(name).first;
+
+    interned_here.emplace(*canonical, canonical);
+
+    return canonical;
+}
+
+} // static
+
+Symbol::Symbol() : name(intern({})) {}
+
+Symbol::Symbol(std::string_view name) : name(intern(name)) {}
+
+} // namespace typedlua
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+namespace typedlua {
+
+// Interned name. Equal names share one canonical string, so symbols compare and hash as pointers.
+// Canonical strings live as long as the process and are never reclaimed, so a long-running host keeps every distinct name it has seen.
+// Interning is safe from any thread.
+class Symbol {
+public:
+    Symbol();
+    Symbol(std::string_view name);
+    Symbol(const std::string& name) : Symbol(std::string_view(name)) {}
+    Symbol(const char* name) : Symbol(std::string_view(name)) {}
+
+    const std::string& str() const { return *name; }
+
+    friend bool operator==(Symbol lhs, Symbol rhs) { return lhs.name == rhs.name; }
+
+    friend bool operator!=(Symbol lhs, Symbol rhs) { return lhs.name != rhs.name; }
+
+private:
+    friend struct std::hash<Symbol>;
+
+    const std::string* name;
+};
+
+inline std::ostream& operator<<(std::ostream& out, Symbol symbol) {
+    return out << symbol.str();
+}
+
+} // namespace typedlua
+
+namespace std {
+
+template <>
+struct hash<typedlua::Symbol> {
+    std::size_t operator()(typedlua::Symbol symbol) const {
+        return std::hash<const std::string*>{}(symbol.name);
+    }
+};
+
+} // namespace std
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace typedlua {
+
+// Text of a token, sliced from the scanner's buffer without copying.
+// Trivial so that it can live in the parser's %union, and only valid while the buffer is.
+struct Token {
+    const char* data;
+    std::size_t size;
+
+    operator std::string_view() const { return {data, size}; }
+
+    std::string str() const { return {data, size}; }
+};
+
+} // namespace typedlua
@@ -1,5 +1,9 @@
 #include "type.hpp"
 
+#include "assign_cache.hpp"
+#include "type_identity.hpp"
+
+#include <algorithm>
 #include <unordered_map>
 #include <unordered_set>
 
@@ -330,6 +334,11 @@ Type apply_genparams(
     const std::function<Type(const std::string& name)>& get_package_type,
     const Type& type)
 {
+    // Closed subtrees come out unchanged, so they are not rebuilt.
+    if (!may_substitute(type, nominals)) {
+        return type;
+    }
+
     switch (type.get_tag()) {
         case Type::Tag::DEFERRED: {
             const auto& defer = type.get_deferred();
@@ -381,7 +390,7 @@ Type apply_genparams(
                 fields.push_back({field.name, fieldtype});
             }
 
-            return Type::make_table(std::move(indexes), std::move(fields));
+            return Type::make_table(std::move(indexes), std::move(fields), table.field_index);
         }
         case Type::Tag::SUM: {
             const auto& sum = type.get_sum();
@@ -471,17 +480,195 @@ Type apply_genparams(
     }
 }
 
+namespace { // static
+
+// Reduces `part` of a deferred type's body the same way reduce_deferred reduces the whole body.
+Type reduce_deferred_part(
+    const DeferredType& defer,
+    const std::function<Type(const std::string& name)>& get_package_type,
+    const Type& part)
+{
+    const auto& nominals = defer.collection->get_nominals(defer.id);
+
+    auto session = std::optional<AssignCache>{};
+    auto cache = AssignCache::current();
+
+    if (!cache) {
+        cache = &session.emplace();
+    }
+
+    cache->begin_reduce(defer);
+
+    auto result = apply_genparams(defer.args, nominals, get_package_type, part);
+
+    cache->finish_reduce();
+
+    return result;
+}
+
+} // static
+
+// Instantiations are memoized per check session, unless a package loader is involved, whose results may vary.
 Type reduce_deferred(
     const DeferredType& defer,
     const std::function<Type(const std::string& name)>& get_package_type)
 {
-    std::vector<std::optional<Type>> argtypes;
-    argtypes.resize(defer.args.size());
+    auto cache = AssignCache::current();
 
-    const auto& basetype = defer.collection->get_type(defer.id);
-    const auto& nominals = defer.collection->get_nominals(defer.id);
+    if (!cache || get_package_type || cache->is_reducing()) {
+        return reduce_deferred_part(defer, get_package_type, defer.collection->get_type(defer.id));
+    }
 
-    return apply_genparams(defer.args, nominals, get_package_type, basetype);
+    if (auto instance = cache->find_instance(defer)) {
+        return *instance;
+    }
+
+    // Interned, so that every use of the instance shares it, and comparing them is a pointer comparison.
+    auto result = intern(reduce_deferred_part(defer, get_package_type, defer.collection->get_type(defer.id)));
+
+    cache->add_instance(defer, result);
+
+    return result;
+}
+
+namespace { // static
+
+// Calls `visit` with every deferred type inside `type`, including those behind nominals.
+template <typename Visit>
+void for_each_deferred(const Type& type, const Visit& visit) {
+    const auto& summary = type.get_summary();
+
+    if (!summary.has_deferred && summary.nominals == 0) {
+        return;
+    }
+
+    switch (type.get_tag()) {
+        case Type::Tag::FUNCTION: {
+            const auto& func = type.get_function();
+            for (const auto& gparam : func.genparams) for_each_deferred(gparam.type, visit);
+            for (const auto& param : func.params) for_each_deferred(param, visit);
+            for_each_deferred(*func.ret, visit);
+            break;
+        }
+        case Type::Tag::TUPLE:
+            for (const auto& t : type.get_tuple().types) for_each_deferred(t, visit);
+            break;
+        case Type::Tag::SUM:
+            for (const auto& t : type.get_sum().types) for_each_deferred(t, visit);
+            break;
+        case Type::Tag::PRODUCT:
+            for (const auto& t : type.get_product().types) for_each_deferred(t, visit);
+            break;
+        case Type::Tag::TABLE: {
+            const auto& table = type.get_table();
+            for (const auto& index : table.indexes) {
+                for_each_deferred(index.key, visit);
+                for_each_deferred(index.val, visit);
+            }
+            for (const auto& field : table.fields) for_each_deferred(field.type, visit);
+            break;
+        }
+        case Type::Tag::DEFERRED: {
+            const auto& defer = type.get_deferred();
+            visit(defer);
+            for (const auto& arg : defer.args) {
+                if (arg) for_each_deferred(*arg, visit);
+            }
+            break;
+        }
+        case Type::Tag::NOMINAL:
+            visit(type.get_nominal().defer);
+            break;
+        case Type::Tag::REQUIRE:
+            for_each_deferred(*type.get_require().basis, visit);
+            break;
+        default:
+            break;
+    }
+}
+
+} // static
+
+std::vector<int> DeferredTypeCollection::end_generation(const std::vector<const Type*>& roots) {
+    if (generations.empty()) {
+        throw std::logic_error("No generation to end");
+    }
+
+    auto owned = std::move(generations.back());
+    generations.pop_back();
+
+    return collect(owned, roots, false);
+}
+
+void DeferredTypeCollection::release(const std::vector<int>& ids, const std::vector<const Type*>& roots) {
+    collect(ids, roots, true);
+}
+
+std::vector<int> DeferredTypeCollection::collect(const std::vector<int>& owned, const std::vector<const Type*>& roots, bool follow_all) {
+    auto is_owned = std::vector<bool>(entries.size());
+    for (auto id : owned) {
+        is_owned[id] = true;
+    }
+
+    auto reached = std::vector<bool>(entries.size());
+    auto pending = std::vector<int>{};
+
+    auto reach = [&](int id) {
+        if (!reached[id]) {
+            reached[id] = true;
+            pending.push_back(id);
+        }
+    };
+
+    auto visit = [&](const DeferredType& defer) {
+        if (defer.collection == this) {
+            reach(defer.id);
+        }
+    };
+
+    for (const auto* root : roots) {
+        for_each_deferred(*root, visit);
+    }
+
+    // Unless `follow_all`, older entries are only looked into if they are narrowing, since nothing else of theirs changes after they are defined.
+    while (!pending.empty()) {
+        auto id = pending.back();
+        pending.pop_back();
+
+        const auto& entry = entries[id];
+
+        if (!follow_all && !is_owned[id] && !entry.narrowing) {
+            continue;
+        }
+
+        for (auto nominal : entry.nominals) {
+            reach(nominal);
+        }
+
+        for_each_deferred(entry.type, visit);
+    }
+
+    auto kept = std::vector<int>{};
+
+    for (auto id : owned) {
+        if (reached[id]) {
+            kept.push_back(id);
+        } else {
+            entries[id] = Entry{{}, {}, {}, false, entries[id].version + 1};
+            free_ids.push_back(id);
+        }
+    }
+
+    // Free entries at the end are dropped rather than kept for reuse.
+    std::sort(free_ids.begin(), free_ids.end());
+
+    while (!free_ids.empty() && free_ids.back() == static_cast<int>(entries.size()) - 1) {
+        tail_version = std::max(tail_version, entries.back().version);
+        free_ids.pop_back();
+        entries.pop_back();
+    }
+
+    return kept;
 }
 
 namespace { // static
@@ -496,7 +683,7 @@ std::optional<Type> get_field_type(const DeferredType& defer, const std::string&
 
 std::optional<Type> get_index_type(const TableType& table, const Type& key, std::vector<std::string>& notes) {
     for (const auto& index : table.indexes) {
-        if (is_assignable(index.key, key).yes) {
+        if (can_assign(index.key, key)) {
             return index.val;
         }
     }
@@ -513,7 +700,7 @@ std::optional<Type> get_index_type(const SumType& sum, const Type& key, std::vec
             if (!rv) {
                 rv = std::move(t);
             } else {
-                rv = *rv | *t;
+                rv = std::move(*rv) | *t;
             }
         } else {
             notes.push_back("Cannot find index `" + to_string(key) + "` in `" + to_string(type) + "`");
@@ -540,10 +727,8 @@ std::optional<Type> get_field_type(const LuaType& luatype, const std::string& ke
 }
 
 std::optional<Type> get_field_type(const TableType& table, const std::string& key, std::vector<std::string>& notes, const std::unordered_map<LuaType, Type>& luatype_metatables) {
-    for (const auto& field : table.fields) {
-        if (field.name == key) {
-            return field.type;
-        }
+    if (auto field = find_field(table, key)) {
+        return field->type;
     }
 
     return get_index_type(table, Type::make_luatype(LuaType::STRING), notes);
@@ -558,7 +743,7 @@ std::optional<Type> get_field_type(const SumType& sum, const std::string& key, s
             if (!rv) {
                 rv = std::move(t);
             } else {
-                rv = *rv | *t;
+                rv = std::move(*rv) | *t;
             }
         } else {
             notes.push_back("Cannot find field '" + key + "' in `" + to_string(type) + "`");
@@ -569,6 +754,15 @@ std::optional<Type> get_field_type(const SumType& sum, const std::string& key, s
 }
 
 std::optional<Type> get_field_type(const DeferredType& defer, const std::string& key, std::vector<std::string>& notes, const std::unordered_map<LuaType, Type>& luatype_metatables) {
+    const auto& basetype = defer.collection->get_type(defer.id);
+
+    // Fields reduce independently, so a single field does not need the whole table reduced.
+    if (basetype.get_tag() == Type::Tag::TABLE) {
+        if (auto field = find_field(basetype.get_table(), key)) {
+            return reduce_deferred_part(defer, {}, field->type);
+        }
+    }
+
     auto r = get_field_type(reduce_deferred(defer, {}), key, notes, luatype_metatables);
     if (!notes.empty()) {
         notes.push_back("In deferred type '" + defer.collection->get_name(defer.id) + "'");
@@ -607,7 +801,277 @@ std::optional<Type> get_index_type(const Type& type, const Type& key, std::vecto
 
 namespace { // static
 
-std::optional<Type> resolve_overload(
+// Kinds of values for overload dispatch. LuaTypes use the bit of their value.
+constexpr unsigned function_kind = 1u << 5;
+constexpr unsigned table_kind = 1u << 6;
+constexpr unsigned all_kinds = (1u << 7) - 1;
+
+unsigned luatype_kind(LuaType luatype) {
+    return 1u << static_cast<unsigned>(luatype);
+}
+
+// Kinds of values an argument of this type may hold, or 0 if it is not known.
+// Every kind present must be accepted for the argument to pass.
+unsigned argument_kinds(const Type& type) {
+    switch (type.get_tag()) {
+        case Type::Tag::LUATYPE: return luatype_kind(type.get_luatype());
+        case Type::Tag::LITERAL: return luatype_kind(type.get_literal().underlying_type);
+        case Type::Tag::FUNCTION: return function_kind;
+        case Type::Tag::PRODUCT: return function_kind;
+        case Type::Tag::TABLE: return table_kind;
+        case Type::Tag::SUM: {
+            auto kinds = 0u;
+            for (const auto& member : type.get_sum().types) {
+                kinds |= argument_kinds(member);
+            }
+            return kinds;
+        }
+        case Type::Tag::DEFERRED: {
+            // Table constructors are deferred so they can be narrowed, but they stay tables.
+            const auto& defer = type.get_deferred();
+            const auto& basetype = defer.collection->get_type(defer.id);
+            return basetype.get_tag() == Type::Tag::TABLE ? table_kind : 0;
+        }
+        default: return 0;
+    }
+}
+
+// Kinds of arguments a parameter might accept. Overapproximates `can_pass_param`.
+unsigned parameter_kinds(const Type& type, const std::vector<int>& nominals) {
+    switch (type.get_tag()) {
+        case Type::Tag::LUATYPE: return luatype_kind(type.get_luatype());
+        case Type::Tag::LITERAL: return luatype_kind(type.get_literal().underlying_type);
+        case Type::Tag::FUNCTION: return function_kind;
+        case Type::Tag::PRODUCT: return function_kind;
+        case Type::Tag::TABLE: return table_kind;
+        case Type::Tag::SUM: {
+            auto kinds = 0u;
+            for (const auto& member : type.get_sum().types) {
+                kinds |= parameter_kinds(member, nominals);
+            }
+            return kinds;
+        }
+        case Type::Tag::NOMINAL: {
+            const auto id = type.get_nominal().defer.id;
+
+            // Generic parameters take whatever they are inferred as. Other nominals only take nominal arguments.
+            if (std::find(nominals.begin(), nominals.end(), id) != nominals.end()) {
+                return all_kinds;
+            }
+
+            return 0;
+        }
+        default: return all_kinds;
+    }
+}
+
+bool is_memoizable(const TypeSummary& summary) {
+    return !summary.has_deferred && !summary.has_require;
+}
+
+} // static
+
+void index_overloads(ProductType& product) {
+    auto index = std::make_shared<OverloadIndex>();
+    auto max_arity = std::size_t{0};
+
+    index->memoizable = true;
+
+    for (auto i = 0u; i < product.types.size(); ++i) {
+        const auto& type = product.types[i];
+
+        index->memoizable = index->memoizable && is_memoizable(type.get_summary());
+
+        switch (type.get_tag()) {
+            case Type::Tag::FUNCTION: {
+                const auto& func = type.get_function();
+                auto candidate = OverloadIndex::Candidate{i};
+
+                candidate.accepts.reserve(func.params.size());
+                for (const auto& param : func.params) {
+                    candidate.accepts.push_back(parameter_kinds(param, func.nominals));
+                }
+
+                max_arity = std::max(max_arity, func.params.size());
+                index->candidates.push_back(std::move(candidate));
+                break;
+            }
+            case Type::Tag::ANY:
+            case Type::Tag::PRODUCT:
+            case Type::Tag::DEFERRED: {
+                auto candidate = OverloadIndex::Candidate{i};
+                candidate.always = true;
+                index->candidates.push_back(std::move(candidate));
+                break;
+            }
+            default:
+                // Never callable.
+                break;
+        }
+    }
+
+    index->by_arity.resize(max_arity + 2);
+
+    for (auto arity = 0u; arity < index->by_arity.size(); ++arity) {
+        for (auto c = 0u; c < index->candidates.size(); ++c) {
+            const auto& candidate = index->candidates[c];
+
+            if (candidate.always ||
+                arity <= candidate.accepts.size() ||
+                product.types[candidate.position].get_function().variadic) {
+                index->by_arity[arity].push_back(c);
+            }
+        }
+    }
+
+    product.overloads = std::move(index);
+}
+
+namespace { // static
+
+// Whether a call with these arguments could resolve to the candidate, judging only by their kinds.
+bool is_plausible(const OverloadIndex::Candidate& candidate, const std::vector<Type>& args) {
+    if (candidate.always) {
+        return true;
+    }
+
+    const auto& accepts = candidate.accepts;
+
+    for (auto i = 0u; i < accepts.size(); ++i) {
+        // Missing arguments are nil.
+        const auto kinds = i < args.size() ? argument_kinds(args[i]) : luatype_kind(LuaType::NIL);
+
+        if ((kinds & ~accepts[i]) != 0) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Arguments whose assignability never changes while checking, so that resolutions against them can be memoized.
+bool is_memoizable(const std::vector<Type>& args) {
+    for (const auto& arg : args) {
+        const auto& summary = arg.get_summary();
+
+        if (!is_memoizable(summary) || summary.nominals != 0) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Overload resolution without notes, used to find the winning candidate cheaply.
+
+std::optional<Type> try_resolve_overload(
+    const Type& type,
+    const std::vector<Type>& args,
+    const std::function<Type(const std::string& name)>& get_package_type);
+
+std::optional<Type> try_resolve_overload(
+    const FunctionType& func,
+    const std::vector<Type>& args,
+    const std::function<Type(const std::string& name)>& get_package_type)
+{
+    if (args.size() > func.params.size() && !func.variadic) {
+        return std::nullopt;
+    }
+
+    auto nils = 0;
+
+    if (args.size() < func.params.size()) {
+        nils = func.params.size() - args.size();
+    }
+
+    auto genparams_inferred = std::vector<std::optional<Type>>{};
+
+    genparams_inferred.resize(func.genparams.size());
+
+    const auto sz = std::min(args.size() + nils, func.params.size());
+
+    auto nil = Type::make_luatype(LuaType::NIL);
+
+    for (auto i = 0u; i < sz; ++i) {
+        const auto& argstype = i < args.size() ? args[i] : nil;
+        const auto& lhstype = func.params[i];
+
+        if (!can_pass_param(lhstype, argstype, func.genparams, func.nominals, genparams_inferred)) {
+            return std::nullopt;
+        }
+    }
+
+    return apply_genparams(genparams_inferred, func.nominals, get_package_type, *func.ret);
+}
+
+std::optional<Type> try_resolve_overload(
+    const ProductType& product,
+    const std::vector<Type>& args,
+    const std::function<Type(const std::string& name)>& get_package_type)
+{
+    const auto& index = *product.overloads;
+
+    auto cache = AssignCache::current();
+    auto memoize = cache && index.memoizable && is_memoizable(args);
+
+    if (memoize) {
+        if (auto position = cache->find_overload(index, args)) {
+            if (*position < 0) {
+                return std::nullopt;
+            }
+
+            return try_resolve_overload(product.types[*position], args, get_package_type);
+        }
+    }
+
+    const auto& arity = index.by_arity[std::min(args.size(), index.by_arity.size() - 1)];
+
+    for (auto c : arity) {
+        const auto& candidate = index.candidates[c];
+
+        if (!is_plausible(candidate, args)) {
+            continue;
+        }
+
+        if (auto result = try_resolve_overload(product.types[candidate.position], args, get_package_type)) {
+            if (memoize) {
+                cache->add_overload(product.overloads, args, candidate.position);
+            }
+
+            return result;
+        }
+    }
+
+    if (memoize) {
+        cache->add_overload(product.overloads, args, -1);
+    }
+
+    return std::nullopt;
+}
+
+std::optional<Type> try_resolve_overload(
+    const Type& type,
+    const std::vector<Type>& args,
+    const std::function<Type(const std::string& name)>& get_package_type)
+{
+    switch (type.get_tag()) {
+        case Type::Tag::ANY: return Type::make_any();
+        case Type::Tag::FUNCTION: return try_resolve_overload(type.get_function(), args, get_package_type);
+        case Type::Tag::PRODUCT: return try_resolve_overload(type.get_product(), args, get_package_type);
+        case Type::Tag::DEFERRED: return try_resolve_overload(reduce_deferred(type.get_deferred(), get_package_type), args, get_package_type);
+        default: return std::nullopt;
+    }
+}
+
+// Overload resolution with notes, only run once resolution is known to fail.
+
+std::optional<Type> explain_overload(
+    const Type& type,
+    const std::vector<Type>& args,
+    std::vector<std::string>& notes,
+    const std::function<Type(const std::string& name)>& get_package_type);
+
+std::optional<Type> explain_overload(
     const FunctionType& func,
     const std::vector<Type>& args,
     std::vector<std::string>& notes,
@@ -650,7 +1114,7 @@ std::optional<Type> resolve_overload(
     }
 }
 
-std::optional<Type> resolve_overload(
+std::optional<Type> explain_overload(
     const ProductType& product,
     const std::vector<Type>& args,
     std::vector<std::string>& notes,
@@ -661,7 +1125,7 @@ std::optional<Type> resolve_overload(
     for (const auto& type : product.types) {
         auto cur_notes = std::vector<std::string>{};
         
-        auto result = resolve_overload(type, args, cur_notes, get_package_type);
+        auto result = explain_overload(type, args, cur_notes, get_package_type);
 
         if (result) {
             notes.insert(
@@ -686,18 +1150,16 @@ std::optional<Type> resolve_overload(
     return std::nullopt;
 }
 
-std::optional<Type> resolve_overload(
+std::optional<Type> explain_overload(
     const DeferredType& defer,
     const std::vector<Type>& args,
     std::vector<std::string>& notes,
     const std::function<Type(const std::string& name)>& get_package_type)
 {
-    return resolve_overload(reduce_deferred(defer, get_package_type), args, notes, get_package_type);
+    return explain_overload(reduce_deferred(defer, get_package_type), args, notes, get_package_type);
 }
 
-} // static
-
-std::optional<Type> resolve_overload(
+std::optional<Type> explain_overload(
     const Type& type,
     const std::vector<Type>& args,
     std::vector<std::string>& notes,
@@ -705,13 +1167,28 @@ std::optional<Type> resolve_overload(
 {
     switch (type.get_tag()) {
         case Type::Tag::ANY: return Type::make_any();
-        case Type::Tag::FUNCTION: return resolve_overload(type.get_function(), args, notes, get_package_type);
-        case Type::Tag::PRODUCT: return resolve_overload(type.get_product(), args, notes, get_package_type);
-        case Type::Tag::DEFERRED: return resolve_overload(type.get_deferred(), args, notes, get_package_type);
+        case Type::Tag::FUNCTION: return explain_overload(type.get_function(), args, notes, get_package_type);
+        case Type::Tag::PRODUCT: return explain_overload(type.get_product(), args, notes, get_package_type);
+        case Type::Tag::DEFERRED: return explain_overload(type.get_deferred(), args, notes, get_package_type);
         default:
             notes.push_back("Type `" + to_string(type) + "` cannot be called");
             return std::nullopt;
     }
 }
 
+} // static
+
+std::optional<Type> resolve_overload(
+    const Type& type,
+    const std::vector<Type>& args,
+    std::vector<std::string>& notes,
+    const std::function<Type(const std::string& name)>& get_package_type)
+{
+    if (auto result = try_resolve_overload(type, args, get_package_type)) {
+        return result;
+    }
+
+    return explain_overload(type, args, notes, get_package_type);
+}
+
 } // namespace typedlua
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <stdexcept>
 #include <utility>
 #include <memory>
@@ -29,6 +30,7 @@ enum class LuaType {
 };
 
 class Type;
+class TypeStore;
 class DeferredTypeCollection;
 struct KeyValPair;
 struct NameType;
@@ -37,36 +39,20 @@ struct FunctionType {
     std::vector<NameType> genparams;
     std::vector<int> nominals;
     std::vector<Type> params;
-    std::unique_ptr<Type> ret;
+    std::shared_ptr<const Type> ret;
     bool variadic = false;
 
     FunctionType() = default;
-    FunctionType(std::vector<Type> params, std::unique_ptr<Type> ret, bool v) :
+    FunctionType(std::vector<Type> params, std::shared_ptr<const Type> ret, bool v) :
         params(std::move(params)),
         ret(std::move(ret)),
         variadic(v) {}
-    FunctionType(std::vector<NameType> genparams, std::vector<int> nominals, std::vector<Type> params, std::unique_ptr<Type> ret, bool v) :
+    FunctionType(std::vector<NameType> genparams, std::vector<int> nominals, std::vector<Type> params, std::shared_ptr<const Type> ret, bool v) :
         genparams(std::move(genparams)),
         nominals(std::move(nominals)),
         params(std::move(params)),
         ret(std::move(ret)),
         variadic(v) {}
-    FunctionType(FunctionType&&) = default;
-    FunctionType(const FunctionType& other) :
-        genparams(other.genparams),
-        nominals(other.nominals),
-        params(other.params),
-        ret(std::make_unique<Type>(*other.ret)),
-        variadic(other.variadic) {}
-    
-    FunctionType& operator=(FunctionType&&) = default;
-    FunctionType& operator=(const FunctionType& other) {
-        genparams = other.genparams;
-        nominals = other.nominals;
-        params = other.params;
-        ret = std::make_unique<Type>(*other.ret);
-        return *this;
-    }
 };
 
 struct TupleType {
@@ -74,18 +60,36 @@ struct TupleType {
     bool is_variadic = false;
 };
 
+struct MemberIndex;
+
 struct SumType {
     std::vector<Type> types;
+    // Present once a sum is large enough to be worth it. See index_members.
+    std::shared_ptr<MemberIndex> index = {};
 };
 
+struct OverloadIndex;
+
 struct ProductType {
     std::vector<Type> types;
+    // Built with the product. See index_overloads.
+    std::shared_ptr<const OverloadIndex> overloads = {};
 };
 
 using FieldMap = std::vector<NameType>;
+
+// Positions of the fields of a wide table by name. Shared by copies of the table, which never reorder their fields.
+// add_table_field copies it before adding to one that is shared.
+using FieldIndex = std::unordered_map<std::string, std::size_t>;
+
+// Tables with fewer fields are scanned.
+constexpr std::size_t field_index_threshold = 8;
+
 struct TableType {
     std::vector<KeyValPair> indexes;
     FieldMap fields;
+    // Present once the table has field_index_threshold fields. Field names are unique.
+    std::shared_ptr<FieldIndex> field_index = {};
 };
 
 struct DeferredType {
@@ -242,33 +246,133 @@ struct LiteralType {
     }
 };
 
+bool same_literal(const LiteralType& lhs, const LiteralType& rhs);
+
+std::size_t hash_literal(const LiteralType& literal);
+
+// Table members of a sum that have literal fields with these names, in this order.
+// A table can only be assigned to one of them if it has the same literals in these fields.
+struct RecordShape {
+    std::vector<std::string> names;
+    // Hash of the literals of each member's fields, see hash_shape, to its position.
+    std::unordered_multimap<std::size_t, std::size_t> records;
+    // Positions of every member of the shape, for tables whose fields are not literals themselves.
+    std::vector<std::size_t> positions;
+};
+
+// Members of a sum by literal value, and table members by their literal fields or a field they require,
+// so that probing a large enum-like union for a literal, or a large union of records for a table, is a lookup instead of a scan.
+// Holds positions rather than values, so copies of the sum can share it. add_sum_member copies it before adding to one that is shared.
+struct MemberIndex {
+    // hash_literal of each literal member, to its position.
+    std::unordered_multimap<std::size_t, std::size_t> literals;
+    // Table members that have literal fields.
+    std::vector<RecordShape> shapes;
+    // Position in `shapes` by the first name of each shape.
+    std::unordered_multimap<std::string, std::size_t> shapes_by_name;
+    // Name of a field that each other table member requires, to its position. Only tables that have that field can be assigned to it.
+    std::unordered_multimap<std::string, std::size_t> tables;
+    // Positions of the remaining members, which may still accept a literal or table that is not in the index.
+    std::vector<std::size_t> others;
+};
+
+// Sums with fewer members are scanned.
+constexpr std::size_t member_index_threshold = 8;
+
+// (Re)builds the member index of a sum after its members changed, or drops it if the sum is too small to need one.
+inline void index_members(SumType& sum);
+
+// Appends a member to a sum under construction, keeping its member index up to date without changing one that other sums share.
+inline void add_sum_member(SumType& sum, Type type);
+
+// Whether the sum has a member that is exactly this literal.
+inline bool has_literal(const SumType& sum, const LiteralType& literal);
+
+// Which members of a product could accept a call, by argument count and the coarse kind of each argument.
+// Holds positions rather than values, so copies of the product can share it. It never changes once built.
+struct OverloadIndex {
+    struct Candidate {
+        std::size_t position;
+        // Kinds of arguments each parameter might accept, one bit per kind.
+        std::vector<unsigned> accepts = {};
+        // Set for members that are checked whatever the arguments, such as deferred ones.
+        bool always = false;
+    };
+
+    std::vector<Candidate> candidates;
+    // Entries of `candidates` that take each argument count, in product order. Larger counts use the last one.
+    std::vector<std::vector<std::size_t>> by_arity;
+    // Whether the product has nothing that can change while checking, so resolutions against it can be memoized.
+    bool memoizable = false;
+};
+
+// Builds the overload index of a product after its members changed.
+void index_overloads(ProductType& product);
+
+// Builds the field index of a table, if it is wide enough to need one.
+inline void index_fields(TableType& table);
+
+// Appends a field to a table under construction, keeping its field index up to date without changing one that other tables share.
+inline void add_table_field(TableType& table, NameType field);
+
+// The field with this name, or null.
+inline const NameType* find_field(const TableType& table, const std::string& name);
+
 struct NominalType {
     DeferredType defer;
 };
 
 struct RequireType {
-    std::unique_ptr<Type> basis;
+    std::shared_ptr<const Type> basis;
+};
 
-    RequireType() = default;
-    RequireType(std::unique_ptr<Type> basis) : basis(std::move(basis)) {}
+// What a type contains anywhere inside it, kept by the type itself so that traversals can skip closed types.
+// Everything but admits_nil may overapproximate.
+struct TypeSummary {
+    // Bit `id % 64` is set for every nominal inside.
+    std::uint64_t nominals = 0;
+    bool has_deferred = false;
+    bool has_require = false;
+    // Whether `nil` can be assigned to the type. Exact unless it has deferred types.
+    bool admits_nil = false;
+};
 
-    RequireType(const RequireType& other) :
-        basis(std::make_unique<Type>(*other.basis))
-    {}
+// Identity of a type's representation, which copies of the type share.
+// Types interned by the same TypeStore have the same id exactly when they are structurally identical.
+class TypeId {
+public:
+    TypeId() = default;
 
-    RequireType(RequireType&& other) = default;
+    friend bool operator==(TypeId lhs, TypeId rhs) { return lhs.node == rhs.node; }
 
-    RequireType& operator=(const RequireType& other) {
-        basis = std::make_unique<Type>(*other.basis);
-        return *this;
-    }
+    friend bool operator!=(TypeId lhs, TypeId rhs) { return lhs.node != rhs.node; }
 
-    RequireType& operator=(RequireType&& other) {
-        std::swap(basis, other.basis);
-        return *this;
+private:
+    friend class Type;
+    friend struct std::hash<TypeId>;
+
+    explicit TypeId(const void* node) : node(node) {}
+
+    const void* node = nullptr;
+};
+
+} // namespace typedlua
+
+namespace std {
+
+template <>
+struct hash<typedlua::TypeId> {
+    std::size_t operator()(typedlua::TypeId id) const {
+        return std::hash<const void*>{}(id.node);
     }
 };
 
+} // namespace std
+
+namespace typedlua {
+
+// Copies share one immutable representation, so they cost a reference count, and freeing one only frees what no other type shares.
+// Operations that change a type in place copy its representation first if it is shared.
 class Type {
 public:
     enum class Tag {
@@ -288,44 +392,34 @@ public:
 
     Type() = default;
 
-    Type(LuaType lt) : types(lt) {}
+    Type(LuaType lt) : Type(Types(lt)) {}
 
     static Type make_any() {
-        auto type = Type{};
-        type.types = AnyType{};
-        return type;
+        return Type(Types(AnyType{}));
     }
 
     static Type make_luatype(LuaType lt) {
-        auto type = Type();
-        type.types = lt;
-        return type;
+        return Type(Types(lt));
     }
 
     static Type make_function(std::vector<Type> params, Type ret, bool variadic) {
-        auto type = Type{};
-        type.types = FunctionType{
+        return Type(Types(FunctionType{
             std::move(params),
-            std::make_unique<Type>(std::move(ret)),
-            variadic};
-        return type;
+            std::make_shared<const Type>(std::move(ret)),
+            variadic}));
     }
 
     static Type make_function(std::vector<NameType> genparams, std::vector<int> nominals, std::vector<Type> params, Type ret, bool variadic) {
-        auto type = Type{};
-        type.types = FunctionType{
+        return Type(Types(FunctionType{
             std::move(genparams),
             std::move(nominals),
             std::move(params),
-            std::make_unique<Type>(std::move(ret)),
-            variadic};
-        return type;
+            std::make_shared<const Type>(std::move(ret)),
+            variadic}));
     }
 
     static Type make_tuple(std::vector<Type> types, bool is_variadic) {
-        auto type = Type{};
-        type.types = TupleType{std::move(types), is_variadic};
-        return type;
+        return Type(Types(TupleType{std::move(types), is_variadic}));
     }
 
     static Type make_reduced_tuple(std::vector<Type> types) {
@@ -336,70 +430,88 @@ public:
         }
     }
 
+    // Members are taken as given. Use operator| and operator& to build normalized sums and products.
+    static Type make_sum(std::vector<Type> types) {
+        auto type = Type(Types(SumType{std::move(types)}));
+        index_members(type.edit_as<SumType>());
+        return type;
+    }
+
+    static Type make_product(std::vector<Type> types) {
+        auto type = Type(Types(ProductType{std::move(types)}));
+        index_overloads(type.edit_as<ProductType>());
+        return type;
+    }
+
     static Type make_table(std::vector<KeyValPair> indexes, FieldMap fields) {
-        auto type = Type{};
-        type.types = TableType{std::move(indexes), std::move(fields)};
+        auto type = Type(Types(TableType{std::move(indexes), std::move(fields)}));
+        index_fields(type.edit_as<TableType>());
         return type;
     }
 
+    // For tables built or rebuilt field by field, whose index is already up to date.
+    static Type make_table(std::vector<KeyValPair> indexes, FieldMap fields, std::shared_ptr<FieldIndex> field_index) {
+        return Type(Types(TableType{std::move(indexes), std::move(fields), std::move(field_index)}));
+    }
+
     static Type make_deferred(DeferredTypeCollection& collection, int id) {
-        auto type = Type{};
-        type.types = DeferredType{&collection, id, {}};
-        return type;
+        return Type(Types(DeferredType{&collection, id, {}}));
     }
 
     static Type make_deferred(DeferredTypeCollection& collection, int id, std::vector<std::optional<Type>> args) {
-        auto type = Type{};
-        type.types = DeferredType{&collection, id, std::move(args)};
-        return type;
+        return Type(Types(DeferredType{&collection, id, std::move(args)}));
     }
 
     static Type make_literal(LiteralType literal) {
-        auto type = Type{};
-        type.types = LiteralType(std::move(literal));
-        return type;
+        return Type(Types(LiteralType(std::move(literal))));
     }
 
     static Type make_nominal(DeferredTypeCollection& collection, int id) {
-        auto type = Type{};
-        type.types = NominalType{DeferredType{&collection, id}};
-        return type;
+        return Type(Types(NominalType{DeferredType{&collection, id}}));
     }
 
     static Type make_require(Type basis) {
-        auto type = Type{};
-        type.types = RequireType{std::make_unique<Type>(std::move(basis))};
-        return type;
+        return Type(Types(RequireType{std::make_shared<const Type>(std::move(basis))}));
     }
 
-    Tag get_tag() const { return static_cast<Tag>(types.index()); }
+    Tag get_tag() const { return static_cast<Tag>(get_types().index()); }
+
+    const LuaType& get_luatype() const { return std::get<LuaType>(get_types()); }
 
-    const LuaType& get_luatype() const { return std::get<LuaType>(types); }
+    const FunctionType& get_function() const { return std::get<FunctionType>(get_types()); }
 
-    const FunctionType& get_function() const { return std::get<FunctionType>(types); }
+    const TupleType& get_tuple() const { return std::get<TupleType>(get_types()); }
 
-    const TupleType& get_tuple() const { return std::get<TupleType>(types); }
+    const SumType& get_sum() const { return std::get<SumType>(get_types()); }
 
-    const SumType& get_sum() const { return std::get<SumType>(types); }
+    const ProductType& get_product() const { return std::get<ProductType>(get_types()); }
 
-    const ProductType& get_product() const { return std::get<ProductType>(types); }
+    const TableType& get_table() const { return std::get<TableType>(get_types()); }
 
-    const TableType& get_table() const { return std::get<TableType>(types); }
+    const DeferredType& get_deferred() const { return std::get<DeferredType>(get_types()); }
 
-    const DeferredType& get_deferred() const { return std::get<DeferredType>(types); }
+    const LiteralType& get_literal() const { return std::get<LiteralType>(get_types()); }
 
-    const LiteralType& get_literal() const { return std::get<LiteralType>(types); }
+    const NominalType& get_nominal() const { return std::get<NominalType>(get_types()); }
 
-    const NominalType& get_nominal() const { return std::get<NominalType>(types); }
+    const RequireType& get_require() const { return std::get<RequireType>(get_types()); }
 
-    const RequireType& get_require() const { return std::get<RequireType>(types); }
+    const TypeSummary& get_summary() const { return node ? node->summary : empty_summary; }
+
+    TypeId get_id() const { return TypeId(node.get()); }
 
     friend Type operator|(const Type& lhs, const Type& rhs);
+    friend Type operator|(Type&& lhs, const Type& rhs);
     
     friend Type operator&(const Type& lhs, const Type& rhs);
 
     friend Type operator-(const Type& lhs, const Type& rhs);
 
+    friend Type narrow_field(Type tabletype, const std::string& fieldname, const Type& fieldtype);
+    friend Type narrow_index(Type tabletype, const Type& keytype, const Type& valtype);
+
+    friend class TypeStore;
+
 private:
     using Types = std::variant<
         VoidType,
@@ -415,9 +527,46 @@ private:
         NominalType,
         RequireType>;
 
-    Types types;
+    struct Node {
+        Types types;
+        TypeSummary summary;
+    };
+
+    explicit Type(Types types) : node(std::make_shared<Node>(Node{std::move(types), {}})) {
+        summarize();
+    }
+
+    const Types& get_types() const { return node ? node->types : empty_types; }
+
+    // The representation, copied first if another type shares it.
+    Node& edit() {
+        if (!node) {
+            node = std::make_shared<Node>();
+        } else if (node.use_count() > 1) {
+            node = std::make_shared<Node>(*node);
+        }
+        return *node;
+    }
+
+    template <typename T>
+    T& edit_as() { return std::get<T>(edit().types); }
+
+    // Recomputes the summary from the members' summaries.
+    void summarize();
+
+    // Accounts for a member added in place.
+    void summarize_member(const Type& member);
+
+    // Null for `void`, so that default-constructed and moved-from types allocate nothing.
+    std::shared_ptr<Node> node;
+
+    static const Types empty_types;
+    static const TypeSummary empty_summary;
 };
 
+inline const Type::Types Type::empty_types = VoidType{};
+inline const TypeSummary Type::empty_summary = TypeSummary{};
+
 std::string to_string(const Type& type);
 std::string to_string(const FunctionType& function);
 std::string to_string(const TupleType& tuple);
@@ -434,18 +583,15 @@ std::string to_string(const RequireType& require);
 class DeferredTypeCollection {
 public:
     int reserve(std::string name) {
-        entries.emplace_back(Entry{{}, std::move(name)});
-        return entries.size() - 1;
+        return allocate(Entry{{}, std::move(name)});
     }
 
     int reserve(std::string name, Type type) {
-        entries.emplace_back(Entry{std::move(type), std::move(name), {}, false});
-        return entries.size() - 1;
+        return allocate(Entry{std::move(type), std::move(name), {}, false});
     }
 
     int reserve_narrow(std::string name) {
-        entries.emplace_back(Entry{{}, std::move(name), {}, true});
-        return entries.size() - 1;
+        return allocate(Entry{{}, std::move(name), {}, true});
     }
 
     const Type& get_type(int i) const {
@@ -462,25 +608,89 @@ public:
 
     void set(int i, Type t) {
         entries[i].type = std::move(t);
+        ++entries[i].version;
+    }
+
+    // Leaves the entry empty until it is set again, so that it can be narrowed without a copy.
+    Type take(int i) {
+        ++entries[i].version;
+        return std::move(entries[i].type);
     }
 
     void set_nominals(int i, std::vector<int> nominals) {
         entries[i].nominals = std::move(nominals);
+        ++entries[i].version;
+    }
+
+    // Changes whenever the entry does, so that results derived from it can tell they are stale.
+    unsigned get_version(int i) const {
+        return entries[i].version;
     }
 
     bool is_narrowing(int i) const {
         return entries[i].narrowing;
     }
 
+    int size() const {
+        return entries.size();
+    }
+
+    // Entries reserved from now on belong to a new generation, nested in the current one if any.
+    void begin_generation() {
+        generations.emplace_back();
+    }
+
+    // Frees the entries of the current generation that none of `roots` reach, and keeps the rest for good.
+    // Freed ids are reused, so every live type that may refer to the generation has to be among the roots.
+    // Returns the ids that were kept, which only release can free later.
+    std::vector<int> end_generation(const std::vector<const Type*>& roots);
+
+    // Frees those of `ids`, as returned by end_generation, that none of `roots` reach.
+    // Unlike end_generation, follows every entry it reaches, since newer entries may refer to these.
+    void release(const std::vector<int>& ids, const std::vector<const Type*>& roots);
+
 private:
     struct Entry {
         Type type;
         std::string name;
-        std::vector<int> nominals;
+        std::vector<int> nominals = {};
         bool narrowing = false;
+        unsigned version = 0;
     };
 
+    // Frees those of `owned` that no root reaches and returns the rest.
+    // Entries outside of `owned` are only looked into if `follow_all` is set or they are narrowing.
+    std::vector<int> collect(const std::vector<int>& owned, const std::vector<const Type*>& roots, bool follow_all);
+
+    int allocate(Entry entry) {
+        auto id = 0;
+
+        if (free_ids.empty()) {
+            // Dropped tail entries may have had this id, so their count carries on too.
+            entry.version = tail_version;
+            entries.push_back(std::move(entry));
+            id = entries.size() - 1;
+        } else {
+            id = free_ids.back();
+            free_ids.pop_back();
+            // Keeps counting, so that nothing derived from the previous occupant looks current.
+            entry.version = entries[id].version + 1;
+            entries[id] = std::move(entry);
+        }
+
+        if (!generations.empty()) {
+            generations.back().push_back(id);
+        }
+
+        return id;
+    }
+
     std::vector<Entry> entries;
+    std::vector<int> free_ids;
+    // Version that entries appended from now on start at, past anything seen of those dropped from the end.
+    unsigned tail_version = 0;
+    // Ids reserved by each open generation.
+    std::vector<std::vector<int>> generations;
 };
 
 Type apply_genparams(
@@ -503,6 +713,94 @@ struct NameType {
     Type type;
 };
 
+inline void Type::summarize() {
+    auto& summary = edit().summary;
+    summary = TypeSummary{};
+
+    switch (get_tag()) {
+        case Tag::ANY:
+            summary.admits_nil = true;
+            break;
+        case Tag::LUATYPE:
+            summary.admits_nil = get_luatype() == LuaType::NIL;
+            break;
+        case Tag::FUNCTION: {
+            const auto& func = get_function();
+            for (const auto& gparam : func.genparams) summarize_member(gparam.type);
+            for (const auto& param : func.params) summarize_member(param);
+            summarize_member(*func.ret);
+            break;
+        }
+        case Tag::TUPLE:
+            for (const auto& type : get_tuple().types) summarize_member(type);
+            break;
+        case Tag::SUM:
+            for (const auto& type : get_sum().types) summarize_member(type);
+            break;
+        case Tag::PRODUCT:
+            for (const auto& type : get_product().types) summarize_member(type);
+            break;
+        case Tag::TABLE: {
+            const auto& table = get_table();
+            for (const auto& index : table.indexes) {
+                summarize_member(index.key);
+                summarize_member(index.val);
+            }
+            for (const auto& field : table.fields) summarize_member(field.type);
+            break;
+        }
+        case Tag::DEFERRED:
+            summary.has_deferred = true;
+            for (const auto& arg : get_deferred().args) {
+                if (arg) summarize_member(*arg);
+            }
+            break;
+        case Tag::NOMINAL:
+            summary.nominals = std::uint64_t(1) << (get_nominal().defer.id % 64);
+            break;
+        case Tag::REQUIRE:
+            summary.has_require = true;
+            summarize_member(*get_require().basis);
+            break;
+        default:
+            break;
+    }
+}
+
+inline void Type::summarize_member(const Type& member) {
+    const auto& inner = member.get_summary();
+    auto& summary = edit().summary;
+
+    summary.nominals |= inner.nominals;
+    summary.has_deferred = summary.has_deferred || inner.has_deferred;
+    summary.has_require = summary.has_require || inner.has_require;
+
+    // A sum admits nil through any member. Nothing else admits it through its members.
+    if (get_tag() == Tag::SUM) {
+        summary.admits_nil = summary.admits_nil || inner.admits_nil;
+    }
+}
+
+// Whether substituting these nominals or resolving requires could change the type.
+inline bool may_substitute(const Type& type, const std::vector<int>& nominals) {
+    const auto& summary = type.get_summary();
+
+    if (summary.has_require) {
+        return true;
+    }
+
+    if (summary.nominals == 0) {
+        return false;
+    }
+
+    auto mask = std::uint64_t(0);
+    for (auto id : nominals) {
+        mask |= std::uint64_t(1) << (id % 64);
+    }
+
+    return (summary.nominals & mask) != 0;
+}
+
 struct AssignResult {
     bool yes = false;
     std::vector<std::string> messages;
@@ -512,8 +810,39 @@ struct AssignResult {
     AssignResult(bool b, std::string m) : yes(b), messages{std::move(m)} {}
 };
 
+// Boolean-only assignability, for probes whose failure is not reported.
+// Must agree with `is_assignable(...).yes` for every pair of types.
+
+template <typename RHS>
+bool can_assign(const SumType& lsum, const RHS& rhs);
+inline bool can_assign(const SumType& lsum, const LiteralType& rliteral);
+inline bool can_assign(const SumType& lsum, const TableType& rtable);
+template <typename RHS>
+bool can_assign(const DeferredType& ldefer, const RHS& rhs);
+
+inline bool can_assign(const LuaType& llua, const LuaType& rlua);
+inline bool can_assign(const FunctionType& lfunc, const FunctionType& rfunc);
+inline bool can_assign(const TupleType& ltuple, const TupleType& rtuple);
+inline bool can_assign(const TableType& ltable, const TableType& rtable);
+bool can_assign(const DeferredType& ldefer, const DeferredType& rdefer);
+bool is_being_reduced(const DeferredType& defer);
+inline bool can_assign(const LiteralType& lliteral, const LiteralType& rliteral);
+inline bool can_assign(const Type& lhs, const LuaType& rlua);
+inline bool can_assign(const Type& lhs, const FunctionType& rfunc);
+inline bool can_assign(const Type& lhs, const SumType& rsum);
+inline bool can_assign(const Type& lhs, const ProductType& rproduct);
+inline bool can_assign(const Type& lhs, const TupleType& rtuple);
+inline bool can_assign(const Type& lhs, const TableType& rtable);
+inline bool can_assign(const Type& lhs, const DeferredType& rdefer);
+inline bool can_assign(const Type& lhs, const LiteralType& rliteral);
+inline bool can_assign(const Type& lhs, const Type& rhs);
+
+// Assignability with diagnostics, for results that will be reported.
+// Internal probes go through `can_assign`, so messages are only built along the failing path.
+
 template <typename RHS>
 AssignResult is_assignable(const SumType& lsum, const RHS& rhs);
+inline AssignResult is_assignable(const SumType& lsum, const LiteralType& rliteral);
 template <typename RHS>
 AssignResult is_assignable(const DeferredType& ldefer, const RHS& rhs);
 
@@ -521,7 +850,7 @@ inline AssignResult is_assignable(const LuaType& llua, const LuaType& rlua);
 inline AssignResult is_assignable(const FunctionType& lfunc, const FunctionType& rfunc);
 inline AssignResult is_assignable(const TupleType& ltuple, const TupleType& rtuple);
 inline AssignResult is_assignable(const TableType& ltable, const TableType& rtable);
-inline AssignResult is_assignable(const DeferredType& ldefer, const DeferredType& rdefer);
+AssignResult is_assignable(const DeferredType& ldefer, const DeferredType& rdefer);
 inline AssignResult is_assignable(const LiteralType& lliteral, const LiteralType& rliteral);
 inline AssignResult is_assignable(const Type& lhs, const LuaType& rlua);
 inline AssignResult is_assignable(const Type& lhs, const FunctionType& rfunc);
@@ -548,76 +877,103 @@ std::optional<Type> resolve_overload(
     const std::function<Type(const std::string& name)>& get_package_type);
 
 inline Type operator|(const Type& lhs, const Type& rhs) {
-    if (is_assignable(lhs, rhs).yes) {
+    if (can_assign(lhs, rhs)) {
         return lhs;
     }
 
-    auto rv = Type{};
-    rv.types = SumType{};
+    auto rv = Type(Type::Types(SumType{}));
+
+    auto& sum = rv.edit_as<SumType>();
 
     const auto lhs_size = lhs.get_tag() == Type::Tag::SUM ? lhs.get_sum().types.size() : 1;
     const auto rhs_size = rhs.get_tag() == Type::Tag::SUM ? rhs.get_sum().types.size() : 1;
 
-    std::get<SumType>(rv.types).types.reserve(lhs_size + rhs_size);
+    sum.types.reserve(lhs_size + rhs_size);
 
     if (lhs.get_tag() == Type::Tag::SUM) {
         const auto& lhs_types = lhs.get_sum().types;
-        std::get<SumType>(rv.types).types.insert(std::get<SumType>(rv.types).types.end(), lhs_types.begin(), lhs_types.end());
+        sum.types.insert(sum.types.end(), lhs_types.begin(), lhs_types.end());
     } else {
-        std::get<SumType>(rv.types).types.push_back(lhs);
+        sum.types.push_back(lhs);
     }
 
+    index_members(sum);
+
     if (rhs.get_tag() == Type::Tag::SUM) {
         const auto& rhs_types = rhs.get_sum().types;
         for (const auto& type : rhs_types) {
-            if (!is_assignable(rv, type).yes) {
-                std::get<SumType>(rv.types).types.push_back(type);
+            // Fetched again, in case the probe kept a copy of the sum.
+            if (!can_assign(rv, type)) {
+                add_sum_member(rv.edit_as<SumType>(), type);
             }
         }
     } else {
-        std::get<SumType>(rv.types).types.push_back(rhs);
+        add_sum_member(sum, rhs);
     }
 
+    rv.summarize();
+
     return rv;
 }
 
+// Adds to a sum in place when it can, so that folding members into a sum one by one is linear.
+inline Type operator|(Type&& lhs, const Type& rhs) {
+    if (lhs.get_tag() != Type::Tag::SUM || rhs.get_tag() == Type::Tag::SUM) {
+        return static_cast<const Type&>(lhs) | rhs;
+    }
+
+    if (can_assign(lhs, rhs)) {
+        return std::move(lhs);
+    }
+
+    add_sum_member(lhs.edit_as<SumType>(), rhs);
+    lhs.summarize_member(rhs);
+
+    return std::move(lhs);
+}
+
 inline Type operator&(const Type& lhs, const Type& rhs) {
-    if (is_assignable(lhs, rhs).yes) {
+    if (can_assign(lhs, rhs)) {
         return rhs;
     }
 
-    if (is_assignable(rhs, lhs).yes) {
+    if (can_assign(rhs, lhs)) {
         return lhs;
     }
 
     if (lhs.get_tag() == Type::Tag::SUM) {
         auto rv = lhs;
 
-        auto& sum = std::get<SumType>(rv.types);
+        auto& sum = rv.edit_as<SumType>();
 
         for (auto& type : sum.types) {
             type = type & rhs;
         }
 
+        index_members(sum);
+        rv.summarize();
+
         return rv;
     }
 
     if (rhs.get_tag() == Type::Tag::SUM) {
         auto rv = rhs;
 
-        auto& sum = std::get<SumType>(rv.types);
+        auto& sum = rv.edit_as<SumType>();
 
         for (auto& type : sum.types) {
             type = lhs & type;
         }
 
+        index_members(sum);
+        rv.summarize();
+
         return rv;
     }
 
-    auto rv = Type{};
-    rv.types = ProductType{};
+    auto rv = Type(Type::Types(ProductType{}));
 
-    auto& product = std::get<ProductType>(rv.types);
+    auto& product = rv.edit_as<ProductType>();
 
     const auto lhs_size = lhs.get_tag() == Type::Tag::PRODUCT ? lhs.get_product().types.size() : 1;
     const auto rhs_size = rhs.get_tag() == Type::Tag::PRODUCT ? rhs.get_product().types.size() : 1;
@@ -637,6 +993,9 @@ inline Type operator&(const Type& lhs, const Type& rhs) {
         product.types.push_back(rhs);
     }
 
+    index_overloads(product);
+    rv.summarize();
+
     return rv;
 }
 
@@ -660,16 +1019,19 @@ inline Type operator-(const Type& lhs, const Type& rhs) {
             return std::move(result[0]);
         }
 
-        auto rv = Type{};
-        rv.types = SumType{std::move(result)};
-        return rv;
+        return Type::make_sum(std::move(result));
     }
 
     if (rhs.get_tag() == Type::Tag::SUM) {
+        // Subtracting a literal only ever removes that same literal.
+        if (lhs.get_tag() == Type::Tag::LITERAL) {
+            return has_literal(rhs.get_sum(), lhs.get_literal()) ? Type{} : lhs;
+        }
+
         auto result = lhs;
 
         for (const auto& type : rhs.get_sum().types) {
-            result = result - rhs;
+            result = result - type;
         }
 
         return result;
@@ -726,31 +1088,25 @@ inline Type operator-(const Type& lhs, const Type& rhs) {
     return lhs;
 }
 
+// Narrowing updates the table in place, so filling a table one field at a time is linear.
+// Only a table that no other type shares is updated in place. A shared one is copied first, which only copies its members' handles.
 inline Type narrow_field(Type tabletype, const std::string& fieldname, const Type& fieldtype) {
     if (tabletype.get_tag() != Type::Tag::TABLE) {
         throw std::logic_error("Cannot narrow table field of type `" + to_string(tabletype) + "`");
     }
 
-    const auto& table = tabletype.get_table();
-
-    std::vector<NameType> newfields;
-
-    bool found = false;
-
-    for (auto field : table.fields) {
-        if (field.name == fieldname) {
-            field.type = field.type | fieldtype;
-            found = true;
-        }
+    auto& table = tabletype.edit_as<TableType>();
 
-        newfields.push_back(std::move(field));
+    if (auto field = find_field(table, fieldname)) {
+        auto& type = table.fields[field - table.fields.data()].type;
+        type = std::move(type) | fieldtype;
+    } else {
+        add_table_field(table, NameType{fieldname, fieldtype});
     }
 
-    if (!found) {
-        newfields.push_back(NameType{fieldname, fieldtype});
-    }
+    tabletype.summarize_member(fieldtype);
 
-    return Type::make_table(table.indexes, std::move(newfields));
+    return tabletype;
 }
 
 inline Type narrow_index(Type tabletype, const Type& keytype, const Type& valtype) {
@@ -758,26 +1114,25 @@ inline Type narrow_index(Type tabletype, const Type& keytype, const Type& valtyp
         throw std::logic_error("Cannot narrow table field of type `" + to_string(tabletype) + "`");
     }
 
-    const auto& table = tabletype.get_table();
-
-    std::vector<KeyValPair> newindexes;
+    auto& table = tabletype.edit_as<TableType>();
 
     bool found = false;
 
-    for (auto index : table.indexes) {
-        if (is_assignable(index.key, keytype).yes) {
-            index.val = index.val | valtype;
+    for (auto& index : table.indexes) {
+        if (can_assign(index.key, keytype)) {
+            index.val = std::move(index.val) | valtype;
             found = true;
         }
-
-        newindexes.push_back(std::move(index));
     }
 
     if (!found) {
-        newindexes.push_back({keytype, valtype});
+        table.indexes.push_back({keytype, valtype});
     }
 
-    return Type::make_table(std::move(newindexes), table.fields);
+    tabletype.summarize_member(keytype);
+    tabletype.summarize_member(valtype);
+
+    return tabletype;
 }
 
 inline std::string to_string(const AssignResult& ar) {
@@ -793,106 +1148,643 @@ std::string cannot_assign(const T& lhs, const U& rhs) {
     return "Cannot assign `" + to_string(rhs) + "` to `" + to_string(lhs) + "`";
 }
 
-template <typename RHS>
-AssignResult is_assignable(const SumType& lsum, const RHS& rhs) {
-    for (const auto& type : lsum.types) {
-        auto r = is_assignable(type, rhs);
-        if (r.yes) return r;
+inline bool is_divisible(const ProductType& product, const Type& divisor) {
+    for (const auto& rtype : product.types) {
+        if (can_assign(divisor, rtype)) {
+            return true;
+        }
     }
-    return {false, cannot_assign(lsum, rhs)};
+
+    return false;
 }
 
 template <typename RHS>
-AssignResult is_assignable(const DeferredType& ldefer, const RHS& rhs) {
-    return is_assignable(reduce_deferred(ldefer, {}), rhs);
+bool can_assign(const SumType& lsum, const RHS& rhs) {
+    for (const auto& type : lsum.types) {
+        if (can_assign(type, rhs)) return true;
+    }
+    return false;
 }
 
-inline AssignResult is_divisible(const ProductType& product, const Type& divisor) {
-    for (const auto& rtype : product.types) {
-        auto r = is_assignable(divisor, rtype);
-        if (r.yes) {
-            return r;
+// A field that every table assignable to `table` has, as its type does not accept nil, or null if there is none.
+// Only types that cannot come to accept nil later count, so deferred and sum fields do not.
+inline const NameType* required_field(const TableType& table) {
+    for (const auto& field : table.fields) {
+        switch (field.type.get_tag()) {
+            case Type::Tag::LUATYPE:
+                if (field.type.get_luatype() == LuaType::NIL) break;
+                return &field;
+            case Type::Tag::LITERAL:
+            case Type::Tag::TABLE:
+            case Type::Tag::FUNCTION:
+                return &field;
+            default:
+                break;
         }
     }
 
-    return false;
+    return nullptr;
 }
 
-inline AssignResult is_assignable(const LuaType& llua, const LuaType& rlua) {
-    if (llua != rlua) {
-        return false;
-    }
-    return true;
-}
+// Combines the literals that `table` has in the fields of `shape`, or returns nullopt if it lacks one or has another type there.
+inline std::optional<std::size_t> hash_shape(const TableType& table, const std::vector<std::string>& names) {
+    auto hash = std::size_t{0};
 
-inline AssignResult is_assignable(const Type& lhs, const LuaType& rlua) {
-    switch (lhs.get_tag()) {
-        case Type::Tag::ANY: return true;
-        case Type::Tag::LUATYPE: return is_assignable(lhs.get_luatype(), rlua);
-        case Type::Tag::SUM: return is_assignable(lhs.get_sum(), rlua);
-        case Type::Tag::DEFERRED: return is_assignable(lhs.get_deferred(), rlua);
-        default: return false;
+    for (const auto& name : names) {
+        auto field = find_field(table, name);
+
+        if (!field || field->type.get_tag() != Type::Tag::LITERAL) {
+            return std::nullopt;
+        }
+
+        hash ^= hash_literal(field->type.get_literal()) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
     }
+
+    return hash;
 }
 
-inline AssignResult is_assignable(const FunctionType& lfunc, const FunctionType& rfunc) {
-    if (rfunc.params.size() < lfunc.params.size()) {
-        return {false, "Not enough parameters."};
-    }
+// Whether no member of the shape can accept `table`, as it lacks one of the fields or has a type there that no literal accepts.
+inline bool rules_out_shape(const TableType& table, const std::vector<std::string>& names) {
+    for (const auto& name : names) {
+        auto field = find_field(table, name);
 
-    auto lgenparams = std::vector<std::optional<Type>>{};
-    auto rgenparams = std::vector<std::optional<Type>>{};
+        if (!field) {
+            return true;
+        }
 
-    lgenparams.reserve(lfunc.genparams.size());
-    rgenparams.reserve(lfunc.genparams.size());
-    
-    for (const auto& gparam : lfunc.genparams) {
-        lgenparams.push_back(gparam.type);
-    }
-    
-    for (const auto& gparam : rfunc.genparams) {
-        rgenparams.push_back(gparam.type);
+        switch (field->type.get_tag()) {
+            case Type::Tag::LUATYPE:
+            case Type::Tag::TABLE:
+            case Type::Tag::FUNCTION:
+                return true;
+            default:
+                break;
+        }
     }
 
-    for (auto i = 0u; i < rfunc.params.size(); ++i) {
-        auto r = AssignResult{};
+    return false;
+}
 
-        if (i < lfunc.params.size()) {
-            auto lparam = apply_genparams(lgenparams, lfunc.nominals, {}, lfunc.params[i]);
-            auto rparam = apply_genparams(rgenparams, rfunc.nominals, {}, rfunc.params[i]);
-            r = is_assignable(rparam, lparam);
-        } else {
-            auto rparam = apply_genparams(rgenparams, rfunc.nominals, {}, rfunc.params[i]);
-            r = is_assignable(rparam, LuaType::NIL);
-        }
+// Indexes a table member by its literal fields, unless it has none.
+inline bool index_record(MemberIndex& index, const TableType& table, std::size_t i) {
+    auto names = std::vector<std::string>{};
 
-        if (!r.yes) {
-            r.messages.push_back("At parameter " + std::to_string(i));
-            return r;
+    for (const auto& field : table.fields) {
+        if (field.type.get_tag() == Type::Tag::LITERAL) {
+            names.push_back(field.name);
         }
     }
 
-    auto lret = apply_genparams(lgenparams, lfunc.nominals, {}, *lfunc.ret);
-    auto rret = apply_genparams(rgenparams, lfunc.nominals, {}, *rfunc.ret);
+    if (names.empty()) {
+        return false;
+    }
 
-    auto r = is_assignable(lret, rret);
+    auto shape = index.shapes.size();
+    auto [first, last] = index.shapes_by_name.equal_range(names.front());
 
-    if (!r.yes) {
-        r.messages.push_back("At return type");
+    for (auto iter = first; iter != last; ++iter) {
+        if (index.shapes[iter->second].names == names) {
+            shape = iter->second;
+            break;
+        }
     }
 
-    return r;
+    if (shape == index.shapes.size()) {
+        index.shapes_by_name.emplace(names.front(), shape);
+        index.shapes.push_back({std::move(names), {}, {}});
+    }
+
+    auto& record = index.shapes[shape];
+    record.records.emplace(*hash_shape(table, record.names), i);
+    record.positions.push_back(i);
+
+    return true;
 }
 
-inline AssignResult is_assignable(const TupleType& ltuple, const TupleType& rtuple) {
-    const auto& lhs = ltuple.types;
-    const auto& rhs = rtuple.types;
+inline void index_member(MemberIndex& index, const std::vector<Type>& types, std::size_t i) {
+    const auto& type = types[i];
 
-    if (!rhs.empty() && rhs.back().get_tag() == Type::Tag::TUPLE) {
-        const auto& tup = rhs.back().get_tuple();
-        auto newrhs = std::vector<Type>(rhs.begin(), rhs.end() - 1);
-        newrhs.insert(newrhs.end(), tup.types.begin(), tup.types.end());
-        return is_assignable(ltuple, TupleType{newrhs, tup.is_variadic});
+    if (type.get_tag() == Type::Tag::LITERAL) {
+        index.literals.emplace(hash_literal(type.get_literal()), i);
+        return;
+    }
+
+    if (type.get_tag() == Type::Tag::TABLE) {
+        const auto& table = type.get_table();
+
+        if (index_record(index, table, i)) {
+            return;
+        }
+
+        if (auto field = required_field(table)) {
+            index.tables.emplace(field->name, i);
+            return;
+        }
+    }
+
+    index.others.push_back(i);
+}
+
+inline void index_members(SumType& sum) {
+    if (sum.types.size() < member_index_threshold) {
+        sum.index = nullptr;
+        return;
+    }
+
+    sum.index = std::make_shared<MemberIndex>();
+
+    for (auto i = 0u; i < sum.types.size(); ++i) {
+        index_member(*sum.index, sum.types, i);
+    }
+}
+
+inline void add_sum_member(SumType& sum, Type type) {
+    sum.types.push_back(std::move(type));
+
+    if (!sum.index) {
+        if (sum.types.size() >= member_index_threshold) {
+            index_members(sum);
+        }
+        return;
+    }
+
+    // Copies of this sum may still be using its index.
+    if (sum.index.use_count() > 1) {
+        sum.index = std::make_shared<MemberIndex>(*sum.index);
+    }
+
+    index_member(*sum.index, sum.types, sum.types.size() - 1);
+}
+
+inline bool has_literal(const SumType& sum, const LiteralType& literal) {
+    if (!sum.index) {
+        for (const auto& type : sum.types) {
+            if (type.get_tag() == Type::Tag::LITERAL && same_literal(type.get_literal(), literal)) return true;
+        }
+        return false;
+    }
+
+    auto [first, last] = sum.index->literals.equal_range(hash_literal(literal));
+
+    for (auto iter = first; iter != last; ++iter) {
+        if (same_literal(sum.types[iter->second].get_literal(), literal)) return true;
+    }
+
+    return false;
+}
+
+inline bool can_assign(const SumType& lsum, const LiteralType& rliteral) {
+    if (!lsum.index) {
+        for (const auto& type : lsum.types) {
+            if (can_assign(type, rliteral)) return true;
+        }
+        return false;
+    }
+
+    if (has_literal(lsum, rliteral)) return true;
+
+    // A literal member only accepts itself and a table member no literal, so only the rest can still match.
+    for (auto i : lsum.index->others) {
+        if (can_assign(lsum.types[i], rliteral)) return true;
+    }
+
+    return false;
+}
+
+inline bool can_assign(const SumType& lsum, const TableType& rtable) {
+    if (!lsum.index) {
+        for (const auto& type : lsum.types) {
+            if (can_assign(type, rtable)) return true;
+        }
+        return false;
+    }
+
+    for (const auto& rfield : rtable.fields) {
+        // A table member only accepts tables that have the field it requires.
+        auto [first, last] = lsum.index->tables.equal_range(rfield.name);
+
+        for (auto iter = first; iter != last; ++iter) {
+            if (can_assign(lsum.types[iter->second], rtable)) return true;
+        }
+
+        // One with literal fields only accepts tables that have the same literals there, unless they have a type that is not settled yet.
+        auto [first_shape, last_shape] = lsum.index->shapes_by_name.equal_range(rfield.name);
+
+        for (auto iter = first_shape; iter != last_shape; ++iter) {
+            const auto& shape = lsum.index->shapes[iter->second];
+
+            if (auto hash = hash_shape(rtable, shape.names)) {
+                auto [first_record, last_record] = shape.records.equal_range(*hash);
+
+                for (auto record = first_record; record != last_record; ++record) {
+                    if (can_assign(lsum.types[record->second], rtable)) return true;
+                }
+            } else if (!rules_out_shape(rtable, shape.names)) {
+                for (auto i : shape.positions) {
+                    if (can_assign(lsum.types[i], rtable)) return true;
+                }
+            }
+        }
+    }
+
+    // A literal member accepts no table, so only the rest can still match.
+    for (auto i : lsum.index->others) {
+        if (can_assign(lsum.types[i], rtable)) return true;
+    }
+
+    return false;
+}
+
+template <typename RHS>
+bool can_assign(const DeferredType& ldefer, const RHS& rhs) {
+    if (is_being_reduced(ldefer)) return false;
+    return can_assign(reduce_deferred(ldefer, {}), rhs);
+}
+
+inline bool can_assign(const LuaType& llua, const LuaType& rlua) {
+    return llua == rlua;
+}
+
+inline bool can_assign(const Type& lhs, const LuaType& rlua) {
+    const auto& summary = lhs.get_summary();
+
+    if (rlua == LuaType::NIL && !summary.has_deferred) {
+        return summary.admits_nil;
+    }
+
+    switch (lhs.get_tag()) {
+        case Type::Tag::ANY: return true;
+        case Type::Tag::LUATYPE: return can_assign(lhs.get_luatype(), rlua);
+        case Type::Tag::SUM: return can_assign(lhs.get_sum(), rlua);
+        case Type::Tag::DEFERRED: return can_assign(lhs.get_deferred(), rlua);
+        default: return false;
+    }
+}
+
+inline bool can_assign(const FunctionType& lfunc, const FunctionType& rfunc) {
+    if (rfunc.params.size() < lfunc.params.size()) {
+        return false;
+    }
+
+    auto lgenparams = std::vector<std::optional<Type>>{};
+    auto rgenparams = std::vector<std::optional<Type>>{};
+
+    lgenparams.reserve(lfunc.genparams.size());
+    rgenparams.reserve(lfunc.genparams.size());
+
+    for (const auto& gparam : lfunc.genparams) {
+        lgenparams.push_back(gparam.type);
+    }
+
+    for (const auto& gparam : rfunc.genparams) {
+        rgenparams.push_back(gparam.type);
+    }
+
+    for (auto i = 0u; i < rfunc.params.size(); ++i) {
+        auto rparam = apply_genparams(rgenparams, rfunc.nominals, {}, rfunc.params[i]);
+
+        if (i < lfunc.params.size()) {
+            auto lparam = apply_genparams(lgenparams, lfunc.nominals, {}, lfunc.params[i]);
+            if (!can_assign(rparam, lparam)) return false;
+        } else {
+            if (!can_assign(rparam, LuaType::NIL)) return false;
+        }
+    }
+
+    auto lret = apply_genparams(lgenparams, lfunc.nominals, {}, *lfunc.ret);
+    auto rret = apply_genparams(rgenparams, lfunc.nominals, {}, *rfunc.ret);
+
+    return can_assign(lret, rret);
+}
+
+inline bool can_assign(const TupleType& ltuple, const TupleType& rtuple) {
+    const auto& lhs = ltuple.types;
+    const auto& rhs = rtuple.types;
+
+    if (!rhs.empty() && rhs.back().get_tag() == Type::Tag::TUPLE) {
+        const auto& tup = rhs.back().get_tuple();
+        auto newrhs = std::vector<Type>(rhs.begin(), rhs.end() - 1);
+        newrhs.insert(newrhs.end(), tup.types.begin(), tup.types.end());
+        return can_assign(ltuple, TupleType{newrhs, tup.is_variadic});
+    }
+
+    const auto edge = std::min(lhs.size(), rhs.size());
+
+    for (auto i = 0u; i < edge; ++i) {
+        if (!can_assign(lhs[i], rhs[i])) return false;
+    }
+
+    if (lhs.size() > rhs.size() && !rtuple.is_variadic) {
+        for (auto i = edge; i < lhs.size(); ++i) {
+            if (!can_assign(lhs[i], LuaType::NIL)) return false;
+        }
+    }
+
+    return lhs.size() >= rhs.size() || ltuple.is_variadic;
+}
+
+inline void index_fields(TableType& table) {
+    if (table.fields.size() < field_index_threshold) {
+        table.field_index = nullptr;
+        return;
+    }
+
+    auto index = std::make_shared<FieldIndex>();
+    index->reserve(table.fields.size());
+
+    for (auto i = 0u; i < table.fields.size(); ++i) {
+        index->emplace(table.fields[i].name, i);
+    }
+
+    table.field_index = std::move(index);
+}
+
+inline void add_table_field(TableType& table, NameType field) {
+    table.fields.push_back(std::move(field));
+
+    if (!table.field_index) {
+        if (table.fields.size() >= field_index_threshold) {
+            index_fields(table);
+        }
+        return;
+    }
+
+    // Copies of this table may still be using its index.
+    if (table.field_index.use_count() > 1) {
+        table.field_index = std::make_shared<FieldIndex>(*table.field_index);
+    }
+
+    const auto i = table.fields.size() - 1;
+
+    table.field_index->emplace(table.fields[i].name, i);
+}
+
+inline const NameType* find_field(const TableType& table, const std::string& name) {
+    if (table.field_index) {
+        auto iter = table.field_index->find(name);
+        return iter != table.field_index->end() ? &table.fields[iter->second] : nullptr;
+    }
+
+    for (const auto& field : table.fields) {
+        if (field.name == name) {
+            return &field;
+        }
+    }
+
+    return nullptr;
+}
+
+inline bool can_assign(const TableType& ltable, const TableType& rtable) {
+    for (const auto& lindex : ltable.indexes) {
+        for (const auto& rindex : rtable.indexes) {
+            if (can_assign(rindex.key, lindex.key) && !can_assign(lindex.val, rindex.val)) {
+                return false;
+            }
+        }
+
+        if (can_assign(lindex.key, LuaType::STRING)) {
+            for (const auto& rfield : rtable.fields) {
+                if (!can_assign(lindex.val, rfield.type)) return false;
+            }
+        }
+    }
+
+    for (const auto& lfield : ltable.fields) {
+        auto rfield = find_field(rtable, lfield.name);
+
+        if (rfield) {
+            if (!can_assign(lfield.type, rfield->type)) return false;
+        } else {
+            if (!can_assign(lfield.type, LuaType::NIL)) return false;
+        }
+    }
+
+    return true;
+}
+
+inline bool can_assign(const LiteralType& lliteral, const LiteralType& rliteral) {
+    if (lliteral.underlying_type == rliteral.underlying_type) {
+        switch (lliteral.underlying_type) {
+            case LuaType::BOOLEAN:
+                return lliteral.boolean == rliteral.boolean;
+            case LuaType::NUMBER:
+                return lliteral.number == rliteral.number;
+            case LuaType::STRING:
+                return lliteral.string == rliteral.string;
+            default:
+                throw std::logic_error("Unsupported literal type");
+        }
+    }
+
+    return false;
+}
+
+inline bool can_assign(const NominalType& lnominal, const NominalType& rnominal) {
+    return lnominal.defer.id == rnominal.defer.id;
+}
+
+inline bool can_assign(const ProductType& lproduct, const ProductType& rproduct) {
+    for (const auto& lhs : lproduct.types) {
+        if (!can_assign(lhs, rproduct)) return false;
+    }
+
+    return true;
+}
+
+inline bool can_assign(const Type& lhs, VoidType) {
+    return lhs.get_tag() == Type::Tag::VOID;
+}
+
+inline bool can_assign(const Type& lhs, const FunctionType& rfunc) {
+    switch (lhs.get_tag()) {
+        case Type::Tag::ANY: return true;
+        case Type::Tag::FUNCTION: return can_assign(lhs.get_function(), rfunc);
+        case Type::Tag::SUM: return can_assign(lhs.get_sum(), rfunc);
+        case Type::Tag::DEFERRED: return can_assign(lhs.get_deferred(), rfunc);
+        default: return false;
+    }
+}
+
+inline bool can_assign(const Type& lhs, const SumType& rsum) {
+    for (const auto& type : rsum.types) {
+        if (!can_assign(lhs, type)) return false;
+    }
+    return true;
+}
+
+inline bool can_assign(const Type& lhs, const TupleType& rtuple) {
+    switch (lhs.get_tag()) {
+        case Type::Tag::ANY: return true;
+        case Type::Tag::TUPLE: return can_assign(lhs.get_tuple(), rtuple);
+        case Type::Tag::SUM: return can_assign(lhs.get_sum(), rtuple);
+        case Type::Tag::DEFERRED: return can_assign(lhs.get_deferred(), rtuple);
+        default: return false;
+    }
+}
+
+inline bool can_assign(const Type& lhs, const TableType& rtable) {
+    switch (lhs.get_tag()) {
+        case Type::Tag::ANY: return true;
+        case Type::Tag::TABLE: return can_assign(lhs.get_table(), rtable);
+        case Type::Tag::SUM: return can_assign(lhs.get_sum(), rtable);
+        case Type::Tag::DEFERRED: return can_assign(lhs.get_deferred(), rtable);
+        default: return false;
+    }
+}
+
+inline bool can_assign(const Type& lhs, const DeferredType& rdefer) {
+    switch (lhs.get_tag()) {
+        case Type::Tag::ANY: return true;
+        case Type::Tag::SUM: return can_assign(lhs.get_sum(), rdefer);
+        case Type::Tag::DEFERRED: return can_assign(lhs.get_deferred(), rdefer);
+        default:
+            if (is_being_reduced(rdefer)) return false;
+            return can_assign(lhs, reduce_deferred(rdefer, {}));
+    }
+}
+
+inline bool can_assign(const Type& lhs, const LiteralType& rliteral) {
+    switch (lhs.get_tag()) {
+        case Type::Tag::ANY: return true;
+        case Type::Tag::LITERAL: return can_assign(lhs.get_literal(), rliteral);
+        case Type::Tag::SUM: return can_assign(lhs.get_sum(), rliteral);
+        case Type::Tag::DEFERRED: return can_assign(lhs.get_deferred(), rliteral);
+        default: return can_assign(lhs, rliteral.underlying_type);
+    }
+}
+
+inline bool can_assign(const Type& lhs, const NominalType& rnominal) {
+    switch (lhs.get_tag()) {
+        case Type::Tag::ANY: return true;
+        case Type::Tag::NOMINAL: return can_assign(lhs.get_nominal(), rnominal);
+        case Type::Tag::SUM: return can_assign(lhs.get_sum(), rnominal);
+        case Type::Tag::DEFERRED: return can_assign(lhs.get_deferred(), rnominal);
+        default: return can_assign(lhs, rnominal.defer);
+    }
+}
+
+inline bool can_assign(const Type& lhs, const ProductType& rproduct) {
+    switch (lhs.get_tag()) {
+        case Type::Tag::ANY: return true;
+        case Type::Tag::PRODUCT: return can_assign(lhs.get_product(), rproduct);
+        case Type::Tag::SUM: return can_assign(lhs.get_sum(), rproduct);
+        case Type::Tag::DEFERRED: return can_assign(lhs.get_deferred(), rproduct);
+        case Type::Tag::FUNCTION: return is_divisible(rproduct, lhs);
+        default: return false;
+    }
+}
+
+inline bool can_assign(const Type& lhs, const Type& rhs) {
+    switch (rhs.get_tag()) {
+        case Type::Tag::ANY: return true;
+        case Type::Tag::VOID: return can_assign(lhs, VoidType{});
+        case Type::Tag::LUATYPE: return can_assign(lhs, rhs.get_luatype());
+        case Type::Tag::FUNCTION: return can_assign(lhs, rhs.get_function());
+        case Type::Tag::TUPLE: return can_assign(lhs, rhs.get_tuple());
+        case Type::Tag::SUM: return can_assign(lhs, rhs.get_sum());
+        case Type::Tag::TABLE: return can_assign(lhs, rhs.get_table());
+        case Type::Tag::DEFERRED: return can_assign(lhs, rhs.get_deferred());
+        case Type::Tag::LITERAL: return can_assign(lhs, rhs.get_literal());
+        case Type::Tag::NOMINAL: return can_assign(lhs, rhs.get_nominal());
+        case Type::Tag::PRODUCT: return can_assign(lhs, rhs.get_product());
+        default: return false;
+    }
+}
+
+template <typename RHS>
+AssignResult is_assignable(const SumType& lsum, const RHS& rhs) {
+    for (const auto& type : lsum.types) {
+        if (can_assign(type, rhs)) return true;
+    }
+    return {false, cannot_assign(lsum, rhs)};
+}
+
+inline AssignResult is_assignable(const SumType& lsum, const LiteralType& rliteral) {
+    if (can_assign(lsum, rliteral)) return true;
+    return {false, cannot_assign(lsum, rliteral)};
+}
+
+template <typename RHS>
+AssignResult is_assignable(const DeferredType& ldefer, const RHS& rhs) {
+    if (is_being_reduced(ldefer)) return {false, cannot_assign(ldefer, rhs)};
+    return is_assignable(reduce_deferred(ldefer, {}), rhs);
+}
+
+inline AssignResult is_assignable(const LuaType& llua, const LuaType& rlua) {
+    if (llua != rlua) {
+        return false;
+    }
+    return true;
+}
+
+inline AssignResult is_assignable(const Type& lhs, const LuaType& rlua) {
+    switch (lhs.get_tag()) {
+        case Type::Tag::ANY: return true;
+        case Type::Tag::LUATYPE: return is_assignable(lhs.get_luatype(), rlua);
+        case Type::Tag::SUM: return is_assignable(lhs.get_sum(), rlua);
+        case Type::Tag::DEFERRED: return is_assignable(lhs.get_deferred(), rlua);
+        default: return false;
+    }
+}
+
+inline AssignResult is_assignable(const FunctionType& lfunc, const FunctionType& rfunc) {
+    if (rfunc.params.size() < lfunc.params.size()) {
+        return {false, "Not enough parameters."};
+    }
+
+    auto lgenparams = std::vector<std::optional<Type>>{};
+    auto rgenparams = std::vector<std::optional<Type>>{};
+
+    lgenparams.reserve(lfunc.genparams.size());
+    rgenparams.reserve(lfunc.genparams.size());
+    
+    for (const auto& gparam : lfunc.genparams) {
+        lgenparams.push_back(gparam.type);
+    }
+    
+    for (const auto& gparam : rfunc.genparams) {
+        rgenparams.push_back(gparam.type);
+    }
+
+    for (auto i = 0u; i < rfunc.params.size(); ++i) {
+        auto r = AssignResult{};
+
+        if (i < lfunc.params.size()) {
+            auto lparam = apply_genparams(lgenparams, lfunc.nominals, {}, lfunc.params[i]);
+            auto rparam = apply_genparams(rgenparams, rfunc.nominals, {}, rfunc.params[i]);
+            r = is_assignable(rparam, lparam);
+        } else {
+            auto rparam = apply_genparams(rgenparams, rfunc.nominals, {}, rfunc.params[i]);
+            r = is_assignable(rparam, LuaType::NIL);
+        }
+
+        if (!r.yes) {
+            r.messages.push_back("At parameter " + std::to_string(i));
+            return r;
+        }
+    }
+
+    auto lret = apply_genparams(lgenparams, lfunc.nominals, {}, *lfunc.ret);
+    auto rret = apply_genparams(rgenparams, lfunc.nominals, {}, *rfunc.ret);
+
+    auto r = is_assignable(lret, rret);
+
+    if (!r.yes) {
+        r.messages.push_back("At return type");
+    }
+
+    return r;
+}
+
+inline AssignResult is_assignable(const TupleType& ltuple, const TupleType& rtuple) {
+    const auto& lhs = ltuple.types;
+    const auto& rhs = rtuple.types;
+
+    if (!rhs.empty() && rhs.back().get_tag() == Type::Tag::TUPLE) {
+        const auto& tup = rhs.back().get_tuple();
+        auto newrhs = std::vector<Type>(rhs.begin(), rhs.end() - 1);
+        newrhs.insert(newrhs.end(), tup.types.begin(), tup.types.end());
+        return is_assignable(ltuple, TupleType{newrhs, tup.is_variadic});
     }
 
     const auto edge = std::min(lhs.size(), rhs.size());
@@ -925,7 +1817,7 @@ inline AssignResult is_assignable(const TupleType& ltuple, const TupleType& rtup
 inline AssignResult is_assignable(const TableType& ltable, const TableType& rtable) {
     for (const auto& lindex : ltable.indexes) {
         for (const auto& rindex : rtable.indexes) {
-            if (is_assignable(rindex.key, lindex.key).yes) {
+            if (can_assign(rindex.key, lindex.key)) {
                 auto r = is_assignable(lindex.val, rindex.val);
                 if (!r.yes) {
                     r.messages.push_back("When checking index `" + to_string(lindex) + "` against `" + to_string(rindex) + "`");
@@ -934,7 +1826,7 @@ inline AssignResult is_assignable(const TableType& ltable, const TableType& rtab
             }
         }
 
-        if (is_assignable(lindex.key, LuaType::STRING).yes) {
+        if (can_assign(lindex.key, LuaType::STRING)) {
             for (const auto& rfield : rtable.fields) {
                 auto r = is_assignable(lindex.val, rfield.type);
                 if (!r.yes) {
@@ -946,21 +1838,15 @@ inline AssignResult is_assignable(const TableType& ltable, const TableType& rtab
     }
 
     for (const auto& lfield : ltable.fields) {
-        bool found = false;
+        auto rfield = find_field(rtable, lfield.name);
 
-        for (const auto& rfield : rtable.fields) {
-            if (lfield.name == rfield.name) {
-                auto r = is_assignable(lfield.type, rfield.type);
-                if (!r.yes) {
-                    r.messages.push_back("At field '" + lfield.name + "`");
-                    return r;
-                }
-                found = true;
-                break;
+        if (rfield) {
+            auto r = is_assignable(lfield.type, rfield->type);
+            if (!r.yes) {
+                r.messages.push_back("At field '" + lfield.name + "`");
+                return r;
             }
-        }
-
-        if (!found) {
+        } else {
             auto r = is_assignable(lfield.type, LuaType::NIL);
             if (!r.yes) {
                 r.messages.push_back("Field '" + lfield.name + "' is missing in right-hand side");
@@ -972,14 +1858,6 @@ inline AssignResult is_assignable(const TableType& ltable, const TableType& rtab
     return true;
 }
 
-inline AssignResult is_assignable(const DeferredType& ldefer, const DeferredType& rdefer) {
-    if (ldefer.collection == rdefer.collection && ldefer.id == rdefer.id) {
-        return true;
-    }
-
-    return is_assignable(reduce_deferred(ldefer, {}), rdefer);
-}
-
 inline AssignResult is_assignable(const LiteralType& lliteral, const LiteralType& rliteral) {
     if (lliteral.underlying_type == rliteral.underlying_type) {
         switch (lliteral.underlying_type) {
@@ -1069,7 +1947,9 @@ inline AssignResult is_assignable(const Type& lhs, const DeferredType& rdefer) {
         case Type::Tag::ANY: return true;
         case Type::Tag::SUM: return is_assignable(lhs.get_sum(), rdefer);
         case Type::Tag::DEFERRED: return is_assignable(lhs.get_deferred(), rdefer);
-        default: return is_assignable(lhs, reduce_deferred(rdefer, {}));
+        default:
+            if (is_being_reduced(rdefer)) return {false, cannot_assign(lhs, rdefer)};
+            return is_assignable(lhs, reduce_deferred(rdefer, {}));
     }
 }
 
@@ -1129,6 +2009,125 @@ inline AssignResult is_assignable(const Type& lhs, const Type& rhs) {
     return r;
 }
 
+// Boolean-only counterpart of `check_param`, with identical inference side effects.
+inline bool can_pass_param(
+    const Type& param,
+    const Type& arg,
+    const std::vector<NameType>& genparams,
+    const std::vector<int>& nominals,
+    std::vector<std::optional<Type>>& genparams_inferred)
+{
+    switch (param.get_tag()) {
+        case Type::Tag::NOMINAL: {
+            auto id = param.get_nominal().defer.id;
+
+            for (auto i = 0u; i < nominals.size(); ++i) {
+                if (nominals[i] == id) {
+                    auto& genparam = genparams[i];
+                    auto& inferred = genparams_inferred[i];
+
+                    if (inferred) {
+                        return can_assign(*inferred, arg);
+                    } else {
+                        auto r = can_pass_param(genparam.type, arg, genparams, nominals, genparams_inferred);
+                        if (r) {
+                            inferred = arg;
+                        }
+                        return r;
+                    }
+                }
+            }
+
+            return can_assign(param, arg);
+        }
+        case Type::Tag::TABLE: {
+            switch (arg.get_tag()) {
+                case Type::Tag::DEFERRED:
+                    return can_pass_param(param, reduce_deferred(arg.get_deferred(), {}), genparams, nominals, genparams_inferred);
+                case Type::Tag::TABLE: {
+                    const auto& table = param.get_table();
+                    const auto& argtable = arg.get_table();
+
+                    for (const auto& index : table.indexes) {
+                        for (const auto& argindex : argtable.indexes) {
+                            if (can_assign(argindex.key, index.key) &&
+                                !can_pass_param(index.val, argindex.val, genparams, nominals, genparams_inferred)) {
+                                return false;
+                            }
+                        }
+                    }
+
+                    for (const auto& field : table.fields) {
+                        auto argfield = find_field(argtable, field.name);
+
+                        if (argfield && !can_pass_param(field.type, argfield->type, genparams, nominals, genparams_inferred)) {
+                            return false;
+                        }
+                    }
+
+                    return true;
+                }
+                case Type::Tag::ANY: {
+                    const auto& table = param.get_table();
+
+                    for (const auto& index : table.indexes) {
+                        if (!can_pass_param(index.val, Type::make_any(), genparams, nominals, genparams_inferred)) {
+                            return false;
+                        }
+                    }
+
+                    for (const auto& field : table.fields) {
+                        if (!can_pass_param(field.type, Type::make_any(), genparams, nominals, genparams_inferred)) {
+                            return false;
+                        }
+                    }
+
+                    return true;
+                }
+                default:
+                    return false;
+            }
+        }
+        case Type::Tag::SUM: {
+            // Without parameters to infer, a sum takes every argument assignable to it, such as a sum of its own members.
+            if (!may_substitute(param, nominals)) {
+                return can_assign(param, arg);
+            }
+
+            if (arg.get_tag() == Type::Tag::SUM) {
+                for (const auto& member : arg.get_sum().types) {
+                    if (!can_pass_param(param, member, genparams, nominals, genparams_inferred)) {
+                        return false;
+                    }
+                }
+
+                return true;
+            }
+
+            for (const auto& type : param.get_sum().types) {
+                if (can_pass_param(type, arg, genparams, nominals, genparams_inferred)) {
+                    return true;
+                }
+            }
+
+            return false;
+        }
+        case Type::Tag::DEFERRED: {
+            const auto& type = reduce_deferred(param.get_deferred(), {});
+
+            return can_pass_param(type, arg, genparams, nominals, genparams_inferred);
+        }
+        default: {
+            if (!may_substitute(param, nominals)) {
+                return can_assign(param, arg);
+            }
+
+            auto reduced_param = apply_genparams(genparams_inferred, nominals, {}, param);
+            return can_assign(reduced_param, arg);
+        }
+    }
+}
+
 inline AssignResult check_param(
     const Type& param,
     const Type& arg,
@@ -1169,7 +2168,7 @@ inline AssignResult check_param(
 
                     for (const auto& index : table.indexes) {
                         for (const auto& argindex : argtable.indexes) {
-                            if (is_assignable(argindex.key, index.key).yes) {
+                            if (can_assign(argindex.key, index.key)) {
                                 auto r = check_param(index.val, argindex.val, genparams, nominals, genparams_inferred);
 
                                 if (!r.yes) {
@@ -1181,14 +2180,14 @@ inline AssignResult check_param(
                     }
 
                     for (const auto& field : table.fields) {
-                        for (const auto& argfield : argtable.fields) {
-                            if (field.name == argfield.name) {
-                                auto r = check_param(field.type, argfield.type, genparams, nominals, genparams_inferred);
+                        auto argfield = find_field(argtable, field.name);
 
-                                if (!r.yes) {
-                                    r.messages.push_back("When checking param table field `" + to_string(field.name) + "`");
-                                    return r;
-                                }
+                        if (argfield) {
+                            auto r = check_param(field.type, argfield->type, genparams, nominals, genparams_inferred);
+
+                            if (!r.yes) {
+                                r.messages.push_back("When checking param table field `" + to_string(field.name) + "`");
+                                return r;
                             }
                         }
                     }
@@ -1224,13 +2223,33 @@ inline AssignResult check_param(
 
         } break;
         case Type::Tag::SUM: {
+            // Without parameters to infer, a sum takes every argument assignable to it, such as a sum of its own members.
+            if (!may_substitute(param, nominals)) {
+                if (can_assign(param, arg)) {
+                    return true;
+                }
+
+                return {false, cannot_assign(param, arg)};
+            }
+
+            if (arg.get_tag() == Type::Tag::SUM) {
+                for (const auto& member : arg.get_sum().types) {
+                    auto r = check_param(param, member, genparams, nominals, genparams_inferred);
+
+                    if (!r.yes) {
+                        r.messages.push_back(cannot_assign(param, arg));
+                        return r;
+                    }
+                }
+
+                return true;
+            }
+
             const auto& sum = param.get_sum();
 
             for (const auto& type : sum.types) {
-                auto r = check_param(type, arg, genparams, nominals, genparams_inferred);
-
-                if (r.yes) {
-                    return r;
+                if (can_pass_param(type, arg, genparams, nominals, genparams_inferred)) {
+                    return true;
                 }
             }
 
@@ -1249,6 +2268,10 @@ inline AssignResult check_param(
             return r;
         } break;
         default: {
+            if (!may_substitute(param, nominals)) {
+                return is_assignable(param, arg);
+            }
+
             auto reduced_param = apply_genparams(genparams_inferred, nominals, {}, param);
             return is_assignable(reduced_param, arg);
         } break;
@@ -0,0 +1,425 @@
+#include "type_identity.hpp"
+
+#include <string>
+#include <utility>
+
+namespace typedlua {
+
+namespace { // static
+
+void hash_combine(std::size_t& seed, std::size_t value) {
+    seed ^= value + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+}
+
+// Structural comparison of the top level of two types, with `same_member` comparing their members.
+template <typename SameMember>
+bool same_members(const std::vector<Type>& lhs, const std::vector<Type>& rhs, const SameMember& same_member) {
+    if (lhs.size() != rhs.size()) {
+        return false;
+    }
+
+    for (auto i = 0u; i < lhs.size(); ++i) {
+        if (!same_member(lhs[i], rhs[i])) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+template <typename SameMember>
+bool same_name_members(const std::vector<NameType>& lhs, const std::vector<NameType>& rhs, const SameMember& same_member) {
+    if (lhs.size() != rhs.size()) {
+        return false;
+    }
+
+    for (auto i = 0u; i < lhs.size(); ++i) {
+        if (lhs[i].name != rhs[i].name || !same_member(lhs[i].type, rhs[i].type)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+template <typename SameMember>
+bool same_ptr_member(const std::shared_ptr<const Type>& lhs, const std::shared_ptr<const Type>& rhs, const SameMember& same_member) {
+    if (lhs == rhs) {
+        return true;
+    }
+
+    if (!lhs || !rhs) {
+        return false;
+    }
+
+    return same_member(*lhs, *rhs);
+}
+
+template <typename SameMember>
+bool same_deferred_with(const DeferredType& lhs, const DeferredType& rhs, const SameMember& same_member) {
+    if (lhs.collection != rhs.collection || lhs.id != rhs.id || lhs.args.size() != rhs.args.size()) {
+        return false;
+    }
+
+    for (auto i = 0u; i < lhs.args.size(); ++i) {
+        const auto& larg = lhs.args[i];
+        const auto& rarg = rhs.args[i];
+
+        if (larg.has_value() != rarg.has_value()) {
+            return false;
+        }
+
+        if (larg && !same_member(*larg, *rarg)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+template <typename SameMember>
+bool same_node(const Type& lhs, const Type& rhs, const SameMember& same_member) {
+    if (lhs.get_tag() != rhs.get_tag()) {
+        return false;
+    }
+
+    switch (lhs.get_tag()) {
+        case Type::Tag::VOID:
+        case Type::Tag::ANY:
+            return true;
+        case Type::Tag::LUATYPE:
+            return lhs.get_luatype() == rhs.get_luatype();
+        case Type::Tag::FUNCTION: {
+            const auto& lfunc = lhs.get_function();
+            const auto& rfunc = rhs.get_function();
+            return lfunc.variadic == rfunc.variadic &&
+                lfunc.nominals == rfunc.nominals &&
+                same_name_members(lfunc.genparams, rfunc.genparams, same_member) &&
+                same_members(lfunc.params, rfunc.params, same_member) &&
+                same_ptr_member(lfunc.ret, rfunc.ret, same_member);
+        }
+        case Type::Tag::TUPLE: {
+            const auto& ltuple = lhs.get_tuple();
+            const auto& rtuple = rhs.get_tuple();
+            return ltuple.is_variadic == rtuple.is_variadic && same_members(ltuple.types, rtuple.types, same_member);
+        }
+        case Type::Tag::SUM:
+            return same_members(lhs.get_sum().types, rhs.get_sum().types, same_member);
+        case Type::Tag::PRODUCT:
+            return same_members(lhs.get_product().types, rhs.get_product().types, same_member);
+        case Type::Tag::TABLE: {
+            const auto& ltable = lhs.get_table();
+            const auto& rtable = rhs.get_table();
+
+            if (ltable.indexes.size() != rtable.indexes.size()) {
+                return false;
+            }
+
+            for (auto i = 0u; i < ltable.indexes.size(); ++i) {
+                const auto& lindex = ltable.indexes[i];
+                const auto& rindex = rtable.indexes[i];
+                if (!same_member(lindex.key, rindex.key) || !same_member(lindex.val, rindex.val)) {
+                    return false;
+                }
+            }
+
+            return same_name_members(ltable.fields, rtable.fields, same_member);
+        }
+        case Type::Tag::DEFERRED:
+            return same_deferred_with(lhs.get_deferred(), rhs.get_deferred(), same_member);
+        case Type::Tag::LITERAL:
+            return same_literal(lhs.get_literal(), rhs.get_literal());
+        case Type::Tag::NOMINAL:
+            return same_deferred_with(lhs.get_nominal().defer, rhs.get_nominal().defer, same_member);
+        case Type::Tag::REQUIRE:
+            return same_ptr_member(lhs.get_require().basis, rhs.get_require().basis, same_member);
+        default:
+            throw std::logic_error("Type tag not supported by same_type");
+    }
+}
+
+template <typename HashMember>
+std::size_t hash_deferred_with(const DeferredType& defer, const HashMember& hash_member) {
+    auto seed = std::hash<const void*>{}(defer.collection);
+    hash_combine(seed, std::hash<int>{}(defer.id));
+    for (const auto& arg : defer.args) {
+        hash_combine(seed, arg ? hash_member(*arg) : 0);
+    }
+    return seed;
+}
+
+// Hash of the top level of a type, with `hash_member` hashing its members.
+template <typename HashMember>
+std::size_t hash_node(const Type& type, const HashMember& hash_member) {
+    auto seed = static_cast<std::size_t>(type.get_tag());
+
+    switch (type.get_tag()) {
+        case Type::Tag::VOID:
+        case Type::Tag::ANY:
+            break;
+        case Type::Tag::LUATYPE:
+            hash_combine(seed, static_cast<std::size_t>(type.get_luatype()));
+            break;
+        case Type::Tag::FUNCTION: {
+            const auto& func = type.get_function();
+            hash_combine(seed, func.variadic);
+            for (const auto& genparam : func.genparams) {
+                hash_combine(seed, std::hash<std::string>{}(genparam.name));
+                hash_combine(seed, hash_member(genparam.type));
+            }
+            for (auto nominal : func.nominals) {
+                hash_combine(seed, std::hash<int>{}(nominal));
+            }
+            for (const auto& param : func.params) {
+                hash_combine(seed, hash_member(param));
+            }
+            hash_combine(seed, func.ret ? hash_member(*func.ret) : 0);
+            break;
+        }
+        case Type::Tag::TUPLE: {
+            const auto& tuple = type.get_tuple();
+            hash_combine(seed, tuple.is_variadic);
+            for (const auto& elem : tuple.types) {
+                hash_combine(seed, hash_member(elem));
+            }
+            break;
+        }
+        case Type::Tag::SUM:
+            for (const auto& elem : type.get_sum().types) {
+                hash_combine(seed, hash_member(elem));
+            }
+            break;
+        case Type::Tag::PRODUCT:
+            for (const auto& elem : type.get_product().types) {
+                hash_combine(seed, hash_member(elem));
+            }
+            break;
+        case Type::Tag::TABLE: {
+            const auto& table = type.get_table();
+            for (const auto& index : table.indexes) {
+                hash_combine(seed, hash_member(index.key));
+                hash_combine(seed, hash_member(index.val));
+            }
+            for (const auto& field : table.fields) {
+                hash_combine(seed, std::hash<std::string>{}(field.name));
+                hash_combine(seed, hash_member(field.type));
+            }
+            break;
+        }
+        case Type::Tag::DEFERRED:
+            hash_combine(seed, hash_deferred_with(type.get_deferred(), hash_member));
+            break;
+        case Type::Tag::LITERAL:
+            hash_combine(seed, hash_literal(type.get_literal()));
+            break;
+        case Type::Tag::NOMINAL:
+            hash_combine(seed, hash_deferred_with(type.get_nominal().defer, hash_member));
+            break;
+        case Type::Tag::REQUIRE: {
+            const auto& require = type.get_require();
+            hash_combine(seed, require.basis ? hash_member(*require.basis) : 0);
+            break;
+        }
+        default:
+            throw std::logic_error("Type tag not supported by hash_type");
+    }
+
+    return seed;
+}
+
+// Members of interned types are interned, so they are the same exactly when they share their representation.
+bool same_id(const Type& lhs, const Type& rhs) {
+    return lhs.get_id() == rhs.get_id();
+}
+
+std::size_t hash_id(const Type& type) {
+    return std::hash<TypeId>{}(type.get_id());
+}
+
+thread_local TypeStore* current_store = nullptr;
+
+} // static
+
+bool same_literal(const LiteralType& lhs, const LiteralType& rhs) {
+    if (lhs.underlying_type != rhs.underlying_type) {
+        return false;
+    }
+
+    switch (lhs.underlying_type) {
+        case LuaType::BOOLEAN: return lhs.boolean == rhs.boolean;
+        case LuaType::NUMBER: return lhs.number == rhs.number;
+        case LuaType::STRING: return lhs.string == rhs.string;
+        default: return true;
+    }
+}
+
+std::size_t hash_literal(const LiteralType& literal) {
+    auto seed = static_cast<std::size_t>(literal.underlying_type);
+    switch (literal.underlying_type) {
+        case LuaType::BOOLEAN:
+            hash_combine(seed, std::hash<bool>{}(literal.boolean));
+            break;
+        case LuaType::NUMBER:
+            if (literal.number.is_integer) {
+                hash_combine(seed, std::hash<std::int64_t>{}(literal.number.integer));
+            } else {
+                // 0.0 and -0.0 compare equal, so they must hash equal.
+                hash_combine(seed, literal.number.floating == 0 ? 0 : std::hash<double>{}(literal.number.floating));
+            }
+            break;
+        case LuaType::STRING:
+            hash_combine(seed, std::hash<std::string>{}(literal.string));
+            break;
+        default:
+            break;
+    }
+    return seed;
+}
+
+bool same_deferred(const DeferredType& lhs, const DeferredType& rhs) {
+    return same_deferred_with(lhs, rhs, same_type);
+}
+
+std::size_t hash_deferred(const DeferredType& defer) {
+    return hash_deferred_with(defer, hash_type);
+}
+
+bool same_type(const Type& lhs, const Type& rhs) {
+    // Copies, and types interned by the same store, share their representation.
+    if (lhs.get_id() == rhs.get_id()) {
+        return true;
+    }
+
+    return same_node(lhs, rhs, same_type);
+}
+
+std::size_t hash_type(const Type& type) {
+    return hash_node(type, hash_type);
+}
+
+TypeStore::TypeStore() : previous(std::exchange(current_store, this)) {}
+
+TypeStore::~TypeStore() {
+    current_store = previous;
+}
+
+TypeStore* TypeStore::current() {
+    return current_store;
+}
+
+Type TypeStore::intern(const Type& type) {
+    if (type.get_tag() == Type::Tag::VOID || ids.count(type.get_id())) {
+        return type;
+    }
+
+    auto [iter, inserted] = types.insert(intern_members(type));
+
+    if (inserted) {
+        ids.insert(iter->get_id());
+    }
+
+    return *iter;
+}
+
+Type TypeStore::intern_members(const Type& type) {
+    auto result = type;
+
+    // Only copies the representation once a member turns out not to be interned yet.
+    auto update = [&](const Type& member, auto&& slot) {
+        auto interned = intern(member);
+
+        if (interned.get_id() != member.get_id()) {
+            slot(result.edit().types) = std::move(interned);
+        }
+    };
+
+    auto update_ptr = [&](const std::shared_ptr<const Type>& member, auto&& slot) {
+        if (!member) {
+            return;
+        }
+
+        auto interned = intern(*member);
+
+        if (interned.get_id() != member->get_id()) {
+            slot(result.edit().types) = std::make_shared<const Type>(std::move(interned));
+        }
+    };
+
+    switch (type.get_tag()) {
+        case Type::Tag::FUNCTION: {
+            const auto& func = type.get_function();
+            for (auto i = 0u; i < func.genparams.size(); ++i) {
+                update(func.genparams[i].type, [i](Type::Types& t) -> Type& { return std::get<FunctionType>(t).genparams[i].type; });
+            }
+            for (auto i = 0u; i < func.params.size(); ++i) {
+                update(func.params[i], [i](Type::Types& t) -> Type& { return std::get<FunctionType>(t).params[i]; });
+            }
+            update_ptr(func.ret, [](Type::Types& t) -> std::shared_ptr<const Type>& { return std::get<FunctionType>(t).ret; });
+            break;
+        }
+        case Type::Tag::TUPLE: {
+            const auto& members = type.get_tuple().types;
+            for (auto i = 0u; i < members.size(); ++i) {
+                update(members[i], [i](Type::Types& t) -> Type& { return std::get<TupleType>(t).types[i]; });
+            }
+            break;
+        }
+        case Type::Tag::SUM: {
+            const auto& members = type.get_sum().types;
+            for (auto i = 0u; i < members.size(); ++i) {
+                update(members[i], [i](Type::Types& t) -> Type& { return std::get<SumType>(t).types[i]; });
+            }
+            break;
+        }
+        case Type::Tag::PRODUCT: {
+            const auto& members = type.get_product().types;
+            for (auto i = 0u; i < members.size(); ++i) {
+                update(members[i], [i](Type::Types& t) -> Type& { return std::get<ProductType>(t).types[i]; });
+            }
+            break;
+        }
+        case Type::Tag::TABLE: {
+            const auto& table = type.get_table();
+            for (auto i = 0u; i < table.indexes.size(); ++i) {
+                update(table.indexes[i].key, [i](Type::Types& t) -> Type& { return std::get<TableType>(t).indexes[i].key; });
+                update(table.indexes[i].val, [i](Type::Types& t) -> Type& { return std::get<TableType>(t).indexes[i].val; });
+            }
+            for (auto i = 0u; i < table.fields.size(); ++i) {
+                update(table.fields[i].type, [i](Type::Types& t) -> Type& { return std::get<TableType>(t).fields[i].type; });
+            }
+            break;
+        }
+        case Type::Tag::DEFERRED: {
+            const auto& args = type.get_deferred().args;
+            for (auto i = 0u; i < args.size(); ++i) {
+                if (args[i]) {
+                    update(*args[i], [i](Type::Types& t) -> Type& { return *std::get<DeferredType>(t).args[i]; });
+                }
+            }
+            break;
+        }
+        case Type::Tag::REQUIRE:
+            update_ptr(type.get_require().basis, [](Type::Types& t) -> std::shared_ptr<const Type>& { return std::get<RequireType>(t).basis; });
+            break;
+        default:
+            break;
+    }
+
+    // Members are only replaced by identical ones, so the summary and the indexes by position still hold.
+    return result;
+}
+
+std::size_t TypeStore::NodeHash::operator()(const Type& type) const {
+    return hash_node(type, hash_id);
+}
+
+bool TypeStore::NodeEqual::operator()(const Type& lhs, const Type& rhs) const {
+    return same_node(lhs, rhs, same_id);
+}
+
+Type intern(const Type& type) {
+    auto store = TypeStore::current();
+    return store ? store->intern(type) : type;
+}
+
+} // namespace typedlua
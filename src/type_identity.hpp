@@ -0,0 +1,56 @@
+#pragma once
+
+#include "type.hpp"
+
+#include <cstddef>
+#include <unordered_set>
+
+namespace typedlua {
+
+// Structural identity, not assignability: `number|string` and `string|number` are different types here.
+bool same_type(const Type& lhs, const Type& rhs);
+
+std::size_t hash_type(const Type& type);
+
+bool same_deferred(const DeferredType& lhs, const DeferredType& rhs);
+
+std::size_t hash_deferred(const DeferredType& defer);
+
+// Hash-consed types of one check session, so that identical types share one representation.
+// Members are interned before the types that contain them, so interned types are identical exactly when their ids are,
+// and finding one only hashes and compares its top level.
+// While constructed, it is the current store of its thread. Interned types live as long as the store.
+class TypeStore {
+public:
+    TypeStore();
+    TypeStore(const TypeStore&) = delete;
+    TypeStore& operator=(const TypeStore&) = delete;
+    ~TypeStore();
+
+    static TypeStore* current();
+
+    // The interned type identical to `type`, which is interned if there is none yet.
+    Type intern(const Type& type);
+
+    std::size_t size() const { return types.size(); }
+
+private:
+    Type intern_members(const Type& type);
+
+    struct NodeHash {
+        std::size_t operator()(const Type& type) const;
+    };
+
+    struct NodeEqual {
+        bool operator()(const Type& lhs, const Type& rhs) const;
+    };
+
+    std::unordered_set<Type, NodeHash, NodeEqual> types;
+    std::unordered_set<TypeId> ids;
+    TypeStore* previous;
+};
+
+// Interns `type` in the current store, or returns it as it is outside of a check session.
+Type intern(const Type& type);
+
+} // namespace typedlua
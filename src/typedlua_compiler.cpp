@@ -1,50 +1,139 @@
 #include "typedlua_compiler.hpp"
 
+#include "assign_cache.hpp"
+#include "descent_parser.hpp"
 #include "parser.hpp"
-#include "lexer.hpp"
 #include "node.hpp"
+#include "scanner.hpp"
+#include "type_identity.hpp"
+
+#ifdef TYPEDLUA_FLEX_LEXER
+#include "lexer.hpp"
+#endif
 
-#include <sstream>
+#include <cstdio>
+#include <stdexcept>
 
 namespace typedlua {
 
-std::tuple<std::unique_ptr<ast::Node>, std::vector<CompileError>> parse(std::string_view source) {
-    yyscan_t scanner;
+namespace { // static
 
-    typedlualex_init(&scanner);
-    
-    auto buffer = typedlua_scan_bytes(source.data(), source.length(), scanner);
-    
-    typedluaset_lineno(1, scanner);
-    
-    auto root = std::unique_ptr<ast::Node>{};
+std::tuple<std::unique_ptr<ast::Tree>, std::vector<CompileError>> parse_tokens(void* scanner) {
+    auto tree = std::make_unique<ast::Tree>();
 
     auto errors = std::vector<CompileError>{};
 
-    if (typedluaparse(scanner, root, errors) != 0) {
-        root = nullptr;
+    if (typedluaparse(scanner, *tree, errors) != 0) {
+        tree = nullptr;
     }
 
+    return {std::move(tree), std::move(errors)};
+}
+
+// Same report as lexer.l.
+void report_unknown_token(const Scanner& scanner) {
+    if (auto unknown = scanner.unknown_token()) {
+        std::printf("Unknown token: `%.1s`\n", unknown);
+    }
+}
+
+#ifdef TYPEDLUA_FLEX_LEXER
+
+std::tuple<std::unique_ptr<ast::Tree>, std::vector<CompileError>> parse_buffer(yyscan_t scanner, YY_BUFFER_STATE buffer) {
+    typedluaset_lineno(1, scanner);
+
+    auto result = parse_tokens(scanner);
+
     typedlua_delete_buffer(buffer, scanner);
     typedlualex_destroy(scanner);
 
-    return {std::move(root), std::move(errors)};
+    return result;
 }
 
-std::vector<CompileError> check(const ast::Node& root, Scope& scope) {
+#endif
+
+// `buffer` is null, or `source` padded as for `parse_in_place` so that flex can scan it there.
+std::tuple<std::unique_ptr<ast::Tree>, std::vector<CompileError>> parse_bison(std::string_view source, char* buffer) {
+#ifdef TYPEDLUA_FLEX_LEXER
+    yyscan_t scanner;
+
+    typedlualex_init(&scanner);
+
+    auto state = buffer
+        ? typedlua_scan_buffer(buffer, source.size() + 2, scanner)
+        : typedlua_scan_bytes(source.data(), source.length(), scanner);
+
+    return parse_buffer(scanner, state);
+#else
+    // The hand-written scanner reads `source` where it is, so it has no use for the padding.
+    (void)buffer;
+
+    auto scanner = Scanner(source);
+
+    auto result = parse_tokens(&scanner);
+
+    report_unknown_token(scanner);
+
+    return result;
+#endif
+}
+
+std::tuple<std::unique_ptr<ast::Tree>, std::vector<CompileError>> parse_source(std::string_view source, char* buffer, ParserKind parser) {
+    if (parser == ParserKind::DESCENT) {
+        auto scanner = Scanner(source);
+
+        if (auto tree = parse_descent(scanner)) {
+            report_unknown_token(scanner);
+
+            return {std::move(tree), std::vector<CompileError>{}};
+        }
+
+        // A syntax error, which the Bison parser finds again and reports.
+    }
+
+    return parse_bison(source, buffer);
+}
+
+} // static
+
+std::tuple<std::unique_ptr<ast::Tree>, std::vector<CompileError>> parse(std::string_view source, ParserKind parser) {
+    return parse_source(source, nullptr, parser);
+}
+
+std::tuple<std::unique_ptr<ast::Tree>, std::vector<CompileError>> parse_in_place(char* buffer, std::size_t size, ParserKind parser) {
+    if (size < 2 || buffer[size - 2] != '\0' || buffer[size - 1] != '\0') {
+        throw std::logic_error("parse_in_place: buffer must end with two null bytes");
+    }
+
+    return parse_source(std::string_view(buffer, size - 2), buffer, parser);
+}
+
+std::vector<CompileError> check(const ast::Tree& tree, Scope& scope) {
     auto errors = std::vector<CompileError>{};
 
-    root.check(scope, errors);
+    auto assign_cache = AssignCache{};
+    auto type_store = TypeStore{};
+    auto annotations = ast::Annotations(tree);
+
+    tree.check(scope, annotations, errors);
 
     return errors;
 }
 
-std::string compile(const ast::Node& root) {
-    auto oss = std::ostringstream{};
+void compile(const ast::Tree& tree, Sink& out) {
+    tree.dump(out);
+    out << "\n";
+}
 
-    oss << root << std::endl;
+std::string compile(const ast::Tree& tree) {
+    auto lua = std::string{};
+
+    {
+        auto out = Sink::to_string(lua);
+        compile(tree, out);
+    }
 
-    return oss.str();
+    return lua;
 }
 
 } // namespace typedlua
@@ -3,7 +3,10 @@
 #include "compile_error.hpp"
 #include "scope.hpp"
 #include "node.hpp"
+#include "sink.hpp"
 
+#include <cstddef>
+#include <memory>
 #include <string>
 #include <string_view>
 #include <tuple>
@@ -11,10 +14,29 @@
 
 namespace typedlua {
 
-std::tuple<std::unique_ptr<ast::Node>, std::vector<CompileError>> parse(std::string_view source);
+// Both build the same tree and report the same errors.
+enum class ParserKind {
+    // The recursive-descent parser in descent_parser.hpp, which leaves diagnostics to the Bison one.
+    DESCENT,
+    // The LALR parser generated from parser.y.
+    BISON
+};
 
-std::vector<CompileError> check(const ast::Node& root, Scope& scope);
+std::tuple<std::unique_ptr<ast::Tree>, std::vector<CompileError>> parse(std::string_view source, ParserKind parser = ParserKind::DESCENT);
 
-std::string compile(const ast::Node& root);
+// Scans `buffer` where it is instead of copying it. The last two of its `size` bytes must be null and are not part of the source.
+// The flex scanner writes into the buffer while parsing, so it must not be read concurrently.
+std::tuple<std::unique_ptr<ast::Tree>, std::vector<CompileError>> parse_in_place(
+    char* buffer,
+    std::size_t size,
+    ParserKind parser = ParserKind::DESCENT);
+
+// Leaves `tree` as it was, so it can be checked again against another scope, also concurrently.
+std::vector<CompileError> check(const ast::Tree& tree, Scope& scope);
+
+// Writes the Lua for `tree` to `out`, ending with a newline. The tail stays buffered until `out` is flushed or destroyed.
+void compile(const ast::Tree& tree, Sink& out);
+
+std::string compile(const ast::Tree& tree);
 
 } // namespace typedlua
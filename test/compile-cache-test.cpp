@@ -0,0 +1,129 @@
+#include "compile_cache.hpp"
+#include "libs.hpp"
+#include "serialize.hpp"
+
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+
+// Damaged cache entries must read as misses, never abort the compiler.
+
+namespace fs = std::filesystem;
+
+namespace {
+
+int failures = 0;
+
+void expect(bool condition, const std::string& what) {
+    if (!condition) {
+        std::cerr << "FAILED: " << what << "\n";
+        ++failures;
+    }
+}
+
+template <typename F>
+bool throws_runtime_error(F&& f) {
+    try {
+        f();
+    } catch (const std::runtime_error&) {
+        return true;
+    }
+    return false;
+}
+
+void write_file(const fs::path& path, const std::string& data) {
+    auto file = std::ofstream(path, std::ios::binary | std::ios::trunc);
+    file << data;
+}
+
+} // static
+
+int main(int argc, char* argv[]) {
+    {
+        auto in = std::string(11, '\xff') + '\x01';
+        auto pos = std::size_t{0};
+        expect(throws_runtime_error([&] { typedlua::deserialize_uint(in, pos); }), "overlong integer is rejected");
+    }
+
+    {
+        auto in = std::string{};
+        typedlua::serialize_uint(in, std::uint64_t{1} << 60);
+        auto pos = std::size_t{0};
+        expect(throws_runtime_error([&] { typedlua::deserialize_count(in, pos); }), "count past the end is rejected");
+    }
+
+    const auto directory = fs::path(argc > 1 ? argv[1] : "compile-cache-test");
+    fs::remove_all(directory);
+
+    const auto source = std::string("local t = { x = 1, 'a', { y = true } }\nreturn t\n");
+    const auto cache = typedlua::CompileCache(directory);
+
+    {
+        auto deferred = typedlua::DeferredTypeCollection{};
+        auto scope = typedlua::Scope(&typedlua::libs::prelude(), &deferred);
+        auto module = typedlua::compile_module(source, scope, &cache);
+        expect(module.errors.empty(), "source compiles");
+    }
+
+    auto entry = fs::path{};
+    for (const auto& file : fs::directory_iterator(directory)) {
+        entry = file.path();
+    }
+    expect(!entry.empty(), "entry is stored");
+
+    auto original = std::string{};
+    {
+        auto file = std::ifstream(entry, std::ios::binary);
+        original.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+
+    // Every prefix of the entry, alone or followed by a huge count or an integer that never ends.
+    // Truncated entries are misses. The others may still decode by chance, but must not throw.
+    auto huge_count = std::string{};
+    typedlua::serialize_uint(huge_count, std::uint64_t{1} << 60);
+
+    for (const auto& tail : {std::string{}, huge_count, std::string(16, '\xff')}) {
+        for (auto size = std::size_t{0}; size < original.size(); ++size) {
+            write_file(entry, original.substr(0, size) + tail);
+
+            auto deferred = typedlua::DeferredTypeCollection{};
+            auto scope = typedlua::Scope(&typedlua::libs::prelude(), &deferred);
+            const auto what = "entry cut at " + std::to_string(size) + " with a " + std::to_string(tail.size()) + " byte tail";
+
+            try {
+                auto module = cache.load(source, scope);
+                expect(!tail.empty() || !module, what + " is a miss");
+            } catch (const std::exception& e) {
+                expect(false, what + " throws " + e.what());
+            }
+        }
+    }
+
+    {
+        auto deferred = typedlua::DeferredTypeCollection{};
+        auto scope = typedlua::Scope(&typedlua::libs::prelude(), &deferred);
+        auto module = typedlua::compile_module(source, scope, &cache);
+        expect(module.errors.empty() && !module.lua.empty(), "damaged entry is compiled again");
+    }
+
+    fs::remove_all(directory);
+
+    // A module that throws while it is checked still closes its generation, which frees its entries.
+    {
+        auto deferred = typedlua::DeferredTypeCollection{};
+        auto scope = typedlua::Scope(&typedlua::libs::prelude(), &deferred);
+        scope.set_get_package_type([](const std::string& name) -> typedlua::Type {
+            throw std::runtime_error("Failed to get type of $require(" + name + ")");
+        });
+
+        const auto size = deferred.size();
+        expect(throws_runtime_error([&] { typedlua::compile_module("interface List: { next: List }\nreturn require('missing')\n", scope, nullptr); }), "failing require throws");
+        expect(deferred.size() == size, "entries of the failed module are freed");
+    }
+
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,349 @@
+local levels = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40, 41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, 52, 53, 54, 55, 56, 57, 58, 59, 60, 61, 62, 63, 64, 65, 66, 67, 68, 69, 70 }
+
+local ok: { [number]: number }
+local bad: { [number]: string }
+
+ok = levels
+bad = levels
+
+local units = {
+    { id = 1, name = 'unit1' },
+    { id = 2, name = 'unit2' },
+    { id = 3, name = 'unit3' },
+    { id = 4, name = 'unit4' },
+    { id = 5, name = 'unit5' },
+    { id = 6, name = 'unit6' },
+    { id = 7, name = 'unit7' },
+    { id = 8, name = 'unit8' },
+    { id = 9, name = 'unit9' },
+    { id = 10, name = 'unit10' },
+    { id = 11, name = 'unit11' },
+    { id = 12, name = 'unit12' },
+    { id = 13, name = 'unit13' },
+    { id = 14, name = 'unit14' },
+    { id = 15, name = 'unit15' },
+    { id = 16, name = 'unit16' },
+    { id = 17, name = 'unit17' },
+    { id = 18, name = 'unit18' },
+    { id = 19, name = 'unit19' },
+    { id = 20, name = 'unit20' },
+    { id = 21, name = 'unit21' },
+    { id = 22, name = 'unit22' },
+    { id = 23, name = 'unit23' },
+    { id = 24, name = 'unit24' },
+    { id = 25, name = 'unit25' },
+    { id = 26, name = 'unit26' },
+    { id = 27, name = 'unit27' },
+    { id = 28, name = 'unit28' },
+    { id = 29, name = 'unit29' },
+    { id = 30, name = 'unit30' },
+    { id = 31, name = 'unit31' },
+    { id = 32, name = 'unit32' },
+    { id = 33, name = 'unit33' },
+    { id = 34, name = 'unit34' },
+    { id = 35, name = 'unit35' },
+    { id = 36, name = 'unit36' },
+    { id = 37, name = 'unit37' },
+    { id = 38, name = 'unit38' },
+    { id = 39, name = 'unit39' },
+    { id = 40, name = 'unit40' },
+    { id = 41, name = 'unit41' },
+    { id = 42, name = 'unit42' },
+    { id = 43, name = 'unit43' },
+    { id = 44, name = 'unit44' },
+    { id = 45, name = 'unit45' },
+    { id = 46, name = 'unit46' },
+    { id = 47, name = 'unit47' },
+    { id = 48, name = 'unit48' },
+    { id = 49, name = 'unit49' },
+    { id = 50, name = 'unit50' },
+    { id = 51, name = 'unit51' },
+    { id = 52, name = 'unit52' },
+    { id = 53, name = 'unit53' },
+    { id = 54, name = 'unit54' },
+    { id = 55, name = 'unit55' },
+    { id = 56, name = 'unit56' },
+    { id = 57, name = 'unit57' },
+    { id = 58, name = 'unit58' },
+    { id = 59, name = 'unit59' },
+    { id = 60, name = 'unit60' },
+    { id = 61, name = 'unit61' },
+    { id = 62, name = 'unit62' },
+    { id = 63, name = 'unit63' },
+    { id = 64, name = 'unit64' },
+    { id = 65, name = 'unit65' },
+    { id = 66, name = 'unit66' },
+    { id = 67, name = 'unit67' },
+    { id = 68, name = 'unit68' },
+    { id = 69, name = 'unit69' },
+    { id = 70, name = 'unit70' }
+}
+
+local named: { [number]: { id: number; name: string } }
+
+named = units
+
+local dice: { [number]: 1|2 }
+
+dice = { 2, 1, 1, 2, 1, 1, 2, 1, 1, 2, 1, 1, 2, 1, 1, 2, 1, 1, 2, 1, 1, 2, 1, 1, 2, 1, 1, 2, 1, 1, 2, 1, 1, 2, 1, 1, 2, 1, 1, 2, 1, 1, 2, 1, 1, 2, 1, 1, 2, 1, 1, 2, 1, 1, 2, 1, 1, 2, 1, 1, 2, 1, 1, 2, 1, 1, 2, 1, 1, 2, 1, 1, 2, 1, 1, 2, 1, 1, 2, 1, 1, 2, 1, 1, 2, 1, 1, 2, 1, 1, 2, 1, 1, 2, 1, 1, 2, 1, 1, 2 }
+
+interface Unit: { id: number; kind: 'melee'|'ranged' }
+
+local roster: { [number]: Unit }
+
+roster = {
+    { id = 1, kind = 'melee' },
+    { id = 2, kind = 'ranged' },
+    { id = 3, kind = 'melee' },
+    { id = 4, kind = 'ranged' },
+    { id = 5, kind = 'melee' },
+    { id = 6, kind = 'ranged' },
+    { id = 7, kind = 'melee' },
+    { id = 8, kind = 'ranged' },
+    { id = 9, kind = 'melee' },
+    { id = 10, kind = 'ranged' },
+    { id = 11, kind = 'melee' },
+    { id = 12, kind = 'ranged' },
+    { id = 13, kind = 'melee' },
+    { id = 14, kind = 'ranged' },
+    { id = 15, kind = 'melee' },
+    { id = 16, kind = 'ranged' },
+    { id = 17, kind = 'melee' },
+    { id = 18, kind = 'ranged' },
+    { id = 19, kind = 'melee' },
+    { id = 20, kind = 'ranged' },
+    { id = 21, kind = 'melee' },
+    { id = 22, kind = 'ranged' },
+    { id = 23, kind = 'melee' },
+    { id = 24, kind = 'ranged' },
+    { id = 25, kind = 'melee' },
+    { id = 26, kind = 'ranged' },
+    { id = 27, kind = 'melee' },
+    { id = 28, kind = 'ranged' },
+    { id = 29, kind = 'melee' },
+    { id = 30, kind = 'ranged' },
+    { id = 31, kind = 'melee' },
+    { id = 32, kind = 'ranged' },
+    { id = 33, kind = 'melee' },
+    { id = 34, kind = 'ranged' },
+    { id = 35, kind = 'melee' },
+    { id = 36, kind = 'ranged' },
+    { id = 37, kind = 'melee' },
+    { id = 38, kind = 'ranged' },
+    { id = 39, kind = 'melee' },
+    { id = 40, kind = 'ranged' },
+    { id = 41, kind = 'melee' },
+    { id = 42, kind = 'ranged' },
+    { id = 43, kind = 'melee' },
+    { id = 44, kind = 'ranged' },
+    { id = 45, kind = 'melee' },
+    { id = 46, kind = 'ranged' },
+    { id = 47, kind = 'melee' },
+    { id = 48, kind = 'ranged' },
+    { id = 49, kind = 'melee' },
+    { id = 50, kind = 'ranged' },
+    { id = 51, kind = 'melee' },
+    { id = 52, kind = 'ranged' },
+    { id = 53, kind = 'melee' },
+    { id = 54, kind = 'ranged' },
+    { id = 55, kind = 'melee' },
+    { id = 56, kind = 'ranged' },
+    { id = 57, kind = 'melee' },
+    { id = 58, kind = 'ranged' },
+    { id = 59, kind = 'melee' },
+    { id = 60, kind = 'ranged' },
+    { id = 61, kind = 'melee' },
+    { id = 62, kind = 'ranged' },
+    { id = 63, kind = 'melee' },
+    { id = 64, kind = 'ranged' },
+    { id = 65, kind = 'melee' },
+    { id = 66, kind = 'ranged' },
+    { id = 67, kind = 'melee' },
+    { id = 68, kind = 'ranged' },
+    { id = 69, kind = 'melee' },
+    { id = 70, kind = 'ranged' }
+}
+
+local points = {
+    { x = 1, y = 2 },
+    { x = 2, y = 4 },
+    { x = 3, y = 6 },
+    { x = 4, y = 8 },
+    { x = 5, y = 10 },
+    { x = 6, y = 12 },
+    { x = 7, y = 14 },
+    { x = 8, y = 16 },
+    { x = 9, y = 18 },
+    { x = 10, y = 20 },
+    { x = 11, y = 22 },
+    { x = 12, y = 24 },
+    { x = 13, y = 26 },
+    { x = 14, y = 28 },
+    { x = 15, y = 30 },
+    { x = 16, y = 32 },
+    { x = 17, y = 34 },
+    { x = 18, y = 36 },
+    { x = 19, y = 38 },
+    { x = 20, y = 40 },
+    { x = 21, y = 42 },
+    { x = 22, y = 44 },
+    { x = 23, y = 46 },
+    { x = 24, y = 48 },
+    { x = 25, y = 50 },
+    { x = 26, y = 52 },
+    { x = 27, y = 54 },
+    { x = 28, y = 56 },
+    { x = 29, y = 58 },
+    { x = 30, y = 60 },
+    { x = 31, y = 62 },
+    { x = 32, y = 64 },
+    { x = 33, y = 66 },
+    { x = 34, y = 68 },
+    { x = 35, y = 70 },
+    { x = 36, y = 72 },
+    { x = 37, y = 74 },
+    { x = 38, y = 76 },
+    { x = 39, y = 78 },
+    { x = 40, y = 80 },
+    { x = 41, y = 82 },
+    { x = 42, y = 84 },
+    { x = 43, y = 86 },
+    { x = 44, y = 88 },
+    { x = 45, y = 90 },
+    { x = 46, y = 92 },
+    { x = 47, y = 94 },
+    { x = 48, y = 96 },
+    { x = 49, y = 98 },
+    { x = 50, y = 100 },
+    { x = 51, y = 102 },
+    { x = 52, y = 104 },
+    { x = 53, y = 106 },
+    { x = 54, y = 108 },
+    { x = 55, y = 110 },
+    { x = 56, y = 112 },
+    { x = 57, y = 114 },
+    { x = 58, y = 116 },
+    { x = 59, y = 118 },
+    { x = 60, y = 120 },
+    { x = 61, y = 122 },
+    { x = 62, y = 124 },
+    { x = 63, y = 126 },
+    { x = 64, y = 128 },
+    { x = 65, y = 130 },
+    { x = 66, y = 132 },
+    { x = 67, y = 134 },
+    { x = 68, y = 136 },
+    { x = 69, y = 138 },
+    { x = 70, y = 140 },
+    { x = 71, y = 142 },
+    { x = 72, y = 144 },
+    { x = 73, y = 146 },
+    { x = 74, y = 148 },
+    { x = 75, y = 150 },
+    { x = 76, y = 152 },
+    { x = 77, y = 154 },
+    { x = 78, y = 156 },
+    { x = 79, y = 158 },
+    { x = 80, y = 160 },
+    { x = 81, y = 162 },
+    { x = 82, y = 164 },
+    { x = 83, y = 166 },
+    { x = 84, y = 168 },
+    { x = 85, y = 170 },
+    { x = 86, y = 172 },
+    { x = 87, y = 174 },
+    { x = 88, y = 176 },
+    { x = 89, y = 178 },
+    { x = 90, y = 180 },
+    { x = 91, y = 182 },
+    { x = 92, y = 184 },
+    { x = 93, y = 186 },
+    { x = 94, y = 188 },
+    { x = 95, y = 190 },
+    { x = 96, y = 192 },
+    { x = 97, y = 194 },
+    { x = 98, y = 196 },
+    { x = 99, y = 198 },
+    { x = 100, y = 200 }
+}
+
+local plot: { [number]: { x: number; y: number } }
+local misplot: { [number]: { x: number; y: string } }
+
+plot = points
+misplot = points
+
+local events: { [number]: { k: 'move'; v: number } | { k: 'say'; v: string } }
+
+events = {
+    { k = 'move', v = 1 },
+    { k = 'say', v = 'hi' },
+    { k = 'move', v = 1 },
+    { k = 'say', v = 'hi' },
+    { k = 'move', v = 1 },
+    { k = 'say', v = 'hi' },
+    { k = 'move', v = 1 },
+    { k = 'say', v = 'hi' },
+    { k = 'move', v = 1 },
+    { k = 'say', v = 'hi' },
+    { k = 'move', v = 1 },
+    { k = 'say', v = 'hi' },
+    { k = 'move', v = 1 },
+    { k = 'say', v = 'hi' },
+    { k = 'move', v = 1 },
+    { k = 'say', v = 'hi' },
+    { k = 'move', v = 1 },
+    { k = 'say', v = 'hi' },
+    { k = 'move', v = 1 },
+    { k = 'say', v = 'hi' },
+    { k = 'move', v = 1 },
+    { k = 'say', v = 'hi' },
+    { k = 'move', v = 1 },
+    { k = 'say', v = 'hi' },
+    { k = 'move', v = 1 },
+    { k = 'say', v = 'hi' },
+    { k = 'move', v = 1 },
+    { k = 'say', v = 'hi' },
+    { k = 'move', v = 1 },
+    { k = 'say', v = 'hi' },
+    { k = 'move', v = 1 },
+    { k = 'say', v = 'hi' },
+    { k = 'move', v = 1 },
+    { k = 'say', v = 'hi' },
+    { k = 'move', v = 1 },
+    { k = 'say', v = 'hi' },
+    { k = 'move', v = 1 },
+    { k = 'say', v = 'hi' },
+    { k = 'move', v = 1 },
+    { k = 'say', v = 'hi' },
+    { k = 'move', v = 1 },
+    { k = 'say', v = 'hi' },
+    { k = 'move', v = 1 },
+    { k = 'say', v = 'hi' },
+    { k = 'move', v = 1 },
+    { k = 'say', v = 'hi' },
+    { k = 'move', v = 1 },
+    { k = 'say', v = 'hi' },
+    { k = 'move', v = 1 },
+    { k = 'say', v = 'hi' },
+    { k = 'move', v = 1 },
+    { k = 'say', v = 'hi' },
+    { k = 'move', v = 1 },
+    { k = 'say', v = 'hi' },
+    { k = 'move', v = 1 },
+    { k = 'say', v = 'hi' },
+    { k = 'move', v = 1 },
+    { k = 'say', v = 'hi' },
+    { k = 'move', v = 1 },
+    { k = 'say', v = 'hi' },
+    { k = 'move', v = 1 },
+    { k = 'say', v = 'hi' },
+    { k = 'move', v = 1 },
+    { k = 'say', v = 'hi' },
+    { k = 'move', v = 1 },
+    { k = 'say', v = 'hi' },
+    { k = 'move', v = 1 },
+    { k = 'say', v = 'hi' },
+    { k = 'move', v = 1 },
+    { k = 'say', v = 'hi' },
+}
@@ -0,0 +1,14 @@
+interface Key: 'up' | 'down' | 'left' | 'right' | 'a' | 'b' | 'x' | 'y' | 'start' | 'select' | 1 | 2 | 3
+
+local k: Key
+
+k = 'start'
+k = 3
+k = 'jump'
+k = 4
+
+local n: Key | number
+
+n = 4
+n = 'select'
+n = 'jump'
@@ -0,0 +1,94 @@
+#include "libs.hpp"
+#include "loader.hpp"
+#include "require.hpp"
+
+#include "lua.hpp"
+
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+// Modules kept by the loader must be checked again once a module they required changed,
+// even when they are asked for before it.
+
+namespace fs = std::filesystem;
+
+namespace {
+
+int failures = 0;
+
+void expect(bool condition, const std::string& what) {
+    if (!condition) {
+        std::cerr << "FAILED: " << what << "\n";
+        ++failures;
+    }
+}
+
+void write_file(const fs::path& path, const std::string& data) {
+    auto file = std::ofstream(path, std::ios::binary | std::ios::trunc);
+    file << data;
+}
+
+// Runs `code`, and returns its error, or an empty string if it had none.
+std::string run(lua_State* L, const std::string& code) {
+    if (luaL_loadstring(L, code.c_str()) != 0 || lua_pcall(L, 0, 0, 0) != 0) {
+        auto message = std::string(lua_tostring(L, -1));
+        lua_pop(L, 1);
+        return message.empty() ? "error" : message;
+    }
+
+    return {};
+}
+
+} // static
+
+int main(int argc, char* argv[]) {
+    const auto directory = fs::path(argc > 1 ? argv[1] : "module-cache-test");
+    fs::remove_all(directory);
+    fs::create_directories(directory);
+
+    write_file(directory / "a.lua", "return {v = 1}\n");
+    write_file(directory / "b.lua", "local n: string\nn = require('a').v\nreturn {}\n");
+    write_file(directory / "c.lua", "local n: number\nn = require('b2').v\nreturn {}\n");
+    write_file(directory / "b2.lua", "return require('a2')\n");
+    write_file(directory / "a2.lua", "return {v = 1}\n");
+
+    auto deferred = typedlua::DeferredTypeCollection{};
+    auto scope = typedlua::Scope(&typedlua::libs::prelude(), &deferred);
+
+    auto L = luaL_newstate();
+    luaL_openlibs(L);
+
+    typedlua::install_loader(L, scope);
+    typedlua::install_require(L, scope);
+
+    expect(run(L, "package.path = '" + (directory / "?.lua").generic_string() + "'").empty(), "package.path is set");
+
+    auto reload = [&](const std::string& name) {
+        return run(L, "package.loaded['" + name + "'] = nil\nrequire('" + name + "')");
+    };
+
+    expect(reload("b").find("Cannot assign") != std::string::npos, "b does not check against the first a");
+
+    write_file(directory / "a.lua", "return {v = 'str'}\n");
+    expect(reload("b").empty(), "b checks against the changed a, asked for first");
+    expect(reload("a").empty(), "changed a loads");
+    expect(reload("b").empty(), "b is still reused");
+
+    write_file(directory / "a.lua", "return {v = 2}\n");
+    expect(reload("b").find("Cannot assign") != std::string::npos, "b checks against a once it changes back");
+
+    // Through a module that did not change itself.
+    expect(reload("c").empty(), "c checks against the first a2");
+
+    write_file(directory / "a2.lua", "return {v = 'str'}\n");
+    expect(reload("c").find("Cannot assign") != std::string::npos, "c checks against the changed a2 through b2");
+
+    lua_close(L);
+
+    fs::remove_all(directory);
+
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
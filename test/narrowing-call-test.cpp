@@ -0,0 +1,84 @@
+#include "libs.hpp"
+#include "typedlua_compiler.hpp"
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// A table whose fields were narrowed into sums is still accepted where its own type is expected.
+
+namespace {
+
+int failures = 0;
+
+void expect(bool condition, const std::string& what) {
+    if (!condition) {
+        std::cerr << "FAILED: " << what << "\n";
+        ++failures;
+    }
+}
+
+std::vector<typedlua::CompileError> check_source(const std::string& source) {
+    auto [tree, errors] = typedlua::parse(source);
+
+    if (!tree || !errors.empty()) {
+        return errors;
+    }
+
+    auto deferred = typedlua::DeferredTypeCollection{};
+    auto scope = typedlua::Scope(&typedlua::libs::prelude(), &deferred);
+
+    return typedlua::check(*tree, scope);
+}
+
+std::string messages(const std::vector<typedlua::CompileError>& errors) {
+    auto result = std::string{};
+
+    for (const auto& error : errors) {
+        result += error.message + "\n";
+    }
+
+    return result;
+}
+
+} // static
+
+int main() {
+    {
+        auto errors = check_source(
+            "local x = {}\n"
+            "x.a = 7\n"
+            "x.a = 'horse'\n"
+            "function x:method(n: number)\n"
+            "    return self.a\n"
+            "end\n"
+            "function x:call_method()\n"
+            "    return self:method(42)\n"
+            "end\n"
+            "x:method(1)\n"
+            "local function g(t: {a: 7|'horse'})\n"
+            "end\n"
+            "g(x)\n");
+
+        expect(errors.empty(), "narrowed table is passed as itself:\n" + messages(errors));
+    }
+
+    {
+        auto errors = check_source(
+            "local x = {}\n"
+            "x.a = 7\n"
+            "x.a = 'horse'\n"
+            "local function f(t: {a: number})\n"
+            "end\n"
+            "f(x)\n");
+
+        auto text = messages(errors);
+
+        expect(errors.size() == 1, "narrowed field that does not fit is reported:\n" + text);
+        expect(text.find("Cannot assign `'horse'` to `number`") != std::string::npos, "the member that does not fit is named:\n" + text);
+        expect(text.find("Cannot assign `7|'horse'` to `7|'horse'`") == std::string::npos, "no sum is rejected by itself:\n" + text);
+    }
+
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
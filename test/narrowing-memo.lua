@@ -0,0 +1,15 @@
+interface Point: { x: number; y: number }
+
+local p: Point
+local q: Point
+
+local t = {}
+
+t.x = 1
+t.y = 2
+
+p = t
+
+t.x = 'oops'
+
+q = t
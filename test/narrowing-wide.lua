@@ -0,0 +1,31 @@
+local m = {}
+
+m.f1 = 1
+m.f2 = 2
+m.f3 = 3
+m.f4 = 4
+m.f5 = 5
+m.f6 = 6
+m.f7 = 7
+m.f8 = 8
+m.f9 = 9
+m.f10 = 10
+m.f11 = 11
+m.f12 = 12
+
+m.f3 = 'three'
+m.f11 = 'eleven'
+
+function m:get_f12()
+    return self.f12
+end
+
+function m:get_f3()
+    return self.f3
+end
+
+local ok: { f1: number; f3: number | string; f12: number }
+local bad: { f11: number }
+
+ok = m
+bad = m
@@ -0,0 +1,24 @@
+global pick:
+    ((): string) &
+    ((x: number): number) &
+    ((x: string, y: number | nil): boolean) &
+    ((x: { n: number }): string) &
+    ((f: (): void, ...): number)
+
+pick = nil
+
+local a: string = pick()
+local b: number = pick(1)
+local c: boolean = pick('x')
+local d: boolean = pick('x', 2)
+local e: string = pick({ n = 1 })
+local f: number = pick(function () end, 1, 2, 3)
+
+-- Repeated calls resolve the same way.
+local g: number = pick(1)
+local h: boolean = pick('x', 2)
+
+-- No overload takes these.
+local i = pick(true)
+local j = pick('x', 'y')
+local k = pick(1, 2)
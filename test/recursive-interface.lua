@@ -0,0 +1,15 @@
+interface ListA: { val: number; next: ListA|nil }
+
+interface ListB: { val: number; next: ListB|nil }
+
+interface ListC: { val: string; next: ListC|nil }
+
+local a: ListA
+local b: ListB
+local c: ListC
+
+b = a
+
+c = a
+
+a = b
@@ -0,0 +1,92 @@
+#include "assign_cache.hpp"
+#include "type.hpp"
+#include "type_identity.hpp"
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Folding a sum into a sum must not let the result share a member index with a copy that the probes kept.
+
+namespace {
+
+int failures = 0;
+
+void expect(bool condition, const std::string& what) {
+    if (!condition) {
+        std::cerr << "FAILED: " << what << "\n";
+        ++failures;
+    }
+}
+
+typedlua::Type make_literals(char first, char last) {
+    auto types = std::vector<typedlua::Type>{};
+
+    for (auto c = first; c <= last; ++c) {
+        types.push_back(typedlua::Type::make_literal(std::string(1, c)));
+    }
+
+    return typedlua::Type::make_sum(std::move(types));
+}
+
+// Whether `sum` has exactly the members from `first` to `last`, and its index finds each of them.
+void expect_members(const typedlua::Type& sum, char first, char last, const std::string& what) {
+    expect(sum.get_tag() == typedlua::Type::Tag::SUM, what + " is a sum");
+
+    if (sum.get_tag() != typedlua::Type::Tag::SUM) {
+        return;
+    }
+
+    const auto& members = sum.get_sum();
+    expect(members.types.size() == std::size_t(last - first + 1), what + " has every member once");
+
+    for (auto c = 'a'; c <= 'z'; ++c) {
+        auto literal = typedlua::Type::make_literal(std::string(1, c));
+        auto expected = c >= first && c <= last;
+        auto name = what + " member '" + c + "'";
+
+        expect(typedlua::has_literal(members, literal.get_literal()) == expected, name + " is indexed");
+        expect(typedlua::can_assign(sum, literal) == expected, name + " is assignable");
+    }
+}
+
+} // static
+
+int main() {
+    auto cache = typedlua::AssignCache{};
+    auto store = typedlua::TypeStore{};
+
+    auto lhs = typedlua::intern(make_literals('a', 'h'));
+    auto rhs = typedlua::intern(make_literals('i', 'p'));
+    auto other = typedlua::intern(make_literals('i', 'l'));
+
+    // Warms the cache and the store with the same fold.
+    auto warm = typedlua::intern(lhs | rhs);
+    expect_members(warm, 'a', 'p', "warm fold");
+
+    auto folded = lhs | rhs;
+    auto folded_other = lhs | other;
+
+    expect_members(folded, 'a', 'p', "fold");
+    expect_members(folded_other, 'a', 'l', "other fold");
+    expect_members(warm, 'a', 'p', "warm fold afterwards");
+    expect_members(lhs, 'a', 'h', "left operand");
+
+    // Adding to a copy of a sum leaves the index of the original alone, whoever does it.
+    {
+        auto original = make_literals('a', 'h');
+        auto copy = original;
+        auto grown = std::move(copy) | typedlua::Type::make_literal(std::string("i"));
+
+        expect_members(grown, 'a', 'i', "sum grown in place");
+        expect_members(original, 'a', 'h', "sum shared with the one grown in place");
+
+        auto members = original.get_sum();
+        typedlua::add_sum_member(members, typedlua::Type::make_literal(std::string("j")));
+
+        expect(typedlua::has_literal(members, typedlua::LiteralType(std::string("j"))), "copied members index the added one");
+        expect_members(original, 'a', 'h', "sum whose members were copied");
+    }
+
+    return failures == 0 ? 0 : 1;
+}